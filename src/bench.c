@@ -0,0 +1,406 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader benchmarks.
+ *
+ * Times the bootloader's computational kernels on representative inputs: 1K
+ * YMODEM packets, 4K FLASH sectors and a multi-megabyte Intel Hex file built
+ * in DDR. Built with SF2BL_BENCH, by "make bench" for the board or
+ * "make host_bench" for the host, the bootloader runs these in place of its
+ * normal job and prints one CSV line per measurement:
+ *
+ *   bench,kernel,bytes,iterations,cycles,cycles_per_byte,mb_per_s
+ *
+ * bytes is per iteration. On the board cycles come from mcycle. On the host
+ * they come from the time stamp counter where there is one, with MB/s from
+ * the wall clock.
+ *
+ * The flash_erase and flash_program lines are an update of a whole
+ * SF2BL_IMAGE_SIZE slot, which overwrites image 1. Their MB/s, and that of the
+ * spi_read lines, is from the virtual clock on the host. So it is what the
+ * board would take with the typical program and erase times of the emulated
+ * N25Q00AA and the register accesses the CoreSPI driver makes.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sf2_bl_defs.h"
+#include "sf2_bl_options.h"
+#include "hw_platform.h"
+#include "spi_flash.h"
+#include "image_tools.h"
+#include "intel_hex.h"
+#include "crc32.h"
+#include "ymodem.h"
+#include "bench.h"
+
+#if defined(SF2BL_BENCH)
+
+#if defined(SF2BL_HOST)
+#include <time.h>
+#include "host.h"
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#else
+#include "encoding.h"
+#endif
+
+#define BENCH_HEX_BIN_SIZE  0x200000u /* Binary size of hex file, ~5.6MB of hex */
+#define BENCH_HEX_REC_LEN   16u
+#define BENCH_SPI_STRIDE    4096u     /* Spread SPI reads over the FLASH */
+
+typedef struct bench_time
+{
+    uint64_t cycles;
+    uint64_t ns;
+} bench_time_t;
+
+static volatile uint32_t g_bench_sink; /* Keeps results from being optimised out */
+
+/***************************************************************************//**
+ * Read the cycle counter and wall clock.
+ */
+static void bench_now(bench_time_t *ptime)
+{
+#if defined(SF2BL_HOST)
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ptime->ns = ((uint64_t)now.tv_sec * 1000000000ull) + (uint64_t)now.tv_nsec;
+#if defined(__x86_64__)
+    ptime->cycles = __rdtsc();
+#else
+    ptime->cycles = ptime->ns;
+#endif
+#else
+    uint32_t hi;
+    uint32_t lo;
+
+    do {
+        hi = read_csr(mcycleh);
+        lo = read_csr(mcycle);
+    } while(hi != read_csr(mcycleh));
+
+    ptime->cycles = ((uint64_t)hi << 32) | lo;
+    ptime->ns     = (ptime->cycles * 1000ull) / (SYS_CLK_FREQ / 1000000ull);
+#endif
+}
+
+static void put_u64(uint64_t value)
+{
+    uint8_t digits[21];
+    int32_t index;
+
+    index = 20;
+    digits[index] = 0;
+    do
+    {
+        digits[--index] = (uint8_t)('0' + (value % 10u));
+        value /= 10u;
+    } while(0u != value);
+
+    _putstring(&digits[index]);
+}
+
+/***************************************************************************//**
+ * Print value / 1000 with 3 decimal places.
+ */
+static void put_milli(uint64_t value)
+{
+    uint8_t fraction[5];
+
+    put_u64(value / 1000u);
+    fraction[0] = '.';
+    fraction[1] = (uint8_t)('0' + ((value / 100u) % 10u));
+    fraction[2] = (uint8_t)('0' + ((value / 10u) % 10u));
+    fraction[3] = (uint8_t)('0' + (value % 10u));
+    fraction[4] = 0;
+    _putstring(fraction);
+}
+
+/***************************************************************************//**
+ * Print the result line for iterations of len bytes between start and end.
+ */
+static void bench_report(const char *kernel, uint32_t len, uint32_t iterations,
+                         const bench_time_t *pstart, const bench_time_t *pend)
+{
+    uint64_t cycles;
+    uint64_t ns;
+    uint64_t total;
+
+    cycles = pend->cycles - pstart->cycles;
+    ns     = pend->ns - pstart->ns;
+    total  = (uint64_t)len * iterations;
+    ns     = (0u == ns) ? 1u : ns;
+
+    _putstring((uint8_t *)"bench,");
+    _putstring((uint8_t *)kernel);
+    _putstring((uint8_t *)",");
+    put_u64(len);
+    _putstring((uint8_t *)",");
+    put_u64(iterations);
+    _putstring((uint8_t *)",");
+    put_u64(cycles);
+    _putstring((uint8_t *)",");
+    put_milli((cycles * 1000u) / total);
+    _putstring((uint8_t *)",");
+    put_milli((total * 1000000ull) / ns);
+    _putstring((uint8_t *)"\r\n");
+}
+
+static void bench_crc32(const uint8_t *data, uint32_t len, uint32_t iterations)
+{
+    bench_time_t start;
+    bench_time_t end;
+    uint32_t count;
+    uint32_t crc = 0xFFFFFFFF;
+
+    bench_now(&start);
+    for(count = 0; count < iterations; count++)
+    {
+        crc = sf2bl_calc_crc32(crc, data, len);
+    }
+    bench_now(&end);
+    g_bench_sink = crc;
+    bench_report("crc32", len, iterations, &start, &end);
+}
+
+static void bench_crc16(const uint8_t *data, uint32_t len, uint32_t iterations)
+{
+    bench_time_t start;
+    bench_time_t end;
+    uint32_t count;
+    uint32_t crc = 0;
+
+    bench_now(&start);
+    for(count = 0; count < iterations; count++)
+    {
+        crc += sf2bl_crc16(data, len);
+    }
+    bench_now(&end);
+    g_bench_sink = crc;
+    bench_report("crc16", len, iterations, &start, &end);
+}
+
+static void bench_memcpy(const char *kernel, uint8_t *dest, const uint8_t *src, uint32_t len, uint32_t iterations)
+{
+    bench_time_t start;
+    bench_time_t end;
+    uint32_t count;
+
+    bench_now(&start);
+    for(count = 0; count < iterations; count++)
+    {
+        memcpy(dest, src, len);
+    }
+    bench_now(&end);
+    g_bench_sink = dest[len - 1u];
+    bench_report(kernel, len, iterations, &start, &end);
+}
+
+/***************************************************************************//**
+ * Read the clock for the SPI FLASH, which on the host is the time the
+ * emulated hardware has taken.
+ */
+static void bench_flash_now(bench_time_t *ptime)
+{
+    bench_now(ptime);
+#if defined(SF2BL_HOST)
+    ptime->ns = host_clock_ns();
+#endif
+}
+
+/***************************************************************************//**
+ * spi_flash_read() of len bytes, which for small reads is dominated by the
+ * command and address framing and the transfer set up.
+ */
+static void bench_spi_read(uint32_t len, uint32_t iterations)
+{
+    bench_time_t start;
+    bench_time_t end;
+    uint32_t count;
+
+    bench_flash_now(&start);
+    for(count = 0; count < iterations; count++)
+    {
+        spi_flash_read(SF2BL_FLASH_BASE + (count * BENCH_SPI_STRIDE), g_sector_buffer, len);
+    }
+    bench_flash_now(&end);
+    bench_report("spi_read", len, iterations, &start, &end);
+}
+
+/***************************************************************************//**
+ * Erase and program the image 1 slot as sf2bl_wr_flash_image() would for an
+ * image filling it, one sector buffer at a time.
+ */
+static void bench_flash_update(void)
+{
+    bench_time_t start;
+    bench_time_t end;
+    uint32_t offset;
+    uint32_t len;
+    spi_flash_status_t status;
+
+    bench_flash_now(&start);
+    status = spi_flash_erase(g_img1_offset, SF2BL_IMAGE_SIZE);
+    bench_flash_now(&end);
+    bench_report("flash_erase", SF2BL_IMAGE_SIZE, 1u, &start, &end);
+
+    /* The SPI read kernels leave FLASH contents in the buffer */
+    for(offset = 0; offset < sizeof(g_sector_buffer); offset++)
+    {
+        g_sector_buffer[offset] = (uint8_t)(offset * 7u);
+    }
+
+    bench_flash_now(&start);
+    for(offset = 0; (SPI_FLASH_SUCCESS == status) && (offset < SF2BL_IMAGE_SIZE); offset += len)
+    {
+        len = SF2BL_IMAGE_SIZE - offset;
+        len = (len < sizeof(g_sector_buffer)) ? len : sizeof(g_sector_buffer);
+        status = spi_flash_write(g_img1_offset + offset, g_sector_buffer, len, 0);
+    }
+    bench_flash_now(&end);
+    g_bench_sink = (uint32_t)status;
+    bench_report("flash_program", SF2BL_IMAGE_SIZE, 1u, &start, &end);
+}
+
+static uint8_t *put_hex_byte(uint8_t *dest, uint32_t value, uint8_t *pchecksum)
+{
+    static const uint8_t hex_digits[] = "0123456789ABCDEF";
+
+    *pchecksum = (uint8_t)(*pchecksum + value);
+    *dest++ = hex_digits[(value >> 4) & 0x0Fu];
+    *dest++ = hex_digits[value & 0x0Fu];
+
+    return(dest);
+}
+
+/***************************************************************************//**
+ * Write one Intel Hex record at dest and return the end of it.
+ */
+static uint8_t *put_hex_record(uint8_t *dest, uint32_t type, uint32_t offset, const uint8_t *data, uint32_t count)
+{
+    uint8_t checksum = 0;
+    uint32_t index;
+
+    *dest++ = ':';
+    dest = put_hex_byte(dest, count, &checksum);
+    dest = put_hex_byte(dest, (offset >> 8) & 0xFFu, &checksum);
+    dest = put_hex_byte(dest, offset & 0xFFu, &checksum);
+    dest = put_hex_byte(dest, type, &checksum);
+    for(index = 0; index < count; index++)
+    {
+        dest = put_hex_byte(dest, data[index], &checksum);
+    }
+    dest = put_hex_byte(dest, (uint32_t)(0x100u - checksum) & 0xFFu, &checksum);
+    *dest++ = '\r';
+    *dest++ = '\n';
+
+    return(dest);
+}
+
+/***************************************************************************//**
+ * Build an Intel Hex file of BENCH_HEX_BIN_SIZE bytes of data at g_rx_base,
+ * laid out as the GNU tools would for an application at SF2BL_DDR_BASE.
+ *
+ * Returns the length of the file.
+ */
+static uint32_t bench_make_hex(void)
+{
+    uint8_t *dest = g_rx_base;
+    uint8_t data[BENCH_HEX_REC_LEN];
+    uint8_t address[2];
+    uint32_t load;
+    uint32_t index;
+    uint32_t seed = 0x12345678u;
+
+    for(load = 0; load < BENCH_HEX_BIN_SIZE; load += BENCH_HEX_REC_LEN)
+    {
+        if(0u == (load & 0xFFFFu))
+        {
+            address[0] = (uint8_t)(((SF2BL_DDR_BASE + load) >> 24) & 0xFFu);
+            address[1] = (uint8_t)(((SF2BL_DDR_BASE + load) >> 16) & 0xFFu);
+            dest = put_hex_record(dest, IHEX_EXLIN_ADDR, 0u, address, 2u);
+        }
+
+        for(index = 0; index < BENCH_HEX_REC_LEN; index++)
+        {
+            seed = (seed * 1103515245u) + 12345u;
+            data[index] = (uint8_t)(seed >> 16);
+        }
+        dest = put_hex_record(dest, IHEX_DATA, load & 0xFFFFu, data, BENCH_HEX_REC_LEN);
+    }
+    dest = put_hex_record(dest, IHEX_EOF, 0u, data, 0u);
+
+    return((uint32_t)(dest - g_rx_base));
+}
+
+static void bench_hex(void)
+{
+    bench_time_t start;
+    bench_time_t end;
+    uint8_t *data;
+    int32_t remaining;
+    int32_t consumed;
+    uint32_t hex_len;
+    uint32_t records = 0;
+
+    hex_len = bench_make_hex();
+
+    /* Record decoding alone */
+    data      = g_rx_base;
+    remaining = (int32_t)hex_len;
+    bench_now(&start);
+    do {
+        consumed = sf2bl_hex_record(data, remaining);
+        if(consumed >= 0)
+        {
+            data      += consumed + 2; /* Skip CR LF */
+            remaining -= consumed + 2;
+            records++;
+        }
+    } while((consumed >= 0) && (IHEX_EOF != g_hex_record.type) && (remaining > 0));
+    bench_now(&end);
+    g_bench_sink = records;
+    bench_report("hex_record", hex_len, 1u, &start, &end);
+
+    /* Whole file to binary image */
+    bench_now(&start);
+    g_bench_sink = sf2bl_process_hex_file((int32_t)hex_len);
+    bench_now(&end);
+    bench_report("hex_file", hex_len, 1u, &start, &end);
+}
+
+/***************************************************************************//**
+ * Run all the benchmarks.
+ */
+void sf2bl_bench(void)
+{
+    uint32_t index;
+
+    /* Something other than zeros to work on */
+    for(index = 0; index < sizeof(g_sector_buffer); index++)
+    {
+        g_sector_buffer[index] = (uint8_t)(index * 7u);
+    }
+
+    _putstring((uint8_t *)"bench,kernel,bytes,iterations,cycles,cycles_per_byte,mb_per_s\r\n");
+
+    bench_crc32(g_sector_buffer, 1024u, 1024u);
+    bench_crc32(g_sector_buffer, 4096u, 256u);
+    bench_crc16(g_sector_buffer, 1024u, 1024u);
+    bench_crc16(g_sector_buffer, 4096u, 256u);
+    bench_memcpy("memcpy_ddr", g_bin_base, g_sector_buffer, 4096u, 256u);
+    bench_memcpy("memcpy_ddr", g_bin_base, g_rx_base, 0x100000u, 4u);
+    bench_hex();
+    bench_spi_read(1u, 256u);
+    bench_spi_read(256u, 256u);
+    bench_spi_read(4096u, 64u);
+    bench_flash_update();
+}
+#endif
@@ -0,0 +1,17 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader benchmark header.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#if defined(SF2BL_BENCH)
+void sf2bl_bench(void);
+#endif
+
+#endif /* BENCH_H_ */
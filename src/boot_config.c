@@ -0,0 +1,475 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader configuration store routines.
+ *
+ * A small key/value store in the SF2BL_CONFIG_SIZE area, so settings like the
+ * YMODEM baud rate can be changed without a new build. See boot_config.h for
+ * the layout.
+ *
+ * At boot the two bank headers are read to pick the current bank, then its
+ * records are read in order through a window of CONFIG_SCAN_LEN bytes, which
+ * normally takes one read, to build an index in RAM of where the latest value
+ * of each key is. Lookups use the index and only read the value itself.
+ *
+ * New records are appended to the current bank. When it is full, or a record
+ * in it turned out to be bad, the live records are copied into the other bank
+ * a page at a time and its header written last with the next generation, so
+ * the old bank stays current until the copy is complete.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sf2_bl_defs.h"
+#include "sf2_bl_options.h"
+#include "spi_flash.h"
+#include "crc32.h"
+#include "boot_config.h"
+
+#if defined(SF2BL_CONFIG_STORE)
+
+#define CONFIG_BASE (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096))
+
+#if defined(SF2BL_SPI_CALIBRATE)
+/* The last sector is left for the calibration record */
+#define CONFIG_BANK_SECTORS ((SF2BL_CONFIG_SIZE - 1) / 2)
+#else
+#define CONFIG_BANK_SECTORS (SF2BL_CONFIG_SIZE / 2)
+#endif
+
+#define CONFIG_BANK_SIZE    (CONFIG_BANK_SECTORS * 4096u)
+#define CONFIG_BANK_ADDR(bank) (CONFIG_BASE + ((bank) * CONFIG_BANK_SIZE))
+#define CONFIG_NO_BANK      0xFFFFFFFFu
+
+#define CONFIG_MAX_KEYS     32u
+#define CONFIG_SCAN_LEN     256u /* Read window, must hold the largest record */
+#define CONFIG_PAGE_LEN     256u /* Records staged for each write when copying */
+
+#define CONFIG_REC_LEN(len) (sizeof(sf2bl_config_rec_t) + (((len) + 3u) & ~3u))
+
+typedef struct config_entry
+{
+    uint16_t key;
+    uint16_t len;
+    uint32_t addr;           /* Address of value in SPI FLASH */
+} config_entry_t;
+
+typedef struct config_store
+{
+    uint32_t bank;           /* Current bank or CONFIG_NO_BANK */
+    uint32_t generation;     /* Its generation */
+    uint32_t end;            /* Address after the last record */
+    uint32_t dirty;          /* Bad record found, copy before appending */
+    uint32_t n_keys;
+    config_entry_t keys[CONFIG_MAX_KEYS];
+} config_store_t;
+
+static config_store_t g_config;
+
+/* Read window for scanning, also used to stage records for writing */
+static uint8_t g_config_buf[CONFIG_SCAN_LEN];
+
+/***************************************************************************//**
+ * Calculate the CRC32 of a record.
+ */
+static uint32_t config_rec_crc(const sf2bl_config_rec_t *prec, const uint8_t *value)
+{
+    uint32_t crc;
+
+    crc = sf2bl_calc_crc32(0xFFFFFFFF, (const uint8_t *)prec, 2u * sizeof(uint16_t));
+
+    return(sf2bl_calc_crc32(crc, value, prec->len));
+}
+
+/***************************************************************************//**
+ * Find a key in the index.
+ *
+ * Returns the entry or 0 if the key is not set.
+ */
+static config_entry_t *config_find(uint16_t key)
+{
+    config_entry_t *return_val = 0;
+    uint32_t index;
+
+    for(index = 0; (0 == return_val) && (index < g_config.n_keys); index++)
+    {
+        if(key == g_config.keys[index].key)
+        {
+            return_val = &g_config.keys[index];
+        }
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Update the index for a record whose value is at addr.
+ *
+ * Returns 0 for success or -1 if the index is full.
+ */
+static int32_t config_index(uint16_t key, uint16_t len, uint32_t addr)
+{
+    config_entry_t *pentry;
+    int32_t return_val = 0;
+
+    pentry = config_find(key);
+    if(0u == len)
+    {
+        if(0 != pentry)
+        {
+            /* Deleted, move the last entry into its place */
+            g_config.n_keys--;
+            *pentry = g_config.keys[g_config.n_keys];
+        }
+    }
+    else
+    {
+        if((0 == pentry) && (g_config.n_keys < CONFIG_MAX_KEYS))
+        {
+            pentry = &g_config.keys[g_config.n_keys];
+            pentry->key = key;
+            g_config.n_keys++;
+        }
+
+        if(0 != pentry)
+        {
+            pentry->len  = len;
+            pentry->addr = addr;
+        }
+        else
+        {
+            return_val = -1;
+        }
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Get the generation of a bank.
+ *
+ * Returns 0 for success or -1 if it does not have a good header.
+ */
+static int32_t config_bank_generation(uint32_t bank, uint32_t *pgeneration)
+{
+    sf2bl_config_bank_t header;
+    int32_t return_val = -1;
+
+    if((SPI_FLASH_SUCCESS == spi_flash_read(CONFIG_BANK_ADDR(bank), (uint8_t *)&header, sizeof(header))) &&
+       (SF2BL_CONFIG_MAGIC == header.magic) && (CONFIG_BANK_SIZE == header.bank_size) &&
+       (header.crc32 == sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)&header, sizeof(header) - sizeof(uint32_t))))
+    {
+        *pgeneration = header.generation;
+        return_val = 0;
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Build the index from the records in the current bank. Reading stops at the
+ * first erased record header or at a bad record, which marks the bank dirty.
+ */
+static void config_scan(void)
+{
+    sf2bl_config_rec_t rec;
+    uint32_t bank_end;
+    uint32_t window = 0u;     /* Address of data in g_config_buf */
+    uint32_t window_len = 0u;
+    uint32_t pos;
+    int32_t done = 0;
+
+    g_config.n_keys = 0u;
+    g_config.dirty  = 0u;
+    pos      = CONFIG_BANK_ADDR(g_config.bank) + sizeof(sf2bl_config_bank_t);
+    bank_end = CONFIG_BANK_ADDR(g_config.bank) + CONFIG_BANK_SIZE;
+
+    while((0 == done) && ((pos + sizeof(rec)) <= bank_end))
+    {
+        /* Move the window on if the largest record might not be in it */
+        if((pos + CONFIG_REC_LEN(SF2BL_CONFIG_MAX_VALUE)) > (window + window_len))
+        {
+            window     = pos;
+            window_len = ((bank_end - pos) < CONFIG_SCAN_LEN) ? (bank_end - pos) : CONFIG_SCAN_LEN;
+            if(SPI_FLASH_SUCCESS != spi_flash_read(window, g_config_buf, window_len))
+            {
+                g_config.dirty = 1u;
+                done = 1;
+            }
+        }
+
+        if(0 == done)
+        {
+            memcpy(&rec, &g_config_buf[pos - window], sizeof(rec));
+            if((SF2BL_CONFIG_NO_KEY == rec.key) && (0xFFFFu == rec.len) && (0xFFFFFFFFu == rec.crc32))
+            {
+                done = 1;
+            }
+            else if((rec.len > SF2BL_CONFIG_MAX_VALUE) || ((pos + CONFIG_REC_LEN(rec.len)) > bank_end) ||
+                    (rec.crc32 != config_rec_crc(&rec, &g_config_buf[(pos - window) + sizeof(rec)])))
+            {
+                /* Probably a write cut short, nothing after it can be trusted */
+                g_config.dirty = 1u;
+                done = 1;
+            }
+            else
+            {
+                (void)config_index(rec.key, rec.len, pos + sizeof(rec));
+                pos += CONFIG_REC_LEN(rec.len);
+            }
+        }
+    }
+
+    g_config.end = pos;
+}
+
+/***************************************************************************//**
+ * Find the current bank and index its records.
+ */
+void sf2bl_config_init(void)
+{
+    uint32_t generation0;
+    uint32_t generation1;
+    int32_t ok0;
+    int32_t ok1;
+
+    memset(&g_config, 0, sizeof(g_config));
+    g_config.bank = CONFIG_NO_BANK;
+
+    ok0 = config_bank_generation(0u, &generation0);
+    ok1 = config_bank_generation(1u, &generation1);
+    if((0 == ok1) && ((0 != ok0) || ((int32_t)(generation1 - generation0) > 0)))
+    {
+        g_config.bank       = 1u;
+        g_config.generation = generation1;
+    }
+    else if(0 == ok0)
+    {
+        g_config.bank       = 0u;
+        g_config.generation = generation0;
+    }
+
+    if(CONFIG_NO_BANK != g_config.bank)
+    {
+        config_scan();
+    }
+}
+
+/***************************************************************************//**
+ * Get the value of a key, up to len bytes of it.
+ *
+ * Returns the length of the value or -1 if the key is not set.
+ */
+int32_t sf2bl_config_get(uint16_t key, uint8_t *value, uint32_t len)
+{
+    config_entry_t *pentry;
+    int32_t return_val = -1;
+
+    pentry = config_find(key);
+    if(0 != pentry)
+    {
+        len = (len < pentry->len) ? len : pentry->len;
+        if(SPI_FLASH_SUCCESS == spi_flash_read(pentry->addr, value, len))
+        {
+            return_val = (int32_t)pentry->len;
+        }
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Get a 32 bit value, default_value if it is not set or is the wrong size.
+ */
+uint32_t sf2bl_config_get_u32(uint16_t key, uint32_t default_value)
+{
+    uint32_t value;
+
+    if((int32_t)sizeof(value) != sf2bl_config_get(key, (uint8_t *)&value, sizeof(value)))
+    {
+        value = default_value;
+    }
+
+    return(value);
+}
+
+/***************************************************************************//**
+ * Put a record in g_config_buf at offset.
+ *
+ * Returns the length of the record.
+ */
+static uint32_t config_stage(uint32_t offset, uint16_t key, const uint8_t *value, uint32_t len)
+{
+    sf2bl_config_rec_t rec;
+    uint32_t rec_len;
+
+    rec.key   = key;
+    rec.len   = (uint16_t)len;
+    rec.crc32 = config_rec_crc(&rec, value);
+    rec_len   = CONFIG_REC_LEN(len);
+    memset(&g_config_buf[offset], 0xFF, rec_len);
+    memcpy(&g_config_buf[offset], &rec, sizeof(rec));
+    if(0u != len)
+    {
+        memcpy(&g_config_buf[offset + sizeof(rec)], value, len);
+    }
+
+    return(rec_len);
+}
+
+/***************************************************************************//**
+ * Copy the live records, replacing or deleting key, into the other bank and
+ * make that the current one. The records are staged in g_config_buf and
+ * written up to CONFIG_PAGE_LEN bytes at a time.
+ *
+ * Returns 0 for success or -1 for error, in which case the current bank is
+ * unchanged.
+ */
+static int32_t config_copy(uint16_t key, const uint8_t *value, uint32_t len)
+{
+    uint8_t old_value[SF2BL_CONFIG_MAX_VALUE];
+    sf2bl_config_bank_t header;
+    spi_flash_status_t flash_result;
+    config_entry_t *pentry;
+    const uint8_t *rec_value;
+    uint16_t rec_key;
+    uint32_t rec_len;
+    uint32_t bank;
+    uint32_t write_addr;
+    uint32_t staged = 0u;
+    uint32_t index;
+    int32_t return_val = -1;
+
+    bank = (0u == g_config.bank) ? 1u : 0u;
+    write_addr = CONFIG_BANK_ADDR(bank) + sizeof(sf2bl_config_bank_t);
+    flash_result = spi_flash_erase(CONFIG_BANK_ADDR(bank), CONFIG_BANK_SIZE);
+
+    /* Every other key and then key itself, unless it is being deleted */
+    for(index = 0; (SPI_FLASH_SUCCESS == flash_result) && (index <= g_config.n_keys); index++)
+    {
+        rec_key   = key;
+        rec_value = value;
+        rec_len   = len;
+        if(index < g_config.n_keys)
+        {
+            pentry    = &g_config.keys[index];
+            rec_key   = pentry->key;
+            rec_value = old_value;
+            rec_len   = (key == pentry->key) ? 0u : pentry->len;
+            if(0u != rec_len)
+            {
+                flash_result = spi_flash_read(pentry->addr, old_value, rec_len);
+            }
+        }
+
+        if((SPI_FLASH_SUCCESS == flash_result) && (0u != rec_len))
+        {
+            if((staged + CONFIG_REC_LEN(rec_len)) > CONFIG_PAGE_LEN)
+            {
+                flash_result = spi_flash_write(write_addr, g_config_buf, staged, 0);
+                write_addr += staged;
+                staged = 0u;
+            }
+
+            if((write_addr + staged + CONFIG_REC_LEN(rec_len)) > (CONFIG_BANK_ADDR(bank) + CONFIG_BANK_SIZE))
+            {
+                flash_result = SPI_FLASH_UNSUCCESS;
+            }
+            else
+            {
+                staged += config_stage(staged, rec_key, rec_value, rec_len);
+            }
+        }
+    }
+
+    if((SPI_FLASH_SUCCESS == flash_result) && (0u != staged))
+    {
+        flash_result = spi_flash_write(write_addr, g_config_buf, staged, 0);
+    }
+
+    if(SPI_FLASH_SUCCESS == flash_result)
+    {
+        /* Writing the header makes the new bank the current one */
+        header.magic      = SF2BL_CONFIG_MAGIC;
+        header.generation = g_config.generation + 1u;
+        header.bank_size  = CONFIG_BANK_SIZE;
+        header.crc32      = sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)&header, sizeof(header) - sizeof(uint32_t));
+        flash_result = spi_flash_write(CONFIG_BANK_ADDR(bank), (uint8_t *)&header, sizeof(header), 0);
+        if(SPI_FLASH_SUCCESS == flash_result)
+        {
+            g_config.bank       = bank;
+            g_config.generation = header.generation;
+            return_val = 0;
+        }
+    }
+
+    if(CONFIG_NO_BANK != g_config.bank)
+    {
+        config_scan();
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Set the value of a key, len 0 deleting it. The record is appended to the
+ * current bank if there is room, otherwise the bank is copied.
+ *
+ * Returns 0 for success or -1 for error.
+ */
+int32_t sf2bl_config_set(uint16_t key, const uint8_t *value, uint32_t len)
+{
+    spi_flash_status_t flash_result;
+    uint32_t rec_len;
+    int32_t return_val = -1;
+
+    if((SF2BL_CONFIG_NO_KEY != key) && (len <= SF2BL_CONFIG_MAX_VALUE) &&
+       ((0u == len) || (0 != config_find(key)) || (g_config.n_keys < CONFIG_MAX_KEYS)))
+    {
+        if((CONFIG_NO_BANK == g_config.bank) || (0u != g_config.dirty) ||
+           ((g_config.end + CONFIG_REC_LEN(len)) > (CONFIG_BANK_ADDR(g_config.bank) + CONFIG_BANK_SIZE)))
+        {
+            return_val = config_copy(key, value, len);
+        }
+        else
+        {
+            rec_len = config_stage(0u, key, value, len);
+            flash_result = spi_flash_write(g_config.end, g_config_buf, rec_len, 0);
+            if(SPI_FLASH_SUCCESS == flash_result)
+            {
+                (void)config_index(key, (uint16_t)len, g_config.end + sizeof(sf2bl_config_rec_t));
+                return_val = 0;
+            }
+            else
+            {
+                /* Whatever was written cannot be appended to */
+                g_config.dirty = 1u;
+            }
+            g_config.end += rec_len;
+        }
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Delete a key.
+ *
+ * Returns 0 for success or -1 for error.
+ */
+int32_t sf2bl_config_delete(uint16_t key)
+{
+    int32_t return_val = 0;
+
+    if(0 != config_find(key))
+    {
+        return_val = sf2bl_config_set(key, 0, 0u);
+    }
+
+    return(return_val);
+}
+#endif
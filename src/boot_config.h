@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader configuration store header.
+ *
+ * The store is kept in two banks at the start of the SF2BL_CONFIG_SIZE area.
+ * Each bank starts with a bank header, the bank with the newest generation
+ * being the current one, followed by records appended one after another. A
+ * record is a record header then len bytes of value padded to a multiple of
+ * 4 bytes. The latest record for a key holds its value and a record with a len
+ * of 0 deletes the key. The first erased record header ends the records.
+ *
+ * The layout is defined here so an application can use this header to read
+ * or add to the store.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef BOOT_CONFIG_H_
+#define BOOT_CONFIG_H_
+
+#define SF2BL_CONFIG_MAGIC     0x46434653u /* "SFCF" */
+#define SF2BL_CONFIG_MAX_VALUE 56u         /* Largest value in bytes */
+#define SF2BL_CONFIG_NO_KEY    0xFFFFu     /* Key of an erased record header */
+
+/*
+ * Keys used by the bootloader. Keys from 0x8000 to 0xFFFE are for the
+ * application.
+ */
+#define SF2BL_CONFIG_KEY_BAUD       0x0001u /* uint32_t YMODEM baud rate */
+#define SF2BL_CONFIG_KEY_BOOT_FLAGS 0x0002u /* uint32_t SF2BL_CONFIG_BOOT_xxx */
+#define SF2BL_CONFIG_KEY_PART_TAG   0x0003u /* uint32_t partition table slot tag */
+
+/*
+ * Boot flags.
+ */
+#define SF2BL_CONFIG_BOOT_UPDATE 0x00000001u /* Download an update, cleared once seen */
+
+typedef struct sf2bl_config_bank
+{
+    uint32_t magic;                 /* SF2BL_CONFIG_MAGIC */
+    uint32_t generation;            /* One more than the other bank's when written */
+    uint32_t bank_size;             /* Bytes in the bank */
+    uint32_t crc32;                 /* CRC32 of the header up to here */
+} sf2bl_config_bank_t;
+
+typedef struct sf2bl_config_rec
+{
+    uint16_t key;
+    uint16_t len;                   /* Bytes of value, 0 to delete the key */
+    uint32_t crc32;                 /* CRC32 of key, len and value */
+} sf2bl_config_rec_t;
+
+#if defined(SF2BL_CONFIG_STORE)
+void     sf2bl_config_init(void);
+int32_t  sf2bl_config_get(uint16_t key, uint8_t *value, uint32_t len);
+int32_t  sf2bl_config_set(uint16_t key, const uint8_t *value, uint32_t len);
+int32_t  sf2bl_config_delete(uint16_t key);
+uint32_t sf2bl_config_get_u32(uint16_t key, uint32_t default_value);
+#endif
+
+#endif /* BOOT_CONFIG_H_ */
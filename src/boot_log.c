@@ -0,0 +1,367 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader boot log routines.
+ *
+ * A record of each boot is appended to a circular log in the SF2BL_LOG_SIZE 4K
+ * sectors at SF2BL_FLASH_BASE. The sectors are used in turn, each one started
+ * by erasing it and writing a header with the next sector sequence number, so
+ * the oldest sector is recycled once the log is full and all the sectors wear
+ * evenly.
+ *
+ * Starting at sector 0 the sequence numbers go up by one from sector to
+ * sector as far as the newest, the head, and anything after that is older or
+ * unused. That lets the head be found with a binary search of the sector
+ * headers, and the first free slot in it with a binary search of its records
+ * as they are written in order.
+ *
+ * Records are queued in RAM and programmed together, the SPI FLASH driver
+ * writing up to a page at a time. Each header and record carries a CRC32 so
+ * a write cut short by a power failure only loses that record. A sector with a
+ * bad header counts as unused and is the next to be started, and a slot is
+ * only free if it is completely erased.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sf2_bl_defs.h"
+#include "sf2_bl_options.h"
+#include "spi_flash.h"
+#include "crc32.h"
+#include "image_tools.h"
+#include "ymodem.h"
+#include "boot_metrics.h"
+#include "boot_log.h"
+#include "boot_part.h"
+
+#if defined(SF2BL_BOOT_LOG)
+
+#define LOG_BASE  (SF2BL_FLASH_BASE)
+#define LOG_BATCH 4u /* Records queued, one page */
+
+#define LOG_SECTOR_ADDR(sector) (LOG_BASE + ((sector) * SF2BL_LOG_SECTOR_SIZE))
+#define LOG_SLOT_ADDR(sector, slot) (LOG_SECTOR_ADDR(sector) + ((slot) * SF2BL_LOG_RECORD_SIZE))
+
+typedef struct boot_log
+{
+    uint32_t found;       /* Head has been found */
+    uint32_t head;        /* Sector being filled */
+    uint32_t sequence;    /* Its sequence number, 0 if log is empty */
+    uint32_t slot;        /* Next free slot in it, from 1 */
+    uint32_t n_queued;
+    sf2bl_log_record_t queue[LOG_BATCH];
+} boot_log_t;
+
+static boot_log_t g_log;
+
+/* This boot's record, filled in as the boot goes */
+static sf2bl_log_record_t g_boot_entry;
+
+/***************************************************************************//**
+ * Get the sequence number of a sector, 0 if it has not got a good header.
+ */
+static uint32_t log_sector_sequence(uint32_t sector)
+{
+    sf2bl_log_sector_t header;
+    uint32_t return_val = 0u;
+
+    if((SPI_FLASH_SUCCESS == spi_flash_read(LOG_SECTOR_ADDR(sector), (uint8_t *)&header, sizeof(header))) &&
+       (SF2BL_LOG_MAGIC == header.magic) && (SF2BL_LOG_RECORD_SIZE == header.record_size) &&
+       (header.crc32 == sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)&header, sizeof(header) - sizeof(uint32_t))))
+    {
+        return_val = header.sequence;
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * See if a record slot is completely erased.
+ */
+static int32_t log_slot_free(uint32_t sector, uint32_t slot)
+{
+    uint32_t record[SF2BL_LOG_RECORD_SIZE / 4u];
+    uint32_t index = 0u;
+    int32_t return_val = 0;
+
+    if(SPI_FLASH_SUCCESS == spi_flash_read(LOG_SLOT_ADDR(sector, slot), (uint8_t *)record, sizeof(record)))
+    {
+        while((index < (SF2BL_LOG_RECORD_SIZE / 4u)) && (0xFFFFFFFFu == record[index]))
+        {
+            index++;
+        }
+        return_val = (index == (SF2BL_LOG_RECORD_SIZE / 4u));
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Find the head sector and the first free slot in it.
+ */
+static void log_find_head(void)
+{
+    uint32_t first;
+    uint32_t low;
+    uint32_t high;
+    uint32_t mid;
+
+    g_log.head     = 0u;
+    g_log.sequence = 0u;
+    g_log.slot     = SF2BL_LOG_RECORDS + 1u;
+
+    first = log_sector_sequence(0u);
+    if(0u == first)
+    {
+        /*
+         * Either the log is empty or sector 0 was being started again when
+         * the power failed, in which case the last sector is the head.
+         */
+        g_log.head     = SF2BL_LOG_SIZE - 1u;
+        g_log.sequence = log_sector_sequence(g_log.head);
+    }
+    else
+    {
+        /* Sectors up to the head have sequence numbers from first upwards */
+        low  = 0u;
+        high = SF2BL_LOG_SIZE;
+        while((high - low) > 1u)
+        {
+            mid = (low + high) / 2u;
+            if(log_sector_sequence(mid) >= first)
+            {
+                low = mid;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        g_log.head     = low;
+        g_log.sequence = log_sector_sequence(low);
+    }
+
+    if(0u != g_log.sequence)
+    {
+        /* Slots before the first free one are all used */
+        low  = 0u;
+        high = SF2BL_LOG_RECORDS + 1u;
+        while((high - low) > 1u)
+        {
+            mid = (low + high) / 2u;
+            if(log_slot_free(g_log.head, mid))
+            {
+                high = mid;
+            }
+            else
+            {
+                low = mid;
+            }
+        }
+        g_log.slot = high;
+    }
+
+    g_log.found = 1u;
+}
+
+/***************************************************************************//**
+ * Erase the sector after the head and make it the new head.
+ *
+ * Returns SPI_FLASH_SUCCESS or the error from the SPI FLASH driver.
+ */
+static spi_flash_status_t log_new_sector(void)
+{
+    sf2bl_log_sector_t header;
+    spi_flash_status_t return_val;
+    uint32_t sector;
+
+    sector = (0u == g_log.sequence) ? 0u : ((g_log.head + 1u) % SF2BL_LOG_SIZE);
+    return_val = spi_flash_erase(LOG_SECTOR_ADDR(sector), SF2BL_LOG_SECTOR_SIZE);
+    if(SPI_FLASH_SUCCESS == return_val)
+    {
+        header.magic       = SF2BL_LOG_MAGIC;
+        header.sequence    = g_log.sequence + 1u;
+        header.record_size = SF2BL_LOG_RECORD_SIZE;
+        header.crc32       = sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)&header, sizeof(header) - sizeof(uint32_t));
+        return_val = spi_flash_write(LOG_SECTOR_ADDR(sector), (uint8_t *)&header, sizeof(header), 0);
+    }
+
+    if(SPI_FLASH_SUCCESS == return_val)
+    {
+        g_log.head     = sector;
+        g_log.sequence = header.sequence;
+        g_log.slot     = 1u;
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Note errors for this boot's record.
+ */
+void sf2bl_log_error(uint32_t errors)
+{
+    g_boot_entry.errors |= errors;
+#if defined(SF2BL_FLASH_WRITE_VERIFY)
+    if(0u != (errors & SF2BL_LOG_ERR_WRITE))
+    {
+        g_boot_entry.verify_address = spi_flash_verify_address();
+    }
+#endif
+}
+
+/***************************************************************************//**
+ * Note the size of the file received and the image built from it.
+ */
+void sf2bl_log_transfer(uint32_t received, uint32_t processed)
+{
+    g_boot_entry.received  = received;
+    g_boot_entry.processed = processed;
+    g_boot_entry.rx_errors = g_ymodem_errors;
+}
+
+/***************************************************************************//**
+ * Queue a record for the log, writing out those already queued if there is no
+ * room. The CRC32 is filled in here.
+ */
+void sf2bl_log_add(const sf2bl_log_record_t *precord)
+{
+    sf2bl_log_record_t *pentry;
+
+    if(LOG_BATCH == g_log.n_queued)
+    {
+        (void)sf2bl_log_flush();
+    }
+
+    pentry = &g_log.queue[g_log.n_queued];
+    memcpy(pentry, precord, sizeof(sf2bl_log_record_t));
+    pentry->crc32 = sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)pentry, sizeof(sf2bl_log_record_t) - sizeof(uint32_t));
+    g_log.n_queued++;
+}
+
+/***************************************************************************//**
+ * Write the queued records to the log, as many as fit in the head sector with
+ * each write.
+ *
+ * Returns 0 for success or -1 for error, in which case the records are lost.
+ */
+int32_t sf2bl_log_flush(void)
+{
+    spi_flash_status_t flash_result = SPI_FLASH_SUCCESS;
+    uint32_t pos = 0u;
+    uint32_t count;
+
+    if((0u != g_log.n_queued) && (0u == g_log.found))
+    {
+        log_find_head();
+    }
+
+    while((SPI_FLASH_SUCCESS == flash_result) && (pos < g_log.n_queued))
+    {
+        if(g_log.slot > SF2BL_LOG_RECORDS)
+        {
+            flash_result = log_new_sector();
+        }
+
+        if(SPI_FLASH_SUCCESS == flash_result)
+        {
+            count = (SF2BL_LOG_RECORDS + 1u) - g_log.slot;
+            count = ((g_log.n_queued - pos) < count) ? (g_log.n_queued - pos) : count;
+            flash_result = spi_flash_write(LOG_SLOT_ADDR(g_log.head, g_log.slot), (uint8_t *)&g_log.queue[pos],
+                                           count * sizeof(sf2bl_log_record_t), 0);
+            /* Even a failed write may have used the slots */
+            g_log.slot += count;
+            pos        += count;
+        }
+    }
+
+    g_log.n_queued = 0u;
+
+    return(SPI_FLASH_SUCCESS == flash_result ? 0 : -1);
+}
+
+/***************************************************************************//**
+ * Get the image slot this boot ended up running from, going by g_boot_mode.
+ * With SF2BL_PART_TABLE this is the slot's place in the partition table.
+ */
+static uint8_t log_slot(void)
+{
+    uint8_t return_val;
+
+#if defined(SF2BL_PART_TABLE)
+    return_val = (uint8_t)sf2bl_part_index(g_img1_offset);
+#if defined(SF2BL_GOLDEN)
+    if(SF2BL_BOOT_EXEC_GOLDEN == g_boot_mode)
+    {
+        return_val = (uint8_t)sf2bl_part_index(g_golden_img_offset);
+    }
+#endif
+#else
+    switch(g_boot_mode)
+    {
+    case SF2BL_BOOT_EXEC_GOLDEN:
+        return_val = 0u;
+        break;
+
+#if defined(SF2BL_2ND_IMAGE)
+    case SF2BL_BOOT_EXEC_2:
+    case SF2BL_BOOT_DOWNLOAD_2:
+        return_val = 2u;
+        break;
+#endif
+
+    default:
+        /* Everything else, including golden updates and copies, runs image 1 */
+        return_val = 1u;
+        break;
+    }
+#endif
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Complete this boot's record with the result and write it to the log. With
+ * SF2BL_BOOT_METRICS the time spent in each phase and the SPI FLASH counters
+ * come from the boot metrics.
+ */
+void sf2bl_log_boot(uint32_t result)
+{
+#if defined(SF2BL_BOOT_METRICS)
+    const sf2bl_boot_metrics_t *pmetrics;
+    uint32_t phase;
+#endif
+
+    g_boot_entry.type      = SF2BL_LOG_TYPE_BOOT;
+    g_boot_entry.boot_mode = (uint8_t)g_boot_mode;
+    g_boot_entry.result    = (uint8_t)result;
+    if(SF2BL_LOG_RESULT_EXEC == result)
+    {
+        g_boot_entry.slot     = log_slot();
+        g_boot_entry.sequence = g_img1_header.sequence;
+    }
+    else
+    {
+        g_boot_entry.slot = SF2BL_LOG_NO_SLOT;
+    }
+
+#if defined(SF2BL_BOOT_METRICS)
+    pmetrics = sf2bl_metrics_update();
+    g_boot_entry.metrics_flags = pmetrics->flags;
+    for(phase = 0; phase < SF2BL_LOG_PHASES; phase++)
+    {
+        g_boot_entry.phase_ticks[phase] = (uint32_t)(pmetrics->mtime[phase + 1u] - pmetrics->mtime[phase]);
+    }
+#endif
+    g_boot_entry.spi_transactions = g_spi_flash_transactions;
+    g_boot_entry.spi_bytes        = g_spi_flash_bytes;
+    g_boot_entry.spi_polls        = g_spi_flash_polls;
+
+    sf2bl_log_add(&g_boot_entry);
+    (void)sf2bl_log_flush();
+}
+#endif
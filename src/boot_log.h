@@ -0,0 +1,99 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader boot log header.
+ *
+ * The layout of the log kept in the SF2BL_LOG_SIZE sectors at SF2BL_FLASH_BASE
+ * is defined here so tools can use this header to decode it, see
+ * host/log_decode.c. Each 4K sector starts with a sector header in the first
+ * record slot followed by SF2BL_LOG_RECORDS fixed size records. Unused slots
+ * are left erased.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef BOOT_LOG_H_
+#define BOOT_LOG_H_
+
+#define SF2BL_LOG_MAGIC       0x4C424653u /* "SFBL" */
+#define SF2BL_LOG_SECTOR_SIZE 4096u
+#define SF2BL_LOG_RECORD_SIZE 64u
+#define SF2BL_LOG_RECORDS     ((SF2BL_LOG_SECTOR_SIZE / SF2BL_LOG_RECORD_SIZE) - 1u)
+
+/*
+ * Record types.
+ */
+#define SF2BL_LOG_TYPE_BOOT   1u    /* One per boot, written as it ends */
+
+/*
+ * Boot results.
+ */
+#define SF2BL_LOG_RESULT_EXEC 0u    /* Application started */
+#define SF2BL_LOG_RESULT_HALT 1u    /* No valid image, bootloader halted */
+
+#define SF2BL_LOG_NO_SLOT     0xFFu /* No image slot booted */
+
+/*
+ * Error flags.
+ */
+#define SF2BL_LOG_ERR_DOWNLOAD 0x00000001u /* YMODEM transfer failed */
+#define SF2BL_LOG_ERR_PROCESS  0x00000002u /* Received file not usable */
+#define SF2BL_LOG_ERR_WRITE    0x00000004u /* Writing image to FLASH failed */
+#define SF2BL_LOG_ERR_LOAD     0x00000008u /* Loading image into RAM failed */
+
+/*
+ * mtime ticks spent in each boot phase from SF2BL_PHASE_MAIN up to the start
+ * of SF2BL_PHASE_EXEC, see boot_metrics.h.
+ */
+#define SF2BL_LOG_PHASES      4u
+
+typedef struct sf2bl_log_sector
+{
+    uint32_t magic;                      /* SF2BL_LOG_MAGIC */
+    uint32_t sequence;                   /* Sectors started so far, from 1 */
+    uint32_t record_size;                /* SF2BL_LOG_RECORD_SIZE */
+    uint32_t crc32;                      /* CRC32 of the header up to here */
+} sf2bl_log_sector_t;
+
+/*
+ * Records are SF2BL_LOG_RECORD_SIZE bytes, so fields can only be added in place
+ * of existing ones.
+ */
+typedef struct sf2bl_log_record
+{
+    uint8_t  type;                       /* SF2BL_LOG_TYPE_xxx */
+    uint8_t  boot_mode;                  /* g_boot_mode at the end of the boot */
+    uint8_t  slot;                       /* 0 golden, 1 or 2, partition table index or SF2BL_LOG_NO_SLOT */
+    uint8_t  result;                     /* SF2BL_LOG_RESULT_xxx */
+    uint32_t errors;                     /* SF2BL_LOG_ERR_xxx */
+    uint32_t sequence;                   /* Sequence number of image booted */
+    uint32_t metrics_flags;              /* SF2BL_METRICS_FLAG_xxx */
+    uint32_t phase_ticks[SF2BL_LOG_PHASES];
+    uint32_t received;                   /* Bytes received by YMODEM */
+    uint32_t processed;                  /* Bytes of image built from them */
+    uint32_t rx_errors;                  /* YMODEM packets in error */
+    uint32_t spi_transactions;           /* SPI FLASH transfers */
+    uint32_t spi_bytes;                  /* SPI FLASH bytes sent and received */
+    uint32_t spi_polls;                  /* SPI FLASH busy status polls */
+    uint32_t verify_address;             /* Failed address for SF2BL_LOG_ERR_WRITE */
+    uint32_t crc32;                      /* CRC32 of the record up to here */
+} sf2bl_log_record_t;
+
+#if defined(SF2BL_BOOT_LOG)
+void    sf2bl_log_error(uint32_t errors);
+void    sf2bl_log_transfer(uint32_t received, uint32_t processed);
+void    sf2bl_log_add(const sf2bl_log_record_t *precord);
+int32_t sf2bl_log_flush(void);
+void    sf2bl_log_boot(uint32_t result);
+
+#define SF2BL_LOG_ERROR(errors)                 sf2bl_log_error(errors);
+#define SF2BL_LOG_TRANSFER(received, processed) sf2bl_log_transfer(received, processed);
+#define SF2BL_LOG_BOOT(result)                  sf2bl_log_boot(result);
+#else
+#define SF2BL_LOG_ERROR(errors)
+#define SF2BL_LOG_TRANSFER(received, processed)
+#define SF2BL_LOG_BOOT(result)
+#endif
+
+#endif /* BOOT_LOG_H_ */
@@ -0,0 +1,142 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader boot time metrics routines.
+ *
+ * Each boot phase is timestamped with both mcycle, for cycle accurate timing,
+ * and mtime, which runs at a fixed rate regardless of the CPU clock. The
+ * record is built in bootloader RAM and copied to SF2BL_BOOT_METRICS_ADDR
+ * along with the SPI FLASH and CRC32 counters just before the application is
+ * started. Each region of RAM loaded is passed to sf2bl_metrics_loaded() and
+ * if any of them covers SF2BL_BOOT_METRICS_ADDR the record is not copied, so
+ * that it cannot overwrite the application, and a0 is 0.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sf2_bl_options.h"
+#include "encoding.h"
+#include "spi_flash.h"
+#include "crc32.h"
+#include "boot_metrics.h"
+
+#if defined(SF2BL_BOOT_METRICS)
+
+#define METRICS_MTIME_ADDR 0x4400BFF8UL
+
+static sf2bl_boot_metrics_t g_metrics;
+static uint32_t g_metrics_covered; /* Image loaded over SF2BL_BOOT_METRICS_ADDR */
+
+/***************************************************************************//**
+ * Read the 64 bit cycle counter. The high word is read again to catch the low
+ * word wrapping between the two reads.
+ */
+static uint64_t metrics_cycles(void)
+{
+    uint32_t hi;
+    uint32_t lo;
+
+    do {
+        hi = read_csr(mcycleh);
+        lo = read_csr(mcycle);
+    } while(hi != read_csr(mcycleh));
+
+    return(((uint64_t)hi << 32) | lo);
+}
+
+/***************************************************************************//**
+ * Read the 64 bit machine timer in the same way.
+ */
+static uint64_t metrics_mtime(void)
+{
+    volatile uint32_t *mtime = (uint32_t *)METRICS_MTIME_ADDR;
+    uint32_t hi;
+    uint32_t lo;
+
+    do {
+        hi = mtime[1];
+        lo = mtime[0];
+    } while(hi != mtime[1]);
+
+    return(((uint64_t)hi << 32) | lo);
+}
+
+/***************************************************************************//**
+ * Timestamp the start of a boot phase.
+ */
+void sf2bl_metrics_mark(uint32_t phase)
+{
+    if(phase < SF2BL_PHASE_COUNT)
+    {
+        g_metrics.cycles[phase] = metrics_cycles();
+        g_metrics.mtime[phase]  = metrics_mtime();
+    }
+}
+
+/***************************************************************************//**
+ * Record something about how this boot went.
+ */
+void sf2bl_metrics_flag(uint32_t flags)
+{
+    g_metrics.flags |= flags;
+}
+
+/***************************************************************************//**
+ * Note a region of RAM the application has been loaded to, or is still in from
+ * the last boot.
+ */
+void sf2bl_metrics_loaded(const uint8_t *start, uint32_t len)
+{
+    if(((uint32_t)start < ((uint32_t)(SF2BL_BOOT_METRICS_ADDR) + sizeof(sf2bl_boot_metrics_t))) &&
+       (((uint32_t)start + len) > (uint32_t)(SF2BL_BOOT_METRICS_ADDR)))
+    {
+        g_metrics_covered = 1u;
+    }
+}
+
+/***************************************************************************//**
+ * Mark the end of the boot and fill in the counters so far.
+ *
+ * Returns the record, still in bootloader RAM.
+ */
+const sf2bl_boot_metrics_t *sf2bl_metrics_update(void)
+{
+    sf2bl_metrics_mark(SF2BL_PHASE_EXEC);
+    g_metrics.magic            = SF2BL_METRICS_MAGIC;
+    g_metrics.version          = SF2BL_METRICS_VERSION;
+    g_metrics.size             = (uint16_t)sizeof(sf2bl_boot_metrics_t);
+    g_metrics.n_phases         = SF2BL_PHASE_COUNT;
+    g_metrics.spi_transactions = g_spi_flash_transactions;
+    g_metrics.spi_bytes        = g_spi_flash_bytes;
+    g_metrics.spi_polls        = g_spi_flash_polls;
+    g_metrics.crc_bytes        = g_crc32_bytes;
+
+    return(&g_metrics);
+}
+
+/***************************************************************************//**
+ * Mark the start of application execution, fill in the counters and copy the
+ * record to SF2BL_BOOT_METRICS_ADDR, unless the application is there.
+ *
+ * Returns the address of the record for passing to the application or 0 if
+ * it was not copied.
+ */
+uint32_t sf2bl_metrics_finish(void)
+{
+    const sf2bl_boot_metrics_t *pmetrics;
+    uint32_t return_val = 0u;
+
+    pmetrics = sf2bl_metrics_update();
+    if(0u == g_metrics_covered)
+    {
+        memcpy((void *)(SF2BL_BOOT_METRICS_ADDR), pmetrics, sizeof(sf2bl_boot_metrics_t));
+        return_val = (uint32_t)(SF2BL_BOOT_METRICS_ADDR);
+    }
+
+    return(return_val);
+}
+#endif
@@ -0,0 +1,70 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader boot time metrics header.
+ *
+ * The layout of the boot metrics record passed to the application in a0 is
+ * defined here so the application can use this header to interpret it. Fields
+ * are only ever added to the end of the record and the version bumped when
+ * that happens, so an application should check magic, version and size before
+ * using any field.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef BOOT_METRICS_H_
+#define BOOT_METRICS_H_
+
+#define SF2BL_METRICS_MAGIC   0x4D424653u /* "SFBM" */
+#define SF2BL_METRICS_VERSION 1u
+
+/*
+ * Boot phases, each timestamped as it starts. Time before SF2BL_PHASE_MAIN is
+ * the startup code and _init(). SF2BL_PHASE_EXEC is taken just before control
+ * passes to the application so it marks the end of the last phase.
+ */
+#define SF2BL_PHASE_MAIN       0u /* Entry to main() */
+#define SF2BL_PHASE_FLASH_INIT 1u /* spi_flash_init() */
+#define SF2BL_PHASE_CHECK      2u /* Checking images, sf2bl_check_flash() */
+#define SF2BL_PHASE_LOAD       3u /* Update or load, sf2bl_rd_flash_image() */
+#define SF2BL_PHASE_EXEC       4u /* sf2bl_exec() */
+#define SF2BL_PHASE_COUNT      5u
+
+/*
+ * Metrics flags.
+ */
+#define SF2BL_METRICS_FLAG_WARM 0x00000001u /* Image reused from RAM */
+
+typedef struct sf2bl_boot_metrics
+{
+    uint32_t magic;                       /* SF2BL_METRICS_MAGIC */
+    uint16_t version;                     /* SF2BL_METRICS_VERSION */
+    uint16_t size;                        /* sizeof this record */
+    uint32_t n_phases;                    /* Entries in cycles[] and mtime[] */
+    uint32_t flags;
+    uint64_t cycles[SF2BL_PHASE_COUNT];   /* mcycle at start of each phase */
+    uint64_t mtime[SF2BL_PHASE_COUNT];    /* mtime at start of each phase */
+    uint32_t spi_transactions;            /* SPI FLASH transfers */
+    uint32_t spi_bytes;                   /* SPI FLASH bytes sent and received */
+    uint32_t spi_polls;                   /* SPI FLASH busy status polls */
+    uint32_t crc_bytes;                   /* Bytes passed through CRC32 */
+} sf2bl_boot_metrics_t;
+
+#if defined(SF2BL_BOOT_METRICS)
+void     sf2bl_metrics_mark(uint32_t phase);
+void     sf2bl_metrics_flag(uint32_t flags);
+void     sf2bl_metrics_loaded(const uint8_t *start, uint32_t len);
+const sf2bl_boot_metrics_t *sf2bl_metrics_update(void);
+uint32_t sf2bl_metrics_finish(void);
+
+#define SF2BL_METRICS_MARK(phase) sf2bl_metrics_mark(phase);
+#define SF2BL_METRICS_FLAG(flags) sf2bl_metrics_flag(flags);
+#define SF2BL_METRICS_LOADED(start, len) sf2bl_metrics_loaded(start, len);
+#else
+#define SF2BL_METRICS_MARK(phase)
+#define SF2BL_METRICS_FLAG(flags)
+#define SF2BL_METRICS_LOADED(start, len)
+#endif
+
+#endif /* BOOT_METRICS_H_ */
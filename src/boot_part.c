@@ -0,0 +1,390 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader partition table routines.
+ *
+ * Rather than splitting the SPI FLASH into SF2BL_IMAGE_SIZE slots for the
+ * golden image, image 1 and image 2, the slots are listed in a partition table
+ * with their sizes and roles, so there can be any number of image slots, for
+ * example one or more for each feature set or customer build. See boot_part.h
+ * for the layout.
+ *
+ * The table is read in one go and each slot's image header read once, with
+ * the status and sequence number of each slot kept in RAM. Everything else,
+ * finding the newest image, where a download goes and what to fall back to,
+ * works from this copy. If there is no good table the slots are laid out as
+ * they would be without one.
+ *
+ * The newest good image slot is used as image 1. A download goes to a slot
+ * without a good image if there is one, otherwise to the slot with the oldest
+ * image, and gets the next sequence number, so older images are left in place
+ * to fall back to.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sf2_bl_defs.h"
+#include "sf2_bl_options.h"
+#include "spi_flash.h"
+#include "image_tools.h"
+#include "crc32.h"
+#include "boot_config.h"
+#include "boot_part.h"
+
+#if defined(SF2BL_PART_TABLE)
+
+#define PART_IMAGE_BASE (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096) + SF2BL_PART_TABLE_RESERVE)
+#define PART_NO_SLOT    0xFFFFFFFFu
+
+typedef struct part_slot
+{
+    uint32_t           offset;
+    uint32_t           size;
+    uint16_t           role;
+    uint16_t           tag;
+    uint16_t           sequence; /* From image header if status is SF2BL_HDR_OK */
+    sf2bl_hdr_status_t status;
+} part_slot_t;
+
+typedef struct part_cache
+{
+    uint32_t    n_slots;
+    uint32_t    current;         /* Newest good image slot or PART_NO_SLOT */
+    uint32_t    target;          /* Slot the next download goes to */
+    uint16_t    tag;             /* Image slots used, SF2BL_PART_NO_TAG for all */
+    part_slot_t slots[SF2BL_PART_MAX_SLOTS];
+} part_cache_t;
+
+static part_cache_t g_part;
+
+/* The largest table, word aligned */
+static uint32_t g_part_buf[(SF2BL_PART_TABLE_LEN(SF2BL_PART_MAX_SLOTS) + 3u) / 4u];
+
+/***************************************************************************//**
+ * See if sequence number a is newer than b, allowing for roll over.
+ */
+static int32_t part_newer(uint16_t a, uint16_t b)
+{
+    return((int16_t)(uint16_t)(a - b) > 0);
+}
+
+/***************************************************************************//**
+ * See if a slot is an image slot for the selected tag.
+ */
+static int32_t part_usable(const part_slot_t *pslot)
+{
+    return((SF2BL_PART_ROLE_IMAGE == pslot->role) &&
+           ((SF2BL_PART_NO_TAG == g_part.tag) || (g_part.tag == pslot->tag)));
+}
+
+/***************************************************************************//**
+ * Find the slot at offset.
+ *
+ * Returns the slot index or PART_NO_SLOT.
+ */
+static uint32_t part_find(uint32_t offset)
+{
+    uint32_t return_val = PART_NO_SLOT;
+    uint32_t index;
+
+    for(index = 0; (PART_NO_SLOT == return_val) && (index < g_part.n_slots); index++)
+    {
+        if(offset == g_part.slots[index].offset)
+        {
+            return_val = index;
+        }
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Add a slot to the cache.
+ */
+static void part_add(uint32_t offset, uint32_t size, uint16_t role, uint16_t tag)
+{
+    part_slot_t *pslot;
+
+    pslot = &g_part.slots[g_part.n_slots];
+    pslot->offset = offset;
+    pslot->size   = size;
+    pslot->role   = role;
+    pslot->tag    = tag;
+    pslot->status = SF2BL_HDR_BLANK;
+    g_part.n_slots++;
+}
+
+/***************************************************************************//**
+ * Read the partition table and check it. Slots must be in address order, clear
+ * of the table and each other and within SF2BL_FLASH_SIZE. There must be at
+ * least one image slot and, with SF2BL_GOLDEN, one golden image slot.
+ *
+ * Returns 0 for success or -1 if there is no usable table.
+ */
+static int32_t part_load_table(void)
+{
+    sf2bl_part_table_t *ptable = (sf2bl_part_table_t *)g_part_buf;
+    sf2bl_part_entry_t *pentry;
+    uint32_t next_free;
+    uint32_t n_images = 0u;
+    uint32_t n_golden = 0u;
+    uint32_t index;
+    uint32_t crc;
+    int32_t return_val = -1;
+
+    if((SPI_FLASH_SUCCESS == spi_flash_read(SF2BL_PART_TABLE_ADDR, (uint8_t *)g_part_buf, sizeof(g_part_buf))) &&
+       (SF2BL_PART_MAGIC == ptable->magic) && (SF2BL_PART_VERSION == ptable->version) &&
+       (0u != ptable->n_slots) && (ptable->n_slots <= SF2BL_PART_MAX_SLOTS))
+    {
+        crc = sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)ptable, sizeof(sf2bl_part_table_t) - sizeof(uint32_t));
+        crc = sf2bl_calc_crc32(crc, (uint8_t *)(ptable + 1), ptable->n_slots * sizeof(sf2bl_part_entry_t));
+        return_val = (crc == ptable->crc32) ? 0 : -1;
+    }
+
+    next_free = SF2BL_PART_TABLE_ADDR + 4096u;
+    pentry = (sf2bl_part_entry_t *)(ptable + 1);
+    for(index = 0; (0 == return_val) && (index < ptable->n_slots); index++, pentry++)
+    {
+        if((pentry->offset < next_free) || (0u != (pentry->offset % SF2BL_FLASH_IMAGE_GRANUALARITY)) ||
+           (0u == pentry->size) || (0u != (pentry->size % SF2BL_FLASH_IMAGE_GRANUALARITY)) ||
+           (pentry->offset > SF2BL_FLASH_SIZE) || (pentry->size > (SF2BL_FLASH_SIZE - pentry->offset)) ||
+           (pentry->role < SF2BL_PART_ROLE_IMAGE) || (pentry->role > SF2BL_PART_ROLE_DATA))
+        {
+            return_val = -1;
+        }
+        else
+        {
+            n_images += (SF2BL_PART_ROLE_IMAGE == pentry->role) ? 1u : 0u;
+            n_golden += (SF2BL_PART_ROLE_GOLDEN == pentry->role) ? 1u : 0u;
+            next_free = pentry->offset + pentry->size;
+            part_add(pentry->offset, pentry->size, pentry->role, pentry->tag);
+        }
+    }
+
+#if defined(SF2BL_GOLDEN)
+    if(1u != n_golden)
+#else
+    if(0u != n_golden)
+#endif
+    {
+        return_val = -1;
+    }
+
+    if((0 != return_val) || (0u == n_images))
+    {
+        g_part.n_slots = 0u;
+        return_val = -1;
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Lay out the slots as they would be without a partition table.
+ */
+static void part_default(void)
+{
+    uint32_t offset = PART_IMAGE_BASE;
+
+#if defined(SF2BL_GOLDEN)
+    part_add(offset, SF2BL_IMAGE_SIZE, SF2BL_PART_ROLE_GOLDEN, SF2BL_PART_NO_TAG);
+    offset += SF2BL_IMAGE_SIZE;
+#endif
+    part_add(offset, SF2BL_IMAGE_SIZE, SF2BL_PART_ROLE_IMAGE, SF2BL_PART_NO_TAG);
+}
+
+/***************************************************************************//**
+ * Pick the slot for the next download. This is the first usable slot without a
+ * good image or failing that the one with the oldest image, leaving the newest
+ * image alone unless it is in the only usable slot.
+ */
+static uint32_t part_pick_target(void)
+{
+    part_slot_t *pslot;
+    uint32_t return_val = PART_NO_SLOT;
+    uint32_t index;
+
+    for(index = 0; index < g_part.n_slots; index++)
+    {
+        pslot = &g_part.slots[index];
+        if(part_usable(pslot) && (index != g_part.current) &&
+           ((PART_NO_SLOT == return_val) ||
+            ((SF2BL_HDR_OK == g_part.slots[return_val].status) &&
+             ((SF2BL_HDR_OK != pslot->status) || part_newer(g_part.slots[return_val].sequence, pslot->sequence)))))
+        {
+            return_val = index;
+        }
+    }
+
+    if(PART_NO_SLOT == return_val)
+    {
+        return_val = g_part.current;
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Read the partition table and the header of each slot, then set up image 1
+ * as the newest good image and, with SF2BL_GOLDEN, the golden image. If there
+ * is no good image, image 1 is the slot a download will go to.
+ */
+void sf2bl_part_check(void)
+{
+    img_hdr_block_t header;
+    part_slot_t *pslot;
+    uint32_t n_tagged = 0u;
+    uint32_t index;
+
+    memset(&g_part, 0, sizeof(g_part));
+    if(0 != part_load_table())
+    {
+        part_default();
+    }
+
+#if defined(SF2BL_CONFIG_STORE)
+    g_part.tag = (uint16_t)sf2bl_config_get_u32(SF2BL_CONFIG_KEY_PART_TAG, SF2BL_PART_NO_TAG);
+#endif
+    for(index = 0; index < g_part.n_slots; index++)
+    {
+        n_tagged += part_usable(&g_part.slots[index]) ? 1u : 0u;
+    }
+
+    /* A tag with no slots would leave nothing to boot, so use them all */
+    if(0u == n_tagged)
+    {
+        g_part.tag = SF2BL_PART_NO_TAG;
+    }
+
+    g_part.current = PART_NO_SLOT;
+    for(index = 0; index < g_part.n_slots; index++)
+    {
+        pslot = &g_part.slots[index];
+        if(SF2BL_PART_ROLE_DATA != pslot->role)
+        {
+            if(SPI_FLASH_SUCCESS == spi_flash_read(pslot->offset, (uint8_t *)&header, sizeof(header)))
+            {
+                pslot->status   = sf2bl_check_img_header(&header);
+                pslot->sequence = header.sequence;
+            }
+            else
+            {
+                pslot->status = SF2BL_HDR_READ_FAIL;
+            }
+
+#if defined(SF2BL_GOLDEN)
+            if(SF2BL_PART_ROLE_GOLDEN == pslot->role)
+            {
+                g_golden_img_offset = pslot->offset;
+                g_golden_img_status = pslot->status;
+                memcpy(&g_golden_img_header, &header, sizeof(header));
+            }
+#endif
+            if(part_usable(pslot) && (SF2BL_HDR_OK == pslot->status) &&
+               ((PART_NO_SLOT == g_part.current) || part_newer(pslot->sequence, g_part.slots[g_part.current].sequence)))
+            {
+                g_part.current = index;
+                memcpy(&g_img1_header, &header, sizeof(header));
+            }
+        }
+    }
+
+    g_part.target = part_pick_target();
+    if(PART_NO_SLOT != g_part.current)
+    {
+        g_img1_offset = g_part.slots[g_part.current].offset;
+        g_img1_status = SF2BL_HDR_OK;
+    }
+    else
+    {
+        g_img1_offset = g_part.slots[g_part.target].offset;
+        g_img1_status = g_part.slots[g_part.target].status;
+    }
+}
+
+/***************************************************************************//**
+ * Get the slot the next download is to be written to.
+ */
+uint32_t sf2bl_part_target(void)
+{
+    return(g_part.slots[g_part.target].offset);
+}
+
+/***************************************************************************//**
+ * Find the image to fall back to if the one at offset cannot be loaded, the
+ * newest good image older than it.
+ *
+ * Returns the FLASH offset of the image or SF2BL_NO_IMAGE if there is none.
+ */
+uint32_t sf2bl_part_next(uint32_t offset)
+{
+    part_slot_t *pslot;
+    uint32_t from;
+    uint32_t next = PART_NO_SLOT;
+    uint32_t index;
+
+    from = part_find(offset);
+    for(index = 0; (PART_NO_SLOT != from) && (index < g_part.n_slots); index++)
+    {
+        pslot = &g_part.slots[index];
+        if(part_usable(pslot) && (SF2BL_HDR_OK == pslot->status) &&
+           part_newer(g_part.slots[from].sequence, pslot->sequence) &&
+           ((PART_NO_SLOT == next) || part_newer(pslot->sequence, g_part.slots[next].sequence)))
+        {
+            next = index;
+        }
+    }
+
+    return((PART_NO_SLOT != next) ? g_part.slots[next].offset : SF2BL_NO_IMAGE);
+}
+
+/***************************************************************************//**
+ * Get the size of the slot at offset.
+ *
+ * Returns the size in bytes or 0 if there is no slot at offset.
+ */
+uint32_t sf2bl_part_size(uint32_t offset)
+{
+    uint32_t index;
+
+    index = part_find(offset);
+
+    return((PART_NO_SLOT != index) ? g_part.slots[index].size : 0u);
+}
+
+/***************************************************************************//**
+ * Get the place in the partition table of the slot at offset.
+ *
+ * Returns the slot index or 0xFFFFFFFF if there is no slot at offset.
+ */
+uint32_t sf2bl_part_index(uint32_t offset)
+{
+    return(part_find(offset));
+}
+
+/***************************************************************************//**
+ * Invalidate every good image in the usable slots except the one at keep, as
+ * is done for image 2 when the golden image is copied to image 1.
+ */
+void sf2bl_part_invalidate(uint32_t keep)
+{
+    part_slot_t *pslot;
+    uint32_t valid = SF2BL_IMG_HDR_INVALID;
+    uint32_t index;
+
+    for(index = 0; index < g_part.n_slots; index++)
+    {
+        pslot = &g_part.slots[index];
+        if(part_usable(pslot) && (SF2BL_HDR_OK == pslot->status) && (keep != pslot->offset))
+        {
+            /* As for image 2, a failure here is not allowed to stop the boot */
+            (void)spi_flash_write(pslot->offset, (uint8_t *)&valid, sizeof(valid), 0);
+            pslot->status = SF2BL_HDR_INVALID;
+        }
+    }
+}
+#endif
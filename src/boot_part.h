@@ -0,0 +1,67 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader partition table header.
+ *
+ * The partition table is kept in the 4K sector at SF2BL_PART_TABLE_ADDR. It is
+ * a table header followed by n_slots slot entries, each giving the offset,
+ * size and role of one image slot. Slots must be in address order, clear of
+ * the table sector and of each other. The CRC32 covers the table header up to
+ * the crc32 field and then the entries.
+ *
+ * The layout is defined here so tools can use this header to build a table,
+ * see host/part_make.c.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef BOOT_PART_H_
+#define BOOT_PART_H_
+
+#define SF2BL_PART_MAGIC     0x54504653u /* "SFPT" */
+#define SF2BL_PART_VERSION   1u
+#define SF2BL_PART_MAX_SLOTS 32u
+
+/*
+ * Slot roles.
+ */
+#define SF2BL_PART_ROLE_IMAGE  1u /* Application image, the newest good one is run */
+#define SF2BL_PART_ROLE_GOLDEN 2u /* Golden image, at most one */
+#define SF2BL_PART_ROLE_DATA   3u /* Left alone by the bootloader */
+
+/*
+ * Tag of an untagged slot. Selecting this tag, see SF2BL_CONFIG_KEY_PART_TAG,
+ * uses every image slot.
+ */
+#define SF2BL_PART_NO_TAG      0u
+
+typedef struct sf2bl_part_table
+{
+    uint32_t magic;       /* SF2BL_PART_MAGIC */
+    uint16_t version;     /* SF2BL_PART_VERSION */
+    uint16_t n_slots;     /* Number of entries following */
+    uint32_t crc32;
+} sf2bl_part_table_t;
+
+typedef struct sf2bl_part_entry
+{
+    uint32_t offset;      /* SPI FLASH address of slot */
+    uint32_t size;        /* Bytes in slot, multiple of SF2BL_FLASH_IMAGE_GRANUALARITY */
+    uint16_t role;        /* SF2BL_PART_ROLE_xxx */
+    uint16_t tag;         /* Build the slot is for, e.g. a feature set or customer */
+    uint32_t reserved;
+} sf2bl_part_entry_t;
+
+#define SF2BL_PART_TABLE_LEN(n) (sizeof(sf2bl_part_table_t) + ((n) * sizeof(sf2bl_part_entry_t)))
+
+#if defined(SF2BL_PART_TABLE)
+void     sf2bl_part_check(void);
+uint32_t sf2bl_part_target(void);
+uint32_t sf2bl_part_next(uint32_t offset);
+uint32_t sf2bl_part_size(uint32_t offset);
+uint32_t sf2bl_part_index(uint32_t offset);
+void     sf2bl_part_invalidate(uint32_t keep);
+#endif
+
+#endif /* BOOT_PART_H_ */
@@ -0,0 +1,244 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader warm boot support routines.
+ *
+ * When an image has been loaded for execution a boot record is left in RAM at
+ * SF2BL_BOOT_RECORD_ADDR describing what was loaded and where, with a CRC32 of
+ * each region of RAM loaded. The CRC32s of uncompressed chunks come from the
+ * load itself, only regions loaded some other way are read again to make
+ * theirs. After a watchdog or software reset the RAM will
+ * usually still hold the application, so if the record is intact, refers to
+ * the image that would be loaded anyway and every region still matches its
+ * CRC32 the image is used as is rather than being read from the SPI FLASH
+ * again.
+ *
+ * A cold boot leaves RAM holding random data, which fails the record CRC32 or
+ * the region checks, and any update invalidates the record so both of these
+ * continue to load from the SPI FLASH as before.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sf2_bl_defs.h"
+#include "sf2_bl_options.h"
+#include "spi_flash.h"
+#include "image_tools.h"
+#include "crc32.h"
+#include "ymodem.h"
+#include "boot_record.h"
+#include "boot_metrics.h"
+
+#if defined(SF2BL_WARM_BOOT)
+
+#define BOOT_RECORD_MAGIC   0x52424653u /* "SFBR" */
+#define BOOT_RECORD_REGIONS 32u
+
+typedef struct boot_region
+{
+    uint32_t start;
+    uint32_t len;
+    uint32_t flags;  /* SF2BL_REGION_xxx */
+    uint32_t crc32;  /* CRC32 of region as loaded */
+} boot_region_t;
+
+typedef struct boot_record
+{
+    uint32_t      magic;      /* BOOT_RECORD_MAGIC when record is usable */
+    uint32_t      img_offset; /* FLASH offset of image loaded */
+    uint32_t      img_crc32;  /* crc32 from the image header */
+    uint32_t      sequence;   /* sequence from the image header */
+    uint32_t      n_regions;
+    uint32_t      overflow;   /* Load map did not fit in the record */
+    boot_region_t regions[BOOT_RECORD_REGIONS];
+    uint32_t      crc32;      /* CRC32 of the record up to here */
+} boot_record_t;
+
+#define BOOT_RECORD ((boot_record_t *)(SF2BL_BOOT_RECORD_ADDR))
+
+/*
+ * The record is built here while the image is loaded, as the image may turn
+ * out to overlap the record, and copied into place once it is complete.
+ */
+static boot_record_t g_new_record;
+
+/***************************************************************************//**
+ * Start a new load map for the image at img_offset. The record is invalid until
+ * the image has been loaded successfully.
+ */
+void sf2bl_boot_record_begin(uint32_t img_offset)
+{
+    BOOT_RECORD->magic      = 0u;
+    g_new_record.magic      = 0u;
+    g_new_record.img_offset = img_offset;
+    g_new_record.n_regions  = 0u;
+    g_new_record.overflow   = 0u;
+}
+
+/***************************************************************************//**
+ * Add a region of RAM which has been loaded to the load map. With
+ * SF2BL_REGION_CRC in flags, crc32 is the CRC32 of the region, otherwise one
+ * is made when the record is sealed. Regions which follow on from the previous
+ * one are merged with it, along with their CRC32s.
+ */
+void sf2bl_boot_record_add(const uint8_t *start, uint32_t len, uint32_t flags, uint32_t crc32)
+{
+    boot_region_t *pregion;
+
+    pregion = 0;
+    if(0u != g_new_record.n_regions)
+    {
+        pregion = &g_new_record.regions[g_new_record.n_regions - 1u];
+    }
+
+    if((0 != pregion) && ((flags & SF2BL_REGION_ZERO_FILL) == (pregion->flags & SF2BL_REGION_ZERO_FILL)) &&
+       ((pregion->start + pregion->len) == (uint32_t)start))
+    {
+        if(0u != (flags & pregion->flags & SF2BL_REGION_CRC))
+        {
+            pregion->crc32 = sf2bl_crc32_combine(pregion->crc32, crc32, len);
+        }
+        else
+        {
+            pregion->flags &= ~SF2BL_REGION_CRC;
+        }
+        pregion->len += len;
+    }
+    else if(g_new_record.n_regions < BOOT_RECORD_REGIONS)
+    {
+        pregion = &g_new_record.regions[g_new_record.n_regions];
+        pregion->start = (uint32_t)start;
+        pregion->len   = len;
+        pregion->flags = flags;
+        pregion->crc32 = crc32;
+        g_new_record.n_regions++;
+    }
+    else
+    {
+        g_new_record.overflow = 1u;
+    }
+}
+
+/***************************************************************************//**
+ * Check a region does not overlap the boot record itself.
+ */
+static int32_t boot_region_clear_of_record(const boot_region_t *pregion)
+{
+    return(((pregion->start + pregion->len) <= (uint32_t)(SF2BL_BOOT_RECORD_ADDR)) ||
+           (pregion->start >= ((uint32_t)(SF2BL_BOOT_RECORD_ADDR) + sizeof(boot_record_t))));
+}
+
+/***************************************************************************//**
+ * Complete the boot record once the image described by pheader has been
+ * loaded successfully. The record is left invalid if the load map did not fit
+ * or the image overlaps the record.
+ */
+static void boot_record_seal(const img_hdr_block_t *pheader)
+{
+    boot_region_t *pregion;
+    uint32_t index;
+    int32_t usable;
+
+    usable = (0u == g_new_record.overflow);
+    for(index = 0; usable && (index < g_new_record.n_regions); index++)
+    {
+        pregion = &g_new_record.regions[index];
+        usable = boot_region_clear_of_record(pregion);
+        if(usable && (0u == (pregion->flags & (SF2BL_REGION_ZERO_FILL | SF2BL_REGION_CRC))))
+        {
+            pregion->crc32 = sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)pregion->start, pregion->len);
+        }
+    }
+
+    if(usable)
+    {
+        g_new_record.img_crc32 = pheader->crc32;
+        g_new_record.sequence  = pheader->sequence;
+        g_new_record.magic     = BOOT_RECORD_MAGIC;
+        g_new_record.crc32     = sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)&g_new_record, sizeof(boot_record_t) - sizeof(uint32_t));
+        memcpy(BOOT_RECORD, &g_new_record, sizeof(boot_record_t));
+    }
+}
+
+/***************************************************************************//**
+ * See if the image at address is still in RAM from the last boot. If it is,
+ * the zero fill regions are cleared again and g_img1_header is loaded with the
+ * image header as sf2bl_rd_flash_image() would do.
+ *
+ * Returns 0 if the image can be used as is or -1 if it must be loaded.
+ */
+static int32_t boot_record_check(uint32_t address)
+{
+    boot_region_t *pregion;
+    uint32_t index;
+    int32_t return_val = -1;
+
+    if((BOOT_RECORD_MAGIC == BOOT_RECORD->magic) && (address == BOOT_RECORD->img_offset) &&
+       (BOOT_RECORD->n_regions <= BOOT_RECORD_REGIONS) &&
+       (BOOT_RECORD->crc32 == sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)BOOT_RECORD, sizeof(boot_record_t) - sizeof(uint32_t))) &&
+       (SPI_FLASH_SUCCESS == spi_flash_read(address, (uint8_t *)&g_img1_header, sizeof(g_img1_header))) &&
+       (SF2BL_HDR_OK == sf2bl_check_img_header(&g_img1_header)) &&
+       (g_img1_header.crc32 == BOOT_RECORD->img_crc32) && (g_img1_header.sequence == BOOT_RECORD->sequence))
+    {
+        return_val = 0;
+        for(index = 0; (0 == return_val) && (index < BOOT_RECORD->n_regions); index++)
+        {
+            pregion = &BOOT_RECORD->regions[index];
+            if((0u == (pregion->flags & SF2BL_REGION_ZERO_FILL)) &&
+               (pregion->crc32 != sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)pregion->start, pregion->len)))
+            {
+                return_val = -1;
+            }
+        }
+
+        for(index = 0; (0 == return_val) && (index < BOOT_RECORD->n_regions); index++)
+        {
+            pregion = &BOOT_RECORD->regions[index];
+            if(0u != (pregion->flags & SF2BL_REGION_ZERO_FILL))
+            {
+                memset((uint8_t *)pregion->start, 0, pregion->len);
+            }
+            SF2BL_METRICS_LOADED((const uint8_t *)pregion->start, pregion->len)
+        }
+    }
+
+    return(return_val);
+}
+#endif
+
+/***************************************************************************//**
+ * Get the image at address ready for execution. With SF2BL_WARM_BOOT this uses
+ * the copy already in RAM if it is intact, otherwise the image is loaded from
+ * the SPI FLASH and a new boot record made.
+ *
+ * Returns 0 for success or -1 for error.
+ */
+int32_t sf2bl_boot_image(uint32_t address)
+{
+    int32_t return_val;
+
+#if defined(SF2BL_WARM_BOOT)
+    if(0 == boot_record_check(address))
+    {
+        SF2BL_MESSAGE("Image still in RAM, skipping load.\r\n")
+        SF2BL_METRICS_FLAG(SF2BL_METRICS_FLAG_WARM)
+        return_val = 0;
+    }
+    else
+    {
+        return_val = sf2bl_rd_flash_image(address);
+        if(0 == return_val)
+        {
+            boot_record_seal(&g_img1_header);
+        }
+    }
+#else
+    return_val = sf2bl_rd_flash_image(address);
+#endif
+
+    return(return_val);
+}
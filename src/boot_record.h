@@ -0,0 +1,26 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader warm boot support header.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef BOOT_RECORD_H_
+#define BOOT_RECORD_H_
+
+int32_t sf2bl_boot_image(uint32_t address);
+
+#if defined(SF2BL_WARM_BOOT)
+/*
+ * Flags for sf2bl_boot_record_add().
+ */
+#define SF2BL_REGION_ZERO_FILL 0x00000001u /* Region is cleared, not checked */
+#define SF2BL_REGION_CRC       0x00000002u /* crc32 is the CRC32 of the region as loaded */
+
+void sf2bl_boot_record_begin(uint32_t img_offset);
+void sf2bl_boot_record_add(const uint8_t *start, uint32_t len, uint32_t flags, uint32_t crc32);
+#endif
+
+#endif /* BOOT_RECORD_H_ */
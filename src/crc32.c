@@ -106,9 +106,12 @@ static const uint32_t crc32_table[256] = {
  * build up a complete CRC for a block by starting with 0xFFFFFFFF and passing
  * in the running CRC for each chunk.
  */
+uint32_t g_crc32_bytes = 0;
+
 uint32_t sf2bl_calc_crc32(uint32_t crc, const uint8_t *data, uint32_t len)
 {
 
+    g_crc32_bytes += len;
     while (len > 0)
     {
         crc = crc32_table[*data ^ ((crc >> 24) & 0xff)] ^ (crc << 8);
@@ -119,3 +122,51 @@ uint32_t sf2bl_calc_crc32(uint32_t crc, const uint8_t *data, uint32_t len)
     return crc;
 }
 
+
+/***************************************************************************//**
+ * Multiply a by b modulo the CRC polynomial.
+ */
+static uint32_t crc32_mul(uint32_t a, uint32_t b)
+{
+    uint32_t product = 0;
+    uint32_t bit;
+
+    for(bit = 0x80000000u; bit != 0; bit >>= 1)
+    {
+        product = (0u != (product & 0x80000000u)) ? ((product << 1) ^ 0x04C11DB7u) : (product << 1);
+        if(0u != (b & bit))
+        {
+            product ^= a;
+        }
+    }
+
+    return product;
+}
+
+
+/***************************************************************************//**
+ * Give the CRC sf2bl_calc_crc32() would return for crc followed by len bytes
+ * whose own CRC, starting from 0xFFFFFFFF, is crc_next. This lets a block be
+ * checked on its own and as part of a larger block with a single pass over
+ * the data.
+ *
+ * Passing len zero bytes multiplies the CRC by x^(8 * len), and the 0xFFFFFFFF
+ * that crc_next was started from is taken out the same way.
+ */
+uint32_t sf2bl_crc32_combine(uint32_t crc, uint32_t crc_next, uint32_t len)
+{
+    uint32_t shift = 1u;    /* x^0 */
+    uint32_t power = 0x100; /* x^8, for one byte */
+
+    while (len > 0)
+    {
+        if(0u != (len & 1u))
+        {
+            shift = crc32_mul(shift, power);
+        }
+        power = crc32_mul(power, power);
+        len >>= 1;
+    }
+
+    return crc_next ^ crc32_mul(crc ^ 0xFFFFFFFF, shift);
+}
@@ -11,6 +11,10 @@
 #ifndef CRC32_H_
 #define CRC32_H_
 
+/* Running count of bytes passed through sf2bl_calc_crc32() */
+extern uint32_t g_crc32_bytes;
+
 uint32_t sf2bl_calc_crc32(uint32_t crc, const uint8_t *data, uint32_t len);
+uint32_t sf2bl_crc32_combine(uint32_t crc, uint32_t crc_next, uint32_t len);
 
 #endif /* CRC32_H_ */
@@ -0,0 +1,186 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader delta update support routines.
+ *
+ * A delta update file describes the new image in terms of the image currently
+ * active in the SPI FLASH plus the data that has changed, so only the changes
+ * need to be sent over the serial link. The file is received into g_rx_base in
+ * the same way as an Intel Hex file and the new image is rebuilt at g_bin_base
+ * from where it is written to the inactive image slot as normal.
+ *
+ * Deltas are always made against the uncompressed form of the active image,
+ * i.e. the binary image exactly as the Bootloader builds it from the Intel Hex
+ * file, so they do not depend on whether SF2BL_IMAGE_COMPRESS is in use.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sf2_bl_defs.h"
+#include "sf2_bl_options.h"
+#include "image_tools.h"
+#include "crc32.h"
+#include "ymodem.h"
+#include "delta.h"
+
+/***************************************************************************//**
+ * Fetch an unaligned little endian 32 bit value from the delta file.
+ */
+static uint32_t delta_get_u32(const uint8_t *data)
+{
+    return((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+}
+
+/***************************************************************************//**
+ * Find the image the delta should be applied to. This is the image which is
+ * currently active, as determined by sf2bl_select_image(), and which the
+ * download is about to supersede.
+ *
+ * Returns the FLASH offset of the image or SF2BL_NO_IMAGE if there is none.
+ */
+static uint32_t delta_source_image(void)
+{
+    uint32_t offset = SF2BL_NO_IMAGE;
+
+#if defined(SF2BL_2ND_IMAGE)
+    if((SF2BL_BOOT_DOWNLOAD_1 == g_boot_mode) && (SF2BL_HDR_OK == g_img2_status))
+    {
+        offset = g_img2_offset;
+    }
+    else if((SF2BL_BOOT_DOWNLOAD_2 == g_boot_mode) && (SF2BL_HDR_OK == g_img1_status))
+    {
+        offset = g_img1_offset;
+    }
+#else
+    /*
+     * Only one image so we are replacing the image we patch against. This is
+     * ok as the new image is built in RAM before the FLASH is touched.
+     */
+    if((SF2BL_BOOT_DOWNLOAD_1 == g_boot_mode) && (SF2BL_HDR_OK == g_img1_status))
+    {
+        offset = g_img1_offset;
+    }
+#endif
+
+    return(offset);
+}
+
+/***************************************************************************//**
+ * Apply the operations in the delta file to build the new image.
+ *
+ * Returns 0 for success or -1 for error.
+ */
+static int32_t delta_apply(const uint8_t *data, const uint8_t *data_end,
+                           const uint8_t *src, uint32_t src_size,
+                           uint8_t *dest, const uint8_t *dest_end)
+{
+    uint32_t offset;
+    uint32_t len;
+    int32_t done  = 0;
+    int32_t error = 0;
+
+    while(!done && !error)
+    {
+        if(data >= data_end)
+        {
+            error = 1; /* Ran out of file before the end operation */
+        }
+        else if(SF2BL_DELTA_OP_END == *data)
+        {
+            done = 1;
+        }
+        else if((SF2BL_DELTA_OP_COPY == *data) && ((data_end - data) >= 9))
+        {
+            offset = delta_get_u32(data + 1);
+            len    = delta_get_u32(data + 5);
+            data  += 9;
+            if((len > (uint32_t)(dest_end - dest)) || (offset > src_size) || (len > (src_size - offset)))
+            {
+                error = 1;
+            }
+            else
+            {
+                memcpy(dest, src + offset, len);
+                dest += len;
+            }
+        }
+        else if((SF2BL_DELTA_OP_INSERT == *data) && ((data_end - data) >= 5))
+        {
+            len   = delta_get_u32(data + 1);
+            data += 5;
+            if((len > (uint32_t)(dest_end - dest)) || (len > (uint32_t)(data_end - data)))
+            {
+                error = 1;
+            }
+            else
+            {
+                memcpy(dest, data, len);
+                dest += len;
+                data += len;
+            }
+        }
+        else
+        {
+            error = 1; /* Unknown or truncated operation */
+        }
+    }
+
+    /* The operations must produce exactly the target size */
+    return((error || (dest != dest_end)) ? -1 : 0);
+}
+
+/***************************************************************************//**
+ * Apply the delta update file at g_rx_base to the active image and build the
+ * new image at g_bin_base. The active image is expanded into the free space
+ * after the delta file first. The result is checked against the target CRC32
+ * in the delta header and then prepared for writing to FLASH.
+ *
+ * Returns the number of bytes in the new image or 0 for error.
+ */
+uint32_t sf2bl_process_delta(uint32_t received)
+{
+    img_delta_hdr_t *pdelta;
+    uint32_t src_offset;
+    uint8_t *src;
+    uint32_t src_size = 0;
+    uint32_t return_val = 0;
+
+    pdelta = (img_delta_hdr_t *)g_rx_base;
+    src_offset = delta_source_image();
+    src = g_rx_base + ((received + 3u) & ~3u);
+
+    if((received < sizeof(img_delta_hdr_t)) ||
+       (SF2BL_DELTA_MAGIC != pdelta->magic) || (SF2BL_DELTA_VERSION != pdelta->version) ||
+       (pdelta->tgt_size <= sizeof(img_hdr_block_t)) || (pdelta->tgt_size > (SF2BL_DDR_SIZE - g_rx_size)))
+    {
+        SF2BL_MESSAGE("Invalid delta file\r\n")
+    }
+    else
+    {
+        if((SF2BL_NO_IMAGE != src_offset) && (received < g_rx_size))
+        {
+            src_size = sf2bl_expand_flash_image(src_offset, src, g_rx_size - (uint32_t)(src - g_rx_base));
+        }
+
+        if((0u == src_size) || (((img_hdr_block_t *)src)->crc32 != pdelta->src_crc32))
+        {
+            SF2BL_MESSAGE("Delta does not match the active image\r\n")
+        }
+        else if((0 != delta_apply(g_rx_base + sizeof(img_delta_hdr_t), g_rx_base + received,
+                                  src, src_size, g_bin_base, g_bin_base + pdelta->tgt_size)) ||
+                (pdelta->tgt_crc32 != sf2bl_calc_crc32(0xFFFFFFFF, g_bin_base, pdelta->tgt_size)))
+        {
+            SF2BL_MESSAGE("Delta did not produce the expected image\r\n")
+        }
+        else
+        {
+            return_val = sf2bl_process_bin_image(pdelta->tgt_size);
+        }
+    }
+
+    return(return_val);
+}
@@ -0,0 +1,15 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader delta update support header.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef DELTA_H_
+#define DELTA_H_
+
+uint32_t sf2bl_process_delta(uint32_t received);
+
+#endif /* DELTA_H_ */
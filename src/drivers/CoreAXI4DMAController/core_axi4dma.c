@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * CoreAXI4DMAController driver implementation.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include "core_axi4dma.h"
+#include "coreaxi4dma_regs.h"
+#include "hal.h"
+#include "hal_assert.h"
+
+/***************************************************************************//**
+ * AXI4DMA_init()
+ * See "core_axi4dma.h" for details of how to use this function.
+ */
+void
+AXI4DMA_init
+(
+    axi4dma_instance_t * this_dma,
+    addr_t base_addr
+)
+{
+    HAL_ASSERT( 0 != this_dma )
+
+    this_dma->base_addr = base_addr;
+
+    /* Events are polled, keep the interrupt output quiet */
+    HAL_set_32bit_reg( base_addr, INTR_0_MASK, 0u );
+    while( 0u != ( HAL_get_32bit_reg( base_addr, INTR_0_STAT ) &
+                   ( INTR_0_OP_COMPLETE_MASK | INTR_0_ERROR_MASK ) ) )
+    {
+        HAL_set_32bit_reg( base_addr, INTR_0_CLEAR, INTR_0_OP_COMPLETE_MASK | INTR_0_ERROR_MASK );
+    }
+}
+
+/***************************************************************************//**
+ * AXI4DMA_configure_desc()
+ * See "core_axi4dma.h" for details of how to use this function.
+ */
+void
+AXI4DMA_configure_desc
+(
+    axi4dma_instance_t * this_dma,
+    uint8_t desc_id,
+    uint32_t src_addr,
+    uint32_t src_op,
+    uint32_t dest_addr,
+    uint32_t dest_op,
+    uint32_t byte_count,
+    uint8_t next_desc
+)
+{
+    addr_t desc_addr;
+    uint32_t config;
+
+    HAL_ASSERT( desc_id < DESC_COUNT )
+    HAL_ASSERT( 0u != byte_count )
+
+    desc_addr = this_dma->base_addr + DESC_REG_OFFSET + ( (addr_t)desc_id * DESC_SIZE );
+
+    config = ( ( src_op << DESC_SRC_OP_SHIFT ) & DESC_SRC_OP_MASK ) |
+             ( ( dest_op << DESC_DEST_OP_SHIFT ) & DESC_DEST_OP_MASK ) |
+             DESC_SRC_DATA_VALID_MASK | DESC_DEST_DATA_READY_MASK | DESC_VALID_MASK;
+    if( AXI4DMA_NO_NEXT_DESC == next_desc )
+    {
+        config |= DESC_IRQ_ON_PROCESS_MASK;
+    }
+    else
+    {
+        HAL_ASSERT( next_desc < DESC_COUNT )
+        config |= DESC_CHAIN_MASK;
+        HAL_set_32bit_reg( desc_addr, DESC_NEXT_DESC, next_desc );
+    }
+
+    HAL_set_32bit_reg( desc_addr, DESC_BYTE_COUNT, byte_count );
+    HAL_set_32bit_reg( desc_addr, DESC_SRC_ADDR, src_addr );
+    HAL_set_32bit_reg( desc_addr, DESC_DEST_ADDR, dest_addr );
+    HAL_set_32bit_reg( desc_addr, DESC_CONFIG, config );
+}
+
+/***************************************************************************//**
+ * AXI4DMA_start()
+ * See "core_axi4dma.h" for details of how to use this function.
+ */
+void
+AXI4DMA_start
+(
+    axi4dma_instance_t * this_dma,
+    uint8_t desc_id
+)
+{
+    HAL_ASSERT( desc_id < DESC_COUNT )
+
+    HAL_set_32bit_reg( this_dma->base_addr, START_OPERATION, (uint32_t)1u << desc_id );
+}
+
+/***************************************************************************//**
+ * AXI4DMA_get_event()
+ * See "core_axi4dma.h" for details of how to use this function.
+ */
+uint32_t
+AXI4DMA_get_event
+(
+    axi4dma_instance_t * this_dma,
+    uint8_t * p_desc_id
+)
+{
+    uint32_t status;
+    uint32_t event = 0u;
+
+    status = HAL_get_32bit_reg( this_dma->base_addr, INTR_0_STAT );
+    if( 0u != ( status & ( INTR_0_OP_COMPLETE_MASK | INTR_0_ERROR_MASK ) ) )
+    {
+        if( 0u != ( status & INTR_0_OP_COMPLETE_MASK ) )
+        {
+            event |= AXI4DMA_EVENT_COMPLETE;
+        }
+        if( 0u != ( status & INTR_0_ERROR_MASK ) )
+        {
+            event |= AXI4DMA_EVENT_ERROR;
+        }
+        *p_desc_id = (uint8_t)( ( status & INTR_0_DESC_NUM_MASK ) >> INTR_0_DESC_NUM_SHIFT );
+        HAL_set_32bit_reg( this_dma->base_addr, INTR_0_CLEAR, status & ( INTR_0_OP_COMPLETE_MASK | INTR_0_ERROR_MASK ) );
+    }
+
+    return( event );
+}
@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * CoreAXI4DMAController public API.
+ *
+ * A minimal driver for the internal descriptors of CoreAXI4DMAController.
+ * Descriptors are loaded one at a time and may be chained together, a chain
+ * being started by starting its first descriptor. Completion and errors are
+ * reported through the interrupt 0 event queue, which can be polled.
+ *
+ * Transfers to or from a peripheral FIFO, such as CoreSPI's TXDATA and RXDATA,
+ * use a fixed address for the peripheral side and rely on the peripheral's DMA
+ * request signals being connected to the controller in the design to pace the
+ * transfer.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+#ifndef CORE_AXI4DMA_H_
+#define CORE_AXI4DMA_H_
+
+#include "cpu_types.h"
+
+/***************************************************************************//**
+ * Address operations for the source and destination of a descriptor.
+ * AXI4DMA_OP_INCR steps through memory and AXI4DMA_OP_FIXED reads or writes
+ * the same address each time, for peripheral data registers.
+ */
+#define AXI4DMA_OP_NONE     0u
+#define AXI4DMA_OP_INCR     1u
+#define AXI4DMA_OP_FIXED    2u
+
+/***************************************************************************//**
+ * Pass as next_desc to AXI4DMA_configure_desc() for the last descriptor of a
+ * chain. The completion event is only raised for the last descriptor.
+ */
+#define AXI4DMA_NO_NEXT_DESC    0xFFu
+
+/***************************************************************************//**
+ * Event status returned by AXI4DMA_get_event().
+ */
+#define AXI4DMA_EVENT_COMPLETE  0x00000001u
+#define AXI4DMA_EVENT_ERROR     0x00000002u
+
+/***************************************************************************//**
+ * There should be one instance of this structure for each instance of
+ * CoreAXI4DMAController in your system. AXI4DMA_init() initializes it.
+ */
+typedef struct __axi4dma_instance_t
+{
+    addr_t base_addr;
+} axi4dma_instance_t;
+
+/***************************************************************************//**
+ * AXI4DMA_init() initializes the instance structure, masks the interrupt 0
+ * output and empties its event queue.
+ *
+ * @param this_dma      Pointer to the axi4dma_instance_t for the controller.
+ * @param base_addr     Base address of the controller's registers.
+ */
+void
+AXI4DMA_init
+(
+    axi4dma_instance_t * this_dma,
+    addr_t base_addr
+);
+
+/***************************************************************************//**
+ * AXI4DMA_configure_desc() loads internal descriptor desc_id with a transfer of
+ * byte_count bytes from src_addr to dest_addr. The descriptor is marked valid
+ * but not started.
+ *
+ * @param this_dma      Pointer to the axi4dma_instance_t for the controller.
+ * @param desc_id       Internal descriptor number, 0 to 31.
+ * @param src_addr      Source address.
+ * @param src_op        AXI4DMA_OP_INCR or AXI4DMA_OP_FIXED.
+ * @param dest_addr     Destination address.
+ * @param dest_op       AXI4DMA_OP_INCR or AXI4DMA_OP_FIXED.
+ * @param byte_count    Bytes to transfer, must not be 0.
+ * @param next_desc     Descriptor to continue with when this one is done or
+ *                      AXI4DMA_NO_NEXT_DESC for the end of a chain.
+ */
+void
+AXI4DMA_configure_desc
+(
+    axi4dma_instance_t * this_dma,
+    uint8_t desc_id,
+    uint32_t src_addr,
+    uint32_t src_op,
+    uint32_t dest_addr,
+    uint32_t dest_op,
+    uint32_t byte_count,
+    uint8_t next_desc
+);
+
+/***************************************************************************//**
+ * AXI4DMA_start() starts the chain beginning with descriptor desc_id.
+ *
+ * @param this_dma      Pointer to the axi4dma_instance_t for the controller.
+ * @param desc_id       First descriptor of the chain.
+ */
+void
+AXI4DMA_start
+(
+    axi4dma_instance_t * this_dma,
+    uint8_t desc_id
+);
+
+/***************************************************************************//**
+ * AXI4DMA_get_event() removes the oldest event from the interrupt 0 queue.
+ *
+ * @param this_dma      Pointer to the axi4dma_instance_t for the controller.
+ * @param p_desc_id     Set to the number of the descriptor the event is for.
+ * @return              0 if there is no event, otherwise AXI4DMA_EVENT_COMPLETE
+ *                      and/or AXI4DMA_EVENT_ERROR.
+ */
+uint32_t
+AXI4DMA_get_event
+(
+    axi4dma_instance_t * this_dma,
+    uint8_t * p_desc_id
+);
+
+#endif /* CORE_AXI4DMA_H_ */
@@ -0,0 +1,84 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * CoreAXI4DMAController register definitions, for the parts of the core used
+ * by the driver.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef __CORE_AXI4DMA_REGISTERS
+#define __CORE_AXI4DMA_REGISTERS    1
+
+/*------------------------------------------------------------------------------
+ * VERSION register details
+ */
+#define VERSION_REG_OFFSET          0x000u
+
+/*------------------------------------------------------------------------------
+ * START_OPERATION register details. Writing a 1 to bit n starts internal
+ * descriptor n.
+ */
+#define START_OPERATION_REG_OFFSET  0x004u
+
+/*------------------------------------------------------------------------------
+ * INTR_0_STAT register details. Each read returns the oldest event queued for
+ * interrupt output 0 and writing INTR_0_CLEAR removes it from the queue.
+ */
+#define INTR_0_STAT_REG_OFFSET      0x010u
+
+#define INTR_0_OP_COMPLETE_OFFSET   0x010u
+#define INTR_0_OP_COMPLETE_MASK     0x00000001u
+#define INTR_0_OP_COMPLETE_SHIFT    0u
+
+#define INTR_0_ERROR_OFFSET         0x010u
+#define INTR_0_ERROR_MASK           0x0000000Eu /* Write, read or invalid descriptor */
+#define INTR_0_ERROR_SHIFT          1u
+
+#define INTR_0_DESC_NUM_OFFSET      0x010u
+#define INTR_0_DESC_NUM_MASK        0x000007F0u
+#define INTR_0_DESC_NUM_SHIFT       4u
+
+/*------------------------------------------------------------------------------
+ * INTR_0_MASK register details
+ */
+#define INTR_0_MASK_REG_OFFSET      0x014u
+
+/*------------------------------------------------------------------------------
+ * INTR_0_CLEAR register details
+ */
+#define INTR_0_CLEAR_REG_OFFSET     0x018u
+
+/*------------------------------------------------------------------------------
+ * Internal descriptors. Descriptor n is at DESC_REG_OFFSET + (n * DESC_SIZE)
+ * and the registers below are relative to that.
+ */
+#define DESC_REG_OFFSET             0x060u
+#define DESC_SIZE                   0x020u
+#define DESC_COUNT                  32u
+
+#define DESC_CONFIG_REG_OFFSET      0x00u
+#define DESC_BYTE_COUNT_REG_OFFSET  0x04u
+#define DESC_SRC_ADDR_REG_OFFSET    0x08u
+#define DESC_DEST_ADDR_REG_OFFSET   0x0Cu
+#define DESC_NEXT_DESC_REG_OFFSET   0x10u
+
+/*
+ * DESC_CONFIG bits.
+ */
+#define DESC_SRC_OP_OFFSET          0x00u
+#define DESC_SRC_OP_MASK            0x00000003u
+#define DESC_SRC_OP_SHIFT           0u
+
+#define DESC_DEST_OP_OFFSET         0x00u
+#define DESC_DEST_OP_MASK           0x0000000Cu
+#define DESC_DEST_OP_SHIFT          2u
+
+#define DESC_CHAIN_MASK             0x00000400u
+#define DESC_IRQ_ON_PROCESS_MASK    0x00001000u
+#define DESC_SRC_DATA_VALID_MASK    0x00002000u
+#define DESC_DEST_DATA_READY_MASK   0x00004000u
+#define DESC_VALID_MASK             0x00008000u
+
+#endif /* __CORE_AXI4DMA_REGISTERS */
@@ -52,6 +52,7 @@ enum {
 static void fill_slave_tx_fifo( spi_instance_t * this_spi );
 static void read_slave_rx_fifo( spi_instance_t * this_spi );
 static void recover_from_rx_overflow( const spi_instance_t * this_spi );
+static void master_xfer_isr( spi_instance_t * this_spi );
 
 /*******************************************************************************
  * SPI_init()
@@ -294,6 +295,101 @@ uint32_t SPI_transfer_frame
 }
 
 
+/*******************************************************************************
+ * Write count frames to TXDATA, taken from tx_ptr or 0s to clock in received
+ * frames if tx_ptr is null. Unrolled as this is the bulk of every FLASH read.
+ */
+static inline void spi_put_tx_frames
+(
+    addr_t base_addr,
+    const uint8_t * tx_ptr,
+    uint32_t count
+)
+{
+    if( 0 != tx_ptr )
+    {
+        while( count >= 4u )
+        {
+            HAL_set_32bit_reg( base_addr, TXDATA, (uint32_t)tx_ptr[0] );
+            HAL_set_32bit_reg( base_addr, TXDATA, (uint32_t)tx_ptr[1] );
+            HAL_set_32bit_reg( base_addr, TXDATA, (uint32_t)tx_ptr[2] );
+            HAL_set_32bit_reg( base_addr, TXDATA, (uint32_t)tx_ptr[3] );
+            tx_ptr += 4u;
+            count -= 4u;
+        }
+        while( count > 0u )
+        {
+            HAL_set_32bit_reg( base_addr, TXDATA, (uint32_t)*tx_ptr );
+            ++tx_ptr;
+            --count;
+        }
+    }
+    else
+    {
+        while( count >= 4u )
+        {
+            HAL_set_32bit_reg( base_addr, TXDATA, 0u );
+            HAL_set_32bit_reg( base_addr, TXDATA, 0u );
+            HAL_set_32bit_reg( base_addr, TXDATA, 0u );
+            HAL_set_32bit_reg( base_addr, TXDATA, 0u );
+            count -= 4u;
+        }
+        while( count > 0u )
+        {
+            HAL_set_32bit_reg( base_addr, TXDATA, 0u );
+            --count;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Write frames tx_idx to tx_idx + count - 1 of a block transfer to the TX FIFO.
+ * Frames past the end of the command are 0s to clock in the response and the
+ * final frame of the transfer goes to TXLAST to end the transfer. The caller
+ * makes sure there is room for all of them so the FIFO status is not checked.
+ *
+ * Returns the index of the next frame to send.
+ */
+static uint32_t spi_fill_tx_fifo
+(
+    addr_t base_addr,
+    const uint8_t * cmd_buffer,
+    uint32_t cmd_byte_size,
+    uint32_t transfer_size,
+    uint32_t tx_idx,
+    uint32_t count
+)
+{
+    uint32_t end = tx_idx + count;
+    uint32_t last = 0u;
+    uint32_t n;
+
+    if( end == transfer_size )
+    {
+        last = 1u;
+        --end;
+    }
+
+    if( tx_idx < cmd_byte_size )
+    {
+        n = ( ( end < cmd_byte_size ) ? end : cmd_byte_size ) - tx_idx;
+        spi_put_tx_frames( base_addr, &cmd_buffer[tx_idx], n );
+        tx_idx += n;
+    }
+
+    /* Receive only */
+    spi_put_tx_frames( base_addr, 0, end - tx_idx );
+    tx_idx = end;
+
+    if( 0u != last )
+    {
+        HAL_set_32bit_reg( base_addr, TXLAST, ( tx_idx < cmd_byte_size ) ? (uint32_t)cmd_buffer[tx_idx] : 0u );
+        ++tx_idx;
+    }
+
+    return( tx_idx );
+}
+
 /***************************************************************************//**
  * SPI_transfer_block()
  * See "core_spi.h" for details of how to use this function.
@@ -495,6 +591,387 @@ void SPI_transfer_block
     }
 }
 
+/*
+ * Position in a list of segments, used to walk through them separately for the
+ * frames sent and received.
+ */
+typedef struct spi_seg_cursor
+{
+    const spi_segment_t * seg;     /* Current segment */
+    uint32_t pos;                  /* Frames of current segment done */
+    uint32_t chunk_pos;            /* Where the next received frame is stored */
+    uint32_t chunk_size;           /* Receive only, see SPI_transfer_segments_chunked() */
+    spi_block_rx_handler_t chunk_handler;
+} spi_seg_cursor_t;
+
+/*******************************************************************************
+ * Write the next count frames of a segment transfer to the TX FIFO, with the
+ * final frame going to TXLAST if last is set. As for spi_fill_tx_fifo() the
+ * caller makes sure there is room for all of them.
+ */
+static void spi_seg_fill_tx_fifo
+(
+    addr_t base_addr,
+    spi_seg_cursor_t * cursor,
+    uint32_t count,
+    uint32_t last
+)
+{
+    const uint8_t * tx_ptr;
+    uint32_t n;
+
+    if( 0u != last )
+    {
+        --count;
+    }
+
+    while( count > 0u )
+    {
+        n = cursor->seg->length - cursor->pos;
+        n = ( n < count ) ? n : count;
+        count -= n;
+        tx_ptr = 0;
+        if( ( SPI_SEG_TX == cursor->seg->direction ) && ( 0 != cursor->seg->buffer ) )
+        {
+            tx_ptr = &cursor->seg->buffer[cursor->pos];
+        }
+        spi_put_tx_frames( base_addr, tx_ptr, n );
+        cursor->pos += n;
+
+        if( cursor->pos >= cursor->seg->length )
+        {
+            ++cursor->seg;
+            cursor->pos = 0u;
+        }
+    }
+
+    if( 0u != last )
+    {
+        while( cursor->pos >= cursor->seg->length )
+        {
+            ++cursor->seg;
+            cursor->pos = 0u;
+        }
+        HAL_set_32bit_reg( base_addr, TXLAST, ( ( SPI_SEG_TX == cursor->seg->direction ) && ( 0 != cursor->seg->buffer ) ) ?
+                                              (uint32_t)cursor->seg->buffer[cursor->pos] : 0u );
+        ++cursor->pos;
+    }
+}
+
+/*******************************************************************************
+ * Read up to max frames of a segment transfer from the RX FIFO, stopping when
+ * it is empty. Frames are stored if they belong to an SPI_SEG_RX segment with
+ * a buffer and discarded otherwise. With a chunk handler each chunk is passed
+ * to it as soon as it is complete and the next one goes in the same place.
+ *
+ * Returns the number of frames read.
+ */
+static uint32_t spi_seg_drain_rx_fifo
+(
+    addr_t base_addr,
+    spi_seg_cursor_t * cursor,
+    uint32_t max
+)
+{
+    uint32_t count = 0u;
+    uint8_t rx_byte;
+
+    while( ( count < max ) && ( 0u == ( HAL_get_8bit_reg( base_addr, STATUS ) & STATUS_RXEMPTY_MASK ) ) )
+    {
+        while( cursor->pos >= cursor->seg->length )
+        {
+            ++cursor->seg;
+            cursor->pos = 0u;
+            cursor->chunk_pos = 0u;
+        }
+
+        rx_byte = (uint8_t)HAL_get_32bit_reg( base_addr, RXDATA );
+        ++cursor->pos;
+        ++count;
+        if( ( SPI_SEG_RX == cursor->seg->direction ) && ( 0 != cursor->seg->buffer ) )
+        {
+            cursor->seg->buffer[cursor->chunk_pos] = rx_byte;
+            ++cursor->chunk_pos;
+            if( ( 0 != cursor->chunk_handler ) &&
+                ( ( cursor->chunk_pos == cursor->chunk_size ) || ( cursor->pos == cursor->seg->length ) ) )
+            {
+                cursor->chunk_handler( cursor->seg->buffer, cursor->chunk_pos );
+                cursor->chunk_pos = 0u;
+            }
+        }
+    }
+
+    return( count );
+}
+
+/***************************************************************************//**
+ * SPI_transfer_segments()
+ * See "core_spi.h" for details of how to use this function.
+ */
+void SPI_transfer_segments
+(
+    spi_instance_t * this_spi,
+    const spi_segment_t * segments,
+    uint32_t n_segments
+)
+{
+    SPI_transfer_segments_chunked( this_spi, segments, n_segments, 0u, 0 );
+}
+
+/***************************************************************************//**
+ * SPI_transfer_segments_chunked()
+ * See "core_spi.h" for details of how to use this function.
+ *
+ * CoreSPI has no FIFO level registers, so the number of frames in flight is
+ * tracked instead. Every frame sent produces one received frame, so as long as
+ * no more than fifo_depth frames are in flight neither FIFO can overflow. The
+ * TX FIFO is topped up a batch at a time once half of it has drained, without
+ * looking at TXFULL, and received frames are read out while RXEMPTY is clear.
+ * One cursor follows the frames sent and another the frames received. While a
+ * chunk handler runs the transfer just pauses if the TX FIFO runs dry.
+ */
+void SPI_transfer_segments_chunked
+(
+    spi_instance_t * this_spi,
+    const spi_segment_t * segments,
+    uint32_t n_segments,
+    uint32_t chunk_size,
+    spi_block_rx_handler_t chunk_handler
+)
+{
+    addr_t base_addr;
+    spi_seg_cursor_t tx_cursor;
+    spi_seg_cursor_t rx_cursor;
+    uint32_t transfer_size = 0u;   /* Total number of frames to transfer */
+    uint32_t fifo_depth;
+    uint32_t tx_idx;               /* Number of frames sent */
+    uint32_t rx_idx = 0u;          /* Number of frames received */
+    uint32_t count;
+    uint32_t index;
+
+    HAL_ASSERT( NULL_INSTANCE != this_spi );
+
+    for( index = 0u; index < n_segments; ++index )
+    {
+        transfer_size += segments[index].length;
+    }
+
+    if( ( NULL_INSTANCE != this_spi ) &&
+        ( DISABLE != HAL_get_8bit_reg_field(this_spi->base_addr, CTRL1_MASTER ) ) &&
+        ( 0u != transfer_size ) )
+    {
+        base_addr = this_spi->base_addr;
+        fifo_depth = this_spi->fifo_depth;
+        tx_cursor.seg = segments;
+        tx_cursor.pos = 0u;
+        rx_cursor.seg = segments;
+        rx_cursor.pos = 0u;
+        rx_cursor.chunk_pos = 0u;
+        rx_cursor.chunk_size = chunk_size;
+        rx_cursor.chunk_handler = ( 0u != chunk_size ) ? chunk_handler : 0;
+
+        /* Flush the receive and transmit FIFOs */
+        HAL_set_8bit_reg(base_addr, CMD, (uint32_t)(CMD_TXFIFORST_MASK | CMD_RXFIFORST_MASK ));
+
+        if( ENABLE == HAL_get_8bit_reg_field(base_addr, STATUS_RXOVFLOW) )
+        {
+             recover_from_rx_overflow( this_spi );
+        }
+
+        HAL_set_8bit_reg_field( base_addr, CTRL1_ENABLE, DISABLE );
+
+        tx_idx = ( transfer_size < fifo_depth ) ? transfer_size : fifo_depth;
+        spi_seg_fill_tx_fifo( base_addr, &tx_cursor, tx_idx, ( tx_idx == transfer_size ) );
+
+        /* FIFO is all loaded up so enable Core SPI to start transfer */
+        HAL_set_8bit_reg_field( base_addr, CTRL1_ENABLE, ENABLE );
+
+        while( rx_idx < transfer_size )
+        {
+            if( ( tx_idx < transfer_size ) && ( ( tx_idx - rx_idx ) <= ( fifo_depth / 2u ) ) )
+            {
+                count = fifo_depth - ( tx_idx - rx_idx );
+                count = ( ( transfer_size - tx_idx ) < count ) ? ( transfer_size - tx_idx ) : count;
+                tx_idx += count;
+                spi_seg_fill_tx_fifo( base_addr, &tx_cursor, count, ( tx_idx == transfer_size ) );
+            }
+            rx_idx += spi_seg_drain_rx_fifo( base_addr, &rx_cursor, tx_idx - rx_idx );
+        }
+    }
+}
+
+/***************************************************************************//**
+ * SPI_transfer_block_async()
+ * See "core_spi.h" for details of how to use this function.
+ *
+ * The same in flight accounting as SPI_transfer_segments_chunked() is used,
+ * with the receive data interrupt taking the place of the polling loop.
+ */
+void SPI_transfer_block_async
+(
+    spi_instance_t * this_spi,
+    const uint8_t * cmd_buffer,
+    uint16_t cmd_byte_size,
+    uint8_t * rx_buffer,
+    uint16_t rx_byte_size,
+    spi_master_done_handler_t done_handler
+)
+{
+    addr_t base_addr;
+    uint32_t count;
+
+    HAL_ASSERT( NULL_INSTANCE != this_spi );
+    HAL_ASSERT( 0u == this_spi->master_busy );
+
+    if( ( NULL_INSTANCE != this_spi ) && ( 0u == this_spi->master_busy ) )
+    {
+        /* This function is only intended to be used with an SPI master. */
+        if( ( DISABLE != HAL_get_8bit_reg_field(this_spi->base_addr, CTRL1_MASTER ) ) &&
+            ( 0u != ( (uint32_t)cmd_byte_size + (uint32_t)rx_byte_size ) ) )
+        {
+            base_addr = this_spi->base_addr;
+            this_spi->master_cmd_buffer   = cmd_buffer;
+            this_spi->master_cmd_size     = cmd_byte_size;
+            this_spi->master_rx_buffer    = rx_buffer;
+            this_spi->master_xfer_size    = (uint32_t)cmd_byte_size + (uint32_t)rx_byte_size;
+            this_spi->master_rx_idx       = 0u;
+            this_spi->master_done_handler = done_handler;
+            this_spi->master_busy         = 1u;
+
+            /* Flush the receive and transmit FIFOs */
+            HAL_set_8bit_reg(base_addr, CMD, (uint32_t)(CMD_TXFIFORST_MASK | CMD_RXFIFORST_MASK ));
+
+            if( ENABLE == HAL_get_8bit_reg_field(base_addr, STATUS_RXOVFLOW) )
+            {
+                 recover_from_rx_overflow( this_spi );
+            }
+
+            HAL_set_8bit_reg_field( base_addr, CTRL1_ENABLE, DISABLE );
+
+            count = ( this_spi->master_xfer_size < this_spi->fifo_depth ) ? this_spi->master_xfer_size : this_spi->fifo_depth;
+            this_spi->master_tx_idx = spi_fill_tx_fifo( base_addr, cmd_buffer, cmd_byte_size,
+                                                        this_spi->master_xfer_size, 0u, count );
+
+            HAL_set_8bit_reg( base_addr, INTCLR, INTCLR_RXDATA_MASK );
+            HAL_set_8bit_reg_field( base_addr, CTRL2_INTRXDATA, ENABLE );
+
+            /* FIFO is all loaded up so enable Core SPI to start transfer */
+            HAL_set_8bit_reg_field( base_addr, CTRL1_ENABLE, ENABLE );
+        }
+        else if( 0 != done_handler )
+        {
+            /* Nothing to transfer */
+            done_handler( this_spi );
+        }
+    }
+}
+
+/***************************************************************************//**
+ * SPI_transfer_busy()
+ * See "core_spi.h" for details of how to use this function.
+ */
+uint32_t SPI_transfer_busy
+(
+    spi_instance_t * this_spi
+)
+{
+    HAL_ASSERT( NULL_INSTANCE != this_spi );
+
+    return( ( NULL_INSTANCE != this_spi ) ? this_spi->master_busy : 0u );
+}
+
+/***************************************************************************//**
+ * SPI_transfer_abort()
+ * See "core_spi.h" for details of how to use this function.
+ */
+void SPI_transfer_abort
+(
+    spi_instance_t * this_spi
+)
+{
+    HAL_ASSERT( NULL_INSTANCE != this_spi );
+
+    if( NULL_INSTANCE != this_spi )
+    {
+        HAL_set_8bit_reg_field( this_spi->base_addr, CTRL2_INTRXDATA, DISABLE );
+        this_spi->master_busy = 0u;
+        recover_from_rx_overflow( this_spi );
+    }
+}
+
+/***************************************************************************//**
+ * SPI_flush_fifos()
+ * See "core_spi.h" for details of how to use this function.
+ */
+void SPI_flush_fifos
+(
+    spi_instance_t * this_spi
+)
+{
+    HAL_ASSERT( NULL_INSTANCE != this_spi );
+
+    if( NULL_INSTANCE != this_spi )
+    {
+        recover_from_rx_overflow( this_spi );
+    }
+}
+
+/***************************************************************************//**
+ * Service the receive data interrupt for a master block transfer. Everything in
+ * the RX FIFO is read and then the TX FIFO is filled with as many frames as can
+ * be in flight. The done handler is called once the last frame is received.
+ * The interrupt is cleared before the RX FIFO is read so that a frame which
+ * arrives after the last RXEMPTY check raises it again.
+ */
+static void master_xfer_isr
+(
+    spi_instance_t * this_spi
+)
+{
+    addr_t base_addr = this_spi->base_addr;
+    uint32_t rx_idx = this_spi->master_rx_idx;
+    uint32_t tx_idx = this_spi->master_tx_idx;
+    uint32_t xfer_size = this_spi->master_xfer_size;
+    uint32_t count;
+    uint32_t rx_frame;
+
+    HAL_set_8bit_reg( base_addr, INTCLR, INTCLR_RXDATA_MASK );
+
+    while( ( rx_idx < tx_idx ) && ( 0u == ( HAL_get_8bit_reg( base_addr, STATUS ) & STATUS_RXEMPTY_MASK ) ) )
+    {
+        rx_frame = HAL_get_32bit_reg( base_addr, RXDATA );
+        if( rx_idx >= this_spi->master_cmd_size )
+        {
+            this_spi->master_rx_buffer[rx_idx - this_spi->master_cmd_size] = (uint8_t)rx_frame;
+        }
+        ++rx_idx;
+    }
+
+    count = this_spi->fifo_depth - ( tx_idx - rx_idx );
+    if( count > ( xfer_size - tx_idx ) )
+    {
+        count = xfer_size - tx_idx;
+    }
+    if( 0u != count )
+    {
+        tx_idx = spi_fill_tx_fifo( base_addr, this_spi->master_cmd_buffer, this_spi->master_cmd_size,
+                                   xfer_size, tx_idx, count );
+    }
+
+    this_spi->master_rx_idx = rx_idx;
+    this_spi->master_tx_idx = tx_idx;
+
+    if( rx_idx == xfer_size )
+    {
+        HAL_set_8bit_reg_field( base_addr, CTRL2_INTRXDATA, DISABLE );
+        this_spi->master_busy = 0u;
+        if( 0 != this_spi->master_done_handler )
+        {
+            this_spi->master_done_handler( this_spi );
+        }
+    }
+}
+
 /***************************************************************************//**
  * SPI_set_frame_rx_handler()
  * See "core_spi.h" for details of how to use this function.
@@ -837,7 +1314,12 @@ void SPI_isr
  * latency once you are sure the interrupt vector code is correct.
  */
     HAL_ASSERT( NULL_INSTANCE != this_spi );
-    if( NULL_INSTANCE != this_spi )
+    if( ( NULL_INSTANCE != this_spi ) && ( 0u != this_spi->master_busy ) )
+    {
+        /* Interrupt driven master block transfer */
+        master_xfer_isr( this_spi );
+    }
+    else if( NULL_INSTANCE != this_spi )
     {
         /* Handle receive. */
         if( ENABLE == HAL_get_8bit_reg_field( this_spi->base_addr, INTMASK_RXDATA ) )
@@ -299,6 +299,37 @@ typedef void (*spi_frame_rx_handler_t)( uint32_t rx_frame );
  */
 typedef void (*spi_block_rx_handler_t)( uint8_t * rx_buff, uint32_t rx_size );
 
+/***************************************************************************//**
+  This defines the function prototype that must be followed by SPI master
+  transfer complete handler functions. These functions are registered with the
+  SPI driver through the SPI_transfer_block_async() function and are called
+  from SPI_isr() once the last frame of the transfer has been received.
+ */
+typedef void (*spi_master_done_handler_t)( spi_instance_t * this_spi );
+
+/***************************************************************************//**
+  This enumeration gives the direction of an spi_segment_t. Frames received
+  while an SPI_SEG_TX segment is sent are discarded and 0s are sent while an
+  SPI_SEG_RX segment is received.
+ */
+typedef enum __spi_seg_dir_t
+{
+    SPI_SEG_TX = 0,
+    SPI_SEG_RX = 1
+} spi_seg_dir_t;
+
+/***************************************************************************//**
+  One part of a transaction passed to SPI_transfer_segments(). A segment with a
+  null buffer sends 0s if it is SPI_SEG_TX, as for dummy cycles, or discards
+  what is received if it is SPI_SEG_RX. SPI_SEG_TX buffers are not written.
+ */
+typedef struct spi_segment
+{
+    uint8_t * buffer;           /*!< Data to send or where to store received data. */
+    uint32_t length;            /*!< Number of frames, 0 length segments are skipped. */
+    spi_seg_dir_t direction;    /*!< SPI_SEG_TX or SPI_SEG_RX. */
+} spi_segment_t;
+
 /***************************************************************************//**
  This enumeration is used to select a specific SPI slave device (0 to 7). It is
  used as a parameter to the SPI_configure_master_mode(), SPI_set_slave_select(),
@@ -377,6 +408,16 @@ struct spi_instance{
 
     /* How we are expecting to deal with slave transfers */
     spi_sxfer_mode_t slave_xfer_mode;	/*!< Current slave mode transfer configuration. */
+
+    /* Interrupt driven master block transfer state: */
+    const uint8_t * master_cmd_buffer;  /*!< Command sent at the start of the transfer. */
+    uint32_t master_cmd_size;           /*!< Number of command frames. */
+    uint8_t * master_rx_buffer;         /*!< Where the response is stored. */
+    uint32_t master_xfer_size;          /*!< Total number of frames in the transfer. */
+    uint32_t master_tx_idx;             /*!< Number of frames sent. */
+    uint32_t master_rx_idx;             /*!< Number of frames received. */
+    spi_master_done_handler_t master_done_handler; /*!< Called when the transfer completes. */
+    volatile uint32_t master_busy;      /*!< Non zero while the transfer is in progress. */
 };
 
 /*==============================================================================
@@ -684,6 +725,154 @@ void SPI_transfer_block
     uint16_t rx_byte_size
 );
 
+/***************************************************************************//**
+  The SPI_transfer_segments() function is used by the SPI master to carry out
+  one transaction made up of a number of segments, each of which is sent from
+  or received into its own buffer. This allows a command, address, dummy cycles
+  and data payload to be sent as one transaction without first copying them
+  into a single buffer, and there is no limit on the size of a transaction.
+
+  As with SPI_transfer_block(), the slave must have been selected with
+  SPI_set_slave_select() and this function returns once the last frame has
+  been received.
+
+  @param this_spi
+  The this_spi parameter is a pointer to a spi_instance_t structure identifying
+  the CoreSPI hardware block to operate on.
+
+  @param segments
+  The segments parameter is a pointer to an array of segments, which are
+  transferred in order.
+
+  @param n_segments
+  The n_segments parameter is the number of segments in the array.
+
+  @return
+  This function does not return any value.
+
+  Example:
+  @code
+      uint8_t cmd[4] = { 0x0B, 0x00, 0x10, 0x00 };
+      uint8_t page[256];
+      spi_segment_t read_page[3] =
+      {
+          { cmd,  sizeof(cmd),  SPI_SEG_TX },
+          { 0,    1,            SPI_SEG_TX },
+          { page, sizeof(page), SPI_SEG_RX }
+      };
+
+      SPI_set_slave_select( &g_spi0, SPI_SLAVE_0 );
+      SPI_transfer_segments( &g_spi0, read_page, 3 );
+      SPI_clear_slave_select( &g_spi0, SPI_SLAVE_0 );
+  @endcode
+ */
+void SPI_transfer_segments
+(
+    spi_instance_t * this_spi,
+    const spi_segment_t * segments,
+    uint32_t n_segments
+);
+
+/***************************************************************************//**
+  The SPI_transfer_segments_chunked() function carries out the same transaction
+  as SPI_transfer_segments() but streams the data received in SPI_SEG_RX
+  segments through a small buffer. Each segment's buffer only has to hold
+  chunk_size bytes, and chunk_handler is called with the buffer and the number
+  of bytes in it each time chunk_size bytes have been received or the segment
+  ends. The next chunk is stored in the same place once the handler returns,
+  so there is no limit on the length of an SPI_SEG_RX segment.
+
+  The slave stays selected throughout. The transfer pauses while the handler
+  runs, so the slave must tolerate a stopped clock, as SPI FLASH devices do.
+
+  @param this_spi, segments, n_segments
+  As for SPI_transfer_segments().
+
+  @param chunk_size
+  The chunk_size parameter is the number of bytes passed to each call of the
+  handler, other than the last one for each segment which may be shorter.
+
+  @param chunk_handler
+  The chunk_handler parameter is the function called with each chunk. If it is
+  0 or chunk_size is 0 this is the same as SPI_transfer_segments().
+
+  @return
+  This function does not return any value.
+ */
+void SPI_transfer_segments_chunked
+(
+    spi_instance_t * this_spi,
+    const spi_segment_t * segments,
+    uint32_t n_segments,
+    uint32_t chunk_size,
+    spi_block_rx_handler_t chunk_handler
+);
+
+/***************************************************************************//**
+  The SPI_transfer_block_async() function starts the same transfer as
+  SPI_transfer_block() but returns as soon as the TX FIFO has been loaded. The
+  rest of the transfer is driven by the CoreSPI receive data interrupt, with
+  SPI_isr() reading the RX FIFO and refilling the TX FIFO, so the CoreSPI
+  interrupt must be enabled and routed to SPI_isr() for this instance.
+
+  Completion is signalled both by SPI_transfer_busy() returning 0 and by a call
+  to done_handler, which may be 0, from SPI_isr(). The buffers must remain
+  valid and no other transfer may be started on the instance until then.
+
+  @param this_spi
+  The this_spi parameter is a pointer to a spi_instance_t structure identifying
+  the CoreSPI hardware block to operate on.
+
+  @param cmd_buffer, cmd_byte_size, rx_buffer, rx_byte_size
+  As for SPI_transfer_block().
+
+  @param done_handler
+  The done_handler parameter is the function to call when the transfer is
+  complete or 0 if the caller will poll SPI_transfer_busy().
+
+  @return
+  This function does not return any value.
+ */
+void SPI_transfer_block_async
+(
+    spi_instance_t * this_spi,
+    const uint8_t * cmd_buffer,
+    uint16_t cmd_byte_size,
+    uint8_t * rx_buffer,
+    uint16_t rx_byte_size,
+    spi_master_done_handler_t done_handler
+);
+
+/***************************************************************************//**
+  The SPI_transfer_busy() function returns non zero while a transfer started
+  with SPI_transfer_block_async() is in progress.
+ */
+uint32_t SPI_transfer_busy
+(
+    spi_instance_t * this_spi
+);
+
+/***************************************************************************//**
+  The SPI_transfer_abort() function stops a transfer started with
+  SPI_transfer_block_async() without calling its done handler. The FIFOs are
+  flushed and the receive data interrupt is disabled.
+ */
+void SPI_transfer_abort
+(
+    spi_instance_t * this_spi
+);
+
+/***************************************************************************//**
+  The SPI_flush_fifos() function empties the TX and RX FIFOs, clears any receive
+  overflow and leaves the CoreSPI enabled. It is used before a DMA controller
+  is set to move the frames of a transfer through the TXDATA and RXDATA
+  registers.
+ */
+void SPI_flush_fifos
+(
+    spi_instance_t * this_spi
+);
+
 /***************************************************************************//**
   The SPI_set_frame_rx_handler() function is used by the SPI slaves to specify
   the receive handler function that will be called by the SPI driver interrupt
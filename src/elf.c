@@ -0,0 +1,319 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader ELF file support routines.
+ *
+ * Builds the binary image at g_bin_base directly from a RISC-V ELF32 executable
+ * as it is received. The ELF and program headers are collected first, which
+ * allows space for each PT_LOAD segment to be laid out in the image, and then
+ * the segment data is copied into place as it arrives. Only the program
+ * headers are used, section headers and the rest of the file are ignored.
+ *
+ * The program header table must be within the first ELF_HDR_BUF_LEN bytes of
+ * the file, which is always the case for files produced by the GNU linker.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sf2_bl_defs.h"
+#include "sf2_bl_options.h"
+#include "image_tools.h"
+#include "crc32.h"
+#include "elf.h"
+
+#define ELF_HDR_BUF_LEN  1024u
+#define ELF_MAX_SEGMENTS 16u
+
+/*
+ * The parts of the ELF32 format we need.
+ */
+#define ELF_EI_CLASS     4u
+#define ELF_EI_DATA      5u
+#define ELF_CLASS32      1u
+#define ELF_DATA2LSB     1u
+#define ELF_ET_EXEC      2u
+#define ELF_EM_RISCV     243u
+#define ELF_PT_LOAD      1u
+
+typedef struct elf32_ehdr
+{
+    uint8_t  e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;
+    uint32_t e_phoff;
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} elf32_ehdr_t;
+
+typedef struct elf32_phdr
+{
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+} elf32_phdr_t;
+
+/*
+ * Where the file data for each loadable segment goes in the image.
+ */
+typedef struct elf_seg
+{
+    uint32_t offset; /* Offset of segment data in ELF file */
+    uint32_t filesz; /* Bytes of segment data in ELF file */
+    uint8_t *dest;   /* Location of chunk data in image */
+} elf_seg_t;
+
+typedef struct elf_stream
+{
+    uint32_t  hdr_buf[ELF_HDR_BUF_LEN / 4]; /* Start of file, word aligned */
+    uint32_t  pos;       /* Bytes of file received so far */
+    uint32_t  need;      /* Bytes needed to cover the program headers */
+    uint32_t  parsed;    /* Image laid out and segment data being copied */
+    int32_t   error;
+    uint32_t  entry;
+    uint32_t  n_chunks;
+    uint32_t  file_end;  /* End of last segment data in ELF file */
+    uint8_t  *img_end;   /* End of image being built */
+    uint32_t  n_segs;
+    elf_seg_t segs[ELF_MAX_SEGMENTS];
+} elf_stream_t;
+
+static elf_stream_t g_elf;
+
+/***************************************************************************//**
+ * Reset ready for a new ELF file.
+ */
+void sf2bl_elf_init(void)
+{
+    memset(&g_elf, 0, sizeof(g_elf));
+}
+
+/***************************************************************************//**
+ * Check the ELF header is one we can use and work out how much of the file is
+ * needed to get all the program headers.
+ *
+ * Returns 0 for success or -1 for error.
+ */
+static int32_t elf_check_ehdr(void)
+{
+    elf32_ehdr_t *pehdr = (elf32_ehdr_t *)g_elf.hdr_buf;
+    int32_t return_val = -1;
+
+    if((ELF_CLASS32 == pehdr->e_ident[ELF_EI_CLASS]) && (ELF_DATA2LSB == pehdr->e_ident[ELF_EI_DATA]) &&
+       (ELF_ET_EXEC == pehdr->e_type) && (ELF_EM_RISCV == pehdr->e_machine) &&
+       (sizeof(elf32_phdr_t) == pehdr->e_phentsize) && (0u != pehdr->e_phnum) &&
+       (pehdr->e_phoff < ELF_HDR_BUF_LEN) &&
+       ((uint32_t)pehdr->e_phnum <= ((ELF_HDR_BUF_LEN - pehdr->e_phoff) / sizeof(elf32_phdr_t))))
+    {
+        g_elf.entry = pehdr->e_entry;
+        g_elf.need  = pehdr->e_phoff + ((uint32_t)pehdr->e_phnum * sizeof(elf32_phdr_t));
+        return_val  = 0;
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Add a chunk header to the image being built.
+ *
+ * Returns 0 for success or -1 if there is no room.
+ */
+static int32_t elf_add_chunk(uint32_t address, uint32_t len, uint32_t flags)
+{
+    img_chunk_hdr_t chunk_hdr;
+    int32_t return_val = -1;
+
+    if(sizeof(chunk_hdr) <= (uint32_t)((g_bin_base + (SF2BL_DDR_SIZE - g_rx_size)) - g_elf.img_end))
+    {
+        chunk_hdr.base   = address & 0xFFFF0000u;
+        chunk_hdr.offset = address & 0x0000FFFFu;
+        chunk_hdr.len    = len;
+        chunk_hdr.index  = g_elf.n_chunks | flags;
+        /* Chunk headers are not necessarily word aligned in the image */
+        memcpy(g_elf.img_end, &chunk_hdr, sizeof(chunk_hdr));
+        g_elf.img_end += sizeof(chunk_hdr);
+        g_elf.n_chunks++;
+        return_val = 0;
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Lay out a chunk in the image for each PT_LOAD segment. Segment data goes in a
+ * normal chunk and any extra memory size beyond the file data, i.e. .bss, is
+ * recorded as a zero fill chunk.
+ *
+ * Returns 0 for success or -1 for error.
+ */
+static int32_t elf_layout(void)
+{
+    elf32_ehdr_t *pehdr = (elf32_ehdr_t *)g_elf.hdr_buf;
+    elf32_phdr_t phdr;
+    uint32_t index;
+    int32_t error = 0;
+
+    g_elf.img_end = g_bin_base + sizeof(img_hdr_block_t);
+
+    for(index = 0; (0 == error) && (index < pehdr->e_phnum); index++)
+    {
+        memcpy(&phdr, (uint8_t *)g_elf.hdr_buf + pehdr->e_phoff + (index * sizeof(phdr)), sizeof(phdr));
+        if((ELF_PT_LOAD == phdr.p_type) && (0u != phdr.p_memsz))
+        {
+            /*
+             * Bounds are checked by subtraction so bad values cannot wrap. The
+             * file is no bigger than g_rx_size as ymodem_receive() enforces it.
+             */
+            if((phdr.p_filesz > phdr.p_memsz) || (g_elf.n_segs >= ELF_MAX_SEGMENTS) ||
+               (phdr.p_filesz > g_rx_size) || (phdr.p_offset > (g_rx_size - phdr.p_filesz)) ||
+               (phdr.p_paddr > (0xFFFFFFFFu - (phdr.p_memsz - 1u))))
+            {
+                error = 1;
+            }
+
+            if((0 == error) && (0u != phdr.p_filesz))
+            {
+                error = elf_add_chunk(phdr.p_paddr, phdr.p_filesz, 0u);
+                if((0 == error) &&
+                   (phdr.p_filesz <= (uint32_t)((g_bin_base + (SF2BL_DDR_SIZE - g_rx_size)) - g_elf.img_end)))
+                {
+                    g_elf.segs[g_elf.n_segs].offset = phdr.p_offset;
+                    g_elf.segs[g_elf.n_segs].filesz = phdr.p_filesz;
+                    g_elf.segs[g_elf.n_segs].dest   = g_elf.img_end;
+                    g_elf.n_segs++;
+                    g_elf.img_end += phdr.p_filesz;
+                    if((phdr.p_offset + phdr.p_filesz) > g_elf.file_end)
+                    {
+                        g_elf.file_end = phdr.p_offset + phdr.p_filesz;
+                    }
+                }
+                else
+                {
+                    error = 1;
+                }
+            }
+
+            if((0 == error) && (phdr.p_memsz > phdr.p_filesz))
+            {
+                error = elf_add_chunk(phdr.p_paddr + phdr.p_filesz, phdr.p_memsz - phdr.p_filesz, SF2BL_CHUNK_ZERO_FILL);
+            }
+        }
+    }
+
+    return((0 == error) && (0u != g_elf.n_chunks) ? 0 : -1);
+}
+
+/***************************************************************************//**
+ * Copy any segment data in the len bytes of file at file offset pos into the
+ * image. Segments are handled independently so overlapping segments are ok.
+ */
+static void elf_copy(const uint8_t *data, uint32_t pos, uint32_t len)
+{
+    elf_seg_t *pseg;
+    uint32_t start;
+    uint32_t end;
+    uint32_t index;
+
+    for(index = 0; index < g_elf.n_segs; index++)
+    {
+        pseg  = &g_elf.segs[index];
+        start = (pos > pseg->offset) ? pos : pseg->offset;
+        end   = pseg->offset + pseg->filesz; /* elf_layout() made sure this fits */
+        if((start < end) && ((end - pos) > len))
+        {
+            end = pos + len;
+        }
+        if(start < end)
+        {
+            memcpy(pseg->dest + (start - pseg->offset), data + (start - pos), end - start);
+        }
+    }
+}
+
+/***************************************************************************//**
+ * Process the next len bytes of the ELF file.
+ *
+ * Returns 0 for success or -1 for error.
+ */
+int32_t sf2bl_elf_data(const uint8_t *data, uint32_t len)
+{
+    uint32_t temp;
+
+    if((0 == g_elf.error) && (0u == g_elf.parsed))
+    {
+        temp = ELF_HDR_BUF_LEN - g_elf.pos;
+        temp = (len < temp) ? len : temp;
+        memcpy((uint8_t *)g_elf.hdr_buf + g_elf.pos, data, temp);
+        g_elf.pos += temp;
+        data      += temp;
+        len       -= temp;
+
+        if((0u == g_elf.need) && (g_elf.pos >= sizeof(elf32_ehdr_t)))
+        {
+            g_elf.error = elf_check_ehdr();
+        }
+
+        if((0 == g_elf.error) && (0u != g_elf.need) && (g_elf.pos >= g_elf.need))
+        {
+            g_elf.error = elf_layout();
+            if(0 == g_elf.error)
+            {
+                /* Segment data may already be in the header buffer */
+                elf_copy((uint8_t *)g_elf.hdr_buf, 0u, g_elf.pos);
+                g_elf.parsed = 1u;
+            }
+        }
+    }
+
+    if((0 == g_elf.error) && (0u != g_elf.parsed) && (0u != len))
+    {
+        elf_copy(data, g_elf.pos, len);
+        g_elf.pos += len;
+    }
+
+    return(g_elf.error);
+}
+
+/***************************************************************************//**
+ * Complete the image once the whole file of received bytes has been processed.
+ *
+ * Returns the number of bytes in the image or 0 for error.
+ */
+uint32_t sf2bl_elf_finish(uint32_t received)
+{
+    img_hdr_block_t *pheader;
+    uint32_t return_val = 0;
+
+    if((0 == g_elf.error) && (0u != g_elf.parsed) && (received >= g_elf.file_end))
+    {
+        pheader = (img_hdr_block_t *)g_bin_base;
+        memset((uint8_t *)pheader, 0, sizeof(img_hdr_block_t));
+        pheader->valid    = SF2BL_IMG_HDR_BLANK;
+        pheader->version  = SF2BL_IMG_VERSION_1;
+        pheader->flags    = SF2BL_IMG_FLAG_ENTRY;
+        pheader->entry    = g_elf.entry;
+        pheader->n_chunks = g_elf.n_chunks;
+        pheader->size     = (uint32_t)(g_elf.img_end - g_bin_base);
+        pheader->crc32    = sf2bl_calc_crc32(0xFFFFFFFF, g_bin_base + sizeof(img_hdr_block_t), pheader->size - sizeof(img_hdr_block_t));
+
+        return_val = sf2bl_process_bin_image(pheader->size);
+    }
+
+    return(return_val);
+}
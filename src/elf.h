@@ -0,0 +1,17 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader ELF file support header.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef ELF_H_
+#define ELF_H_
+
+void     sf2bl_elf_init(void);
+int32_t  sf2bl_elf_data(const uint8_t *data, uint32_t len);
+uint32_t sf2bl_elf_finish(uint32_t received);
+
+#endif /* ELF_H_ */
@@ -16,9 +16,12 @@ void interrupts_deinit(void);
  * This is the final  stage of the bootloader before passing control to the
  * application which now resides in DDR. All interrupt generating sources should
  * be shut down at this stage.
+ *
+ * entry is the address of the reset handler of the application and arg is
+ * passed to it in a0.
  */
 
-void sf2bl_exec(void)
+void sf2bl_exec(uint32_t entry, uint32_t arg)
 {
     /*
      * Disable all interrupts.
@@ -26,20 +29,15 @@ void sf2bl_exec(void)
     interrupts_deinit();
 
     /*
-     * Set the return address register to the base of the DDR memory at 0x80000000.
-     * The reset handler of the application loaded to DDR memory by the  bootloader
-     * is expected to be at that location.
-     */
-    __asm volatile("lui ra,0x80000");
-    
-    /*
-     * Flush the cache.
-     */
-    __asm volatile ("fence.i");
-
-    /*
+     * Load a0 with arg, set the return address register to the application
+     * entry point, flush the cache and then jump there. This is done in one asm
+     * statement so that the compiler cannot use ra or a0 in between.
+     *
      * We need to explicitly execute a return intruction in case the compiler had
      * done some return addres register manipulation in this function's veneer.
      */
-    __asm volatile("ret");
+    __asm volatile("mv a0, %1\n\t"
+                   "mv ra, %0\n\t"
+                   "fence.i\n\t"
+                   "ret" : : "r" (entry), "r" (arg) : "a0");
 }
@@ -10,6 +10,6 @@
 #ifndef EXEC_H_
 #define EXEC_H_
 
-void sf2bl_exec(void);
+void sf2bl_exec(uint32_t entry, uint32_t arg);
 
 #endif /* EXEC_H_ */
@@ -0,0 +1,50 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SPI FLASH DMA backend interface.
+ *
+ * With SF2BL_FLASH_USE_DMA and CoreSPI, spi_flash.c moves every byte of a
+ * FLASH transaction with DMA. A transaction is described as two descriptor
+ * chains, one from memory to the CoreSPI TX FIFO and one from the RX FIFO to
+ * memory, which between them cover the same number of frames. The backend is
+ * flash_dma_axi4.c for CoreAXI4DMAController on the target and is emulated in
+ * host/host_spi.c for the host build.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef FLASH_DMA_H_
+#define FLASH_DMA_H_
+
+#include <stdint.h>
+
+/*
+ * Descriptor flags.
+ *
+ * FLASH_DMA_FIXED - The memory address does not advance, for clocking out a
+ * constant or discarding received bytes.
+ *
+ * FLASH_DMA_LAST - TX only. The bytes go to the CoreSPI TXLAST register to end
+ * the frame sequence, so this is only used on a final 1 byte descriptor.
+ */
+#define FLASH_DMA_FIXED 0x00000001u
+#define FLASH_DMA_LAST  0x00000002u
+
+/*
+ * Most descriptors in each chain.
+ */
+#define FLASH_DMA_MAX_DESCS 4u
+
+typedef struct flash_dma_desc
+{
+    uint8_t  *mem;   /* Memory end of the transfer */
+    uint32_t  len;   /* Bytes, 0 descriptors are skipped */
+    uint32_t  flags;
+} flash_dma_desc_t;
+
+void    flash_dma_init(void);
+void    flash_dma_start(const flash_dma_desc_t *tx, uint32_t n_tx, const flash_dma_desc_t *rx, uint32_t n_rx);
+int32_t flash_dma_busy(void);
+
+#endif /* FLASH_DMA_H_ */
@@ -0,0 +1,142 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SPI FLASH DMA backend for CoreAXI4DMAController.
+ *
+ * The RX chain uses internal descriptors from SF2BL_FLASH_RX_DMA_CHAN and the
+ * TX chain those from SF2BL_FLASH_TX_DMA_CHAN, FLASH_DMA_MAX_DESCS each. The
+ * RX chain is started first so nothing is lost once the TX chain starts the
+ * SPI clock. A transaction is complete when the last descriptor of each chain
+ * has reported completion.
+ *
+ * The CoreSPI SPIRXAVAIL and SPITXRFM outputs must be connected to the DMA
+ * controller's request inputs for these descriptors in the design.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+
+#include "sf2_bl_options.h"
+#include "hw_platform.h"
+#include "corespi_regs.h"
+#include "core_axi4dma.h"
+#include "flash_dma.h"
+
+#if defined(SF2BL_FLASH_USE_DMA) && (SF2BL_SPI_PORT == SF2BL_CORE_SPI)
+
+static axi4dma_instance_t g_flash_dma;
+
+/*
+ * Last descriptor of each chain still to complete.
+ */
+static uint8_t  g_rx_tail = AXI4DMA_NO_NEXT_DESC;
+static uint8_t  g_tx_tail = AXI4DMA_NO_NEXT_DESC;
+
+/***************************************************************************//**
+ * Load a chain of descriptors starting at internal descriptor first. to_spi is
+ * non zero for the TX chain.
+ *
+ * Returns the number of the last descriptor loaded or AXI4DMA_NO_NEXT_DESC if
+ * all the descriptors were empty.
+ */
+static uint8_t load_chain(uint8_t first, const flash_dma_desc_t *descs, uint32_t count, int32_t to_spi)
+{
+    const flash_dma_desc_t *pdesc;
+    uint32_t spi_reg;
+    uint32_t mem_op;
+    uint32_t index;
+    uint32_t last = count;
+    uint8_t desc_id = first;
+    uint8_t next;
+
+    /* Find the last non empty descriptor so it can end the chain */
+    for(index = 0; index < count; index++)
+    {
+        if(0u != descs[index].len)
+        {
+            last = index;
+        }
+    }
+
+    for(index = 0; (last != count) && (index <= last); index++)
+    {
+        pdesc = &descs[index];
+        if(0u != pdesc->len)
+        {
+            mem_op = (0u != (pdesc->flags & FLASH_DMA_FIXED)) ? AXI4DMA_OP_FIXED : AXI4DMA_OP_INCR;
+            next   = (index == last) ? AXI4DMA_NO_NEXT_DESC : (uint8_t)(desc_id + 1u);
+            if(0 != to_spi)
+            {
+                spi_reg = FLASH_CORE_SPI_BASE + ((0u != (pdesc->flags & FLASH_DMA_LAST)) ? TXLAST_REG_OFFSET : TXDATA_REG_OFFSET);
+                AXI4DMA_configure_desc(&g_flash_dma, desc_id, (uint32_t)pdesc->mem, mem_op,
+                                       spi_reg, AXI4DMA_OP_FIXED, pdesc->len, next);
+            }
+            else
+            {
+                spi_reg = FLASH_CORE_SPI_BASE + RXDATA_REG_OFFSET;
+                AXI4DMA_configure_desc(&g_flash_dma, desc_id, spi_reg, AXI4DMA_OP_FIXED,
+                                       (uint32_t)pdesc->mem, mem_op, pdesc->len, next);
+            }
+            desc_id++;
+        }
+    }
+
+    return((last != count) ? (uint8_t)(desc_id - 1u) : AXI4DMA_NO_NEXT_DESC);
+}
+
+/***************************************************************************//**
+ * Get the DMA controller ready for use.
+ */
+void flash_dma_init(void)
+{
+    AXI4DMA_init(&g_flash_dma, FLASH_DMA_BASE_ADDR);
+    g_rx_tail = AXI4DMA_NO_NEXT_DESC;
+    g_tx_tail = AXI4DMA_NO_NEXT_DESC;
+}
+
+/***************************************************************************//**
+ * Start the transaction described by the n_tx descriptors at tx and the n_rx
+ * descriptors at rx.
+ */
+void flash_dma_start(const flash_dma_desc_t *tx, uint32_t n_tx, const flash_dma_desc_t *rx, uint32_t n_rx)
+{
+    g_rx_tail = load_chain((uint8_t)(SF2BL_FLASH_RX_DMA_CHAN * FLASH_DMA_MAX_DESCS), rx, n_rx, 0);
+    g_tx_tail = load_chain((uint8_t)(SF2BL_FLASH_TX_DMA_CHAN * FLASH_DMA_MAX_DESCS), tx, n_tx, 1);
+
+    if(AXI4DMA_NO_NEXT_DESC != g_rx_tail)
+    {
+        AXI4DMA_start(&g_flash_dma, (uint8_t)(SF2BL_FLASH_RX_DMA_CHAN * FLASH_DMA_MAX_DESCS));
+    }
+    if(AXI4DMA_NO_NEXT_DESC != g_tx_tail)
+    {
+        AXI4DMA_start(&g_flash_dma, (uint8_t)(SF2BL_FLASH_TX_DMA_CHAN * FLASH_DMA_MAX_DESCS));
+    }
+}
+
+/***************************************************************************//**
+ * Returns non zero until both chains of the last transaction started are
+ * complete. A chain which fails is treated as complete, the data will be
+ * caught by the CRC32 checks of the caller.
+ */
+int32_t flash_dma_busy(void)
+{
+    uint8_t desc_id = 0;
+
+    while(0u != AXI4DMA_get_event(&g_flash_dma, &desc_id))
+    {
+        if(desc_id == g_rx_tail)
+        {
+            g_rx_tail = AXI4DMA_NO_NEXT_DESC;
+        }
+        if(desc_id == g_tx_tail)
+        {
+            g_tx_tail = AXI4DMA_NO_NEXT_DESC;
+        }
+    }
+
+    return((AXI4DMA_NO_NEXT_DESC != g_rx_tail) || (AXI4DMA_NO_NEXT_DESC != g_tx_tail));
+}
+
+#endif
@@ -45,13 +45,21 @@
 #endif
 #include "sf2_bl_options.h"
 #include "sf2_bl_defs.h"
+#if defined(SF2BL_FLASH_VERIFY_CRC)
+#include "crc32.h"
+#endif
 
 #ifdef  SF2BL_FLASH_USE_DMA
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+#include "flash_dma.h"
+#else
 #include "mss_pdma.h"
 #endif
+#endif
 
 
 #define READ_ARRAY_OPCODE         0x0B
+#define READ_SLOW_OPCODE          0x03
 #define DEVICE_ID_READ            0x9F
 
 #define WRITE_ENABLE_CMD          0x06
@@ -74,6 +82,10 @@
 
 #define DONT_CARE                    0
 
+/* First dummy byte of a fast read, to stay in or leave XIP mode */
+#define XIP_CONFIRM                  0x00
+#define XIP_EXIT_BITS                0xFF
+
 #define NB_BYTES_PER_PAGE          256
 #define NB_BYTES_PER_SECTOR        4096
 
@@ -111,89 +123,56 @@
  */
 /* #define SF2BL_FLASH_USE_DMA */
 
-#ifdef SF2BL_FLASH_USE_DMA
-#define SPI_TRANS_BLOCK spi_flash_transfer_block
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+/*<CJ>TODO: created RISC-V equivalent.*/
 #define IRQS_OFF
 #define IRQS_ON
-#else
-#if defined(RISCV_PLATFORM)
-#define SPI_TRANS_BLOCK SPI_transfer_block
-/*<CJ>TODO: created RISC-V equivalent.*/
+#elif defined(SF2BL_FLASH_USE_DMA)
+#define SPI_TRANS_BLOCK_HW spi_flash_transfer_block
 #define IRQS_OFF
 #define IRQS_ON
 #else
-#define SPI_TRANS_BLOCK MSS_SPI_transfer_block
+#define SPI_TRANS_BLOCK_HW MSS_SPI_transfer_block
 #define IRQS_OFF         __disable_irq();
 #define IRQS_ON          __enable_irq();
 #endif
-#endif
-
-#define SF2BL_FLASH_DEV_AT25DF641        0
-#define SF2BL_FLASH_DEV_W25Q64FVSSIG     1
-#define SF2BL_FLASH_DEV_N25Q00AA13GSF40G 2
-#define SF2BL_FLASH_DEV_S25FL128SDPBHICO 3
-
-
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_AT25DF641)
-/*
- * millisecond timeouts for various operations, based on ADESTO AT25DF641
- * maximums + 10ms and rounded up to the next 10ms
- */
-
-#define FLASH_TIMEOUT_WR_STATUS  30
-#define FLASH_TIMEOUT_WR_BYTE    30
-#define FLASH_TIMEOUT_WR_PAGE    30
-#define FLASH_TIMEOUT_ERASE_4K   220
-#define FLASH_TIMEOUT_ERASE_32K  620
-#define FLASH_TIMEOUT_ERASE_64K  970
-#define FLASH_TIMEOUT_ERASE_CHIP 112000 /* Yes, 112 seconds! */
-#define FLASH_TIMEOUT_MISC       50
 
 /*
- * Maximum bytes required for command including opcode,
- * address and any dummy bytes.
+ * Every transaction is counted so the cost of an operation in SPI
+ * transactions and bytes, including status polling, can be reported. With
+ * CoreSPI every transaction is a list of segments and is counted in
+ * spi_flash_transfer_segments().
  */
-#define FLASH_MAX_CMD_BYTES 6
-
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+#define SPI_TRANS_BLOCK(inst, cmd, cmd_len, rd, rd_len) \
+    spi_flash_transfer_block((inst), (cmd), (cmd_len), (rd), (rd_len))
+#else
+#define SPI_TRANS_BLOCK(inst, cmd, cmd_len, rd, rd_len) \
+    do \
+    { \
+        g_spi_flash_transactions++; \
+        g_spi_flash_bytes += (uint32_t)(cmd_len) + (uint32_t)(rd_len); \
+        SPI_TRANS_BLOCK_HW((inst), (cmd), (cmd_len), (rd), (rd_len)); \
+    } while(0)
 #endif
 
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_W25Q64FVSSIG)
-/*
- * millisecond timeouts for various operations, based on Winbond W25Q64FV
- * maximums + 10ms and rounded up to the next 10ms
- */
-
-#define FLASH_TIMEOUT_WR_STATUS  30
-#define FLASH_TIMEOUT_WR_BYTE    30
-#define FLASH_TIMEOUT_WR_PAGE    30
-#define FLASH_TIMEOUT_ERASE_4K   420
-#define FLASH_TIMEOUT_ERASE_32K  1620
-#define FLASH_TIMEOUT_ERASE_64K  2020
-#define FLASH_TIMEOUT_ERASE_CHIP 100000 /* Yes, 100 seconds! */
-#define FLASH_TIMEOUT_MISC       50
+uint32_t g_spi_flash_transactions = 0;
+uint32_t g_spi_flash_bytes = 0;
+uint32_t g_spi_flash_polls = 0;
 
-/*
- * Maximum bytes required for command including opcode,
- * address and any dummy bytes.
- */
-#define FLASH_MAX_CMD_BYTES 6
+#define SF2BL_FLASH_DEV_AT25DF641        0
+#define SF2BL_FLASH_DEV_W25Q64FVSSIG     1
+#define SF2BL_FLASH_DEV_N25Q00AA13GSF40G 2
+#define SF2BL_FLASH_DEV_S25FL128SDPBHICO 3
 
-#endif
 
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
 /*
- * millisecond timeouts for various operations, based on Micron N25Q00AA
- * maximums + 10ms and rounded up to the next 10ms
+ * millisecond timeout for commands other than program and erase, which take
+ * their timeouts from the device description.
  */
-
-#define FLASH_TIMEOUT_WR_STATUS  30
-#define FLASH_TIMEOUT_WR_BYTE    30
-#define FLASH_TIMEOUT_WR_PAGE    30
-#define FLASH_TIMEOUT_ERASE_4K   820
-#define FLASH_TIMEOUT_ERASE_32K  3020
-#define FLASH_TIMEOUT_ERASE_64K  3020
-#define FLASH_TIMEOUT_ERASE_CHIP 480000 /* Yes, 480 seconds! For one of the 4 die... */
 #define FLASH_TIMEOUT_MISC       50
+#define FLASH_TIMEOUT_WR_PAGE    (g_flash_dev.timeout_page)
+#define FLASH_TIMEOUT_ERASE_CHIP (g_flash_dev.timeout_chip)
 
 /*
  * Maximum bytes required for command including opcode,
@@ -201,15 +180,19 @@
  */
 #define FLASH_MAX_CMD_BYTES 7
 
+/* Largest page we will program in one go */
+#define FLASH_MAX_PAGE_SIZE 512
+
 /*
  * Local global to indicate if the FLASH device is configured for extended 4
  * byte address in the non volatile configuration register. This determines if
  * we need to add preamble and postamble calls to enter and exit 4 byte
- * addressing before any operations that need an address.
+ * addressing before any operations that need an address, on devices without
+ * the 4 byte address opcodes.
  */
 static int32_t g_4_byte_addr_enabled = 0;
 
-/* Non volatile config bit masks */
+/* Micron non volatile config bit masks */
 
 #define NV_CFG_DUMMY_CLOCKS   0xF000
 #define NV_CFG_XIP_MODE       0x0E00
@@ -221,14 +204,14 @@ static int32_t g_4_byte_addr_enabled = 0;
 #define NV_CFG_128MB_SELECT   0x0002
 #define NV_CFG_ADDRESS_BYTES  0x0001
 
-/* Volatile config bit masks */
+/* Micron volatile config bit masks */
 
 #define V_CFG_DUMMY_CLOCKS    0xF0
 #define V_CFG_XIP             0x08
 #define V_CFG_RESERVED        0x04
 #define V_CFG_WRAP            0x03
 
-/* Flag Status register bit masks */
+/* Micron flag Status register bit masks */
 
 #define FSR_WRITE_BUSY        0x80
 #define FSR_ERASE_SUSPEND     0x40
@@ -250,37 +233,104 @@ static int32_t g_4_byte_addr_enabled = 0;
 #define EXIT_4_BYTE_ADR_MODE  0xE9
 #define READ_FLAG_STATUS_REG  0x70
 #define CLEAR_FLAG_STATUS_REG 0x50
+#define READ_4_BYTE_OPCODE    0x13 /* Reads with 4 byte address in any mode */
+#define FAST_READ_4_BYTE_CMD  0x0C
+#define PROGRAM_PAGE_4_BYTE_CMD 0x12
+#define READ_SFDP_CMD         0x5A
 
 #define ENABLE_4_BYTE_ADDR  1
 #define DISABLE_4_BYTE_ADDR 0
 static spi_flash_status_t spi_flash_4_byte_addr(int32_t enable);
-#endif
 
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_S25FL128SDPBHICO)
-#endif
+/*
+ * Known devices, indexed by SF2BL_FLASH_DEV_xxx. millisecond timeouts are the
+ * datasheet maximums + 10ms and rounded up to the next 10ms.
+ */
+static const spi_flash_dev_t g_flash_devs[] =
+{
+    {
+        "AT25DF641", { 0x1F, 0x48, 0x00 }, 8, 0xB0, 0xD0, SPI_FLASH_DEV_SECTOR_PROTECT,
+        8388608, 256, 3, 30, 112000, /* Yes, 112 seconds! */
+        { { 0x20, 0x00, 220 }, { 0x52, 0x00, 620 }, { 0xD8, 0x00, 970 } }
+    },
+    {
+        "W25Q64FV", { 0xEF, 0x40, 0x17 }, 8, 0x75, 0x7A, 0,
+        8388608, 256, 3, 30, 100000, /* Yes, 100 seconds! */
+        { { 0x20, 0x00, 420 }, { 0x52, 0x00, 1620 }, { 0xD8, 0x00, 2020 } }
+    },
+    {
+        "N25Q00AA", { 0x20, 0xBA, 0x21 }, 8, 0x75, 0x7A,
+        SPI_FLASH_DEV_4_BYTE_OPCODES | SPI_FLASH_DEV_FLAG_STATUS | SPI_FLASH_DEV_MICRON_CFG,
+        134217728, 256, 4, 30, 480000, /* Yes, 480 seconds! For one of the 4 die... */
+        { { 0x20, 0x21, 820 }, { 0x00, 0x00, 0 }, { 0xD8, 0xDC, 3020 } }
+    },
+    {
+        "S25FL128S", { 0x01, 0x20, 0x18 }, 8, 0x75, 0x7A, SPI_FLASH_DEV_4_BYTE_OPCODES,
+        16777216, 256, 3, 30, 165010,
+        { { 0x20, 0x21, 660 }, { 0x00, 0x00, 0 }, { 0xD8, 0xDC, 660 } }
+    }
+};
+
+/* The device in use, see spi_flash_init() */
+static spi_flash_dev_t g_flash_dev;
 
 #if defined(SF2BL_FLASH_WRITE_VERIFY)
 /* Somewhere to read back up to 1 page of data to verify last write operation */
-static uint8_t verify_buffer[NB_BYTES_PER_PAGE];
+static uint8_t verify_buffer[FLASH_MAX_PAGE_SIZE];
+
+/* Start of the page which failed verification, see spi_flash_verify_address() */
+static uint32_t g_verify_address = 0;
 #endif
 
 static uint8_t wait_ready(uint32_t timeout);
+static uint8_t read_busy(void);
 static int32_t spi_flash_insert_cmd_addr(uint8_t *dest, uint32_t command, uint32_t address);
+#if defined(SF2BL_FLASH_SFDP)
+static void sfdp_update(void);
+#endif
+#if defined(SF2BL_FLASH_XIP)
+static void xip_reset(void);
+#endif
 
 #if defined(SF2BL_USE_CORESPI)
 spi_instance_t g_flash_core_spi;
 #endif
 
+/*
+ * Read command and number of dummy bytes used by spi_flash_read(). See
+ * SPI_FLASH_SET_READ_MODE.
+ */
+static uint8_t g_read_opcode = READ_ARRAY_OPCODE;
+static int32_t g_read_dummy  = 1;
+
+#if defined(SF2BL_FLASH_XIP)
+/*
+ * g_xip_enabled is set once the XIP enable in the volatile configuration
+ * register has been cleared, after which every fast read must say whether the
+ * device is to be left in XIP mode. g_read_xip is set while SPI_FLASH_READ_XIP
+ * is selected and g_xip_active while the device is in XIP mode, taking each
+ * frame as the address of a fast read. No other command can be sent until
+ * xip_exit() has been called.
+ */
+static int32_t g_xip_enabled = 0;
+static int32_t g_read_xip    = 0;
+static int32_t g_xip_active  = 0;
+
+#define XIP_ACTIVE g_xip_active
+#else
+#define XIP_ACTIVE 0
+#endif
+
 /******************************************************************************
  *For more details please refer the spi_flash.h file
  ******************************************************************************/
 spi_flash_status_t spi_flash_init( void )
 {
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
     spi_flash_status_t status;
+    spi_dev_info_t dev_info;
+    uint32_t index;
     int16_t nv_cfg;
     int8_t  v_cfg;
-#endif
 
     /*--------------------------------------------------------------------------
      * Configure MSS_SPI.
@@ -289,6 +339,9 @@ spi_flash_status_t spi_flash_init( void )
 	SPI_init( SPI_INSTANCE, FLASH_CORE_SPI_BASE, 32 );
 	SPI_configure_master_mode( SPI_INSTANCE );
 	SPI_set_slave_select( SPI_INSTANCE, SPI_SLAVE );
+#ifdef SF2BL_FLASH_USE_DMA
+    flash_dma_init();
+#endif
 #else
     MSS_SPI_init(SPI_INSTANCE);
     MSS_SPI_configure_master_mode
@@ -319,7 +372,7 @@ spi_flash_status_t spi_flash_init( void )
     }
 #endif
 
-#ifdef SF2BL_FLASH_USE_DMA
+#if defined(SF2BL_FLASH_USE_DMA) && (SF2BL_SPI_PORT != SF2BL_CORE_SPI)
     /*--------------------------------------------------------------------------
      * Configure DMA channel used as part of this MSS_SPI Flash driver.
      */
@@ -377,33 +430,103 @@ spi_flash_status_t spi_flash_init( void )
     MSS_GPIO_set_output(SF2BL_SPI_RESET , 1u);
 #endif
 
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-    /* Read non volatile config register and check for 4 byte address mode */
-    status = spi_flash_control_hw(SPI_FLASH_READ_NV_CFG, 0, (void *)&nv_cfg);
+#if defined(SF2BL_FLASH_XIP)
+    xip_reset();
+#endif
+
+    /*
+     * Identify the FLASH device. The SF2BL_FLASH_DEVICE description is used
+     * until we know better and if the device is not one we recognise.
+     */
+    g_flash_dev = g_flash_devs[SF2BL_FLASH_DEVICE];
+    status = spi_flash_control_hw(SPI_FLASH_READ_DEVICE_ID, 0, (void *)&dev_info);
     if(SPI_FLASH_SUCCESS == status)
     {
-        g_4_byte_addr_enabled = 0 == (nv_cfg & NV_CFG_ADDRESS_BYTES) ? 1 : 0;
+        for(index = 0; index < (sizeof(g_flash_devs) / sizeof(g_flash_devs[0])); index++)
+        {
+            if((dev_info.manufacturer_id == g_flash_devs[index].jedec_id[0]) &&
+               (dev_info.device_id == g_flash_devs[index].jedec_id[1]) &&
+               (dev_info.capacity == g_flash_devs[index].jedec_id[2]))
+            {
+                g_flash_dev = g_flash_devs[index];
+            }
+        }
 
-        /*
-         * Ensure single dummy byte selected for fast read operations which will
-         * suffice for up to 90MHz SPI clock speed.
-         */
-        status = spi_flash_control_hw(SPI_FLASH_READ_V_CFG, 0, (void *)&v_cfg);
+        g_flash_dev.jedec_id[0] = dev_info.manufacturer_id;
+        g_flash_dev.jedec_id[1] = dev_info.device_id;
+        g_flash_dev.jedec_id[2] = dev_info.capacity;
+#if defined(SF2BL_FLASH_SFDP)
+        sfdp_update();
+#endif
+    }
+
+    if((SPI_FLASH_SUCCESS == status) && (0u != (g_flash_dev.flags & SPI_FLASH_DEV_MICRON_CFG)))
+    {
+        /* Read non volatile config register and check for 4 byte address mode */
+        status = spi_flash_control_hw(SPI_FLASH_READ_NV_CFG, 0, (void *)&nv_cfg);
         if(SPI_FLASH_SUCCESS == status)
         {
-            v_cfg = (v_cfg & ~V_CFG_DUMMY_CLOCKS) | 0x80;
-            status = spi_flash_control_hw(SPI_FLASH_WRITE_V_CFG, (uint32_t)v_cfg, 0);
+            g_4_byte_addr_enabled = 0 == (nv_cfg & NV_CFG_ADDRESS_BYTES) ? 1 : 0;
+
+            /*
+             * Select the dummy clocks we use for fast read operations, 8 will
+             * suffice for up to 90MHz SPI clock speed.
+             */
+            status = spi_flash_control_hw(SPI_FLASH_READ_V_CFG, 0, (void *)&v_cfg);
+            if(SPI_FLASH_SUCCESS == status)
+            {
+                v_cfg = (v_cfg & ~V_CFG_DUMMY_CLOCKS) | (g_flash_dev.fast_read_dummy << 4);
+#if defined(SF2BL_FLASH_XIP)
+                /* Allow XIP mode, which is entered by the first dummy bit */
+                v_cfg &= ~V_CFG_XIP;
+#endif
+                status = spi_flash_control_hw(SPI_FLASH_WRITE_V_CFG, (uint32_t)v_cfg, 0);
+#if defined(SF2BL_FLASH_XIP)
+                g_xip_enabled = (SPI_FLASH_SUCCESS == status) ? 1 : 0;
+#endif
+            }
         }
     }
 
+    if(READ_ARRAY_OPCODE == g_read_opcode)
+    {
+        g_read_dummy = (int32_t)(g_flash_dev.fast_read_dummy / 8u);
+    }
+
     return(status);
-#else
-    return(SPI_FLASH_SUCCESS);
-#endif
+}
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+const spi_flash_dev_t *spi_flash_get_device(void)
+{
+    return(&g_flash_dev);
 }
 
 void spi_flash_deinit( void )
 {
+#if defined(SF2BL_FLASH_XIP)
+    uint8_t v_cfg;
+#endif
+
+#if defined(SF2BL_FLASH_BG_ERASE)
+    /* Do not leave the application an erase in progress or suspended */
+    (void)spi_flash_erase_wait();
+#endif
+#if defined(SF2BL_FLASH_XIP)
+    /* Or the device in XIP mode, or with XIP mode enabled */
+    if(0 != g_xip_enabled)
+    {
+        (void)spi_flash_control_hw(SPI_FLASH_SET_READ_MODE, SPI_FLASH_READ_FAST, 0);
+        if(SPI_FLASH_SUCCESS == spi_flash_control_hw(SPI_FLASH_READ_V_CFG, 0, (void *)&v_cfg))
+        {
+            (void)spi_flash_control_hw(SPI_FLASH_WRITE_V_CFG, (uint32_t)(v_cfg | V_CFG_XIP), 0);
+        }
+        g_xip_enabled = 0;
+    }
+#endif
+
     /*--------------------------------------------------------------------------
      * Configure MSS_SPI.
      */
@@ -428,7 +551,7 @@ void spi_flash_deinit( void )
      * shuts down any DMA transfers.
      * This means a separate deinit is not needed.
      */
-#ifdef SF2BL_FLASH_USE_DMA
+#if defined(SF2BL_FLASH_USE_DMA) && (SF2BL_SPI_PORT != SF2BL_CORE_SPI)
     PDMA_init();
     NVIC_DisableIRQ(DMA_IRQn); /* Kill ints at NVIC as well */
     g_driver_init &= ~SF2BL_DRIVER_MSS_PDMA;
@@ -444,12 +567,203 @@ void spi_flash_deinit( void )
 #define TX_FIFO_RESET_MASK      0x00000008u
 #define RX_FIFO_RESET_MASK      0x00000004u
 #define RX_DATA_READY_MASK      0x00000002u
+
+#if defined(SF2BL_FLASH_USE_DMA) && (SF2BL_SPI_PORT == SF2BL_CORE_SPI)
+/*
+ * Constant clocked out while data is read and somewhere to drop the bytes
+ * received while the command or write data is sent.
+ */
+static uint8_t g_dma_zero = 0;
+static uint8_t g_dma_sink;
+
+/*
+ * Add a descriptor to a chain, merging it with the previous one if both
+ * stay on the same fixed location.
+ */
+static void dma_add_desc(flash_dma_desc_t *chain, uint32_t *n_descs, uint8_t *mem, uint32_t len, uint32_t flags)
+{
+    flash_dma_desc_t *pdesc;
+
+    if((0u != *n_descs) && (0u != (flags & FLASH_DMA_FIXED)) &&
+       (flags == chain[*n_descs - 1u].flags) && (mem == chain[*n_descs - 1u].mem))
+    {
+        chain[*n_descs - 1u].len += len;
+    }
+    else
+    {
+        pdesc = &chain[*n_descs];
+        pdesc->mem   = mem;
+        pdesc->len   = len;
+        pdesc->flags = flags;
+        (*n_descs)++;
+    }
+}
+
+/*
+ * Start a DMA transaction made up of the given segments. Nothing is copied and
+ * no CPU time is spent per byte. Segments which send 0s or discard what is
+ * received use one fixed location, so the command, dummy and data segments of
+ * a FLASH transaction fit in FLASH_DMA_MAX_DESCS descriptors.
+ *
+ * A transaction can be sent in parts. The FIFOs are only flushed for the first
+ * part and only the last part ends with TXLAST.
+ */
+static void spi_flash_dma_start(const spi_segment_t *segments, uint32_t n_segments, uint32_t first, uint32_t last)
+{
+    flash_dma_desc_t tx[FLASH_DMA_MAX_DESCS];
+    flash_dma_desc_t rx[FLASH_DMA_MAX_DESCS];
+    flash_dma_desc_t *plast;
+    uint32_t n_tx = 0u;
+    uint32_t n_rx = 0u;
+    uint32_t index;
+
+    if(0u != first)
+    {
+        SPI_flush_fifos(SPI_INSTANCE);
+    }
+
+    for(index = 0; index < n_segments; index++)
+    {
+        if(0u != segments[index].length)
+        {
+            if((SPI_SEG_TX == segments[index].direction) && (0 != segments[index].buffer))
+            {
+                dma_add_desc(tx, &n_tx, segments[index].buffer, segments[index].length, 0u);
+                dma_add_desc(rx, &n_rx, &g_dma_sink, segments[index].length, FLASH_DMA_FIXED);
+            }
+            else if((SPI_SEG_RX == segments[index].direction) && (0 != segments[index].buffer))
+            {
+                dma_add_desc(tx, &n_tx, &g_dma_zero, segments[index].length, FLASH_DMA_FIXED);
+                dma_add_desc(rx, &n_rx, segments[index].buffer, segments[index].length, 0u);
+            }
+            else
+            {
+                dma_add_desc(tx, &n_tx, &g_dma_zero, segments[index].length, FLASH_DMA_FIXED);
+                dma_add_desc(rx, &n_rx, &g_dma_sink, segments[index].length, FLASH_DMA_FIXED);
+            }
+        }
+    }
+
+    /* The final frame goes to TXLAST */
+    if(0u != last)
+    {
+        plast = &tx[n_tx - 1u];
+        plast->len--;
+        tx[n_tx].mem   = (0u != (plast->flags & FLASH_DMA_FIXED)) ? plast->mem : (plast->mem + plast->len);
+        tx[n_tx].len   = 1u;
+        tx[n_tx].flags = plast->flags | FLASH_DMA_LAST;
+        n_tx++;
+    }
+
+    flash_dma_start(tx, n_tx, rx, n_rx);
+}
+#endif
+
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+/*
+ * Most segments in one FLASH transaction: command, including any dummy bytes,
+ * and data.
+ */
+#define FLASH_MAX_SEGMENTS 2u
+
+/*
+ * Carry out one FLASH transaction made up of the given segments, with DMA if
+ * it is enabled. With a chunk_handler the final segment, which must be the
+ * data read, is streamed through its buffer chunk_size bytes at a time as for
+ * SPI_transfer_segments_chunked().
+ */
+static void spi_flash_transfer_segments
+(
+    const spi_segment_t *segments,
+    uint32_t n_segments,
+    uint32_t chunk_size,
+    spi_block_rx_handler_t chunk_handler
+)
+{
+#ifdef SF2BL_FLASH_USE_DMA
+    spi_segment_t part[FLASH_MAX_SEGMENTS];
+    spi_segment_t *pdata;
+    uint32_t first;
+    uint32_t left;
+#endif
+    uint32_t index;
+
+    g_spi_flash_transactions++;
+    for(index = 0; index < n_segments; index++)
+    {
+        g_spi_flash_bytes += segments[index].length;
+    }
+
+#ifdef SF2BL_FLASH_USE_DMA
+    if((0 == chunk_handler) || (0u == chunk_size) || (0u == segments[n_segments - 1u].length))
+    {
+        spi_flash_dma_start(segments, n_segments, 1u, 1u);
+        while(0 != flash_dma_busy())
+        {
+            ;
+        }
+    }
+    else
+    {
+        /*
+         * The first part is everything up to the first chunk of data and each
+         * part after that is one more chunk, the FLASH staying selected.
+         */
+        memcpy(part, segments, n_segments * sizeof(spi_segment_t));
+        pdata = &part[n_segments - 1u];
+        left  = pdata->length;
+        first = 1u;
+        while(0u != left)
+        {
+            pdata->length = (left < chunk_size) ? left : chunk_size;
+            left -= pdata->length;
+            spi_flash_dma_start((0u != first) ? part : pdata, (0u != first) ? n_segments : 1u, first, (0u == left));
+            while(0 != flash_dma_busy())
+            {
+                ;
+            }
+            chunk_handler(pdata->buffer, pdata->length);
+            first = 0u;
+        }
+    }
+#else
+    SPI_transfer_segments_chunked(SPI_INSTANCE, segments, n_segments, chunk_size, chunk_handler);
+#endif
+}
+
+/*
+ * Transfer a command to the FLASH device and read the response, CoreSPI
+ * version.
+ */
+static void spi_flash_transfer_block
+(
+    spi_instance_t * this_spi,
+    const uint8_t * cmd_buffer,
+    uint16_t cmd_byte_size,
+    uint8_t * rd_buffer,
+    uint16_t rd_byte_size
+)
+{
+    spi_segment_t segments[2];
+
+    (void)this_spi;
+
+    segments[0].buffer    = (uint8_t *)cmd_buffer;
+    segments[0].length    = cmd_byte_size;
+    segments[0].direction = SPI_SEG_TX;
+    segments[1].buffer    = rd_buffer;
+    segments[1].length    = rd_byte_size;
+    segments[1].direction = SPI_SEG_RX;
+    spi_flash_transfer_segments(segments, 2u, 0u, 0);
+}
+#endif
+
 /*
  * Transfer a command to the FLASH device and read the response using 2 DMA
  * channels and two buffers to handle the read/write transfers which are
  * required to keep the SPI interface happy.
  */
-#ifdef SF2BL_FLASH_USE_DMA
+#if defined(SF2BL_FLASH_USE_DMA) && (SF2BL_SPI_PORT != SF2BL_CORE_SPI)
 static void spi_flash_transfer_block
 (
 #if SF2BL_SPI_PORT == SF2BL_CORE_SPI
@@ -551,417 +865,623 @@ static void spi_flash_transfer_block
 }
 #endif
 
+#if defined(SF2BL_FLASH_SFDP)
+/*
+ * The SFDP tables, JEDEC JESD216, are read with a 3 byte address and 8 dummy
+ * clocks whatever the device. We use the header, the basic FLASH parameter
+ * table up to the chip erase time and the 4 byte address instruction table.
+ */
+#define SFDP_SIGNATURE   0x50444653u /* "SFDP" */
+#define SFDP_MAX_HEADERS 4u
+#define SFDP_BFPT_DWORDS 11u
+#define SFDP_4BAIT_ID    0x84u
+
 /******************************************************************************
- *For more details please refer the spi_flash.h file
+ * Read len bytes of the SFDP tables from address.
  ******************************************************************************/
-spi_flash_status_t
-spi_flash_control_hw
-(
-    spi_flash_control_hw_t operation,
-    uint32_t peram1,
-    void *   ptrPeram
-)
+static spi_flash_status_t sfdp_read(uint32_t address, uint32_t *dest, uint32_t len)
 {
     spi_flash_status_t return_val = SPI_FLASH_SUCCESS;
-    uint8_t cmd_buffer[FLASH_MAX_CMD_BYTES];
-    uint32_t timeout = 0; /* Exit timeout, 0 for not required */
-    int32_t cmd_len;
+    uint8_t cmd_buffer[5];
 
-#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
-    SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
-#else
-    MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
-#endif
+    if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+    {
+        return_val = SPI_FLASH_TIMEOUT;
+    }
+    else
+    {
+        cmd_buffer[0] = READ_SFDP_CMD;
+        cmd_buffer[1] = (uint8_t)(address >> 16);
+        cmd_buffer[2] = (uint8_t)(address >> 8);
+        cmd_buffer[3] = (uint8_t)address;
+        cmd_buffer[4] = DONT_CARE;
+        IRQS_OFF
+        SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 5, (uint8_t *)dest, len);
+        IRQS_ON
+    }
 
-    switch(operation){
-        case SPI_FLASH_READ_DEVICE_ID:
-        {
-            uint8_t read_buffer[2];
+    return(return_val);
+}
 
-            /* Check for completion of any prior command */
-            if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-            {
-                return_val = SPI_FLASH_TIMEOUT;
-            }
-            else
-            {
-                cmd_buffer[0] = DEVICE_ID_READ;
-                IRQS_OFF
-                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, read_buffer,
-                                sizeof(read_buffer));
-                IRQS_ON
+/******************************************************************************
+ * Convert an SFDP typical time, a 5 bit count and 2 bit units, to a timeout
+ * in the form used in the device table: the maximum, typical * 2 * (mult + 1),
+ * + 10ms and rounded up to the next 10ms.
+ ******************************************************************************/
+static uint32_t sfdp_timeout(uint32_t field, const uint32_t *units, uint32_t mult)
+{
+    uint32_t max_time;
 
-                ((spi_dev_info_t *)ptrPeram)->manufacturer_id = read_buffer[0];
-                ((spi_dev_info_t *)ptrPeram)->device_id       = read_buffer[1];
-            }
-        }
-        break;
+    max_time = ((field & 0x1Fu) + 1u) * units[(field >> 5) & 0x03u] * 2u * (mult + 1u);
+    return(((max_time + 19u) / 10u) * 10u);
+}
 
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_AT25DF641)
-        case SPI_FLASH_SECTOR_PROTECT:
+/******************************************************************************
+ * Update g_flash_dev from the device's SFDP tables. Devices without them are
+ * left as they are.
+ ******************************************************************************/
+static void sfdp_update(void)
+{
+    static const uint32_t erase_units[4] = { 1u, 16u, 128u, 1000u };
+    static const uint32_t chip_units[4]  = { 16u, 256u, 4000u, 64000u };
+    uint32_t header[2u + (2u * SFDP_MAX_HEADERS)];
+    uint32_t bfpt[SFDP_BFPT_DWORDS];
+    uint32_t bait[2];
+    spi_flash_erase_t erase[SPI_FLASH_ERASE_TYPES];
+    uint32_t slot[4]; /* Our erase type for each SFDP erase type */
+    uint32_t n_headers;
+    uint32_t n_dwords;
+    uint32_t n_erase = 0;
+    uint32_t max_timeout = 0;
+    uint32_t index;
+    uint32_t temp;
+
+    memset(header, 0, sizeof(header));
+    memset(bfpt, 0, sizeof(bfpt));
+    n_dwords = 0;
+    if((SPI_FLASH_SUCCESS == sfdp_read(0u, header, sizeof(header))) && (SFDP_SIGNATURE == header[0]) &&
+       (0u == (header[2] & 0xFFu)) && (0xFFu == (header[3] >> 24)))
+    {
+        n_dwords = header[2] >> 24;
+        n_dwords = (n_dwords < SFDP_BFPT_DWORDS) ? n_dwords : SFDP_BFPT_DWORDS;
+    }
+
+    /* JESD216 tables have at least 9 DWORDs, later revisions more */
+    if((n_dwords >= 9u) && (SPI_FLASH_SUCCESS == sfdp_read(header[3] & 0x00FFFFFFu, bfpt, n_dwords * 4u)))
+    {
+        g_flash_dev.flags |= SPI_FLASH_DEV_SFDP;
+        g_flash_dev.flags |= ((0u != (bfpt[0] & 0x00010000u)) ? SPI_FLASH_DEV_READ_1_1_2 : 0u) |
+                             ((0u != (bfpt[0] & 0x00100000u)) ? SPI_FLASH_DEV_READ_1_2_2 : 0u) |
+                             ((0u != (bfpt[0] & 0x00200000u)) ? SPI_FLASH_DEV_READ_1_4_4 : 0u) |
+                             ((0u != (bfpt[0] & 0x00400000u)) ? SPI_FLASH_DEV_READ_1_1_4 : 0u);
+
+        /* Density in bits, either N - 1 or 2^N */
+        temp = bfpt[1] & 0x7FFFFFFFu;
+        if(0u == (bfpt[1] & 0x80000000u))
         {
-            /* Check for completion of any prior command */
-            if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-            {
-                return_val = SPI_FLASH_TIMEOUT;
-            }
-            else
-            {
-                /* Send Write Enable command */
-                cmd_buffer[0] = WRITE_ENABLE_CMD;
-                IRQS_OFF
-                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-                IRQS_ON
-                if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-                {
-                    return_val = SPI_FLASH_TIMEOUT;
-                }
-                else
-                {
-                    /* Safe to protect sector now */
-                	cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, PROTECT_SECTOR_OPCODE, peram1);
-                    IRQS_OFF
-                    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
-                    IRQS_ON
+            g_flash_dev.size = (temp >> 3) + 1u;
+        }
+        else if((temp >= 3u) && (temp <= 34u))
+        {
+            g_flash_dev.size = 1u << (temp - 3u);
+        }
 
-                    timeout = FLASH_TIMEOUT_MISC;
-                }
-            }
+        g_flash_dev.addr_bytes = (g_flash_dev.size > 0x01000000u) ? 4u : 3u;
+        if(0x00040000u == (bfpt[0] & 0x00060000u))
+        {
+            /* Device only has 4 byte addressing */
+            g_flash_dev.addr_bytes = 4u;
+            g_4_byte_addr_enabled  = 1;
         }
-        break;
 
-        case SPI_FLASH_SECTOR_UNPROTECT:
+        /*
+         * Erase types are given as size 2^N and opcode. The times for the
+         * ones we know stay unless the table has times for them.
+         */
+        for(index = 0; index < SPI_FLASH_ERASE_TYPES; index++)
         {
-            /* Check for completion of any prior command */
-            if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-            {
-                return_val = SPI_FLASH_TIMEOUT;
-            }
-            else
-            {
-                /* Send Write Enable command */
-                cmd_buffer[0] = WRITE_ENABLE_CMD;
-                IRQS_OFF
-                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-                IRQS_ON
+            max_timeout = (g_flash_dev.erase[index].timeout > max_timeout) ? g_flash_dev.erase[index].timeout : max_timeout;
+        }
 
-                if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+        memset(erase, 0, sizeof(erase));
+        for(index = 0; index < 4u; index++)
+        {
+            temp = (bfpt[7u + (index / 2u)] >> ((index % 2u) * 16u)) & 0xFFFFu;
+            slot[index] = (12u == (temp & 0xFFu)) ? SPI_FLASH_ERASE_4K :
+                          (15u == (temp & 0xFFu)) ? SPI_FLASH_ERASE_32K :
+                          (16u == (temp & 0xFFu)) ? SPI_FLASH_ERASE_64K : SPI_FLASH_ERASE_TYPES;
+            if(SPI_FLASH_ERASE_TYPES != slot[index])
+            {
+                erase[slot[index]].opcode  = (uint8_t)(temp >> 8);
+                erase[slot[index]].timeout = max_timeout;
+                if(erase[slot[index]].opcode == g_flash_dev.erase[slot[index]].opcode)
                 {
-                    return_val = SPI_FLASH_TIMEOUT;
+                    erase[slot[index]].opcode_4b = g_flash_dev.erase[slot[index]].opcode_4b;
+                    erase[slot[index]].timeout   = g_flash_dev.erase[slot[index]].timeout;
                 }
-                else
-                {
-                    /* Now safe to unprotect sector */
-                	cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, UNPROTECT_SECTOR_OPCODE, peram1);
-                    IRQS_OFF
-                    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
-                    IRQS_ON
 
-                    timeout = FLASH_TIMEOUT_MISC;
+                if(n_dwords >= 10u)
+                {
+                    erase[slot[index]].timeout = sfdp_timeout(bfpt[9] >> (4u + (7u * index)), erase_units, bfpt[9] & 0x0Fu);
                 }
+                n_erase++;
             }
         }
-        break;
 
-        case SPI_FLASH_GLOBAL_PROTECT:
-        case SPI_FLASH_GLOBAL_UNPROTECT:
+        if(0u != n_erase)
         {
-            if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-            {
-                return_val = SPI_FLASH_TIMEOUT;
-            }
-            else
-            {
-                /* Send Write Enable command */
-                cmd_buffer[0] = WRITE_ENABLE_CMD;
-                IRQS_OFF
-                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-                IRQS_ON
+            memcpy(g_flash_dev.erase, erase, sizeof(erase));
+        }
 
-                if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+        if(n_dwords >= 11u)
+        {
+            temp = 1u << ((bfpt[10] >> 4) & 0x0Fu);
+            g_flash_dev.page_size    = (temp < FLASH_MAX_PAGE_SIZE) ? temp : FLASH_MAX_PAGE_SIZE;
+            g_flash_dev.timeout_chip = sfdp_timeout(bfpt[10] >> 24, chip_units, bfpt[9] & 0x0Fu);
+        }
+
+        /* The 4 byte address instruction table, if the device has one */
+        n_headers = ((header[1] >> 16) & 0xFFu) + 1u;
+        n_headers = (n_headers < SFDP_MAX_HEADERS) ? n_headers : SFDP_MAX_HEADERS;
+        for(index = 1u; index < n_headers; index++)
+        {
+            if((SFDP_4BAIT_ID == (header[2u + (2u * index)] & 0xFFu)) && (0xFFu == (header[3u + (2u * index)] >> 24)) &&
+               (SPI_FLASH_SUCCESS == sfdp_read(header[3u + (2u * index)] & 0x00FFFFFFu, bait, sizeof(bait))))
+            {
+                /* READ, FAST READ and PAGE PROGRAM all have 4 byte forms */
+                if(0x00000043u == (bait[0] & 0x00000043u))
                 {
-                    return_val = SPI_FLASH_TIMEOUT;
+                    g_flash_dev.flags |= SPI_FLASH_DEV_4_BYTE_OPCODES;
                 }
-                else
-                {
-                    /* Send Chip Erase command */
-                    cmd_buffer[0] = WRITE_STATUS1_OPCODE;
-                    cmd_buffer[1] = 0;
-
-                    IRQS_OFF
-                    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 2, 0, 0);
-                    IRQS_ON
 
-                    timeout = FLASH_TIMEOUT_MISC;
+                for(temp = 0; temp < 4u; temp++)
+                {
+                    if((0u != (bait[0] & (0x00000200u << temp))) && (SPI_FLASH_ERASE_TYPES != slot[temp]))
+                    {
+                        g_flash_dev.erase[slot[temp]].opcode_4b = (uint8_t)(bait[1] >> (8u * temp));
+                    }
                 }
             }
         }
-        break;
+    }
+}
 #endif
-        case SPI_FLASH_CHIP_ERASE:
-        {
-            if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-            {
-                return_val = SPI_FLASH_TIMEOUT;
-            }
-            else
-            {
-                /* Send Write Enable command */
-                cmd_buffer[0] = WRITE_ENABLE_CMD;
-                IRQS_OFF
-                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-                IRQS_ON
 
-                if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-                {
-                    return_val = SPI_FLASH_TIMEOUT;
-                }
-                else
-                {
-                    /* Send Chip Erase command */
-                    cmd_buffer[0] = CHIP_ERASE_OPCODE;
+/*
+ * Size of each spi_flash_erase_type_t.
+ */
+static const uint32_t g_erase_block_size[SPI_FLASH_ERASE_TYPES] = { 4096u, 32768u, 65536u };
 
-                    IRQS_OFF
-                    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-                    IRQS_ON
+/******************************************************************************
+ * Start erasing the block of the given type containing address. The device is
+ * left busy with the erase and, on devices which need it, in 4 byte address
+ * mode.
+ ******************************************************************************/
+static spi_flash_status_t erase_block_start(spi_flash_erase_type_t type, uint32_t address)
+{
+    spi_flash_status_t return_val = SPI_FLASH_SUCCESS;
+    uint8_t cmd_buffer[FLASH_MAX_CMD_BYTES];
+    int32_t cmd_len;
 
-                    timeout = FLASH_TIMEOUT_ERASE_CHIP;
-                }
-            }
-        }
-        break;
+    if(0u == g_flash_dev.erase[type].opcode)
+    {
+        return_val = SPI_FLASH_INVALID_ARGUMENTS;
+    }
+    else if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+    {
+        return_val = SPI_FLASH_TIMEOUT;
+    }
+    else
+    {
+        /* Select block start by masking off non significant bits */
+        address &= ~(g_erase_block_size[type] - 1u);
 
-        case SPI_FLASH_RESET:
+        return_val = spi_flash_4_byte_addr(ENABLE_4_BYTE_ADDR);
+        if(SPI_FLASH_SUCCESS == return_val)
         {
-            /*
-             * Reset is a two step operation and if you really want to do it,
-             * you will not test for completion of previous command as you are
-             * probably not concerned about that!
-             *
-             * It's a two step process so send Enable Reset command first
-             */
-            cmd_buffer[0] = ENABLE_RESET_CMD;
-            IRQS_OFF
-            SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-            IRQS_ON
-
-            /* Followed immediately by Reset command */
-            cmd_buffer[0] = ENABLE_RESET_CMD;
+            /* Send Write Enable command */
+            cmd_buffer[0] = WRITE_ENABLE_CMD;
             IRQS_OFF
             SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
             IRQS_ON
 
-            timeout = FLASH_TIMEOUT_MISC;
-        }
-        break;
-
-        case SPI_FLASH_4KBLOCK_ERASE:
-        {
             if(0 != wait_ready(FLASH_TIMEOUT_MISC))
             {
                 return_val = SPI_FLASH_TIMEOUT;
             }
-            else
-            {
-				/* Select block start by masking off non significant bits */
-				peram1 &= BLOCK_ALIGN_MASK_4K;
-
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-				return_val = spi_flash_4_byte_addr(ENABLE_4_BYTE_ADDR);
-				if(SPI_FLASH_SUCCESS == return_val)
-				{
-					/* Send Write Enable command */
-					cmd_buffer[0] = WRITE_ENABLE_CMD;
-					IRQS_OFF
-					SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-					IRQS_ON
-
-					if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-					{
-						return_val = SPI_FLASH_TIMEOUT;
-					}
-				}
-				if(SPI_FLASH_SUCCESS == return_val)
-				{
-					/* Send 4K Block Erase command */
-					cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, ERASE_4K_BLOCK_OPCODE, peram1);
-					IRQS_OFF
-					SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
-					IRQS_ON
-
-					if(0 != wait_ready(FLASH_TIMEOUT_ERASE_4K))
-					{
-						return_val = SPI_FLASH_TIMEOUT;
-					}
-				}
-				if(SPI_FLASH_SUCCESS == return_val)
-				{
-					return_val = spi_flash_4_byte_addr(DISABLE_4_BYTE_ADDR);
-				}
-#else
-				if(SPI_FLASH_SUCCESS == return_val)
-				{
-					/* Send Write Enable command */
-					cmd_buffer[0] = WRITE_ENABLE_CMD;
-					IRQS_OFF
-					SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-					IRQS_ON
-
-					if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-					{
-						return_val = SPI_FLASH_TIMEOUT;
-					}
-				}
-				if(SPI_FLASH_SUCCESS == return_val)
-				{
-					/* Send 4K Block Erase command */
-					cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, ERASE_4K_BLOCK_OPCODE, peram1);
-					IRQS_OFF
-					SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
-					IRQS_ON
-
-					timeout = FLASH_TIMEOUT_ERASE_4K;
-				}
-#endif
-            }
         }
-        break;
+        if(SPI_FLASH_SUCCESS == return_val)
+        {
+            /* Send Block Erase command */
+            cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, g_flash_dev.erase[type].opcode, address);
+            IRQS_OFF
+            SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
+            IRQS_ON
+        }
+    }
 
-#if (SF2BL_FLASH_DEVICE != SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-        case SPI_FLASH_32KBLOCK_ERASE:
+    return(return_val);
+}
+
+/******************************************************************************
+ * Erase the block of the given type containing address and wait for the erase
+ * to complete.
+ ******************************************************************************/
+static spi_flash_status_t erase_block(spi_flash_erase_type_t type, uint32_t address)
+{
+    spi_flash_status_t return_val;
+
+    return_val = erase_block_start(type, address);
+    if(SPI_FLASH_SUCCESS == return_val)
+    {
+        if(0 != wait_ready(g_flash_dev.erase[type].timeout))
         {
-            if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-            {
-                return_val = SPI_FLASH_TIMEOUT;
-            }
-            else
-            {
-                /* Send Write Enable command */
-                cmd_buffer[0] = WRITE_ENABLE_CMD;
-                IRQS_OFF
-                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-                IRQS_ON
+            return_val = SPI_FLASH_TIMEOUT;
+        }
+        else
+        {
+            return_val = spi_flash_4_byte_addr(DISABLE_4_BYTE_ADDR);
+        }
+    }
 
-                if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-                {
-                    return_val = SPI_FLASH_TIMEOUT;
-                }
-                else
-                {
-                    /* Select block start by masking off non significant bits */
-                    peram1 &= BLOCK_ALIGN_MASK_32K;
+    return(return_val);
+}
 
-                    /* Send 32K Block Erase command */
-                	cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, ERASE_32K_BLOCK_OPCODE, peram1);
+/******************************************************************************
+ * Unprotect the sector containing address on devices which need it.
+ ******************************************************************************/
+static spi_flash_status_t unprotect_block(uint32_t address)
+{
+    spi_flash_status_t return_val = SPI_FLASH_SUCCESS;
+    uint8_t cmd_buffer[FLASH_MAX_CMD_BYTES];
+    int32_t cmd_len;
 
-                    IRQS_OFF
-                    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
-                    IRQS_ON
+    if(0u != (g_flash_dev.flags & SPI_FLASH_DEV_SECTOR_PROTECT))
+    {
+        /* Send Write Enable command */
+        cmd_buffer[0] = WRITE_ENABLE_CMD;
+        IRQS_OFF
+        SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
+        IRQS_ON
 
-                    timeout = FLASH_TIMEOUT_ERASE_32K;
-                }
-            }
+        if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+        {
+            return_val = SPI_FLASH_TIMEOUT;
         }
-        break;
-#endif
-        case SPI_FLASH_64KBLOCK_ERASE:
+        else
         {
+            /* Send Sector unprotect command */
+            cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, UNPROTECT_SECTOR_OPCODE, address);
+            IRQS_OFF
+            SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
+            IRQS_ON
+
             if(0 != wait_ready(FLASH_TIMEOUT_MISC))
             {
                 return_val = SPI_FLASH_TIMEOUT;
             }
-            else
-            {
-				/* Select block start by masking off non significant bits */
-				peram1 &= BLOCK_ALIGN_MASK_64K;
-
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-				return_val = spi_flash_4_byte_addr(ENABLE_4_BYTE_ADDR);
-				if(SPI_FLASH_SUCCESS == return_val)
-				{
-					/* Send Write Enable command */
-					cmd_buffer[0] = WRITE_ENABLE_CMD;
-					IRQS_OFF
-					SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-					IRQS_ON
-
-					if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-					{
-						return_val = SPI_FLASH_TIMEOUT;
-					}
-				}
-				if(SPI_FLASH_SUCCESS == return_val)
-				{
-					/* Send 64K Block Erase command */
-					cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, ERASE_64K_BLOCK_OPCODE, peram1);
-					IRQS_OFF
-					SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
-					IRQS_ON
-
-					if(0 != wait_ready(FLASH_TIMEOUT_ERASE_64K))
-					{
-						return_val = SPI_FLASH_TIMEOUT;
-					}
-				}
-				if(SPI_FLASH_SUCCESS == return_val)
-				{
-					return_val = spi_flash_4_byte_addr(DISABLE_4_BYTE_ADDR);
-				}
-#else
-				if(SPI_FLASH_SUCCESS == return_val)
-				{
-					/* Send Write Enable command */
-					cmd_buffer[0] = WRITE_ENABLE_CMD;
-					IRQS_OFF
-					SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-					IRQS_ON
-
-					if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-					{
-						return_val = SPI_FLASH_TIMEOUT;
-					}
-				}
-				if(SPI_FLASH_SUCCESS == return_val)
-				{
-					/* Send 64K Block Erase command */
-					cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, ERASE_64K_BLOCK_OPCODE, peram1);
-					IRQS_OFF
-					SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
-					IRQS_ON
-
-					timeout = FLASH_TIMEOUT_ERASE_64K;
-				}
-#endif
-            }
         }
-        break;
+    }
 
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-        case SPI_FLASH_READ_NV_CFG:
-        {
-            uint8_t read_buffer[2];
+    return(return_val);
+}
 
-            /* Check for completion of any prior command */
+/******************************************************************************
+ * Returns the largest erase type the device has which starts at address and
+ * does not go past end, or -1 if there is none.
+ ******************************************************************************/
+static int32_t erase_type_at(uint32_t address, uint32_t end)
+{
+    int32_t type;
+
+    type = SPI_FLASH_ERASE_TYPES - 1;
+    while((type >= 0) && ((0u == g_flash_dev.erase[type].opcode) ||
+                          (0u != (address & (g_erase_block_size[type] - 1u))) ||
+                          ((end - address) < g_erase_block_size[type])))
+    {
+        type--;
+    }
+
+    return(type);
+}
+
+/******************************************************************************
+ * Erase the 4K sectors covering size_in_bytes from address with the largest
+ * erase blocks the device has that fit.
+ ******************************************************************************/
+static spi_flash_status_t erase_range(uint32_t address, uint32_t size_in_bytes)
+{
+    spi_flash_status_t return_val = SPI_FLASH_SUCCESS;
+    uint32_t end;
+    int32_t  type;
+
+    end     = (address + size_in_bytes + (NB_BYTES_PER_SECTOR - 1)) & BLOCK_ALIGN_MASK_4K;
+    address = address & BLOCK_ALIGN_MASK_4K;
+    while((SPI_FLASH_SUCCESS == return_val) && (address < end))
+    {
+        type = erase_type_at(address, end);
+        if(type < 0)
+        {
+            return_val = SPI_FLASH_INVALID_ARGUMENTS;
+        }
+        else
+        {
+            return_val = unprotect_block(address);
+            if(SPI_FLASH_SUCCESS == return_val)
+            {
+                return_val = erase_block((spi_flash_erase_type_t)type, address);
+            }
+            address += g_erase_block_size[type];
+        }
+    }
+
+    return(return_val);
+}
+
+#if defined(SF2BL_FLASH_BG_ERASE)
+/*
+ * Range being erased in the background, see spi_flash_erase_start(). Blocks
+ * from next up to end are still to be erased and block_busy is set while the
+ * device is erasing the block before next.
+ */
+typedef struct bg_erase
+{
+    uint32_t           base;       /* Start of range */
+    uint32_t           next;
+    uint32_t           end;
+    uint32_t           block_busy;
+    uint32_t           suspended;
+    uint32_t           start_time; /* g_10ms_count at block start or resume */
+    uint32_t           timeout;
+    spi_flash_status_t status;     /* Error which stopped the erase */
+} bg_erase_t;
+
+static bg_erase_t g_bg_erase;
+
+/******************************************************************************
+ * Move the background erase on without waiting for the device.
+ *
+ * Returns SPI_FLASH_BUSY until the range is erased.
+ ******************************************************************************/
+static spi_flash_status_t bg_erase_service(void)
+{
+    int32_t type;
+
+    if((0u != g_bg_erase.block_busy) && (0u == g_bg_erase.suspended))
+    {
+        if(0u == read_busy())
+        {
+            g_bg_erase.block_busy = 0u;
+        }
+        else if((g_10ms_count - g_bg_erase.start_time) >= g_bg_erase.timeout)
+        {
+            g_bg_erase.block_busy = 0u;
+            g_bg_erase.status     = SPI_FLASH_TIMEOUT;
+        }
+    }
+
+    if((0u == g_bg_erase.block_busy) && (SPI_FLASH_SUCCESS == g_bg_erase.status) &&
+       (g_bg_erase.next < g_bg_erase.end))
+    {
+        type = erase_type_at(g_bg_erase.next, g_bg_erase.end);
+        if(type < 0)
+        {
+            g_bg_erase.status = SPI_FLASH_INVALID_ARGUMENTS;
+        }
+        else
+        {
+            g_bg_erase.status = unprotect_block(g_bg_erase.next);
+            if(SPI_FLASH_SUCCESS == g_bg_erase.status)
+            {
+                g_bg_erase.status = erase_block_start((spi_flash_erase_type_t)type, g_bg_erase.next);
+            }
+            if(SPI_FLASH_SUCCESS == g_bg_erase.status)
+            {
+                g_bg_erase.block_busy = 1u;
+                g_bg_erase.start_time = g_10ms_count;
+                g_bg_erase.timeout    = g_flash_dev.erase[type].timeout;
+            }
+            g_bg_erase.next += g_erase_block_size[type];
+        }
+    }
+
+    if(SPI_FLASH_SUCCESS != g_bg_erase.status)
+    {
+        g_bg_erase.next = g_bg_erase.end; /* Abandon the rest of the range */
+    }
+
+    return(((0u != g_bg_erase.block_busy) || (g_bg_erase.next < g_bg_erase.end)) ?
+           SPI_FLASH_BUSY : g_bg_erase.status);
+}
+
+/******************************************************************************
+ * Resume a suspended block erase.
+ ******************************************************************************/
+static void bg_erase_resume(void)
+{
+    uint8_t command;
+
+    if(0u != g_bg_erase.suspended)
+    {
+        command = g_flash_dev.resume_opcode;
+        IRQS_OFF
+        SPI_TRANS_BLOCK(SPI_INSTANCE, &command, 1, 0, 0);
+        IRQS_ON
+        g_bg_erase.suspended  = 0u;
+        g_bg_erase.start_time = g_10ms_count;
+    }
+}
+
+/******************************************************************************
+ * Wait for the whole background erase range to be erased.
+ ******************************************************************************/
+static spi_flash_status_t bg_erase_finish(void)
+{
+    spi_flash_status_t return_val;
+
+    bg_erase_resume();
+    do {
+        return_val = bg_erase_service();
+    } while(SPI_FLASH_BUSY == return_val);
+
+    return(return_val);
+}
+
+/******************************************************************************
+ * Suspend a block erase in progress so other blocks can be read, or let the
+ * block complete on devices without a suspend command. The caller waits for
+ * the device to be ready. If the erase completes before the suspend command
+ * arrives the resume command is ignored by the device.
+ ******************************************************************************/
+static void bg_erase_suspend(void)
+{
+    uint8_t command;
+
+    if((0u != g_bg_erase.block_busy) && (0u == g_bg_erase.suspended))
+    {
+        if(0u == g_flash_dev.suspend_opcode)
+        {
+            if(0 != wait_ready(g_bg_erase.timeout))
+            {
+                g_bg_erase.status = SPI_FLASH_TIMEOUT;
+                g_bg_erase.next   = g_bg_erase.end;
+            }
+            g_bg_erase.block_busy = 0u;
+        }
+        else
+        {
+            command = g_flash_dev.suspend_opcode;
+            IRQS_OFF
+            SPI_TRANS_BLOCK(SPI_INSTANCE, &command, 1, 0, 0);
+            IRQS_ON
+            g_bg_erase.suspended = 1u;
+        }
+    }
+}
+
+#define BG_ERASE_FINISH  (void)bg_erase_finish();
+#define BG_ERASE_SUSPEND bg_erase_suspend();
+#define BG_ERASE_RESUME  bg_erase_resume();
+#define BG_ERASE_IDLE    ((0u == g_bg_erase.block_busy) && (g_bg_erase.next >= g_bg_erase.end))
+#else
+#define BG_ERASE_FINISH
+#define BG_ERASE_SUSPEND
+#define BG_ERASE_RESUME
+#define BG_ERASE_IDLE    1
+#endif
+
+#if defined(SF2BL_FLASH_XIP)
+/******************************************************************************
+ * Take the device out of XIP mode, if it is in it, with a read whose first
+ * dummy bit is set so that commands can be sent again.
+ ******************************************************************************/
+static void xip_exit(void)
+{
+    uint8_t cmd_buffer[FLASH_MAX_CMD_BYTES];
+    uint8_t data;
+    int32_t cmd_len;
+
+    if(0 != g_xip_active)
+    {
+        cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, g_read_opcode, 0u);
+        memset(&cmd_buffer[cmd_len], XIP_EXIT_BITS, (size_t)g_read_dummy);
+        IRQS_OFF
+        SPI_TRANS_BLOCK(SPI_INSTANCE, &cmd_buffer[1], (uint16_t)(cmd_len - 1 + g_read_dummy), &data, 1);
+        IRQS_ON
+        g_xip_active = 0;
+    }
+}
+
+/******************************************************************************
+ * A warm reset can leave the device in XIP mode from before. A frame of all
+ * ones is a read with the XIP exit bit set then, and is ignored otherwise.
+ ******************************************************************************/
+static void xip_reset(void)
+{
+    uint8_t cmd_buffer[FLASH_MAX_CMD_BYTES];
+
+    memset(cmd_buffer, XIP_EXIT_BITS, sizeof(cmd_buffer));
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+    SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+    MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+    IRQS_OFF
+    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, sizeof(cmd_buffer), 0, 0);
+    IRQS_ON
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+    SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+    MSS_SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+}
+
+#define XIP_EXIT xip_exit();
+#else
+#define XIP_EXIT
+#endif
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t
+spi_flash_control_hw
+(
+    spi_flash_control_hw_t operation,
+    uint32_t peram1,
+    void *   ptrPeram
+)
+{
+    spi_flash_status_t return_val = SPI_FLASH_SUCCESS;
+    uint8_t cmd_buffer[FLASH_MAX_CMD_BYTES];
+    uint32_t timeout = 0; /* Exit timeout, 0 for not required */
+    int32_t cmd_len;
+
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+    SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+    MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+
+    XIP_EXIT
+    if((SPI_FLASH_ERASE_SUSPEND != operation) && (SPI_FLASH_ERASE_RESUME != operation))
+    {
+        BG_ERASE_FINISH
+    }
+
+    switch(operation){
+        case SPI_FLASH_READ_DEVICE_ID:
+        {
+            uint8_t read_buffer[3];
+
+            /* Check for completion of any prior command */
             if(0 != wait_ready(FLASH_TIMEOUT_MISC))
             {
                 return_val = SPI_FLASH_TIMEOUT;
             }
             else
             {
-                cmd_buffer[0] = READ_NV_CFG_REG_CMD;
+                cmd_buffer[0] = DEVICE_ID_READ;
                 IRQS_OFF
-                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, read_buffer, 2);
+                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, read_buffer,
+                                sizeof(read_buffer));
                 IRQS_ON
 
-                *(uint16_t *)ptrPeram = (read_buffer[0] << 8) + read_buffer[1];
+                ((spi_dev_info_t *)ptrPeram)->manufacturer_id = read_buffer[0];
+                ((spi_dev_info_t *)ptrPeram)->device_id       = read_buffer[1];
+                ((spi_dev_info_t *)ptrPeram)->capacity        = read_buffer[2];
             }
         }
         break;
 
-        case SPI_FLASH_WRITE_NV_CFG:
+        case SPI_FLASH_SECTOR_PROTECT:
         {
             /* Check for completion of any prior command */
-            if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+            if(0u == (g_flash_dev.flags & SPI_FLASH_DEV_SECTOR_PROTECT))
+            {
+                return_val = SPI_FLASH_INVALID_ARGUMENTS;
+            }
+            else if(0 != wait_ready(FLASH_TIMEOUT_MISC))
             {
                 return_val = SPI_FLASH_TIMEOUT;
             }
@@ -978,12 +1498,10 @@ spi_flash_control_hw
                 }
                 else
                 {
-                    /* Safe to modify register now */
-                    cmd_buffer[0] = WRITE_NV_CFG_REG_CMD;
-                    cmd_buffer[1] = (uint8_t)(peram1 >> 8);
-                    cmd_buffer[2] = (uint8_t)peram1;
+                    /* Safe to protect sector now */
+                	cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, PROTECT_SECTOR_OPCODE, peram1);
                     IRQS_OFF
-                    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 3, 0, 0);
+                    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
                     IRQS_ON
 
                     timeout = FLASH_TIMEOUT_MISC;
@@ -992,31 +1510,51 @@ spi_flash_control_hw
         }
         break;
 
-        case SPI_FLASH_READ_V_CFG:
+        case SPI_FLASH_SECTOR_UNPROTECT:
         {
-            uint8_t read_buffer;
-
             /* Check for completion of any prior command */
-            if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+            if(0u == (g_flash_dev.flags & SPI_FLASH_DEV_SECTOR_PROTECT))
+            {
+                return_val = SPI_FLASH_INVALID_ARGUMENTS;
+            }
+            else if(0 != wait_ready(FLASH_TIMEOUT_MISC))
             {
                 return_val = SPI_FLASH_TIMEOUT;
             }
             else
             {
-                cmd_buffer[0] = READ_V_CFG_REG_CMD;
+                /* Send Write Enable command */
+                cmd_buffer[0] = WRITE_ENABLE_CMD;
                 IRQS_OFF
-                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, &read_buffer, 1);
+                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
                 IRQS_ON
 
-                *(uint8_t *)ptrPeram = read_buffer;
+                if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+                {
+                    return_val = SPI_FLASH_TIMEOUT;
+                }
+                else
+                {
+                    /* Now safe to unprotect sector */
+                	cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, UNPROTECT_SECTOR_OPCODE, peram1);
+                    IRQS_OFF
+                    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
+                    IRQS_ON
+
+                    timeout = FLASH_TIMEOUT_MISC;
+                }
             }
         }
         break;
 
-        case SPI_FLASH_WRITE_V_CFG:
+        case SPI_FLASH_GLOBAL_PROTECT:
+        case SPI_FLASH_GLOBAL_UNPROTECT:
         {
-            /* Check for completion of any prior command */
-            if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+            if(0u == (g_flash_dev.flags & SPI_FLASH_DEV_SECTOR_PROTECT))
+            {
+                return_val = SPI_FLASH_INVALID_ARGUMENTS;
+            }
+            else if(0 != wait_ready(FLASH_TIMEOUT_MISC))
             {
                 return_val = SPI_FLASH_TIMEOUT;
             }
@@ -1027,15 +1565,17 @@ spi_flash_control_hw
                 IRQS_OFF
                 SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
                 IRQS_ON
+
                 if(0 != wait_ready(FLASH_TIMEOUT_MISC))
                 {
                     return_val = SPI_FLASH_TIMEOUT;
                 }
                 else
                 {
-                    /* Safe to modify register now */
-                    cmd_buffer[0] = WRITE_V_CFG_REG_CMD;
-                    cmd_buffer[1] = (uint8_t)peram1;
+                    /* Send Chip Erase command */
+                    cmd_buffer[0] = WRITE_STATUS1_OPCODE;
+                    cmd_buffer[1] = 0;
+
                     IRQS_OFF
                     SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 2, 0, 0);
                     IRQS_ON
@@ -1045,19 +1585,758 @@ spi_flash_control_hw
             }
         }
         break;
-#endif
-        default:
-              return_val = SPI_FLASH_INVALID_ARGUMENTS;
-        break;
-    }
 
-    if(0 != timeout)
-    {
-        if(0 != wait_ready(timeout))
+        case SPI_FLASH_CHIP_ERASE:
         {
-            return_val = SPI_FLASH_TIMEOUT;
-        }
-    }
+            if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+            {
+                return_val = SPI_FLASH_TIMEOUT;
+            }
+            else
+            {
+                /* Send Write Enable command */
+                cmd_buffer[0] = WRITE_ENABLE_CMD;
+                IRQS_OFF
+                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
+                IRQS_ON
+
+                if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+                {
+                    return_val = SPI_FLASH_TIMEOUT;
+                }
+                else
+                {
+                    /* Send Chip Erase command */
+                    cmd_buffer[0] = CHIP_ERASE_OPCODE;
+
+                    IRQS_OFF
+                    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
+                    IRQS_ON
+
+                    timeout = FLASH_TIMEOUT_ERASE_CHIP;
+                }
+            }
+        }
+        break;
+
+        case SPI_FLASH_RESET:
+        {
+            /*
+             * Reset is a two step operation and if you really want to do it,
+             * you will not test for completion of previous command as you are
+             * probably not concerned about that!
+             *
+             * It's a two step process so send Enable Reset command first
+             */
+            cmd_buffer[0] = ENABLE_RESET_CMD;
+            IRQS_OFF
+            SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
+            IRQS_ON
+
+            /* Followed immediately by Reset command */
+            cmd_buffer[0] = ENABLE_RESET_CMD;
+            IRQS_OFF
+            SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
+            IRQS_ON
+
+            timeout = FLASH_TIMEOUT_MISC;
+        }
+        break;
+
+        case SPI_FLASH_4KBLOCK_ERASE:
+        case SPI_FLASH_32KBLOCK_ERASE:
+        case SPI_FLASH_64KBLOCK_ERASE:
+        {
+            return_val = erase_block((spi_flash_erase_type_t)(operation - SPI_FLASH_4KBLOCK_ERASE), peram1);
+        }
+        break;
+
+        case SPI_FLASH_READ_NV_CFG:
+        {
+            uint8_t read_buffer[2];
+
+            /* Check for completion of any prior command */
+            if(0u == (g_flash_dev.flags & SPI_FLASH_DEV_MICRON_CFG))
+            {
+                return_val = SPI_FLASH_INVALID_ARGUMENTS;
+            }
+            else if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+            {
+                return_val = SPI_FLASH_TIMEOUT;
+            }
+            else
+            {
+                cmd_buffer[0] = READ_NV_CFG_REG_CMD;
+                IRQS_OFF
+                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, read_buffer, 2);
+                IRQS_ON
+
+                *(uint16_t *)ptrPeram = (read_buffer[0] << 8) + read_buffer[1];
+            }
+        }
+        break;
+
+        case SPI_FLASH_WRITE_NV_CFG:
+        {
+            /* Check for completion of any prior command */
+            if(0u == (g_flash_dev.flags & SPI_FLASH_DEV_MICRON_CFG))
+            {
+                return_val = SPI_FLASH_INVALID_ARGUMENTS;
+            }
+            else if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+            {
+                return_val = SPI_FLASH_TIMEOUT;
+            }
+            else
+            {
+                /* Send Write Enable command */
+                cmd_buffer[0] = WRITE_ENABLE_CMD;
+                IRQS_OFF
+                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
+                IRQS_ON
+                if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+                {
+                    return_val = SPI_FLASH_TIMEOUT;
+                }
+                else
+                {
+                    /* Safe to modify register now */
+                    cmd_buffer[0] = WRITE_NV_CFG_REG_CMD;
+                    cmd_buffer[1] = (uint8_t)(peram1 >> 8);
+                    cmd_buffer[2] = (uint8_t)peram1;
+                    IRQS_OFF
+                    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 3, 0, 0);
+                    IRQS_ON
+
+                    timeout = FLASH_TIMEOUT_MISC;
+                }
+            }
+        }
+        break;
+
+        case SPI_FLASH_READ_V_CFG:
+        {
+            uint8_t read_buffer;
+
+            /* Check for completion of any prior command */
+            if(0u == (g_flash_dev.flags & SPI_FLASH_DEV_MICRON_CFG))
+            {
+                return_val = SPI_FLASH_INVALID_ARGUMENTS;
+            }
+            else if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+            {
+                return_val = SPI_FLASH_TIMEOUT;
+            }
+            else
+            {
+                cmd_buffer[0] = READ_V_CFG_REG_CMD;
+                IRQS_OFF
+                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, &read_buffer, 1);
+                IRQS_ON
+
+                *(uint8_t *)ptrPeram = read_buffer;
+            }
+        }
+        break;
+
+        case SPI_FLASH_WRITE_V_CFG:
+        {
+            /* Check for completion of any prior command */
+            if(0u == (g_flash_dev.flags & SPI_FLASH_DEV_MICRON_CFG))
+            {
+                return_val = SPI_FLASH_INVALID_ARGUMENTS;
+            }
+            else if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+            {
+                return_val = SPI_FLASH_TIMEOUT;
+            }
+            else
+            {
+                /* Send Write Enable command */
+                cmd_buffer[0] = WRITE_ENABLE_CMD;
+                IRQS_OFF
+                SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
+                IRQS_ON
+                if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+                {
+                    return_val = SPI_FLASH_TIMEOUT;
+                }
+                else
+                {
+                    /* Safe to modify register now */
+                    cmd_buffer[0] = WRITE_V_CFG_REG_CMD;
+                    cmd_buffer[1] = (uint8_t)peram1;
+                    IRQS_OFF
+                    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 2, 0, 0);
+                    IRQS_ON
+
+                    timeout = FLASH_TIMEOUT_MISC;
+                }
+            }
+        }
+        break;
+
+        case SPI_FLASH_SET_READ_MODE:
+        {
+            if(SPI_FLASH_READ_NORMAL == peram1)
+            {
+                g_read_opcode = READ_SLOW_OPCODE;
+                g_read_dummy  = 0;
+            }
+            else if(SPI_FLASH_READ_FAST == peram1)
+            {
+                g_read_opcode = READ_ARRAY_OPCODE;
+                g_read_dummy  = (int32_t)(g_flash_dev.fast_read_dummy / 8u);
+            }
+#if defined(SF2BL_FLASH_XIP)
+            /* XIP frames cannot switch the address mode around each read */
+            else if((SPI_FLASH_READ_XIP == peram1) && (0 != g_xip_enabled) &&
+                    ((4u != g_flash_dev.addr_bytes) || (0 != g_4_byte_addr_enabled) ||
+                     (0u != (g_flash_dev.flags & SPI_FLASH_DEV_4_BYTE_OPCODES))))
+            {
+                g_read_opcode = READ_ARRAY_OPCODE;
+                g_read_dummy  = (int32_t)(g_flash_dev.fast_read_dummy / 8u);
+            }
+#endif
+            else
+            {
+                return_val = SPI_FLASH_INVALID_ARGUMENTS;
+            }
+
+#if defined(SF2BL_FLASH_XIP)
+            if(SPI_FLASH_SUCCESS == return_val)
+            {
+                g_read_xip = (SPI_FLASH_READ_XIP == peram1) ? 1 : 0;
+            }
+#endif
+        }
+        break;
+
+#if defined(SF2BL_FLASH_BG_ERASE)
+        case SPI_FLASH_ERASE_SUSPEND:
+        {
+            bg_erase_suspend();
+            timeout = FLASH_TIMEOUT_MISC;
+        }
+        break;
+
+        case SPI_FLASH_ERASE_RESUME:
+        {
+            bg_erase_resume();
+        }
+        break;
+#endif
+
+        default:
+              return_val = SPI_FLASH_INVALID_ARGUMENTS;
+        break;
+    }
+
+    if(0 != timeout)
+    {
+        if(0 != wait_ready(timeout))
+        {
+            return_val = SPI_FLASH_TIMEOUT;
+        }
+    }
+
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+    SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+    MSS_SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+
+    return(return_val);
+}
+
+
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+/*
+ * Handler and context for the spi_flash_read_long() in progress, called from
+ * the driver's chunk handler.
+ */
+static spi_flash_chunk_handler_t g_chunk_handler = 0;
+static void *g_chunk_context = 0;
+
+static void read_chunk_done(uint8_t *chunk, uint32_t chunk_len)
+{
+    g_chunk_handler(chunk, chunk_len, g_chunk_context);
+}
+#endif
+
+/*******************************************************************************
+ * This function puts the current read command for address in cmd_buffer,
+ * followed by its dummy bytes, and returns the number of bytes to send. With
+ * XIP mode enabled the first dummy bit keeps the device in XIP mode after the
+ * read if SPI_FLASH_READ_XIP is selected, except while a background erase is
+ * outstanding as the resume command could not be sent then.
+ */
+static int32_t read_cmd(uint8_t * cmd_buffer, uint32_t address)
+{
+    int32_t cmd_len;
+    int32_t index;
+    uint8_t dummy = DONT_CARE;
+
+    cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, g_read_opcode, address);
+#if defined(SF2BL_FLASH_XIP)
+    if(0 != g_xip_enabled)
+    {
+        g_xip_active = (0 != g_read_xip) && BG_ERASE_IDLE;
+        dummy = (0 != g_xip_active) ? XIP_CONFIRM : XIP_EXIT_BITS;
+    }
+#endif
+    for(index = 0; index < g_read_dummy; index++)
+    {
+        cmd_buffer[cmd_len + index] = dummy;
+    }
+
+    return(cmd_len + g_read_dummy);
+}
+
+/*******************************************************************************
+ * This function sends a read command, including its dummy bytes, and reads the
+ * data on SPI, streaming it through rx_buffer chunk_size bytes at a time if
+ * chunk_size is not 0.
+ */
+static void read_cmd_data
+(
+    uint8_t * cmd_buffer,
+    uint16_t cmd_byte_size,
+    uint8_t * rx_buffer,
+    uint32_t rx_byte_size,
+    uint32_t chunk_size
+)
+{
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+    spi_segment_t segments[FLASH_MAX_SEGMENTS];
+
+    segments[0].buffer    = cmd_buffer;
+    segments[0].length    = cmd_byte_size;
+    segments[0].direction = SPI_SEG_TX;
+    segments[1].buffer    = rx_buffer;
+    segments[1].length    = rx_byte_size;
+    segments[1].direction = SPI_SEG_RX;
+    spi_flash_transfer_segments(segments, 2u, chunk_size, (0u != chunk_size) ? read_chunk_done : 0);
+#else
+    (void)chunk_size;
+
+    IRQS_OFF
+    SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_byte_size, rx_buffer, rx_byte_size);
+    IRQS_ON
+#endif
+}
+
+/*******************************************************************************
+ * Read size_in_bytes bytes from address with one read command, streamed
+ * through rx_buffer chunk_size bytes at a time if chunk_size is not 0. In XIP
+ * mode the device is ready for the address straight away.
+ */
+static spi_flash_status_t read_data
+(
+    uint32_t address,
+    uint8_t * rx_buffer,
+    uint32_t size_in_bytes,
+    uint32_t chunk_size
+)
+{
+    spi_flash_status_t return_val = SPI_FLASH_SUCCESS;
+    uint8_t cmd_buffer[FLASH_MAX_CMD_BYTES];
+    int32_t cmd_len;
+    int32_t skip; /* Opcode bytes not sent */
+
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+    SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+    MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+    
+    skip = XIP_ACTIVE;
+    if(0 == skip)
+    {
+        BG_ERASE_SUSPEND
+        if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+        {
+            return_val = SPI_FLASH_TIMEOUT;
+        }
+        else
+        {
+            return_val = spi_flash_4_byte_addr(ENABLE_4_BYTE_ADDR);
+        }
+    }
+
+    if(SPI_FLASH_SUCCESS == return_val)
+    {
+        cmd_len = read_cmd(cmd_buffer, address);
+        read_cmd_data(&cmd_buffer[skip], (uint16_t)(cmd_len - skip), rx_buffer, size_in_bytes, chunk_size);
+        return_val = spi_flash_4_byte_addr(DISABLE_4_BYTE_ADDR);
+    }
+    BG_ERASE_RESUME
+
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+    SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+    MSS_SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+    return(return_val);
+}
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t
+spi_flash_read
+(
+    uint32_t address,
+    uint8_t * rx_buffer,
+    size_t size_in_bytes
+)
+{
+    return(read_data(address, rx_buffer, (uint32_t)size_in_bytes, 0u));
+}
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t
+spi_flash_read_long
+(
+    uint32_t address,
+    uint8_t * rx_buffer,
+    uint32_t size_in_bytes,
+    uint32_t chunk_size,
+    spi_flash_chunk_handler_t chunk_handler,
+    void * context
+)
+{
+    spi_flash_status_t return_val = SPI_FLASH_SUCCESS;
+#if SF2BL_SPI_PORT != SF2BL_CORE_SPI
+    uint32_t pos;
+    uint32_t len;
+#endif
+
+    if(0 == chunk_handler)
+    {
+        return_val = read_data(address, rx_buffer, size_in_bytes, 0u);
+    }
+    else if(0u == chunk_size)
+    {
+        return_val = SPI_FLASH_INVALID_ARGUMENTS;
+    }
+    else
+    {
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+        g_chunk_handler = chunk_handler;
+        g_chunk_context = context;
+        return_val = read_data(address, rx_buffer, size_in_bytes, chunk_size);
+#else
+        for(pos = 0; (SPI_FLASH_SUCCESS == return_val) && (pos < size_in_bytes); pos += len)
+        {
+            len = ((size_in_bytes - pos) < chunk_size) ? (size_in_bytes - pos) : chunk_size;
+            return_val = read_data(address + pos, rx_buffer, len, 0u);
+            if(SPI_FLASH_SUCCESS == return_val)
+            {
+                chunk_handler(rx_buffer, len, context);
+            }
+        }
+#endif
+    }
+
+    return(return_val);
+}
+
+#if defined(SF2BL_SPI_ASYNC) && (SF2BL_SPI_PORT == SF2BL_CORE_SPI)
+/*
+ * Command and size of the read started by spi_flash_read_start(). The command
+ * buffer must stay put until the transfer completes.
+ */
+static uint8_t  g_async_cmd[FLASH_MAX_CMD_BYTES];
+static uint32_t g_async_size = 0;
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t
+spi_flash_read_start
+(
+    uint32_t address,
+    uint8_t * rx_buffer,
+    size_t size_in_bytes
+)
+{
+    spi_flash_status_t return_val = SPI_FLASH_SUCCESS;
+    int32_t cmd_len;
+    int32_t skip; /* Opcode bytes not sent */
+#ifdef SF2BL_FLASH_USE_DMA
+    spi_segment_t segments[2];
+#endif
+
+    SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+
+    skip = XIP_ACTIVE;
+    if(0 == skip)
+    {
+        BG_ERASE_SUSPEND
+        if((0 != wait_ready(FLASH_TIMEOUT_MISC)) ||
+           (SPI_FLASH_SUCCESS != spi_flash_4_byte_addr(ENABLE_4_BYTE_ADDR)))
+        {
+            return_val = SPI_FLASH_TIMEOUT;
+            BG_ERASE_RESUME
+            SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
+        }
+    }
+
+    if(SPI_FLASH_SUCCESS == return_val)
+    {
+        cmd_len = read_cmd(g_async_cmd, address) - skip;
+        g_async_size = (uint32_t)size_in_bytes;
+
+        g_spi_flash_transactions++;
+        g_spi_flash_bytes += (uint32_t)cmd_len + (uint32_t)size_in_bytes;
+#ifdef SF2BL_FLASH_USE_DMA
+        segments[0].buffer    = &g_async_cmd[skip];
+        segments[0].length    = (uint32_t)cmd_len;
+        segments[0].direction = SPI_SEG_TX;
+        segments[1].buffer    = rx_buffer;
+        segments[1].length    = (uint32_t)size_in_bytes;
+        segments[1].direction = SPI_SEG_RX;
+        spi_flash_dma_start(segments, 2u, 1u, 1u);
+#else
+        SPI_transfer_block_async(SPI_INSTANCE, &g_async_cmd[skip], (uint16_t)cmd_len,
+                                 rx_buffer, (uint16_t)size_in_bytes, 0);
+#endif
+    }
+
+    return(return_val);
+}
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+int32_t spi_flash_read_busy(void)
+{
+#ifdef SF2BL_FLASH_USE_DMA
+    return(flash_dma_busy());
+#else
+    return((int32_t)SPI_transfer_busy(SPI_INSTANCE));
+#endif
+}
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t spi_flash_read_wait(void)
+{
+    spi_flash_status_t return_val = SPI_FLASH_SUCCESS;
+    uint32_t start_time;
+    uint32_t timeout;
+
+    start_time = g_10ms_count;
+    timeout = FLASH_TIMEOUT_MISC + (g_async_size / 1024u);
+    while((0 != spi_flash_read_busy()) && ((g_10ms_count - start_time) < timeout))
+    {
+        ;
+    }
+
+    if(0 != spi_flash_read_busy())
+    {
+#ifndef SF2BL_FLASH_USE_DMA
+        SPI_transfer_abort(SPI_INSTANCE);
+#endif
+        return_val = SPI_FLASH_TIMEOUT;
+    }
+    else
+    {
+        return_val = spi_flash_4_byte_addr(DISABLE_4_BYTE_ADDR);
+    }
+    BG_ERASE_RESUME
+
+    SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
+    return(return_val);
+}
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+void spi_flash_isr(void)
+{
+    SPI_isr(SPI_INSTANCE);
+}
+#endif
+
+
+/*******************************************************************************
+ * This function sends the command and data on SPI
+ */
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+static void write_cmd_data
+(
+    spi_instance_t * this_spi,
+    const uint8_t * cmd_buffer,
+    uint16_t cmd_byte_size,
+    uint8_t * data_buffer,
+    uint16_t data_byte_size
+)
+{
+    spi_segment_t segments[2];
+
+    (void)this_spi;
+
+    segments[0].buffer    = (uint8_t *)cmd_buffer;
+    segments[0].length    = cmd_byte_size;
+    segments[0].direction = SPI_SEG_TX;
+    segments[1].buffer    = data_buffer;
+    segments[1].length    = data_byte_size;
+    segments[1].direction = SPI_SEG_TX;
+    spi_flash_transfer_segments(segments, 2u, 0u, 0);
+}
+#elif defined(SF2BL_FLASH_USE_DMA)
+static void write_cmd_data
+(
+    mss_spi_instance_t * this_spi,
+    const uint8_t * cmd_buffer,
+    uint16_t cmd_byte_size,
+    uint8_t * data_buffer,
+    uint16_t data_byte_size
+)
+{
+    uint32_t transfer_size;
+
+    transfer_size = cmd_byte_size + data_byte_size;
+
+    MSS_SPI_disable(this_spi);
+    MSS_SPI_set_transfer_byte_count(this_spi, transfer_size);
+
+    PDMA_start
+        (
+            SF2BL_FLASH_TX_DMA_CHAN,  /* channel_id */
+            (uint32_t)cmd_buffer,   /* src_addr */
+            SPI_DEST_TXBUFF,             /* dest_addr */
+            cmd_byte_size           /* transfer_count */
+        );
+
+    PDMA_load_next_buffer
+        (
+            SF2BL_FLASH_TX_DMA_CHAN,  /* channel_id */
+            (uint32_t)data_buffer,  /* src_addr */
+            SPI_DEST_TXBUFF,             /* dest_addr */
+            data_byte_size          /* transfer_count */
+        );
+    MSS_SPI_enable(this_spi);
+    while(!MSS_SPI_tx_done(this_spi))
+    {
+        ;
+    }
+}
+#endif
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t
+spi_flash_erase
+(
+    uint32_t address,
+    uint32_t size_in_bytes
+)
+{
+    spi_flash_status_t return_val;
+
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+    SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+    MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+
+    XIP_EXIT
+    BG_ERASE_FINISH
+    return_val = erase_range(address, size_in_bytes);
+
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+    SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+    MSS_SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+
+    return(return_val);
+}
+
+#if defined(SF2BL_FLASH_BG_ERASE)
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t
+spi_flash_erase_start
+(
+    uint32_t address,
+    uint32_t size_in_bytes
+)
+{
+    spi_flash_status_t return_val;
+    uint32_t end;
+
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+    SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+    MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+
+    XIP_EXIT
+    end     = (address + size_in_bytes + (NB_BYTES_PER_SECTOR - 1)) & BLOCK_ALIGN_MASK_4K;
+    address = address & BLOCK_ALIGN_MASK_4K;
+    if((4u == g_flash_dev.addr_bytes) && (0 == g_4_byte_addr_enabled) &&
+       (0u == (g_flash_dev.flags & SPI_FLASH_DEV_4_BYTE_OPCODES)))
+    {
+        /* Reads cannot change the address mode under a suspended erase */
+        return_val = erase_range(address, end - address);
+    }
+    else
+    {
+        if((address < g_bg_erase.base) || (address > g_bg_erase.end) ||
+           (SPI_FLASH_SUCCESS != g_bg_erase.status))
+        {
+            (void)bg_erase_finish();
+            g_bg_erase.base   = address;
+            g_bg_erase.next   = address;
+            g_bg_erase.end    = address;
+            g_bg_erase.status = SPI_FLASH_SUCCESS;
+        }
+
+        if(end > g_bg_erase.end)
+        {
+            g_bg_erase.end = end;
+        }
+
+        return_val = bg_erase_service();
+        if(SPI_FLASH_BUSY == return_val)
+        {
+            return_val = SPI_FLASH_SUCCESS;
+        }
+    }
+
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+    SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+    MSS_SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+
+    return(return_val);
+}
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+spi_flash_status_t spi_flash_erase_poll(void)
+{
+    spi_flash_status_t return_val;
+
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+    SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+    MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+
+    XIP_EXIT
+    return_val = bg_erase_service();
 
 #if SF2BL_SPI_PORT == SF2BL_CORE_SPI
     SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
@@ -1068,144 +2347,132 @@ spi_flash_control_hw
     return(return_val);
 }
 
-
 /******************************************************************************
  *For more details please refer the spi_flash.h file
  ******************************************************************************/
-spi_flash_status_t
-spi_flash_read
-(
-    uint32_t address,
-    uint8_t * rx_buffer,
-    size_t size_in_bytes
-)
+spi_flash_status_t spi_flash_erase_wait(void)
 {
-    spi_flash_status_t return_val = SPI_FLASH_SUCCESS;
-    uint8_t cmd_buffer[FLASH_MAX_CMD_BYTES];
-    int32_t cmd_len;
+    spi_flash_status_t return_val;
 
 #if SF2BL_SPI_PORT == SF2BL_CORE_SPI
     SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
 #else
     MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
 #endif
-    
-    if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-    {
-        return_val = SPI_FLASH_TIMEOUT;
-    }
-    else
-    {
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-		return_val = spi_flash_4_byte_addr(ENABLE_4_BYTE_ADDR);
-		if(SPI_FLASH_SUCCESS == return_val)
-		{
-			cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, READ_ARRAY_OPCODE, address);
-			cmd_buffer[cmd_len] = DONT_CARE;
-
-			IRQS_OFF
-			SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len + 1, rx_buffer, size_in_bytes);
-			IRQS_ON
-		}
-		if(SPI_FLASH_SUCCESS == return_val)
-		{
-			return_val = spi_flash_4_byte_addr(DISABLE_4_BYTE_ADDR);
-		}
-#else
-		cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, READ_ARRAY_OPCODE, address);
-		cmd_buffer[cmd_len] = DONT_CARE;
 
-		IRQS_OFF
-		SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len + 1, rx_buffer, size_in_bytes);
-		IRQS_ON
-#endif
-    }
+    XIP_EXIT
+    return_val = bg_erase_finish();
 
 #if SF2BL_SPI_PORT == SF2BL_CORE_SPI
     SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
 #else
     MSS_SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
 #endif
+
     return(return_val);
 }
-
+#endif
 
 /*******************************************************************************
- * This function sends the command and data on SPI
+ * This function returns non zero if all len bytes of data are 0xFF.
  */
-#ifdef SF2BL_FLASH_USE_DMA
-static void write_cmd_data
-(
-    mss_spi_instance_t * this_spi,
-    const uint8_t * cmd_buffer,
-    uint16_t cmd_byte_size,
-    uint8_t * data_buffer,
-    uint16_t data_byte_size
-)
+static int32_t data_blank(const uint8_t * data, uint32_t len)
 {
-    uint32_t transfer_size;
-
-    transfer_size = cmd_byte_size + data_byte_size;
-
-    MSS_SPI_disable(this_spi);
-    MSS_SPI_set_transfer_byte_count(this_spi, transfer_size);
-
-    PDMA_start
-        (
-            SF2BL_FLASH_TX_DMA_CHAN,  /* channel_id */
-            (uint32_t)cmd_buffer,   /* src_addr */
-            SPI_DEST_TXBUFF,             /* dest_addr */
-            cmd_byte_size           /* transfer_count */
-        );
+    uint32_t index = 0u;
 
-    PDMA_load_next_buffer
-        (
-            SF2BL_FLASH_TX_DMA_CHAN,  /* channel_id */
-            (uint32_t)data_buffer,  /* src_addr */
-            SPI_DEST_TXBUFF,             /* dest_addr */
-            data_byte_size          /* transfer_count */
-        );
-    MSS_SPI_enable(this_spi);
-    while(!MSS_SPI_tx_done(this_spi))
+    while((index < len) && (0xFFu == data[index]))
     {
-        ;
+        index++;
     }
+
+    return(index == len);
 }
-#else
-static void write_cmd_data
-(
-    spi_instance_t * this_spi,
-    const uint8_t * cmd_buffer,
-    uint16_t cmd_byte_size,
-    uint8_t * data_buffer,
-    uint16_t data_byte_size
-)
+
+#if defined(SF2BL_FLASH_WRITE_VERIFY)
+/*******************************************************************************
+ * This function reads back len bytes, up to a page, from address and compares
+ * them with data, noting the address if they differ. The FLASH is left
+ * selected and out of XIP mode for the rest of the write.
+ */
+static spi_flash_status_t verify_page(uint32_t address, const uint8_t * data, uint32_t len)
 {
-    uint8_t tx_buffer[512];
-    uint32_t tx_size;
-    uint32_t inc;
-    
-    if ((cmd_byte_size + data_byte_size) <= 512)
+    spi_flash_status_t return_val;
+
+    return_val = spi_flash_read(address, verify_buffer, len);
+    if(SPI_FLASH_SUCCESS == return_val)
     {
-        for(inc = 0; inc < cmd_byte_size; ++inc)
-        {
-            tx_buffer[inc] = cmd_buffer[inc];
-        }
-        
-        for(inc = 0; inc < data_byte_size; ++inc)
+        if(memcmp(verify_buffer, data, len))
         {
-            tx_buffer[cmd_byte_size + inc] = data_buffer[inc];
+            g_verify_address = address;
+            return_val = SPI_FLASH_VERIFY_FAIL;
         }
 
-        IRQS_OFF
-        SPI_TRANS_BLOCK(SPI_INSTANCE, tx_buffer, cmd_byte_size + data_byte_size, 0, 0);
-        IRQS_ON
+        /* We need to do this as spi_flash_read() clears it */
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+        SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+        MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+        /* And the read may have left the device in XIP mode */
+        XIP_EXIT
     }
-    else
+
+    return(return_val);
+}
+
+#if defined(SF2BL_FLASH_VERIFY_CRC)
+/*******************************************************************************
+ * Chunk handler for verify_crc(), adds each chunk read back to the CRC32 in
+ * context.
+ */
+static void verify_chunk(uint8_t * chunk, uint32_t chunk_len, void * context)
+{
+    uint32_t *pcrc = (uint32_t *)context;
+
+    *pcrc = sf2bl_calc_crc32(*pcrc, chunk, chunk_len);
+}
+
+/*******************************************************************************
+ * This function streams len bytes back from address with one long read and
+ * checks their CRC32 against write_crc, the CRC32 of data. Only if that fails
+ * are the pages compared one at a time to find the first bad one. If they all
+ * match it was the read back which went wrong and the write is good.
+ */
+static spi_flash_status_t verify_crc(uint32_t address, const uint8_t * data, uint32_t len, uint32_t write_crc)
+{
+    spi_flash_status_t return_val;
+    uint32_t read_crc = 0xFFFFFFFF;
+    uint32_t pos;
+    uint32_t page_len;
+
+    return_val = spi_flash_read_long(address, verify_buffer, len, sizeof(verify_buffer), verify_chunk, &read_crc);
+    if(SPI_FLASH_SUCCESS == return_val)
     {
-        //<CJ>: replace with assertion once assertion tested.
-        _exit(12);
+#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
+        SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#else
+        MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
+#endif
+        XIP_EXIT
+
+        for(pos = 0; (SPI_FLASH_SUCCESS == return_val) && (read_crc != write_crc) && (pos < len); pos += page_len)
+        {
+            page_len = g_flash_dev.page_size - ((address + pos) & (g_flash_dev.page_size - 1));
+            page_len = ((len - pos) < page_len) ? (len - pos) : page_len;
+            return_val = verify_page(address + pos, &data[pos], page_len);
+        }
     }
+
+    return(return_val);
+}
+#endif
+
+/******************************************************************************
+ *For more details please refer the spi_flash.h file
+ ******************************************************************************/
+uint32_t spi_flash_verify_address(void)
+{
+    return(g_verify_address);
 }
 #endif
 
@@ -1227,17 +2494,19 @@ spi_flash_write
     uint32_t in_buffer_idx;
     uint32_t nb_bytes_to_write;
     uint32_t target_addr;
-    uint32_t current_sector;
     uint32_t size_left;
-
-    /* make sure current_sector is not the same as starting sector */
-    current_sector = (address + NB_BYTES_PER_SECTOR) & BLOCK_ALIGN_MASK_4K;
+    int32_t blank;
+#if defined(SF2BL_FLASH_VERIFY_CRC)
+    uint32_t write_crc = 0xFFFFFFFF;
+#endif
 
 #if SF2BL_SPI_PORT == SF2BL_CORE_SPI
     SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
 #else
     MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
 #endif
+    XIP_EXIT
+    BG_ERASE_FINISH
     if(0 != wait_ready(FLASH_TIMEOUT_MISC))
     {
         return_val = SPI_FLASH_TIMEOUT;
@@ -1247,164 +2516,83 @@ spi_flash_write
     nb_bytes_to_write = size_in_bytes;
     target_addr       = address;
 
+    /*
+     * Format all the sectors we are going to write to first, which lets
+     * whole 32K or 64K blocks be erased in one go.
+     */
+    if((SPI_FLASH_SUCCESS == return_val) && (0 != format) && (0u != size_in_bytes))
+    {
+        return_val = erase_range(address, (uint32_t)size_in_bytes);
+    }
+
     while((in_buffer_idx < size_in_bytes) && (SPI_FLASH_SUCCESS == return_val))
     {
-        /* See if we have moved to a new sector and need to format it */
-        if((current_sector != (target_addr & BLOCK_ALIGN_MASK_4K)) &&
-           (0 != format))
+        /*
+         * When writing to the FLASH device there are a number of rules we
+         * must enforce:
+         *
+         *  1. We cannot cross a page boundary which means we have to write
+         *     in chunks of no more than a page in length.
+         *
+         *  2. If we are not currently on a page boundary, we can only write
+         *     up to the end of the current page as otherwise we will wrap
+         *     around to the beginning of the page.
+         *
+         * To do this, we ensure we write the first data only up to the end
+         * of the current page, write in full page chunks after that and
+         * finally write a possibly less than full page last chunk.
+         */
+
+        /*
+         * If we are not on a page boundary this will set nb_bytes_to_write
+         * to the number of bytes required to get us to the end of the
+         * current page. Otherwise it will set nb_bytes_to_write to the page
+         * length
+         */
+        nb_bytes_to_write = g_flash_dev.page_size - (target_addr & (g_flash_dev.page_size - 1));
+
+        /* Truncate if actually less than nb_bytes_to_write left to go */
+        size_left = size_in_bytes - in_buffer_idx;
+        if(size_left < nb_bytes_to_write)
         {
-			/* Select block start by masking off non significant bits */
-			 current_sector = target_addr & BLOCK_ALIGN_MASK_4K;
-
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-			return_val = spi_flash_4_byte_addr(ENABLE_4_BYTE_ADDR);
-			if(SPI_FLASH_SUCCESS == return_val)
-			{
-				/* Send Write Enable command */
-				cmd_buffer[0] = WRITE_ENABLE_CMD;
-				IRQS_OFF
-				SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-				IRQS_ON
-
-				if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-				{
-					return_val = SPI_FLASH_TIMEOUT;
-				}
-				else
-				{
-					/* Send 4K Sector Erase command */
-					cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, ERASE_4K_BLOCK_OPCODE, current_sector);
-
-					IRQS_OFF
-					SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
-					IRQS_ON
-
-					if(0 != wait_ready(FLASH_TIMEOUT_ERASE_4K))
-					{
-						return_val = SPI_FLASH_TIMEOUT;
-					}
-				}
-			}
-
-			if(SPI_FLASH_SUCCESS == return_val)
-			{
-				return_val = spi_flash_4_byte_addr(DISABLE_4_BYTE_ADDR);
-			}
-#else
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_AT25DF641)
-			/* Send Write Enable command */
-			cmd_buffer[0] = WRITE_ENABLE_CMD;
-			IRQS_OFF
-			SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-			IRQS_ON
-
-			if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-			{
-				return_val = SPI_FLASH_TIMEOUT;
-			}
-			else
-			{
-				/* Send 4K Sector unprotect command */
-				cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, UNPROTECT_SECTOR_OPCODE, current_sector);
-
-				IRQS_OFF
-				SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
-				IRQS_ON
-
-				if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-				{
-					return_val = SPI_FLASH_TIMEOUT;
-				}
-			}
-
-			if(SPI_FLASH_SUCCESS == return_val)
-			{
-#endif /* (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_AT25DF641) */
-			/* Send Write Enable command */
-			cmd_buffer[0] = WRITE_ENABLE_CMD;
-			IRQS_OFF
-			SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, 1, 0, 0);
-			IRQS_ON
-
-			if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-			{
-				return_val = SPI_FLASH_TIMEOUT;
-			}
-			else
-			{
-				/* Send 4K Sector Erase command */
-				cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, ERASE_4K_BLOCK_OPCODE, current_sector);
-
-				IRQS_OFF
-				SPI_TRANS_BLOCK(SPI_INSTANCE, cmd_buffer, cmd_len, 0, 0);
-				IRQS_ON
-
-				if(0 != wait_ready(FLASH_TIMEOUT_ERASE_4K))
-				{
-					return_val = SPI_FLASH_TIMEOUT;
-				}
-			}
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_AT25DF641)
-			}
-#endif
-#endif
+            nb_bytes_to_write = size_left;
         }
 
-        if(SPI_FLASH_SUCCESS == return_val)
+        /*
+         * Programming can only clear bits so a page of 0xFF leaves the FLASH
+         * as it is and does not need to be sent. It is still verified below
+         * in case the FLASH was not blank.
+         */
+        blank = data_blank(&write_buffer[in_buffer_idx], nb_bytes_to_write);
+        if(0 == blank)
         {
-            /*
-             * When writing to the FLASH device there are a number of rules we
-             * must enforce:
-             *
-             *  1. We cannot cross a page boundary which means we have to write
-             *     in chunks of no more than a page in length.
-             *
-             *  2. If we are not currently on a page boundary, we can only write
-             *     up to the end of the current page as otherwise we will wrap
-             *     around to the beginning of the page.
-             *
-             * To do this, we ensure we write the first data only up to the end
-             * of the current page, write in full page chunks after that and
-             * finally write a possibly less than full page last chunk.
-             */
-
-            /*
-             * If we are not on a page boundary this will set nb_bytes_to_write
-             * to the number of bytes required to get us to the end of the
-             * current page. Otherwise it will set nb_bytes_to_write to the page
-             * length
-             */
-            nb_bytes_to_write = NB_BYTES_PER_PAGE - (target_addr & (NB_BYTES_PER_PAGE - 1));
-
-            /* Truncate if actually less than nb_bytes_to_write left to go */
-            size_left = size_in_bytes - in_buffer_idx;
-            if(size_left < nb_bytes_to_write)
+            return_val = spi_flash_4_byte_addr(ENABLE_4_BYTE_ADDR);
+            if(SPI_FLASH_SUCCESS == return_val)
             {
-                nb_bytes_to_write = size_left;
+                /*
+                 * Send Write Enable command. This only sets a latch so the
+                 * device is ready for the program command straight away.
+                 */
+                cmd_buffer[0] = WRITE_ENABLE_CMD;
+                IRQS_OFF
+                SPI_TRANS_BLOCK( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
+                IRQS_ON
             }
+        }
 
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-			return_val = spi_flash_4_byte_addr(ENABLE_4_BYTE_ADDR);
-			if(SPI_FLASH_SUCCESS == return_val)
-			{
-				/* Send Write Enable command */
-				cmd_buffer[0] = WRITE_ENABLE_CMD;
-				IRQS_OFF
-				SPI_TRANS_BLOCK( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
-				IRQS_ON
-
-				if(0 != wait_ready(FLASH_TIMEOUT_MISC))
-				{
-					return_val = SPI_FLASH_TIMEOUT;
-				}
-			}
-            if(SPI_FLASH_SUCCESS == return_val)
+        if(SPI_FLASH_SUCCESS == return_val)
+        {
+            if(0 == blank)
             {
-             	cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, PROGRAM_PAGE_CMD, target_addr);
+                cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, PROGRAM_PAGE_CMD, target_addr);
 
                 write_cmd_data(SPI_INSTANCE, cmd_buffer, cmd_len,
                                &write_buffer[in_buffer_idx],
                                nb_bytes_to_write);
+#if defined(SF2BL_FLASH_VERIFY_CRC)
+                /* The FLASH is busy programming for a while so do this now */
+                write_crc = sf2bl_calc_crc32(write_crc, &write_buffer[in_buffer_idx], nb_bytes_to_write);
+#endif
 
                 if(0 != wait_ready(FLASH_TIMEOUT_WR_PAGE))
                 {
@@ -1412,84 +2600,35 @@ spi_flash_write
                 }
                 else
                 {
-        			return_val = spi_flash_4_byte_addr(DISABLE_4_BYTE_ADDR);
-                }
-#if defined(SF2BL_FLASH_WRITE_VERIFY)
-                if(SPI_FLASH_SUCCESS == return_val)
-                {
-                    /* Read back what we just wrote and see if it is the same */
-                    return_val = spi_flash_read(target_addr, verify_buffer, nb_bytes_to_write);
-                    if(SPI_FLASH_SUCCESS == return_val)
-                    {
-                        if(memcmp(verify_buffer, &write_buffer[in_buffer_idx], nb_bytes_to_write))
-                        {
-                            return_val = SPI_FLASH_VERIFY_FAIL;
-                        }
-
-                        /* We need to do this as spi_flash_read() clears it */
-#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
-                        SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
-#else
-                        MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
-#endif
-                    }
+                    return_val = spi_flash_4_byte_addr(DISABLE_4_BYTE_ADDR);
                 }
-#endif
-                target_addr   += nb_bytes_to_write;
-                in_buffer_idx += nb_bytes_to_write;
             }
-#else
-            /* Send Write Enable command */
-            cmd_buffer[0] = WRITE_ENABLE_CMD;
-            IRQS_OFF
-            SPI_TRANS_BLOCK( SPI_INSTANCE, cmd_buffer, 1, 0, 0 );
-            IRQS_ON
-
-            if(0 != wait_ready(FLASH_TIMEOUT_MISC))
+#if defined(SF2BL_FLASH_VERIFY_CRC)
+            else
             {
-                return_val = SPI_FLASH_TIMEOUT;
+                write_crc = sf2bl_calc_crc32(write_crc, &write_buffer[in_buffer_idx], nb_bytes_to_write);
             }
-
+#endif
+#if defined(SF2BL_FLASH_WRITE_VERIFY) && !defined(SF2BL_FLASH_VERIFY_CRC)
             if(SPI_FLASH_SUCCESS == return_val)
             {
-             	cmd_len = spi_flash_insert_cmd_addr(cmd_buffer, PROGRAM_PAGE_CMD, target_addr);
-
-                write_cmd_data(SPI_INSTANCE, cmd_buffer, cmd_len,
-                               &write_buffer[in_buffer_idx],
-                               nb_bytes_to_write);
-
-                if(0 != wait_ready(FLASH_TIMEOUT_WR_PAGE))
-                {
-                    return_val = SPI_FLASH_TIMEOUT;
-                }
-#if defined(SF2BL_FLASH_WRITE_VERIFY)
-                else
-                {
-                    /* Read back what we just wrote and see if it is the same */
-                    return_val = spi_flash_read(target_addr, verify_buffer, nb_bytes_to_write);
-                    if(SPI_FLASH_SUCCESS == return_val)
-                    {
-                        if(memcmp(verify_buffer, &write_buffer[in_buffer_idx], nb_bytes_to_write))
-                        {
-                            return_val = SPI_FLASH_VERIFY_FAIL;
-                        }
-
-                    /* We need to do this as spi_flash_read() clears it */
-#if SF2BL_SPI_PORT == SF2BL_CORE_SPI
-                    SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
-#else
-                    MSS_SPI_set_slave_select(SPI_INSTANCE, SPI_SLAVE);
-#endif
-                    }
-                }
-#endif
-                target_addr   += nb_bytes_to_write;
-                in_buffer_idx += nb_bytes_to_write;
+                /* Read back what we just wrote and see if it is the same */
+                return_val = verify_page(target_addr, &write_buffer[in_buffer_idx], nb_bytes_to_write);
             }
 #endif
+            target_addr   += nb_bytes_to_write;
+            in_buffer_idx += nb_bytes_to_write;
         }
     }
 
+#if defined(SF2BL_FLASH_VERIFY_CRC)
+    if((SPI_FLASH_SUCCESS == return_val) && (0u != size_in_bytes))
+    {
+        /* Read back everything we just wrote in one go */
+        return_val = verify_crc(address, write_buffer, (uint32_t)size_in_bytes, write_crc);
+    }
+#endif
+
 #if SF2BL_SPI_PORT == SF2BL_CORE_SPI
     SPI_clear_slave_select(SPI_INSTANCE, SPI_SLAVE);
 #else
@@ -1500,6 +2639,38 @@ spi_flash_write
 }
 
 
+/******************************************************************************
+ * This function reads the busy status once, from the flag status register on
+ * devices which have one.
+ *
+ * Returns 0 if the device is ready or READY_BIT_MASK if it is busy.
+ ******************************************************************************/
+static uint8_t read_busy(void)
+{
+    uint8_t command = READ_STATUS;
+    uint8_t status;
+    uint8_t ready_bit;
+
+    g_spi_flash_polls++;
+    if(0u != (g_flash_dev.flags & SPI_FLASH_DEV_FLAG_STATUS))
+    {
+        command = READ_FLAG_STATUS_REG;
+        IRQS_OFF
+        SPI_TRANS_BLOCK(SPI_INSTANCE, &command, 1, &status, 1);
+        IRQS_ON
+        ready_bit = (0u != (status & FSR_WRITE_BUSY)) ? 0u : READY_BIT_MASK;
+    }
+    else
+    {
+        IRQS_OFF
+        SPI_TRANS_BLOCK(SPI_INSTANCE, &command, 1, &status, 1);
+        IRQS_ON
+        ready_bit = status & READY_BIT_MASK;
+    }
+
+    return(ready_bit);
+}
+
 /******************************************************************************
  * This function waits for the FLASH operation to complete.
  *
@@ -1509,50 +2680,30 @@ spi_flash_write
 static uint8_t wait_ready(uint32_t timeout)
 {
     uint8_t ready_bit;
-    volatile int error = 0;
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-    uint8_t command = READ_FLAG_STATUS_REG;
-#else
-    uint8_t command = READ_STATUS;
-#endif
+    uint8_t command;
     uint32_t start_time;
 
     start_time = g_10ms_count; /* Record when it all began */
 
     do {
-        IRQS_OFF
-        SPI_TRANS_BLOCK(SPI_INSTANCE, &command, 1, &ready_bit, 1);
-        IRQS_ON
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-        ready_bit &= FSR_WRITE_BUSY;
-    } while((0 == ready_bit) && ((g_10ms_count - start_time) < timeout));
-#else
-        ready_bit &= READY_BIT_MASK;
-        error++;
+        ready_bit = read_busy();
     } while((0 != ready_bit) && ((g_10ms_count - start_time) < timeout));
-#endif
 
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-    command = CLEAR_FLAG_STATUS_REG;
-    IRQS_OFF
-    SPI_TRANS_BLOCK(SPI_INSTANCE, &command, 1, 0, 0);
-    IRQS_ON
+    if(0u != (g_flash_dev.flags & SPI_FLASH_DEV_FLAG_STATUS))
+    {
+        command = CLEAR_FLAG_STATUS_REG;
+        IRQS_OFF
+        SPI_TRANS_BLOCK(SPI_INSTANCE, &command, 1, 0, 0);
+        IRQS_ON
+    }
 
-    if(0 == ready_bit)
-    	error++;
-    return (!ready_bit);
-#else
-    if(0 != ready_bit)
-    	error++;
     return (ready_bit);
-#endif
 }
 
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
 /******************************************************************************
  * This function implements the preamble/postamble for 4 byte addressing with
- * the N25Q00AA SPI FLASH. If 4 byte addressing is enabled in the non volatile
- * configuration it does nothing.
+ * devices over 16MB which do not have the 4 byte address opcodes. If 4 byte
+ * addressing is enabled in the non volatile configuration it does nothing.
  *
  * Passing enable == 0 disables 4 byte addressing. Any other value enables 4
  * byte addressing.
@@ -1564,7 +2715,8 @@ static spi_flash_status_t spi_flash_4_byte_addr(int32_t enable)
     spi_flash_status_t return_val = SPI_FLASH_SUCCESS;
     uint8_t cmd_buffer;
 
-    if(0 == g_4_byte_addr_enabled)
+    if((4u == g_flash_dev.addr_bytes) && (0 == g_4_byte_addr_enabled) &&
+       (0u == (g_flash_dev.flags & SPI_FLASH_DEV_4_BYTE_OPCODES)))
     {
         /* Check for completion of any prior command */
         if(0 != wait_ready(FLASH_TIMEOUT_MISC + 2000))
@@ -1600,30 +2752,58 @@ static spi_flash_status_t spi_flash_4_byte_addr(int32_t enable)
 
     return(return_val);
 }
-#endif
 
 /******************************************************************************
  * This function inserts the command byte and address field for an SPI FLASH
  * command at the location specified by dest. The address  field will be either
- * 3 or 4 bytes long depending on the FLASH device.
+ * 3 or 4 bytes long depending on the FLASH device. Where the device has them
+ * the 4 byte address forms of the commands are used for 4 byte addresses so
+ * the address mode does not have to be changed.
  *
  * Returns the number of bytes inserted.
  ******************************************************************************/
 
 static int32_t spi_flash_insert_cmd_addr(uint8_t *dest, uint32_t command, uint32_t target_addr)
 {
-    *dest++ = (uint8_t)command;
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-    *dest++ = (uint8_t)(target_addr >> 24);
-#endif
-    *dest++ = (uint8_t)(target_addr >> 16);
-    *dest++ = (uint8_t)(target_addr >> 8);
-    *dest++ = (uint8_t)target_addr;
+    uint32_t index;
+    int32_t return_val = 4;
 
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_N25Q00AA13GSF40G)
-    return(5);
-#else
-    return(4);
-#endif
+    if(4u == g_flash_dev.addr_bytes)
+    {
+        if(0u != (g_flash_dev.flags & SPI_FLASH_DEV_4_BYTE_OPCODES))
+        {
+            if(READ_SLOW_OPCODE == command)
+            {
+                command = READ_4_BYTE_OPCODE;
+            }
+            else if(READ_ARRAY_OPCODE == command)
+            {
+                command = FAST_READ_4_BYTE_CMD;
+            }
+            else if(PROGRAM_PAGE_CMD == command)
+            {
+                command = PROGRAM_PAGE_4_BYTE_CMD;
+            }
+            else
+            {
+                for(index = 0; index < SPI_FLASH_ERASE_TYPES; index++)
+                {
+                    if((command == g_flash_dev.erase[index].opcode) && (0u != g_flash_dev.erase[index].opcode_4b))
+                    {
+                        command = g_flash_dev.erase[index].opcode_4b;
+                    }
+                }
+            }
+        }
 
+        dest[1]    = (uint8_t)(target_addr >> 24);
+        return_val = 5;
+    }
+
+    dest[0] = (uint8_t)command;
+    dest[return_val - 3] = (uint8_t)(target_addr >> 16);
+    dest[return_val - 2] = (uint8_t)(target_addr >> 8);
+    dest[return_val - 1] = (uint8_t)target_addr;
+
+    return(return_val);
 }
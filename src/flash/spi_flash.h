@@ -55,7 +55,8 @@ typedef enum {
     SPI_FLASH_INVALID_ADDRESS,
     SPI_FLASH_TIMEOUT,
     SPI_FLASH_VERIFY_FAIL,
-    SPI_FLASH_UNSUCCESS
+    SPI_FLASH_UNSUCCESS,
+    SPI_FLASH_BUSY          /* Background erase still in progress */
 } spi_flash_status_t;
 
 /*******************************************************************************
@@ -76,18 +77,88 @@ typedef enum {
     SPI_FLASH_WRITE_NV_CFG,
     SPI_FLASH_READ_V_CFG,
     SPI_FLASH_WRITE_V_CFG,
-    SPI_FLASH_RESET
+    SPI_FLASH_RESET,
+    SPI_FLASH_SET_READ_MODE,
+    SPI_FLASH_ERASE_SUSPEND,
+    SPI_FLASH_ERASE_RESUME
 /*
     SPI_FLASH_SECTOR_LOCKDOWN,
     SPI_FLASH_FREEZE_SECTOR_LOCKDOWN
 */
 } spi_flash_control_hw_t;
 
+/*******************************************************************************
+ * Read commands used by spi_flash_read(), see SPI_FLASH_SET_READ_MODE.
+ ******************************************************************************/
+typedef enum {
+    SPI_FLASH_READ_FAST = 0, /* FAST READ with 8 dummy clocks, the default */
+    SPI_FLASH_READ_NORMAL,   /* READ, no dummy clocks but a lower clock limit */
+    SPI_FLASH_READ_XIP,      /* FAST READ in XIP mode, address and dummy only */
+    SPI_FLASH_READ_MODES
+} spi_flash_read_mode_t;
+
 typedef struct spi_dev_Info{
     uint8_t manufacturer_id;
     uint8_t device_id;
+    uint8_t capacity;
 } spi_dev_info_t;
 
+/*******************************************************************************
+ * Runtime description of the FLASH device, see spi_flash_get_device().
+ *
+ * spi_flash_init() reads the JEDEC ID and takes the matching entry from the
+ * driver's table of known devices, or the SF2BL_FLASH_DEVICE entry if the ID is
+ * not recognised. With SF2BL_FLASH_SFDP the entry is then updated from the
+ * device's SFDP tables, if it has them.
+ ******************************************************************************/
+#define SPI_FLASH_DEV_4_BYTE_OPCODES 0x0001u /* 4 byte address opcodes, no mode change */
+#define SPI_FLASH_DEV_4_BYTE_MODE    0x0002u /* EN4B/EX4B needed for 4 byte addresses */
+#define SPI_FLASH_DEV_FLAG_STATUS    0x0004u /* Busy polled in flag status register */
+#define SPI_FLASH_DEV_MICRON_CFG     0x0008u /* Micron NV and V configuration registers */
+#define SPI_FLASH_DEV_SECTOR_PROTECT 0x0010u /* Sectors must be unprotected to erase */
+#define SPI_FLASH_DEV_SFDP           0x0020u /* Updated from SFDP tables */
+#define SPI_FLASH_DEV_READ_1_1_2     0x0100u /* Multi I/O fast reads, from SFDP */
+#define SPI_FLASH_DEV_READ_1_2_2     0x0200u
+#define SPI_FLASH_DEV_READ_1_1_4     0x0400u
+#define SPI_FLASH_DEV_READ_1_4_4     0x0800u
+
+typedef enum {
+    SPI_FLASH_ERASE_4K = 0,
+    SPI_FLASH_ERASE_32K,
+    SPI_FLASH_ERASE_64K,
+    SPI_FLASH_ERASE_TYPES
+} spi_flash_erase_type_t;
+
+typedef struct spi_flash_erase {
+    uint8_t  opcode;    /* 0 if the device has no erase of this size */
+    uint8_t  opcode_4b; /* 4 byte address form, 0 if none */
+    uint32_t timeout;   /* Maximum time, as other driver timeouts */
+} spi_flash_erase_t;
+
+typedef struct spi_flash_dev {
+    const char       *name;
+    uint8_t           jedec_id[3];     /* Manufacturer, memory type, capacity */
+    uint8_t           fast_read_dummy; /* Dummy clocks for FAST READ */
+    uint8_t           suspend_opcode;  /* Program/erase suspend, 0 if none */
+    uint8_t           resume_opcode;   /* Program/erase resume */
+    uint32_t          flags;           /* SPI_FLASH_DEV_xxx */
+    uint32_t          size;            /* Bytes */
+    uint32_t          page_size;       /* Bytes */
+    uint32_t          addr_bytes;      /* 3, or 4 for devices over 16MB */
+    uint32_t          timeout_page;
+    uint32_t          timeout_chip;
+    spi_flash_erase_t erase[SPI_FLASH_ERASE_TYPES];
+} spi_flash_dev_t;
+
+/*******************************************************************************
+ * Running counts of SPI transfers made to the FLASH device, bytes transferred
+ * and busy status polls. Transfers and bytes include the status polling. Never
+ * reset by the driver.
+ */
+extern uint32_t g_spi_flash_transactions;
+extern uint32_t g_spi_flash_bytes;
+extern uint32_t g_spi_flash_polls;
+
 /*******************************************************************************
  * This function initialises the SPI peripheral and PDMA for data transfer
  ******************************************************************************/
@@ -98,6 +169,11 @@ spi_flash_init
 );
 
 
+/*******************************************************************************
+ * Returns the description of the FLASH device found by spi_flash_init().
+ ******************************************************************************/
+const spi_flash_dev_t *spi_flash_get_device(void);
+
 /*******************************************************************************
  * This function shuts down the SPI peripheral and PDMA
  ******************************************************************************/
@@ -161,6 +237,13 @@ void spi_flash_deinit
  *           'ptrPeram' of this API which should point to an spi_dev_info_t
  *           structure.
  *
+ *           SPI_FLASH_SECTOR_PROTECT, SPI_FLASH_SECTOR_UNPROTECT and the
+ *           global versions are only supported by devices with
+ *           SPI_FLASH_DEV_SECTOR_PROTECT, the configuration register
+ *           commands by devices with SPI_FLASH_DEV_MICRON_CFG and the block
+ *           erases by devices with an erase of that size. Otherwise
+ *           SPI_FLASH_INVALID_ARGUMENTS is returned.
+ *
  *       11. SPI_FLASH_RESET: In some cases it may be necessary to prematurely
  *           terminate a program or erase cycle early rather than wait the
  *           hundreds of microseconds or milliseconds necessary for the program
@@ -168,6 +251,26 @@ void spi_flash_deinit
  *           The Reset command allows a program or erase operation in progress
  *           to be ended abruptly and returns the device to an idle state.
  *
+ *       12. SPI_FLASH_SET_READ_MODE: Selects the read command used by
+ *           spi_flash_read() from spi_flash_read_mode_t, passed in peram1.
+ *           No command is sent to the device except for SPI_FLASH_READ_XIP,
+ *           which is only supported with SF2BL_FLASH_XIP on devices with the
+ *           Micron configuration registers and sets or clears the XIP enable
+ *           in the volatile configuration register. In XIP mode the first read
+ *           leaves the device expecting the next address without an opcode and
+ *           the driver takes it back out of XIP mode before any other command.
+ *
+ *       13. SPI_FLASH_ERASE_SUSPEND: Suspends the background erase started by
+ *           spi_flash_erase_start(), if one is in progress, so other blocks can
+ *           be read. Returns once the device is ready.
+ *
+ *       14. SPI_FLASH_ERASE_RESUME: Resumes a background erase suspended by
+ *           SPI_FLASH_ERASE_SUSPEND.
+ *
+ *           The suspend and resume operations are only supported with
+ *           SF2BL_FLASH_BG_ERASE and every other operation first waits for
+ *           any background erase to complete.
+ *
  * @param peram1        The peram1 usage is explained in the above description
  *                      according to the command in use.
  * @param ptrPeram      The ptrPeram usage is explained in the above description
@@ -248,6 +351,110 @@ spi_flash_read
     size_t size_in_bytes
 );
 
+/*******************************************************************************
+ * Handler for the data read by spi_flash_read_long(), called with each chunk
+ * as it arrives and the context passed to spi_flash_read_long().
+ */
+typedef void (*spi_flash_chunk_handler_t)(uint8_t *chunk, uint32_t chunk_len, void *context);
+
+/*******************************************************************************
+ * Reads size_in_bytes bytes from address with a single read command, whatever
+ * the size. With a chunk_handler the data is streamed rather than stored:
+ * rx_buffer only has to hold chunk_size bytes and each chunk_size bytes read,
+ * or fewer for the last one, are passed to chunk_handler in it, the next chunk
+ * overwriting the previous one once the handler returns. Without a handler
+ * this is spi_flash_read() with a 32 bit size.
+ *
+ * With CoreSPI the FLASH stays selected and the read continues from one chunk
+ * to the next. With the MSS SPI each chunk is a separate read.
+ *
+ * Return values as for spi_flash_read(), SPI_FLASH_INVALID_ARGUMENTS if there
+ * is a chunk_handler and chunk_size is 0.
+ */
+spi_flash_status_t
+spi_flash_read_long
+(
+    uint32_t address,
+    uint8_t * rx_buffer,
+    uint32_t size_in_bytes,
+    uint32_t chunk_size,
+    spi_flash_chunk_handler_t chunk_handler,
+    void * context
+);
+
+/*******************************************************************************
+ * These functions split spi_flash_read() in two so the CPU can do something
+ * else while the data arrives. Only available with SF2BL_SPI_ASYNC and CoreSPI.
+ *
+ * spi_flash_read_start() waits for the FLASH to be ready and starts reading
+ * size_in_bytes bytes, up to 65535 less the command length, from address into
+ * rx_buffer. The transfer is then driven by the CoreSPI receive interrupt so
+ * spi_flash_isr() must be called from the interrupt handler for the CoreSPI
+ * interrupt.
+ *
+ * spi_flash_read_busy() returns non zero until the transfer is complete.
+ *
+ * spi_flash_read_wait() waits for the transfer to complete and must be called
+ * once for each successful spi_flash_read_start() before any other FLASH
+ * operation. SPI_FLASH_TIMEOUT is returned if the transfer is abandoned.
+ */
+spi_flash_status_t
+spi_flash_read_start
+(
+    uint32_t address,
+    uint8_t * rx_buffer,
+    size_t size_in_bytes
+);
+
+int32_t spi_flash_read_busy(void);
+spi_flash_status_t spi_flash_read_wait(void);
+void spi_flash_isr(void);
+
+/*******************************************************************************
+ * Erases the 4K sectors covering size_in_bytes bytes from address using the
+ * largest erase blocks the device has that fit, unprotecting each block first
+ * on devices with SPI_FLASH_DEV_SECTOR_PROTECT.
+ *
+ * Return values as for spi_flash_control_hw().
+ */
+spi_flash_status_t
+spi_flash_erase
+(
+    uint32_t address,
+    uint32_t size_in_bytes
+);
+
+/*******************************************************************************
+ * Background erase, only available with SF2BL_FLASH_BG_ERASE.
+ *
+ * spi_flash_erase_start() queues the 4K sectors covering size_in_bytes bytes
+ * from address for erasing and starts the first block erase without waiting
+ * for it. A range which starts inside or at the end of the one already queued
+ * extends it, any other range waits for the queued one to complete first.
+ *
+ * spi_flash_erase_poll() starts the next block erase each time the previous one
+ * completes and must be called regularly while the erase is in progress. It
+ * never waits for the device and returns SPI_FLASH_BUSY until the whole range
+ * is erased, then SPI_FLASH_SUCCESS or the error which stopped the erase.
+ *
+ * spi_flash_erase_wait() waits for the queued range to be erased.
+ *
+ * Reads made while a block erase is in progress suspend the erase, on devices
+ * with a suspend command, and resume it afterwards. They must not be from the
+ * block being erased. Any other operation waits for the whole range first.
+ * Devices which have to be switched into 4 byte address mode are erased
+ * before spi_flash_erase_start() returns.
+ */
+spi_flash_status_t
+spi_flash_erase_start
+(
+    uint32_t address,
+    uint32_t size_in_bytes
+);
+
+spi_flash_status_t spi_flash_erase_poll(void);
+spi_flash_status_t spi_flash_erase_wait(void);
+
 /*******************************************************************************
  * This function writes the content of the buffer passed as parameter to
  * Serial Flash through SPI. The data is written from the memory location specified
@@ -299,4 +506,12 @@ spi_flash_write
     uint32_t format
 );
 
+/*******************************************************************************
+ * With SF2BL_FLASH_WRITE_VERIFY, returns the address of the start of the data
+ * which did not match when spi_flash_write() last returned
+ * SPI_FLASH_VERIFY_FAIL. This is the start of the page written, or of the
+ * data if it did not start on a page boundary.
+ */
+uint32_t spi_flash_verify_address(void);
+
 #endif
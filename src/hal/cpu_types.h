@@ -10,8 +10,11 @@
 #include <stdint.h>
 
 /*------------------------------------------------------------------------------
+ * The host build uses the C library's size_t.
  */
+#if !defined(SF2BL_HOST)
 typedef unsigned int size_t;
+#endif
 
 /*------------------------------------------------------------------------------
  * addr_t: address type.
@@ -203,4 +203,6 @@ void HAL_restore_interrupts( psr_t saved_psr );
                 FIELD_SHIFT(FIELD_NAME),\
                 FIELD_MASK(FIELD_NAME)))
   
+#include "hal_inline.h"
+
 #endif /*HAL_H_*/
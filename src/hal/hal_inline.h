@@ -0,0 +1,103 @@
+/***************************************************************************//**
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * Header only register access.
+ *
+ * HAL_REG8(), HAL_REG16() and HAL_REG32() give a register as an lvalue so it
+ * can be read or written with a single load or store. They are always
+ * available for code such as polling loops which needs them.
+ *
+ * If HAL_INLINE_REG_ACCESS is defined the HAL_set/get_xxbit_reg() and
+ * HAL_set/get_xxbit_reg_field() macros from hal.h are replaced with versions
+ * using these, with the field masks and shifts from the peripheral's register
+ * header as compile time constants, instead of calls into hw_reg_access.c.
+ * Driver source is unchanged either way and the HW_xxx() functions remain
+ * available to anything which calls them directly.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+#ifndef HAL_INLINE_H_
+#define HAL_INLINE_H_
+
+#define HAL_REG32(BASE_ADDR, REG_NAME) \
+            (*((volatile uint32_t *)((BASE_ADDR) + (REG_NAME##_REG_OFFSET))))
+
+#define HAL_REG16(BASE_ADDR, REG_NAME) \
+            (*((volatile uint16_t *)((BASE_ADDR) + (REG_NAME##_REG_OFFSET))))
+
+#define HAL_REG8(BASE_ADDR, REG_NAME) \
+            (*((volatile uint8_t *)((BASE_ADDR) + (REG_NAME##_REG_OFFSET))))
+
+/*
+ * As above for the register containing a field.
+ */
+#define HAL_FIELD_REG32(BASE_ADDR, FIELD_NAME) \
+            (*((volatile uint32_t *)((BASE_ADDR) + FIELD_OFFSET(FIELD_NAME))))
+
+#define HAL_FIELD_REG16(BASE_ADDR, FIELD_NAME) \
+            (*((volatile uint16_t *)((BASE_ADDR) + FIELD_OFFSET(FIELD_NAME))))
+
+#define HAL_FIELD_REG8(BASE_ADDR, FIELD_NAME) \
+            (*((volatile uint8_t *)((BASE_ADDR) + FIELD_OFFSET(FIELD_NAME))))
+
+#if defined(HAL_INLINE_REG_ACCESS)
+
+#undef HAL_set_32bit_reg
+#undef HAL_get_32bit_reg
+#undef HAL_set_32bit_reg_field
+#undef HAL_get_32bit_reg_field
+#undef HAL_set_16bit_reg
+#undef HAL_get_16bit_reg
+#undef HAL_set_16bit_reg_field
+#undef HAL_get_16bit_reg_field
+#undef HAL_set_8bit_reg
+#undef HAL_get_8bit_reg
+#undef HAL_set_8bit_reg_field
+#undef HAL_get_8bit_reg_field
+
+#define HAL_set_32bit_reg(BASE_ADDR, REG_NAME, VALUE) \
+            ((void)(HAL_REG32(BASE_ADDR, REG_NAME) = (uint32_t)(VALUE)))
+
+#define HAL_get_32bit_reg(BASE_ADDR, REG_NAME) \
+            ((uint32_t)HAL_REG32(BASE_ADDR, REG_NAME))
+
+#define HAL_set_32bit_reg_field(BASE_ADDR, FIELD_NAME, VALUE) \
+            ((void)(HAL_FIELD_REG32(BASE_ADDR, FIELD_NAME) = \
+                (uint32_t)((HAL_FIELD_REG32(BASE_ADDR, FIELD_NAME) & ~(uint32_t)FIELD_MASK(FIELD_NAME)) | \
+                           (((uint32_t)(VALUE) << FIELD_SHIFT(FIELD_NAME)) & FIELD_MASK(FIELD_NAME)))))
+
+#define HAL_get_32bit_reg_field(BASE_ADDR, FIELD_NAME) \
+            ((uint32_t)((HAL_FIELD_REG32(BASE_ADDR, FIELD_NAME) & FIELD_MASK(FIELD_NAME)) >> FIELD_SHIFT(FIELD_NAME)))
+
+#define HAL_set_16bit_reg(BASE_ADDR, REG_NAME, VALUE) \
+            ((void)(HAL_REG16(BASE_ADDR, REG_NAME) = (uint16_t)(VALUE)))
+
+#define HAL_get_16bit_reg(BASE_ADDR, REG_NAME) \
+            ((uint16_t)HAL_REG16(BASE_ADDR, REG_NAME))
+
+#define HAL_set_16bit_reg_field(BASE_ADDR, FIELD_NAME, VALUE) \
+            ((void)(HAL_FIELD_REG16(BASE_ADDR, FIELD_NAME) = \
+                (uint16_t)((HAL_FIELD_REG16(BASE_ADDR, FIELD_NAME) & ~(uint32_t)FIELD_MASK(FIELD_NAME)) | \
+                           (((uint32_t)(VALUE) << FIELD_SHIFT(FIELD_NAME)) & FIELD_MASK(FIELD_NAME)))))
+
+#define HAL_get_16bit_reg_field(BASE_ADDR, FIELD_NAME) \
+            ((uint16_t)((HAL_FIELD_REG16(BASE_ADDR, FIELD_NAME) & FIELD_MASK(FIELD_NAME)) >> FIELD_SHIFT(FIELD_NAME)))
+
+#define HAL_set_8bit_reg(BASE_ADDR, REG_NAME, VALUE) \
+            ((void)(HAL_REG8(BASE_ADDR, REG_NAME) = (uint8_t)(VALUE)))
+
+#define HAL_get_8bit_reg(BASE_ADDR, REG_NAME) \
+            ((uint8_t)HAL_REG8(BASE_ADDR, REG_NAME))
+
+#define HAL_set_8bit_reg_field(BASE_ADDR, FIELD_NAME, VALUE) \
+            ((void)(HAL_FIELD_REG8(BASE_ADDR, FIELD_NAME) = \
+                (uint8_t)((HAL_FIELD_REG8(BASE_ADDR, FIELD_NAME) & ~(uint32_t)FIELD_MASK(FIELD_NAME)) | \
+                          (((uint32_t)(VALUE) << FIELD_SHIFT(FIELD_NAME)) & FIELD_MASK(FIELD_NAME)))))
+
+#define HAL_get_8bit_reg_field(BASE_ADDR, FIELD_NAME) \
+            ((uint8_t)((HAL_FIELD_REG8(BASE_ADDR, FIELD_NAME) & FIELD_MASK(FIELD_NAME)) >> FIELD_SHIFT(FIELD_NAME)))
+
+#endif /* HAL_INLINE_REG_ACCESS */
+
+#endif /* HAL_INLINE_H_ */
@@ -0,0 +1,27 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader host build CSR access.
+ *
+ * Stands in for riscv_hal/encoding.h in the host build. The CSR read macro is
+ * replaced with calls into the virtual clock so that mcycle reads give the
+ * cycles the board would have counted.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef HOST_ENCODING_H_
+#define HOST_ENCODING_H_
+
+#include_next "encoding.h"
+
+#include <stdint.h>
+
+uint32_t host_read_csr_mcycle(void);
+uint32_t host_read_csr_mcycleh(void);
+
+#undef read_csr
+#define read_csr(reg) host_read_csr_##reg()
+
+#endif /* HOST_ENCODING_H_ */
@@ -0,0 +1,52 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader host build emulation header.
+ *
+ * The host build runs the bootloader as a Linux process with the CoreUARTapb,
+ * CoreGPIO and timer drivers replaced by the emulations in this directory and
+ * the CoreSPI driver running on a model of the CoreSPI registers. All emulated
+ * hardware shares one virtual clock so timings are those the board would see
+ * rather than those of the host.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdint.h>
+
+/*
+ * Virtual clock.
+ */
+uint64_t host_clock_ns(void);
+void     host_clock_advance(uint64_t ns);
+int32_t  host_clock_init(void);
+
+/*
+ * Emulated devices. The open/map functions return 0 for success or -1 for
+ * error, having reported the error on stderr.
+ */
+int32_t  host_ddr_map(const char *path);
+int32_t  host_spi_flash_open(const char *path, const char *trace_path, uint32_t spi_hz);
+void     host_spi_flash_close(void);
+int32_t  host_uart_open(const char *link);
+void     host_gpio_set_inputs(uint32_t inputs);
+
+/*
+ * Between the CoreSPI model and the FLASH emulation, a byte sent and the one
+ * received for each frame and the end of each command frame.
+ */
+uint8_t  host_spi_flash_frame(uint8_t mosi);
+void     host_spi_flash_deselect(void);
+uint32_t host_spi_flash_hz(void);
+
+/*
+ * CoreSPI model, see host_core_spi.c.
+ */
+int32_t  host_core_spi_idle(void);
+uint32_t host_core_spi_accesses(void);
+
+#endif /* HOST_H_ */
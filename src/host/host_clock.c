@@ -0,0 +1,177 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader host build virtual clock.
+ *
+ * Time only moves when emulated hardware does something that takes time on the
+ * board: SPI transfers, UART characters and FLASH program/erase cycles. Every
+ * 10ms of virtual time SysTick_Handler() is called, as the timer interrupt
+ * would, and mtime is kept up to date in a page mapped at its usual address.
+ *
+ * The bootloader also spins on g_10ms_count with nothing else happening, e.g.
+ * in _sleep(). A 1ms interval timer spots when the virtual clock has stood
+ * still for HOST_IDLE_TICKS real milliseconds and then advances it in real
+ * time until something else moves it again. CoreSPI is given the chance to
+ * finish an interrupt driven transfer first, which is what the bootloader
+ * may be waiting for. Short bursts of pure computation
+ * are therefore free in virtual time and results stay reproducible.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include "hw_platform.h"
+#include "encoding.h"
+#include "host.h"
+
+#define HOST_TICK_NS      10000000ull /* SysTick_Handler() period */
+#define HOST_IDLE_TICKS   10          /* Real ms still before idling starts */
+
+/*
+ * mtime as set up in interrupts.c, SYS_CLK_FREQ / RTC_PRESCALER.
+ */
+#define HOST_MTIME_ADDR   0x4400BFF8UL
+#define HOST_MTIME_PAGE   0x4400B000UL
+#define HOST_RTC_HZ       (SYS_CLK_FREQ / 100ull)
+
+void SysTick_Handler(void);
+
+static volatile uint64_t g_host_ns;
+static volatile sig_atomic_t g_host_in_clock;
+static volatile sig_atomic_t g_host_still;
+static volatile uint64_t *g_host_mtime;
+
+/***************************************************************************//**
+ * Move the clock on, delivering any timer ticks that fall due.
+ */
+static void clock_step(uint64_t ns)
+{
+    uint64_t old_ns;
+    uint64_t ticks;
+
+    old_ns    = g_host_ns;
+    g_host_ns = old_ns + ns;
+    if(0 != g_host_mtime)
+    {
+        *g_host_mtime = (g_host_ns / 1000ull) * HOST_RTC_HZ / 1000000ull;
+    }
+
+    for(ticks = (g_host_ns / HOST_TICK_NS) - (old_ns / HOST_TICK_NS); ticks != 0u; ticks--)
+    {
+        SysTick_Handler();
+    }
+}
+
+/***************************************************************************//**
+ * Interval timer handler, advances the clock while the bootloader is idle.
+ */
+static void clock_idle(int sig)
+{
+    (void)sig;
+    if(0 == g_host_in_clock)
+    {
+        if(g_host_still < HOST_IDLE_TICKS)
+        {
+            g_host_still++;
+        }
+        else if(0 == host_core_spi_idle())
+        {
+            clock_step(1000000ull);
+        }
+    }
+}
+
+/***************************************************************************//**
+ * Current virtual time in ns.
+ */
+uint64_t host_clock_ns(void)
+{
+    return(g_host_ns);
+}
+
+/***************************************************************************//**
+ * Account for ns of emulated hardware activity.
+ */
+void host_clock_advance(uint64_t ns)
+{
+    g_host_in_clock = 1;
+    clock_step(ns);
+    g_host_still    = 0;
+    g_host_in_clock = 0;
+}
+
+/***************************************************************************//**
+ * Map the mtime register page.
+ *
+ * Returns 0 for success or -1 for error.
+ */
+int32_t host_clock_init(void)
+{
+    void *page;
+    int32_t return_val = -1;
+
+    page = mmap((void *)HOST_MTIME_PAGE, 4096, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if(page == (void *)HOST_MTIME_PAGE)
+    {
+        g_host_mtime = (volatile uint64_t *)HOST_MTIME_ADDR;
+        return_val   = 0;
+    }
+    else
+    {
+        fprintf(stderr, "host: cannot map mtime at 0x%08lX\n", HOST_MTIME_PAGE);
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * mcycle, counting at SYS_CLK_FREQ in virtual time.
+ */
+static uint64_t clock_cycles(void)
+{
+    return((g_host_ns / 1000ull) * (SYS_CLK_FREQ / 1000000ull));
+}
+
+uint32_t host_read_csr_mcycle(void)
+{
+    return((uint32_t)clock_cycles());
+}
+
+uint32_t host_read_csr_mcycleh(void)
+{
+    return((uint32_t)(clock_cycles() >> 32));
+}
+
+/***************************************************************************//**
+ * Stand ins for interrupts.c. The timer "interrupt" is the virtual clock so
+ * all that is needed here is the idle timer.
+ */
+void interrupts_init(void)
+{
+    struct sigaction action;
+    struct itimerval interval;
+
+    action.sa_handler = clock_idle;
+    action.sa_flags   = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGALRM, &action, 0);
+
+    interval.it_interval.tv_sec  = 0;
+    interval.it_interval.tv_usec = 1000;
+    interval.it_value            = interval.it_interval;
+    setitimer(ITIMER_REAL, &interval, 0);
+}
+
+void interrupts_deinit(void)
+{
+    struct itimerval interval = {{0, 0}, {0, 0}};
+
+    setitimer(ITIMER_REAL, &interval, 0);
+}
@@ -0,0 +1,471 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader host build CoreSPI register model.
+ *
+ * The CoreSPI driver from ../drivers/CoreSPI runs in the host build too, built
+ * without HAL_INLINE_REG_ACCESS so that its register accesses are calls to the
+ * HW_xxx() functions of hw_reg_access.h. They are implemented here for the
+ * CoreSPI at FLASH_CORE_SPI_BASE, so the FIFO handling which runs on the board
+ * is what talks to the N25Q00AA emulation in host_spi.c.
+ *
+ * The model has the 32 frame TX and RX FIFOs of the FPGA design and shifts
+ * 8 bit frames back to back at the SPI clock in virtual time, from when the
+ * frame is written or CoreSPI is enabled. Each register access takes
+ * HOST_CORE_SPI_REG_NS, roughly what an APB access takes on the board, and the
+ * frames due by then are sent to the FLASH before it is done. The command
+ * frame ends with the frame written to TXLAST or when the slave select is
+ * cleared.
+ *
+ * The driver counts frames in flight rather than checking TXFULL, so writing
+ * a full TX FIFO, reading an empty RX FIFO and RX FIFO overflow are reported
+ * on stderr. Any of them means the driver has lost track of the frames and
+ * the data would be wrong on the board.
+ *
+ * With SF2BL_SPI_ASYNC the receive data interrupt is delivered by calling
+ * spi_flash_isr() from host_core_spi_idle(), as the bootloader only leaves an
+ * interrupt driven transfer running while it waits for something.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sf2_bl_options.h"
+#include "hw_platform.h"
+#include "hal.h"
+#include "corespi_regs.h"
+#include "spi_flash.h"
+#include "host.h"
+
+#define HOST_CORE_SPI_FIFO_DEPTH    32u
+#define HOST_CORE_SPI_REG_NS        ((8ull * 1000000000ull) / SYS_CLK_FREQ) /* 8 clocks */
+#define HOST_CORE_SPI_SIZE          0x100u
+
+/*
+ * Frame in the TX FIFO.
+ */
+typedef struct core_spi_tx
+{
+    uint64_t ns;       /* When it was written */
+    uint8_t  data;
+    uint8_t  last;     /* Written to TXLAST */
+} core_spi_tx_t;
+
+typedef struct core_spi
+{
+    uint8_t       ctrl1;
+    uint8_t       ctrl2;
+    uint8_t       ssel;
+    uint8_t       intraw;
+    uint8_t       rx_overflow;
+    core_spi_tx_t tx[HOST_CORE_SPI_FIFO_DEPTH];
+    uint32_t      tx_head;
+    uint32_t      tx_count;
+    uint8_t       rx[HOST_CORE_SPI_FIFO_DEPTH];
+    uint32_t      rx_head;
+    uint32_t      rx_count;
+    core_spi_tx_t shift;       /* Frame being sent */
+    uint32_t      shifting;
+    uint64_t      shift_end;   /* When it is done */
+    uint64_t      free_ns;     /* When the next frame can start */
+    uint32_t      in_model;    /* Register access or interrupt in progress */
+    uint32_t      accesses;
+    uint32_t      tx_overflows;
+    uint32_t      rx_underflows;
+    uint32_t      rx_overflows;
+} core_spi_t;
+
+static core_spi_t g_core_spi;
+
+/***************************************************************************//**
+ * Report the first of each kind of FIFO error.
+ */
+static void core_spi_error(uint32_t *pcount, const char *what)
+{
+    if(0u == *pcount)
+    {
+        fprintf(stderr, "host: CoreSPI %s at %.3fus\n", what, host_clock_ns() / 1000.0);
+    }
+    (*pcount)++;
+}
+
+static uint64_t core_spi_frame_ns(void)
+{
+    uint32_t spi_hz = host_spi_flash_hz();
+
+    return((8u * 1000000000ull + (spi_hz / 2u)) / spi_hz);
+}
+
+/***************************************************************************//**
+ * Start the next frame if there is one and CoreSPI is enabled.
+ */
+static void core_spi_start(void)
+{
+    if((0u == g_core_spi.shifting) && (0u != g_core_spi.tx_count) &&
+       (0u != (g_core_spi.ctrl1 & CTRL1_ENABLE_MASK)))
+    {
+        g_core_spi.shift    = g_core_spi.tx[g_core_spi.tx_head];
+        g_core_spi.tx_head  = (g_core_spi.tx_head + 1u) % HOST_CORE_SPI_FIFO_DEPTH;
+        g_core_spi.tx_count--;
+        if(g_core_spi.shift.ns > g_core_spi.free_ns)
+        {
+            g_core_spi.free_ns = g_core_spi.shift.ns;
+        }
+        g_core_spi.shift_end = g_core_spi.free_ns + core_spi_frame_ns();
+        g_core_spi.shifting  = 1;
+    }
+}
+
+/***************************************************************************//**
+ * Send the frames done by now to the FLASH.
+ */
+static void core_spi_run(uint64_t now)
+{
+    uint8_t miso;
+
+    core_spi_start();
+    while((0u != g_core_spi.shifting) && (g_core_spi.shift_end <= now))
+    {
+        g_core_spi.shifting = 0;
+        g_core_spi.free_ns  = g_core_spi.shift_end;
+
+        miso = host_spi_flash_frame(g_core_spi.shift.data);
+        if(g_core_spi.rx_count < HOST_CORE_SPI_FIFO_DEPTH)
+        {
+            g_core_spi.rx[(g_core_spi.rx_head + g_core_spi.rx_count) % HOST_CORE_SPI_FIFO_DEPTH] = miso;
+            g_core_spi.rx_count++;
+        }
+        else
+        {
+            g_core_spi.rx_overflow = 1;
+            g_core_spi.intraw     |= INTRAW_RXOVERFLOW_MASK;
+            core_spi_error(&g_core_spi.rx_overflows, "RX FIFO overflow");
+        }
+        g_core_spi.intraw |= INTRAW_RXDATA_MASK;
+
+        if(0u != g_core_spi.shift.last)
+        {
+            host_spi_flash_deselect();
+            g_core_spi.intraw |= INTRAW_TXDONE_MASK;
+        }
+
+        core_spi_start();
+    }
+}
+
+/***************************************************************************//**
+ * Interrupts which are raised and enabled.
+ */
+static uint8_t core_spi_intmask(void)
+{
+    uint8_t enabled = 0;
+
+    enabled |= (0u != (g_core_spi.ctrl1 & CTRL1_INTTXDONE_MASK))   ? INTRAW_TXDONE_MASK : 0u;
+    enabled |= (0u != (g_core_spi.ctrl1 & CTRL1_INTRXOVFLOW_MASK)) ? INTRAW_RXOVERFLOW_MASK : 0u;
+    enabled |= (0u != (g_core_spi.ctrl1 & CTRL1_INTTXURUN_MASK))   ? INTRAW_TXUNDERRUN_MASK : 0u;
+    enabled |= (0u != (g_core_spi.ctrl2 & CTRL2_INTCMD_MASK))      ? INTRAW_CMDINT_MASK : 0u;
+    enabled |= (0u != (g_core_spi.ctrl2 & CTRL2_INTSSEND_MASK))    ? INTRAW_SSEND_MASK : 0u;
+    enabled |= (0u != (g_core_spi.ctrl2 & CTRL2_INTRXDATA_MASK))   ? INTRAW_RXDATA_MASK : 0u;
+    enabled |= (0u != (g_core_spi.ctrl2 & CTRL2_INTTXDATA_MASK))   ? INTRAW_TXDATA_MASK : 0u;
+
+    return((uint8_t)(g_core_spi.intraw & enabled));
+}
+
+static uint8_t core_spi_status(void)
+{
+    uint8_t status = 0;
+
+    status |= ((0u == g_core_spi.shifting) && (0u == g_core_spi.tx_count)) ? STATUS_DONE_MASK : 0u;
+    status |= (0u == g_core_spi.rx_count) ? STATUS_RXEMPTY_MASK : 0u;
+    status |= (HOST_CORE_SPI_FIFO_DEPTH == g_core_spi.tx_count) ? STATUS_TXFULL_MASK : 0u;
+    status |= (0u != g_core_spi.rx_overflow) ? STATUS_RXOVFLOW_MASK : 0u;
+    status |= ((0u != g_core_spi.shifting) || (0u != g_core_spi.tx_count)) ? STATUS_ACTIVE_MASK : 0u;
+
+    return(status);
+}
+
+static uint32_t core_spi_read(uint32_t offset)
+{
+    uint32_t return_val = 0;
+
+    switch(offset)
+    {
+    case CTRL1_REG_OFFSET:
+        return_val = g_core_spi.ctrl1;
+        break;
+
+    case RXDATA_REG_OFFSET:
+        if(0u != g_core_spi.rx_count)
+        {
+            return_val = g_core_spi.rx[g_core_spi.rx_head];
+            g_core_spi.rx_head = (g_core_spi.rx_head + 1u) % HOST_CORE_SPI_FIFO_DEPTH;
+            g_core_spi.rx_count--;
+        }
+        else
+        {
+            core_spi_error(&g_core_spi.rx_underflows, "RX FIFO read while empty");
+        }
+        break;
+
+    case INTMASK_REG_OFFSET:
+        return_val = core_spi_intmask();
+        break;
+
+    case INTRAW_REG_OFFSET:
+        return_val = g_core_spi.intraw;
+        break;
+
+    case CTRL2_REG_OFFSET:
+        return_val = g_core_spi.ctrl2;
+        break;
+
+    case STATUS_REG_OFFSET:
+        return_val = core_spi_status();
+        break;
+
+    case SSEL_REG_OFFSET:
+        return_val = g_core_spi.ssel;
+        break;
+
+    default:
+        /* INTCLR, TXDATA, CMD and TXLAST read as 0 */
+        break;
+    }
+
+    return(return_val);
+}
+
+static void core_spi_write(uint32_t offset, uint32_t value)
+{
+    switch(offset)
+    {
+    case CTRL1_REG_OFFSET:
+        if((0u == (g_core_spi.ctrl1 & CTRL1_ENABLE_MASK)) && (0u != (value & CTRL1_ENABLE_MASK)) &&
+           (g_core_spi.free_ns < host_clock_ns()))
+        {
+            g_core_spi.free_ns = host_clock_ns();
+        }
+        g_core_spi.ctrl1 = (uint8_t)value;
+        break;
+
+    case INTCLR_REG_OFFSET:
+        g_core_spi.intraw &= (uint8_t)~value;
+        break;
+
+    case TXDATA_REG_OFFSET:
+    case TXLAST_REG_OFFSET:
+        if(g_core_spi.tx_count < HOST_CORE_SPI_FIFO_DEPTH)
+        {
+            g_core_spi.tx[(g_core_spi.tx_head + g_core_spi.tx_count) % HOST_CORE_SPI_FIFO_DEPTH].ns   = host_clock_ns();
+            g_core_spi.tx[(g_core_spi.tx_head + g_core_spi.tx_count) % HOST_CORE_SPI_FIFO_DEPTH].data = (uint8_t)value;
+            g_core_spi.tx[(g_core_spi.tx_head + g_core_spi.tx_count) % HOST_CORE_SPI_FIFO_DEPTH].last =
+                (TXLAST_REG_OFFSET == offset) ? 1u : 0u;
+            g_core_spi.tx_count++;
+        }
+        else
+        {
+            core_spi_error(&g_core_spi.tx_overflows, "TX FIFO written while full");
+        }
+        break;
+
+    case CTRL2_REG_OFFSET:
+        g_core_spi.ctrl2 = (uint8_t)value;
+        break;
+
+    case CMD_REG_OFFSET:
+        if(0u != (value & CMD_RXFIFORST_MASK))
+        {
+            g_core_spi.rx_count    = 0;
+            g_core_spi.rx_overflow = 0;
+        }
+        if(0u != (value & CMD_TXFIFORST_MASK))
+        {
+            g_core_spi.tx_count = 0;
+        }
+        break;
+
+    case SSEL_REG_OFFSET:
+        if((0u != (g_core_spi.ssel & 0x01u)) && (0u == (value & 0x01u)))
+        {
+            host_spi_flash_deselect();
+        }
+        g_core_spi.ssel = (uint8_t)value;
+        break;
+
+    default:
+        break;
+    }
+}
+
+/***************************************************************************//**
+ * Bring the model up to date with the virtual clock for a register access and
+ * check the address. Returns the register offset or HOST_CORE_SPI_SIZE if the
+ * address is not a CoreSPI register.
+ */
+static uint32_t core_spi_access(addr_t reg_addr)
+{
+    uint32_t return_val = HOST_CORE_SPI_SIZE;
+
+    if((reg_addr >= FLASH_CORE_SPI_BASE) && (reg_addr < (FLASH_CORE_SPI_BASE + HOST_CORE_SPI_SIZE)))
+    {
+        g_core_spi.in_model++;
+        g_core_spi.accesses++;
+        core_spi_run(host_clock_ns());
+        return_val = (uint32_t)(reg_addr - FLASH_CORE_SPI_BASE);
+    }
+    else
+    {
+        fprintf(stderr, "host: no register at 0x%08X\n", (unsigned)reg_addr);
+    }
+
+    return(return_val);
+}
+
+static void core_spi_access_done(void)
+{
+    host_clock_advance(HOST_CORE_SPI_REG_NS);
+    g_core_spi.in_model--;
+}
+
+static uint32_t core_spi_get(addr_t reg_addr)
+{
+    uint32_t offset;
+    uint32_t return_val = 0;
+
+    offset = core_spi_access(reg_addr);
+    if(HOST_CORE_SPI_SIZE != offset)
+    {
+        return_val = core_spi_read(offset);
+        core_spi_access_done();
+    }
+
+    return(return_val);
+}
+
+static void core_spi_set(addr_t reg_addr, uint32_t value)
+{
+    uint32_t offset;
+
+    offset = core_spi_access(reg_addr);
+    if(HOST_CORE_SPI_SIZE != offset)
+    {
+        core_spi_write(offset, value);
+        core_spi_access_done();
+    }
+}
+
+/*==============================================================================
+ * hw_reg_access.h, the field functions being a read and a write as on the
+ * board.
+ */
+void HW_set_32bit_reg(addr_t reg_addr, uint32_t value)
+{
+    core_spi_set(reg_addr, value);
+}
+
+uint32_t HW_get_32bit_reg(addr_t reg_addr)
+{
+    return(core_spi_get(reg_addr));
+}
+
+void HW_set_32bit_reg_field(addr_t reg_addr, int_fast8_t shift, uint32_t mask, uint32_t value)
+{
+    core_spi_set(reg_addr, (core_spi_get(reg_addr) & ~mask) | ((value << shift) & mask));
+}
+
+uint32_t HW_get_32bit_reg_field(addr_t reg_addr, int_fast8_t shift, uint32_t mask)
+{
+    return((core_spi_get(reg_addr) & mask) >> shift);
+}
+
+void HW_set_16bit_reg(addr_t reg_addr, uint_fast16_t value)
+{
+    core_spi_set(reg_addr, (uint16_t)value);
+}
+
+uint16_t HW_get_16bit_reg(addr_t reg_addr)
+{
+    return((uint16_t)core_spi_get(reg_addr));
+}
+
+void HW_set_16bit_reg_field(addr_t reg_addr, int_fast8_t shift, uint_fast16_t mask, uint_fast16_t value)
+{
+    core_spi_set(reg_addr, (uint16_t)((core_spi_get(reg_addr) & ~mask) | ((value << shift) & mask)));
+}
+
+uint16_t HW_get_16bit_reg_field(addr_t reg_addr, int_fast8_t shift, uint_fast16_t mask)
+{
+    return((uint16_t)((core_spi_get(reg_addr) & mask) >> shift));
+}
+
+void HW_set_8bit_reg(addr_t reg_addr, uint_fast8_t value)
+{
+    core_spi_set(reg_addr, (uint8_t)value);
+}
+
+uint8_t HW_get_8bit_reg(addr_t reg_addr)
+{
+    return((uint8_t)core_spi_get(reg_addr));
+}
+
+void HW_set_8bit_reg_field(addr_t reg_addr, int_fast8_t shift, uint_fast8_t mask, uint_fast8_t value)
+{
+    core_spi_set(reg_addr, (uint8_t)((core_spi_get(reg_addr) & ~mask) | ((value << shift) & mask)));
+}
+
+uint8_t HW_get_8bit_reg_field(addr_t reg_addr, int_fast8_t shift, uint_fast8_t mask)
+{
+    return((uint8_t)((core_spi_get(reg_addr) & mask) >> shift));
+}
+
+/***************************************************************************//**
+ * Called by the virtual clock when the bootloader is idle. Runs any frames
+ * still to be sent, delivering the CoreSPI interrupt with SF2BL_SPI_ASYNC.
+ *
+ * Returns 1 if there was anything to do, which took virtual time, or 0.
+ */
+int32_t host_core_spi_idle(void)
+{
+    int32_t return_val = 0;
+
+    if(0u == g_core_spi.in_model)
+    {
+        g_core_spi.in_model++;
+        core_spi_run(host_clock_ns());
+        for(;;)
+        {
+#if defined(SF2BL_SPI_ASYNC)
+            if(0u != core_spi_intmask())
+            {
+                spi_flash_isr();
+                return_val = 1;
+            }
+#endif
+            core_spi_start();
+            if(0u == g_core_spi.shifting)
+            {
+                break;
+            }
+            if(g_core_spi.shift_end > host_clock_ns())
+            {
+                host_clock_advance(g_core_spi.shift_end - host_clock_ns());
+            }
+            core_spi_run(host_clock_ns());
+            return_val = 1;
+        }
+        g_core_spi.in_model--;
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Number of CoreSPI register accesses so far.
+ */
+uint32_t host_core_spi_accesses(void)
+{
+    return(g_core_spi.accesses);
+}
@@ -0,0 +1,38 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader host build CoreGPIO emulation.
+ *
+ * The inputs are fixed for the run, set from the command line, so the update
+ * and golden image pins can be exercised.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+
+#include "core_gpio.h"
+#include "host.h"
+
+static uint32_t g_host_gpio_inputs = 0;
+
+void host_gpio_set_inputs(uint32_t inputs)
+{
+    g_host_gpio_inputs = inputs;
+}
+
+/*==============================================================================
+ * CoreGPIO driver API.
+ */
+void GPIO_init(gpio_instance_t *this_gpio, addr_t base_addr, gpio_apb_width_t bus_width)
+{
+    this_gpio->base_addr = base_addr;
+    this_gpio->apb_bus_width = bus_width;
+}
+
+uint32_t GPIO_get_inputs(gpio_instance_t *this_gpio)
+{
+    (void)this_gpio;
+    return(g_host_gpio_inputs);
+}
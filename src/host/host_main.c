@@ -0,0 +1,164 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader host build start up and exit.
+ *
+ * Sets up the emulated hardware from the command line and runs the bootloader,
+ * whose main() is renamed sf2bl_main() in this build. DDR is mapped at
+ * SF2BL_DDR_BASE so images load to their real addresses. Backing DDR with a
+ * file keeps its contents from one run to the next, as over a warm reset.
+ *
+ * Running the application is not possible so sf2bl_exec() reports the entry
+ * point, the virtual boot time and the boot metrics, if any, and exits.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "sf2_bl_options.h"
+#include "hw_platform.h"
+#include "boot_metrics.h"
+#include "exec.h"
+#include "host.h"
+
+int sf2bl_main(void);
+void interrupts_deinit(void);
+
+/***************************************************************************//**
+ * Map DDR at its real address, backed by path if it is not null.
+ */
+int32_t host_ddr_map(const char *path)
+{
+    void *ddr = MAP_FAILED;
+    int fd;
+    int32_t return_val = -1;
+
+    if(0 == path)
+    {
+        ddr = mmap((void *)SF2BL_DDR_BASE, SF2BL_DDR_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
+    }
+    else
+    {
+        fd = open(path, O_RDWR | O_CREAT, 0644);
+        if((fd >= 0) && (0 == ftruncate(fd, SF2BL_DDR_SIZE)))
+        {
+            ddr = mmap((void *)SF2BL_DDR_BASE, SF2BL_DDR_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+        }
+    }
+
+    if(ddr == (void *)SF2BL_DDR_BASE)
+    {
+        return_val = 0;
+    }
+    else
+    {
+        fprintf(stderr, "host: cannot map DDR at 0x%08X\n", (unsigned)SF2BL_DDR_BASE);
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Report how the boot went, one key=value per line.
+ */
+static void host_report(uint32_t entry, uint32_t arg)
+{
+    const sf2bl_boot_metrics_t *pmetrics;
+    uint32_t phase;
+
+    printf("entry=0x%08X\n", entry);
+    printf("boot_us=%.3f\n", host_clock_ns() / 1000.0);
+    printf("spi_reg_accesses=%u\n", host_core_spi_accesses());
+    if(0u != arg)
+    {
+        pmetrics = (const sf2bl_boot_metrics_t *)(uintptr_t)arg;
+        for(phase = 0; phase < pmetrics->n_phases; phase++)
+        {
+            printf("phase%u_cycles=%llu\n", phase, (unsigned long long)pmetrics->cycles[phase]);
+        }
+        printf("flags=0x%08X\n", pmetrics->flags);
+        printf("spi_transactions=%u\n", pmetrics->spi_transactions);
+        printf("spi_bytes=%u\n", pmetrics->spi_bytes);
+        printf("spi_polls=%u\n", pmetrics->spi_polls);
+        printf("crc_bytes=%u\n", pmetrics->crc_bytes);
+    }
+}
+
+/***************************************************************************//**
+ * Stand in for exec.c.
+ */
+void sf2bl_exec(uint32_t entry, uint32_t arg)
+{
+    interrupts_deinit();
+    host_report(entry, arg);
+    host_spi_flash_close();
+    exit(0);
+}
+
+/***************************************************************************//**
+ * The bootloader halts in a loop if there is nothing to run so stopping it
+ * with a signal is normal, make sure the trace is complete when that happens.
+ */
+static void host_stop(int sig)
+{
+    (void)sig;
+    interrupts_deinit();
+    host_spi_flash_close();
+    _exit(2);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s -f flash.bin [-d ddr.bin] [-t trace.txt] [-u uart-link|-] [-g gpio-inputs] [-c spi-hz]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *flash_path = 0;
+    const char *ddr_path   = 0;
+    const char *trace_path = 0;
+    const char *uart_link  = 0;
+    uint32_t spi_hz = SYS_CLK_FREQ / 8u; /* CoreSPI clock is fixed in the FPGA design */
+    int option;
+    int return_val = 1;
+
+    while(-1 != (option = getopt(argc, argv, "f:d:t:u:g:c:")))
+    {
+        switch(option)
+        {
+        case 'f': flash_path = optarg; break;
+        case 'd': ddr_path   = optarg; break;
+        case 't': trace_path = optarg; break;
+        case 'u': uart_link  = optarg; break;
+        case 'g': host_gpio_set_inputs((uint32_t)strtoul(optarg, 0, 0)); break;
+        case 'c': spi_hz = (uint32_t)strtoul(optarg, 0, 0); break;
+        default:  flash_path = 0; optind = argc; break;
+        }
+    }
+
+    if((0 == flash_path) || (0u == spi_hz))
+    {
+        usage(argv[0]);
+    }
+    else if((0 == host_clock_init()) && (0 == host_ddr_map(ddr_path)) &&
+            (0 == host_spi_flash_open(flash_path, trace_path, spi_hz)) && (0 == host_uart_open(uart_link)))
+    {
+        setvbuf(stdout, 0, _IOLBF, 0);
+        signal(SIGINT, host_stop);
+        signal(SIGTERM, host_stop);
+        return_val = sf2bl_main();
+        host_spi_flash_close();
+    }
+
+    return(return_val);
+}
@@ -0,0 +1,880 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader host build N25Q00AA emulation.
+ *
+ * Emulates a Micron N25Q00AA on the CoreSPI modelled in host_core_spi.c. The
+ * FLASH array is a file mapped into memory, created erased if it does not
+ * exist. CoreSPI passes each byte sent to host_spi_flash_frame(), which
+ * returns the byte clocked back, and ends the command frame with
+ * host_spi_flash_deselect() after the frame written to TXLAST. A command is
+ * carried out as soon as the bytes before its response are in, so a read
+ * streams from the array for as long as the frame lasts, or when the frame
+ * ends if it has no response.
+ *
+ * The model follows the datasheet for the commands the driver uses: write
+ * enable latch, 3 and 4 byte address modes, configurable fast read dummy
+ * cycles, NOR programming which only clears bits and wraps within the page,
+ * the flag status register, the SFDP tables, erase suspend and resume and XIP
+ * mode, where each frame is the address of a fast read and the first dummy bit
+ * decides whether the next one is too. READ without dummy cycles
+ * returns data a bit late, so shifted by one bit, above its N25Q_READ_MAX_HZ
+ * clock limit. Program and erase take the typical datasheet
+ * times in virtual time, during which only status reads are accepted.
+ *
+ * The SPI FLASH DMA backend from flash_dma.h is emulated here too, each DMA
+ * transaction being one command frame unless it does not end with TXLAST, in
+ * which case a read carries on with the next DMA transaction. A DMA
+ * transaction takes its bit time at the SPI clock plus HOST_SPI_XFER_NS of
+ * set up.
+ *
+ * The optional trace has a line per command frame giving the virtual time in
+ * us, the command, address, bytes sent and received and any busy time.
+ * Consecutive status polls are merged into one line with a count.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "flash_dma.h"
+#include "host.h"
+
+#define N25Q_SIZE           0x08000000u /* 1Gbit */
+#define N25Q_DIE_SIZE       0x02000000u
+#define N25Q_PAGE_SIZE      256u
+#define N25Q_FRAME_MAX      (N25Q_PAGE_SIZE + 16u) /* Bytes of a command frame kept */
+#define N25Q_RESP_MAX       256u /* Longest response other than a read */
+
+/*
+ * Typical times from the N25Q00AA datasheet.
+ */
+#define N25Q_PP_NS          500000ull
+#define N25Q_SSE_NS         250000000ull
+#define N25Q_SE_NS          700000000ull
+#define N25Q_DIE_NS         240000000000ull
+#define N25Q_WRSR_NS        1300000ull
+#define N25Q_WRNVCR_NS      200000000ull
+#define N25Q_SUSPEND_NS     15000ull
+
+#define N25Q_READ_MAX_HZ    54000000u
+
+#define HOST_SPI_XFER_NS    2000ull
+
+/*
+ * Register bits.
+ */
+#define SR_WIP              0x01u
+#define SR_WEL              0x02u
+#define FSR_READY           0x80u
+#define FSR_ERASE_SUSPEND   0x40u
+#define FSR_ERRORS          0x3Au
+#define FSR_4_BYTE          0x01u
+#define NVCR_3_BYTE         0x0001u
+#define VCR_DEFAULT         0xFBu
+#define VCR_XIP_DISABLE     0x08u
+#define XIP_EXIT_BIT        0x80u
+
+typedef struct n25q
+{
+    uint8_t  *array;
+    int       fd;
+    FILE     *trace;
+    uint32_t  spi_hz;
+    uint64_t  busy_until;
+    uint32_t  wel;
+    uint32_t  addr4;
+    uint32_t  reset_enabled;
+    uint8_t   status;
+    uint8_t   flags;
+    uint16_t  nvcr;
+    uint8_t   vcr;
+    uint8_t   last_cmd;    /* Status command being merged in the trace */
+    uint32_t  polls;
+    uint64_t  poll_start;
+    uint32_t  read_next;   /* Where a read continues if the frame is not ended */
+    uint32_t  erasing;     /* Internal cycle is an erase, which can be suspended */
+    uint64_t  suspend_left;
+    uint8_t   xip_cmd;     /* Fast read continued by each frame in XIP mode, 0 if not */
+} n25q_t;
+
+static n25q_t g_n25q = { 0, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0xFFFF, VCR_DEFAULT, 0, 0, 0, 0, 0, 0, 0 };
+
+/*
+ * Command frame coming from CoreSPI. While its header, the bytes before the
+ * response, is carried out the trace line is held back as the length of the
+ * response is only known when the frame ends.
+ */
+typedef struct n25q_frame
+{
+    uint8_t     tx[N25Q_FRAME_MAX];
+    uint32_t    len;         /* Bytes sent */
+    uint32_t    hdr_len;     /* Bytes before the response, 0 if none */
+    uint32_t    started;     /* Header carried out, response being sent */
+    uint32_t    streaming;   /* Header being carried out */
+    uint8_t     resp[N25Q_RESP_MAX];
+    uint32_t    stream;      /* Response is read from the array at stream_addr */
+    uint32_t    stream_addr;
+    uint32_t    shift;       /* READ above N25Q_READ_MAX_HZ */
+    const char *trace_name;  /* Trace line held back, if not null */
+    uint8_t     trace_cmd;
+    uint32_t    trace_addr;
+    uint32_t    trace_tx;
+    uint64_t    trace_busy;
+} n25q_frame_t;
+
+static n25q_frame_t g_frame;
+
+/*
+ * SFDP header, one parameter header and the JESD216 basic FLASH parameter
+ * table at 0x30: 4K erase, 3 or 4 byte addresses, 1-1-2, 1-2-2, 1-1-4 and 1-4-4
+ * fast reads, 1Gbit and 4K and 64K erase types.
+ */
+static const uint32_t g_sfdp[] =
+{
+    0x50444653u, 0xFF000100u, 0x09010000u, 0xFF000030u,
+    0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu,
+    0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu,
+    0xFFF320E5u, 0x3FFFFFFFu, 0x6B27EB29u, 0xBB273B27u,
+    0xFFFFFFFFu, 0xBB27FFFFu, 0xEB29FFFFu, 0xD810200Cu,
+    0x00000000u
+};
+
+/***************************************************************************//**
+ * Write out any merged status polls.
+ */
+static void trace_polls(void)
+{
+    if((0 != g_n25q.trace) && (0u != g_n25q.polls))
+    {
+        fprintf(g_n25q.trace, "%12.3f %-6s x%u\n", g_n25q.poll_start / 1000.0,
+                (0x70u == g_n25q.last_cmd) ? "RDFSR" : "RDSR", g_n25q.polls);
+        g_n25q.polls = 0;
+    }
+}
+
+static void trace_cmd(const char *name, uint8_t cmd, uint32_t address, uint32_t tx, uint32_t rx, uint64_t busy_ns)
+{
+    if(0u != g_frame.streaming)
+    {
+        g_frame.trace_name = name;
+        g_frame.trace_cmd  = cmd;
+        g_frame.trace_addr = address;
+        g_frame.trace_tx   = tx;
+        g_frame.trace_busy = busy_ns;
+    }
+    else if(0 != g_n25q.trace)
+    {
+        trace_polls();
+        fprintf(g_n25q.trace, "%12.3f %-6s 0x%02X addr=0x%08X tx=%u rx=%u", host_clock_ns() / 1000.0,
+                name, cmd, address, tx, rx);
+        if(0u != busy_ns)
+        {
+            fprintf(g_n25q.trace, " busy=%.3fus", busy_ns / 1000.0);
+        }
+        fputc('\n', g_n25q.trace);
+    }
+}
+
+static int32_t n25q_busy(void)
+{
+    return(host_clock_ns() < g_n25q.busy_until);
+}
+
+/***************************************************************************//**
+ * Dummy clocks of a fast read, as set in the volatile configuration register.
+ */
+static uint32_t n25q_dummy(void)
+{
+    uint32_t dummy;
+
+    dummy = (uint32_t)(g_n25q.vcr >> 4);
+
+    return(((0u == dummy) || (15u == dummy)) ? 8u : dummy);
+}
+
+/***************************************************************************//**
+ * Get the address following the command byte. Returns the number of address
+ * bytes or 0 if the frame is too short.
+ */
+static uint32_t n25q_address(const uint8_t *tx, uint32_t tx_size, uint32_t addr_bytes, uint32_t *paddress)
+{
+    uint32_t index;
+    uint32_t return_val = 0;
+
+    if(tx_size > addr_bytes)
+    {
+        *paddress = 0;
+        for(index = 1; index <= addr_bytes; index++)
+        {
+            *paddress = (*paddress << 8) | tx[index];
+        }
+        *paddress &= N25Q_SIZE - 1u;
+        return_val = addr_bytes;
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Start an internal cycle which needs the write enable latch. Returns 0 if the
+ * latch was not set, in which case the command is ignored.
+ */
+static int32_t n25q_start_cycle(uint64_t ns)
+{
+    int32_t return_val = 0;
+
+    if(0u != g_n25q.wel)
+    {
+        g_n25q.wel        = 0;
+        g_n25q.erasing    = 0;
+        g_n25q.busy_until = host_clock_ns() + ns;
+        return_val = 1;
+    }
+
+    return(return_val);
+}
+
+static void n25q_erase(const char *name, const uint8_t *tx, uint32_t tx_size, uint32_t addr_bytes,
+                       uint32_t len, uint64_t ns)
+{
+    uint32_t address = 0;
+
+    /* No new erase while one is suspended */
+    if((0u != n25q_address(tx, tx_size, addr_bytes, &address)) &&
+       (0u == (g_n25q.flags & FSR_ERASE_SUSPEND)) && n25q_start_cycle(ns))
+    {
+        g_n25q.erasing = 1;
+        address &= ~(len - 1u);
+        memset(g_n25q.array + address, 0xFF, len);
+        trace_cmd(name, tx[0], address, tx_size, 0, ns);
+    }
+    else
+    {
+        trace_cmd("IGNORE", tx[0], address, tx_size, 0, 0);
+    }
+}
+
+static void n25q_program(const uint8_t *tx, uint32_t tx_size, uint32_t addr_bytes)
+{
+    uint32_t address = 0;
+    uint32_t page;
+    uint32_t index;
+    uint32_t len;
+    const uint8_t *data;
+
+    if((0u != n25q_address(tx, tx_size, addr_bytes, &address)) && n25q_start_cycle(N25Q_PP_NS))
+    {
+        data = tx + 1 + addr_bytes;
+        len  = tx_size - 1u - addr_bytes;
+        /* Only the last page worth of data is kept if more is sent */
+        if(len > N25Q_PAGE_SIZE)
+        {
+            data += len - N25Q_PAGE_SIZE;
+            len   = N25Q_PAGE_SIZE;
+        }
+
+        page = address & ~(N25Q_PAGE_SIZE - 1u);
+        for(index = 0; index < len; index++)
+        {
+            g_n25q.array[page + ((address + index) & (N25Q_PAGE_SIZE - 1u))] &= data[index];
+        }
+        trace_cmd("PP", tx[0], address, tx_size, 0, N25Q_PP_NS);
+    }
+    else
+    {
+        trace_cmd("IGNORE", tx[0], address, tx_size, 0, 0);
+    }
+}
+
+static void n25q_read(const uint8_t *tx, uint32_t tx_size, uint8_t *rx, uint32_t rx_size,
+                      uint32_t addr_bytes, uint32_t fast)
+{
+    uint32_t address = 0;
+    uint32_t dummy;
+    uint32_t index;
+    uint32_t xip;
+
+    xip   = (0u != g_n25q.xip_cmd) ? 1u : 0u; /* Opcode not really sent */
+    dummy = fast ? n25q_dummy() : 0u;
+
+    if((0u != n25q_address(tx, tx_size, addr_bytes, &address)) &&
+       ((1u + addr_bytes + (dummy / 8u)) == tx_size) && (0u == (dummy % 8u)))
+    {
+        if(0u != g_frame.streaming)
+        {
+            /* host_spi_flash_frame() sends the data as it is clocked out */
+            g_frame.stream      = 1;
+            g_frame.stream_addr = address;
+            g_frame.shift       = ((0u == fast) && (g_n25q.spi_hz > N25Q_READ_MAX_HZ)) ? 1u : 0u;
+        }
+        else
+        {
+            for(index = 0; index < rx_size; index++)
+            {
+                rx[index] = g_n25q.array[(address + index) & (N25Q_SIZE - 1u)];
+            }
+            if((0u == fast) && (g_n25q.spi_hz > N25Q_READ_MAX_HZ))
+            {
+                for(index = rx_size; index > 0u; index--)
+                {
+                    rx[index - 1u] = (uint8_t)((rx[index - 1u] >> 1) | ((index > 1u) ? (uint8_t)(rx[index - 2u] << 7) : 0x80u));
+                }
+            }
+            g_n25q.read_next = address + rx_size;
+        }
+        trace_cmd(xip ? "XIP" : (fast ? "FREAD" : "READ"), tx[0], address, tx_size - xip, rx_size, 0);
+        if(fast)
+        {
+            g_n25q.xip_cmd = ((0u == (g_n25q.vcr & VCR_XIP_DISABLE)) && (0u == (tx[1u + addr_bytes] & XIP_EXIT_BIT))) ?
+                             tx[0] : 0u;
+        }
+    }
+    else
+    {
+        /* Misframed, the data would be shifted on the real device */
+        memset(rx, 0xFF, rx_size);
+        trace_cmd("BADRD", tx[0], address, tx_size, rx_size, 0);
+    }
+}
+
+/***************************************************************************//**
+ * Carry out one command frame.
+ */
+static void n25q_command(const uint8_t *tx, uint32_t tx_size, uint8_t *rx, uint32_t rx_size)
+{
+    static const uint8_t id[] = { 0x20, 0xBA, 0x21, 0x10, 0x00 };
+    uint32_t addr_bytes;
+    uint32_t address = 0;
+    uint32_t index;
+    uint8_t  reply[2];
+    uint32_t reply_len = 0;
+    uint8_t  frame[16];
+
+    memset(rx, 0xFF, rx_size);
+    addr_bytes = g_n25q.addr4 ? 4u : 3u;
+
+    if(0u != g_n25q.xip_cmd)
+    {
+        /* Every frame is a fast read without the opcode, too long is misframed */
+        frame[0] = g_n25q.xip_cmd;
+        memcpy(&frame[1], tx, (tx_size < sizeof(frame)) ? tx_size : (sizeof(frame) - 1u));
+        n25q_read(frame, tx_size + 1u, rx, rx_size, (0x0Cu == frame[0]) ? 4u : addr_bytes, 1);
+    }
+    else if((0x05u == tx[0]) || (0x70u == tx[0]))
+    {
+        if((g_n25q.last_cmd != tx[0]) || (0u == g_n25q.polls))
+        {
+            trace_polls();
+            g_n25q.last_cmd   = tx[0];
+            g_n25q.poll_start = host_clock_ns();
+        }
+        g_n25q.polls++;
+        if(0x05u == tx[0])
+        {
+            reply[0] = (n25q_busy() ? SR_WIP : 0u) | (g_n25q.wel ? SR_WEL : 0u) | (g_n25q.status & 0xFCu);
+        }
+        else
+        {
+            reply[0] = g_n25q.flags | (n25q_busy() ? 0u : FSR_READY) | (g_n25q.addr4 ? FSR_4_BYTE : 0u);
+        }
+        reply_len = 1;
+    }
+    else if(0x75u == tx[0])
+    {
+        if(n25q_busy() && (0u != g_n25q.erasing))
+        {
+            g_n25q.erasing      = 0;
+            g_n25q.suspend_left = g_n25q.busy_until - host_clock_ns();
+            g_n25q.busy_until   = host_clock_ns() + N25Q_SUSPEND_NS;
+            g_n25q.flags       |= FSR_ERASE_SUSPEND;
+        }
+        trace_cmd("PES", tx[0], 0, tx_size, rx_size, 0);
+    }
+    else if(n25q_busy())
+    {
+        trace_cmd("BUSY", tx[0], 0, tx_size, rx_size, 0);
+    }
+    else
+    {
+        if(0x99u != tx[0])
+        {
+            g_n25q.reset_enabled = 0;
+        }
+
+        switch(tx[0])
+        {
+        case 0x9Fu:
+            if(rx_size <= sizeof(id))
+            {
+                memcpy(rx, id, rx_size);
+            }
+            else
+            {
+                memcpy(rx, id, sizeof(id));
+            }
+            trace_cmd("RDID", tx[0], 0, tx_size, rx_size, 0);
+            break;
+
+        case 0x5Au:
+            if((5u == tx_size) && n25q_address(tx, tx_size - 1u, 3u, &address))
+            {
+                for(index = 0; (index < rx_size) && ((address + index) < sizeof(g_sfdp)); index++)
+                {
+                    rx[index] = ((const uint8_t *)g_sfdp)[address + index];
+                }
+            }
+            trace_cmd("RDSFDP", tx[0], address, tx_size, rx_size, 0);
+            break;
+
+        case 0x06u:
+            g_n25q.wel = 1;
+            trace_cmd("WREN", tx[0], 0, tx_size, rx_size, 0);
+            break;
+
+        case 0x04u:
+            g_n25q.wel = 0;
+            trace_cmd("WRDI", tx[0], 0, tx_size, rx_size, 0);
+            break;
+
+        case 0x50u:
+            g_n25q.flags &= (uint8_t)~FSR_ERRORS;
+            trace_cmd("CLFSR", tx[0], 0, tx_size, rx_size, 0);
+            break;
+
+        case 0xB7u:
+        case 0xE9u:
+            if(0u != g_n25q.wel)
+            {
+                g_n25q.wel   = 0;
+                g_n25q.addr4 = (0xB7u == tx[0]);
+            }
+            trace_cmd((0xB7u == tx[0]) ? "EN4B" : "EX4B", tx[0], 0, tx_size, rx_size, 0);
+            break;
+
+        case 0x03u:
+            n25q_read(tx, tx_size, rx, rx_size, addr_bytes, 0);
+            break;
+
+        case 0x13u:
+            n25q_read(tx, tx_size, rx, rx_size, 4u, 0);
+            break;
+
+        case 0x0Bu:
+            n25q_read(tx, tx_size, rx, rx_size, addr_bytes, 1);
+            break;
+
+        case 0x0Cu:
+            n25q_read(tx, tx_size, rx, rx_size, 4u, 1);
+            break;
+
+        case 0x02u:
+            n25q_program(tx, tx_size, addr_bytes);
+            break;
+
+        case 0x12u:
+            n25q_program(tx, tx_size, 4u);
+            break;
+
+        case 0x20u:
+            n25q_erase("SSE", tx, tx_size, addr_bytes, 4096u, N25Q_SSE_NS);
+            break;
+
+        case 0x21u:
+            n25q_erase("SSE", tx, tx_size, 4u, 4096u, N25Q_SSE_NS);
+            break;
+
+        case 0xD8u:
+            n25q_erase("SE", tx, tx_size, addr_bytes, 65536u, N25Q_SE_NS);
+            break;
+
+        case 0xDCu:
+            n25q_erase("SE", tx, tx_size, 4u, 65536u, N25Q_SE_NS);
+            break;
+
+        case 0xC4u:
+            n25q_erase("DIE", tx, tx_size, addr_bytes, N25Q_DIE_SIZE, N25Q_DIE_NS);
+            break;
+
+        case 0x01u:
+            if((tx_size > 1u) && n25q_start_cycle(N25Q_WRSR_NS))
+            {
+                g_n25q.status = tx[1] & 0xFCu;
+            }
+            trace_cmd("WRSR", tx[0], 0, tx_size, rx_size, N25Q_WRSR_NS);
+            break;
+
+        case 0xB5u:
+            reply[0]  = (uint8_t)g_n25q.nvcr;
+            reply[1]  = (uint8_t)(g_n25q.nvcr >> 8);
+            reply_len = 2;
+            trace_cmd("RDNVCR", tx[0], 0, tx_size, rx_size, 0);
+            break;
+
+        case 0xB1u:
+            if((tx_size > 2u) && n25q_start_cycle(N25Q_WRNVCR_NS))
+            {
+                g_n25q.nvcr = (uint16_t)(tx[1] | (tx[2] << 8));
+            }
+            trace_cmd("WRNVCR", tx[0], 0, tx_size, rx_size, N25Q_WRNVCR_NS);
+            break;
+
+        case 0x85u:
+            reply[0]  = g_n25q.vcr;
+            reply_len = 1;
+            trace_cmd("RDVCR", tx[0], 0, tx_size, rx_size, 0);
+            break;
+
+        case 0x81u:
+            if((tx_size > 1u) && (0u != g_n25q.wel))
+            {
+                g_n25q.wel = 0;
+                g_n25q.vcr = tx[1];
+            }
+            trace_cmd("WRVCR", tx[0], 0, tx_size, rx_size, 0);
+            break;
+
+        case 0x7Au:
+            if(0u != (g_n25q.flags & FSR_ERASE_SUSPEND))
+            {
+                g_n25q.flags     &= (uint8_t)~FSR_ERASE_SUSPEND;
+                g_n25q.erasing    = 1;
+                g_n25q.busy_until = host_clock_ns() + g_n25q.suspend_left;
+            }
+            trace_cmd("PER", tx[0], 0, tx_size, rx_size, 0);
+            break;
+
+        case 0x66u:
+            g_n25q.reset_enabled = 1;
+            trace_cmd("RSTEN", tx[0], 0, tx_size, rx_size, 0);
+            break;
+
+        case 0x99u:
+            if(0u != g_n25q.reset_enabled)
+            {
+                g_n25q.reset_enabled = 0;
+                g_n25q.wel   = 0;
+                g_n25q.vcr   = VCR_DEFAULT;
+                g_n25q.addr4 = (0u == (g_n25q.nvcr & NVCR_3_BYTE));
+            }
+            trace_cmd("RST", tx[0], 0, tx_size, rx_size, 0);
+            break;
+
+        default:
+            trace_cmd("UNSUPP", tx[0], 0, tx_size, rx_size, 0);
+            break;
+        }
+    }
+
+    if(0u != reply_len)
+    {
+        memcpy(rx, reply, (rx_size < reply_len) ? rx_size : reply_len);
+    }
+}
+
+/***************************************************************************//**
+ * Open the FLASH array file, creating it erased if need be, and the trace
+ * file if trace_path is not null.
+ */
+int32_t host_spi_flash_open(const char *path, const char *trace_path, uint32_t spi_hz)
+{
+    struct stat info;
+    void *array;
+    int32_t return_val = -1;
+
+    g_n25q.spi_hz = spi_hz;
+    g_n25q.fd = open(path, O_RDWR | O_CREAT, 0644);
+    if((g_n25q.fd >= 0) && (0 == fstat(g_n25q.fd, &info)) &&
+       ((info.st_size >= N25Q_SIZE) || (0 == ftruncate(g_n25q.fd, N25Q_SIZE))))
+    {
+        array = mmap(0, N25Q_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, g_n25q.fd, 0);
+        if(MAP_FAILED != array)
+        {
+            g_n25q.array = (uint8_t *)array;
+            if(info.st_size < N25Q_SIZE)
+            {
+                memset(g_n25q.array + info.st_size, 0xFF, N25Q_SIZE - info.st_size);
+            }
+            return_val = 0;
+        }
+    }
+
+    if((0 == return_val) && (0 != trace_path))
+    {
+        g_n25q.trace = fopen(trace_path, "w");
+        if(0 == g_n25q.trace)
+        {
+            return_val = -1;
+        }
+    }
+
+    if(0 != return_val)
+    {
+        fprintf(stderr, "host: cannot open SPI FLASH %s\n", (0 == g_n25q.array) ? path : trace_path);
+    }
+
+    g_n25q.addr4 = (0u == (g_n25q.nvcr & NVCR_3_BYTE));
+
+    return(return_val);
+}
+
+void host_spi_flash_close(void)
+{
+    if(0 != g_n25q.trace)
+    {
+        trace_polls();
+        fclose(g_n25q.trace);
+        g_n25q.trace = 0;
+    }
+
+    if(0 != g_n25q.array)
+    {
+        msync(g_n25q.array, N25Q_SIZE, MS_SYNC);
+    }
+}
+
+/***************************************************************************//**
+ * Number of bytes before the response of the command frame so far, 0 if it has
+ * no response or if that is not known yet.
+ */
+static uint32_t n25q_header_len(void)
+{
+    uint32_t addr_bytes;
+    uint32_t len = 0;
+    uint8_t  cmd;
+
+    addr_bytes = g_n25q.addr4 ? 4u : 3u;
+    cmd = (0u != g_n25q.xip_cmd) ? g_n25q.xip_cmd : g_frame.tx[0];
+
+    switch(cmd)
+    {
+    case 0x05u:
+    case 0x70u:
+    case 0x9Fu:
+    case 0xB5u:
+    case 0x85u:
+        len = 1;
+        break;
+
+    case 0x5Au:
+    case 0x13u:
+        len = 5;
+        break;
+
+    case 0x03u:
+        len = 1u + addr_bytes;
+        break;
+
+    case 0x0Bu:
+        len = 1u + addr_bytes + (n25q_dummy() / 8u);
+        break;
+
+    case 0x0Cu:
+        len = 5u + (n25q_dummy() / 8u);
+        break;
+
+    default:
+        break;
+    }
+
+    /* The opcode is not sent in XIP mode */
+    if((0u != g_n25q.xip_cmd) && (0u != len))
+    {
+        len--;
+    }
+
+    return(len);
+}
+
+/***************************************************************************//**
+ * Take one byte of a command frame from CoreSPI and return the byte clocked
+ * back at the same time.
+ */
+uint8_t host_spi_flash_frame(uint8_t mosi)
+{
+    uint32_t index;
+    uint8_t  byte;
+    uint8_t  return_val = 0xFF;
+
+    if(0u != g_frame.started)
+    {
+        index = g_frame.len - g_frame.hdr_len;
+        if(0u != g_frame.stream)
+        {
+            byte = g_n25q.array[(g_frame.stream_addr + index) & (N25Q_SIZE - 1u)];
+            if(0u != g_frame.shift)
+            {
+                byte = (uint8_t)((byte >> 1) | ((index > 0u) ?
+                       (uint8_t)(g_n25q.array[(g_frame.stream_addr + index - 1u) & (N25Q_SIZE - 1u)] << 7) : 0x80u));
+            }
+            return_val = byte;
+        }
+        else if(index < N25Q_RESP_MAX)
+        {
+            return_val = g_frame.resp[index];
+        }
+    }
+
+    if(g_frame.len < N25Q_FRAME_MAX)
+    {
+        g_frame.tx[g_frame.len] = mosi;
+    }
+    g_frame.len++;
+
+    if((0u == g_frame.started) && (1u == g_frame.len))
+    {
+        g_frame.hdr_len = n25q_header_len();
+    }
+
+    if((0u == g_frame.started) && (0u != g_frame.hdr_len) && (g_frame.len == g_frame.hdr_len))
+    {
+        g_frame.started    = 1;
+        g_frame.streaming  = 1;
+        g_frame.trace_name = 0;
+        n25q_command(g_frame.tx, g_frame.hdr_len, g_frame.resp, N25Q_RESP_MAX);
+        g_frame.streaming  = 0;
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * End the command frame.
+ */
+void host_spi_flash_deselect(void)
+{
+    uint32_t rx_size;
+    uint8_t  dummy;
+
+    if(0u != g_frame.started)
+    {
+        rx_size = g_frame.len - g_frame.hdr_len;
+        if(0u != g_frame.stream)
+        {
+            g_n25q.read_next = g_frame.stream_addr + rx_size;
+        }
+        if(0 != g_frame.trace_name)
+        {
+            trace_cmd(g_frame.trace_name, g_frame.trace_cmd, g_frame.trace_addr, g_frame.trace_tx, rx_size,
+                      g_frame.trace_busy);
+        }
+    }
+    else if(0u != g_frame.len)
+    {
+        n25q_command(g_frame.tx, (g_frame.len < N25Q_FRAME_MAX) ? g_frame.len : N25Q_FRAME_MAX, &dummy, 0);
+    }
+
+    g_frame.len     = 0;
+    g_frame.started = 0;
+    g_frame.stream  = 0;
+}
+
+/***************************************************************************//**
+ * SPI clock, for the CoreSPI model.
+ */
+uint32_t host_spi_flash_hz(void)
+{
+    return(g_n25q.spi_hz);
+}
+
+/*==============================================================================
+ * SPI FLASH DMA backend. The transaction runs as soon as it is started. The
+ * incrementing RX descriptors at the end of the RX chain receive the response
+ * and everything sent before the response is the command. After a transaction
+ * without a FLASH_DMA_LAST descriptor the next one is more of the same read.
+ */
+static uint32_t g_dma_frame_open = 0;
+
+void flash_dma_init(void)
+{
+}
+
+void flash_dma_start(const flash_dma_desc_t *tx, uint32_t n_tx, const flash_dma_desc_t *rx, uint32_t n_rx)
+{
+    uint8_t *cmd;
+    uint8_t *resp;
+    uint8_t dummy;
+    uint32_t total = 0;
+    uint32_t resp_len = 0;
+    uint32_t cmd_len;
+    uint32_t first_resp = n_rx;
+    uint32_t frame_open = 1;
+    uint32_t pos;
+    uint32_t len;
+    uint32_t index;
+
+    for(index = 0; index < n_tx; index++)
+    {
+        total += tx[index].len;
+        if(0u != (tx[index].flags & FLASH_DMA_LAST))
+        {
+            frame_open = 0;
+        }
+    }
+
+    while((first_resp > 0u) && ((0u == rx[first_resp - 1u].len) || (0u == (rx[first_resp - 1u].flags & FLASH_DMA_FIXED))))
+    {
+        first_resp--;
+        resp_len += rx[first_resp].len;
+    }
+
+    cmd_len = total - resp_len;
+    cmd  = malloc(cmd_len + 1u);
+    resp = malloc(resp_len + 1u);
+
+    /* Gather the command from the TX chain */
+    pos = 0;
+    for(index = 0; (index < n_tx) && (pos < cmd_len); index++)
+    {
+        len = ((cmd_len - pos) < tx[index].len) ? (cmd_len - pos) : tx[index].len;
+        if(0u != (tx[index].flags & FLASH_DMA_FIXED))
+        {
+            memset(&cmd[pos], tx[index].mem[0], len);
+        }
+        else
+        {
+            memcpy(&cmd[pos], tx[index].mem, len);
+        }
+        pos += len;
+    }
+
+    host_clock_advance(HOST_SPI_XFER_NS + ((uint64_t)total * 8u * 1000000000ull) / g_n25q.spi_hz);
+    if(0u != g_dma_frame_open)
+    {
+        for(index = 0; index < resp_len; index++)
+        {
+            resp[index] = g_n25q.array[(g_n25q.read_next + index) & (N25Q_SIZE - 1u)];
+        }
+        trace_cmd("READ+", 0, g_n25q.read_next, cmd_len, resp_len, 0);
+        g_n25q.read_next += resp_len;
+    }
+    else if(0u != cmd_len)
+    {
+        n25q_command(cmd, cmd_len, (0u != resp_len) ? resp : &dummy, resp_len);
+    }
+    g_dma_frame_open = frame_open;
+
+    /* Scatter the response */
+    pos = 0;
+    for(index = first_resp; index < n_rx; index++)
+    {
+        memcpy(rx[index].mem, &resp[pos], rx[index].len);
+        pos += rx[index].len;
+    }
+
+    free(cmd);
+    free(resp);
+}
+
+int32_t flash_dma_busy(void)
+{
+    return(0);
+}
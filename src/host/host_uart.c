@@ -0,0 +1,157 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader host build CoreUARTapb emulation.
+ *
+ * The UART is the master side of a pseudo terminal. Its slave device, whose
+ * name is printed on stderr and optionally linked to a fixed path, can be
+ * opened with a terminal emulator or sz for YMODEM transfers. Characters take
+ * their time on the line at the configured baud rate in virtual time, and an
+ * empty receiver waits 1ms of real time for each 1ms of virtual time so that
+ * timeouts behave as they would for a person at a terminal.
+ *
+ * A link name of "-" uses stdin and stdout instead, for capturing output.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "hw_platform.h"
+#include "core_uart_apb.h"
+#include "host.h"
+
+#define HOST_UART_IDLE_MS 1
+
+/*
+ * Normally in riscv_hal/syscall.c.
+ */
+UART_instance_t g_uart;
+
+static int g_host_uart_fd    = -1;
+static int g_host_uart_out   = -1;
+static int g_host_uart_slave = -1;
+static uint64_t g_host_char_ns = (10ull * 1000000000ull) / 115200u;
+
+/***************************************************************************//**
+ * Create the pseudo terminal. The slave side is kept open so the UART carries
+ * on working when nothing is connected.
+ */
+static int32_t uart_open_pty(const char *link)
+{
+    struct termios settings;
+    const char *name = 0;
+    int32_t return_val = -1;
+
+    g_host_uart_fd  = posix_openpt(O_RDWR | O_NOCTTY);
+    g_host_uart_out = g_host_uart_fd;
+    if((g_host_uart_fd >= 0) && (0 == grantpt(g_host_uart_fd)) && (0 == unlockpt(g_host_uart_fd)))
+    {
+        name = ptsname(g_host_uart_fd);
+        g_host_uart_slave = open(name, O_RDWR | O_NOCTTY);
+    }
+
+    if((g_host_uart_slave >= 0) && (0 == tcgetattr(g_host_uart_slave, &settings)))
+    {
+        cfmakeraw(&settings);
+        tcsetattr(g_host_uart_slave, TCSANOW, &settings);
+        return_val = 0;
+
+        if(0 != link)
+        {
+            unlink(link);
+            if(0 != symlink(name, link))
+            {
+                return_val = -1;
+            }
+        }
+        fprintf(stderr, "host: UART on %s\n", (0 != link) ? link : name);
+    }
+
+    if(0 != return_val)
+    {
+        fprintf(stderr, "host: cannot create UART pseudo terminal\n");
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Set up the UART on a pseudo terminal, or on stdin/stdout if link is "-".
+ */
+int32_t host_uart_open(const char *link)
+{
+    int32_t return_val = 0;
+
+    if((0 != link) && (0 == strcmp(link, "-")))
+    {
+        g_host_uart_fd  = STDIN_FILENO;
+        g_host_uart_out = STDOUT_FILENO;
+    }
+    else
+    {
+        return_val = uart_open_pty(link);
+    }
+
+    if(0 == return_val)
+    {
+        fcntl(g_host_uart_fd, F_SETFL, O_NONBLOCK);
+    }
+
+    return(return_val);
+}
+
+/*==============================================================================
+ * CoreUARTapb driver API.
+ */
+void UART_init(UART_instance_t *this_uart, addr_t base_addr, uint16_t baud_value, uint8_t line_config)
+{
+    (void)line_config;
+    this_uart->base_address = base_addr;
+    this_uart->status       = 0;
+    /* baud_value is (SYS_CLK_FREQ / (16 * baud)) - 1 */
+    g_host_char_ns = (10ull * 16u * ((uint64_t)baud_value + 1u) * 1000000000ull) / SYS_CLK_FREQ;
+}
+
+void UART_send(UART_instance_t *this_uart, const uint8_t *tx_buffer, size_t tx_size)
+{
+    (void)this_uart;
+    host_clock_advance(g_host_char_ns * tx_size);
+    /* Output is dropped if nothing is reading the terminal */
+    if(write(g_host_uart_out, tx_buffer, tx_size) < 0)
+    {
+    }
+}
+
+size_t UART_get_rx(UART_instance_t *this_uart, uint8_t *rx_buffer, size_t buff_size)
+{
+    struct pollfd wait;
+    ssize_t received;
+    size_t return_val = 0;
+
+    (void)this_uart;
+    received = read(g_host_uart_fd, rx_buffer, buff_size);
+    if(received > 0)
+    {
+        host_clock_advance(g_host_char_ns * (uint64_t)received);
+        return_val = (size_t)received;
+    }
+    else
+    {
+        wait.fd     = g_host_uart_fd;
+        wait.events = POLLIN;
+        poll(&wait, 1, HOST_UART_IDLE_MS);
+        host_clock_advance(HOST_UART_IDLE_MS * 1000000ull);
+    }
+
+    return(return_val);
+}
@@ -0,0 +1,196 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader boot log decoder.
+ *
+ * Prints the boot log from a copy of the SPI FLASH, oldest record first, one
+ * line per record. The log is taken to be at SF2BL_FLASH_BASE with
+ * SF2BL_LOG_SIZE sectors, as configured in sf2_bl_user_opts.h, unless a base
+ * address and sector count are given. See boot_log.h for the layout.
+ *
+ * Unlike the bootloader this reads every sector header and sorts them, so it
+ * also copes with a log whose sequence numbers are not in order.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sf2_bl_options.h"
+#include "crc32.h"
+#include "boot_log.h"
+
+#define MAX_SECTORS 1024u
+
+static const char *g_mode_names[] =
+{
+    "exec", "exec_1", "exec_2", "exec_golden", "copy_golden",
+    "download", "download_1", "download_2", "download_golden"
+};
+
+typedef struct log_sector
+{
+    uint32_t index;
+    uint32_t sequence;
+} log_sector_t;
+
+/***************************************************************************//**
+ * Check the CRC32 which ends a header or record of len bytes.
+ */
+static int crc_ok(const uint8_t *data, uint32_t len)
+{
+    uint32_t crc;
+
+    memcpy(&crc, data + len - sizeof(uint32_t), sizeof(crc));
+
+    return(crc == sf2bl_calc_crc32(0xFFFFFFFF, data, len - sizeof(uint32_t)));
+}
+
+/***************************************************************************//**
+ * See if a record slot is erased.
+ */
+static int slot_free(const uint8_t *slot)
+{
+    uint32_t index = 0u;
+
+    while((index < SF2BL_LOG_RECORD_SIZE) && (0xFFu == slot[index]))
+    {
+        index++;
+    }
+
+    return(index == SF2BL_LOG_RECORD_SIZE);
+}
+
+/***************************************************************************//**
+ * Print one record.
+ */
+static void print_record(uint32_t number, const sf2bl_log_record_t *precord)
+{
+    uint32_t phase;
+
+    printf("record=%u type=%u", number, precord->type);
+    if(precord->boot_mode < (sizeof(g_mode_names) / sizeof(g_mode_names[0])))
+    {
+        printf(" mode=%s", g_mode_names[precord->boot_mode]);
+    }
+    else
+    {
+        printf(" mode=%u", precord->boot_mode);
+    }
+    printf(" result=%s", (SF2BL_LOG_RESULT_EXEC == precord->result) ? "exec" : "halt");
+    if(SF2BL_LOG_NO_SLOT != precord->slot)
+    {
+        printf(" slot=%u sequence=%u", precord->slot, precord->sequence);
+    }
+    printf(" errors=0x%08X", precord->errors);
+    if(0u != (precord->errors & SF2BL_LOG_ERR_WRITE))
+    {
+        printf(" verify_address=0x%08X", precord->verify_address);
+    }
+    printf(" metrics_flags=0x%08X", precord->metrics_flags);
+    for(phase = 0; phase < SF2BL_LOG_PHASES; phase++)
+    {
+        printf(" phase%u_ticks=%u", phase, precord->phase_ticks[phase]);
+    }
+    if((0u != precord->received) || (0u != precord->rx_errors))
+    {
+        printf(" received=%u processed=%u rx_errors=%u", precord->received, precord->processed, precord->rx_errors);
+    }
+    printf(" spi_transactions=%u spi_bytes=%u spi_polls=%u\n",
+           precord->spi_transactions, precord->spi_bytes, precord->spi_polls);
+}
+
+int main(int argc, char *argv[])
+{
+    static uint8_t sector_buf[SF2BL_LOG_SECTOR_SIZE];
+    static log_sector_t sectors[MAX_SECTORS];
+    sf2bl_log_sector_t header;
+    sf2bl_log_record_t record;
+    uint32_t base    = SF2BL_FLASH_BASE;
+    uint32_t n_total = SF2BL_LOG_SIZE;
+    uint32_t n_used  = 0u;
+    uint32_t n_records = 0u;
+    uint32_t n_bad   = 0u;
+    uint32_t index;
+    uint32_t slot;
+    log_sector_t temp;
+    FILE *fp;
+    int pos;
+
+    if((argc < 2) || (argc > 4))
+    {
+        fprintf(stderr, "usage: %s flash.bin [log-base [log-sectors]]\n", argv[0]);
+        return(1);
+    }
+    if(argc > 2)
+    {
+        base = (uint32_t)strtoul(argv[2], 0, 0);
+    }
+    if(argc > 3)
+    {
+        n_total = (uint32_t)strtoul(argv[3], 0, 0);
+    }
+    if(n_total > MAX_SECTORS)
+    {
+        n_total = MAX_SECTORS;
+    }
+
+    fp = fopen(argv[1], "rb");
+    if(0 == fp)
+    {
+        perror(argv[1]);
+        return(1);
+    }
+
+    /* Collect the sectors in use and sort them oldest first */
+    for(index = 0; index < n_total; index++)
+    {
+        if((0 == fseek(fp, (long)(base + (index * SF2BL_LOG_SECTOR_SIZE)), SEEK_SET)) &&
+           (1u == fread(&header, sizeof(header), 1, fp)) &&
+           (SF2BL_LOG_MAGIC == header.magic) && (SF2BL_LOG_RECORD_SIZE == header.record_size) &&
+           crc_ok((uint8_t *)&header, sizeof(header)))
+        {
+            temp.index    = index;
+            temp.sequence = header.sequence;
+            for(pos = (int)n_used; (pos > 0) && (sectors[pos - 1].sequence > temp.sequence); pos--)
+            {
+                sectors[pos] = sectors[pos - 1];
+            }
+            sectors[pos] = temp;
+            n_used++;
+        }
+    }
+
+    for(index = 0; index < n_used; index++)
+    {
+        if((0 != fseek(fp, (long)(base + (sectors[index].index * SF2BL_LOG_SECTOR_SIZE)), SEEK_SET)) ||
+           (1u != fread(sector_buf, sizeof(sector_buf), 1, fp)))
+        {
+            break;
+        }
+
+        for(slot = 1u; (slot <= SF2BL_LOG_RECORDS) && !slot_free(&sector_buf[slot * SF2BL_LOG_RECORD_SIZE]); slot++)
+        {
+            memcpy(&record, &sector_buf[slot * SF2BL_LOG_RECORD_SIZE], sizeof(record));
+            if(crc_ok((uint8_t *)&record, sizeof(record)))
+            {
+                print_record(((sectors[index].sequence - 1u) * SF2BL_LOG_RECORDS) + (slot - 1u), &record);
+                n_records++;
+            }
+            else
+            {
+                printf("record=%u bad_crc\n", ((sectors[index].sequence - 1u) * SF2BL_LOG_RECORDS) + (slot - 1u));
+                n_bad++;
+            }
+        }
+    }
+
+    fclose(fp);
+    printf("sectors=%u records=%u bad=%u\n", n_used, n_records, n_bad);
+
+    return(0);
+}
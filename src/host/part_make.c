@@ -0,0 +1,153 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader partition table builder.
+ *
+ * Builds a partition table from a list of slots, each given as role:size or
+ * role:size:tag where role is image, golden or data and size is in bytes with
+ * an optional K or M suffix. The slots are laid out one after another from the
+ * sector after SF2BL_PART_TABLE_ADDR, each rounded up to
+ * SF2BL_FLASH_IMAGE_GRANUALARITY, as configured in sf2_bl_user_opts.h. See
+ * boot_part.h for the layout.
+ *
+ * If the output file exists it is taken to be a copy of the SPI FLASH, such as
+ * the one used by the host build, and the table is written into it at
+ * SF2BL_PART_TABLE_ADDR. Otherwise the file is created holding just the 4K
+ * table sector, ready to be programmed at SF2BL_PART_TABLE_ADDR.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sf2_bl_options.h"
+#include "crc32.h"
+#include "boot_part.h"
+
+#define TABLE_SECTOR_SIZE 4096u
+
+static const char *g_role_names[] = { "", "image", "golden", "data" };
+
+/***************************************************************************//**
+ * Parse one slot, role:size[:tag].
+ *
+ * Returns 0 for success or -1 for error.
+ */
+static int parse_slot(const char *arg, sf2bl_part_entry_t *pentry)
+{
+    char role[16];
+    char *end;
+    unsigned long value;
+    uint32_t index;
+    int return_val = -1;
+
+    memset(pentry, 0, sizeof(*pentry));
+    for(index = 0; (index < (sizeof(role) - 1u)) && (0 != arg[index]) && (':' != arg[index]); index++)
+    {
+        role[index] = arg[index];
+    }
+    role[index] = 0;
+
+    for(pentry->role = SF2BL_PART_ROLE_IMAGE; pentry->role <= SF2BL_PART_ROLE_DATA; pentry->role++)
+    {
+        if(0 == strcmp(role, g_role_names[pentry->role]))
+        {
+            break;
+        }
+    }
+
+    if((pentry->role <= SF2BL_PART_ROLE_DATA) && (':' == arg[index]))
+    {
+        value = strtoul(&arg[index + 1u], &end, 0);
+        if(('K' == *end) || ('k' == *end))
+        {
+            value *= 1024u;
+            end++;
+        }
+        else if(('M' == *end) || ('m' == *end))
+        {
+            value *= 1024u * 1024u;
+            end++;
+        }
+
+        pentry->size = (uint32_t)((value + SF2BL_FLASH_IMAGE_GRANUALARITY - 1u) / SF2BL_FLASH_IMAGE_GRANUALARITY) *
+                       SF2BL_FLASH_IMAGE_GRANUALARITY;
+        if(':' == *end)
+        {
+            pentry->tag = (uint16_t)strtoul(end + 1, &end, 0);
+        }
+
+        if((0 == *end) && (0u != pentry->size))
+        {
+            return_val = 0;
+        }
+    }
+
+    return(return_val);
+}
+
+int main(int argc, char *argv[])
+{
+    static uint8_t sector_buf[TABLE_SECTOR_SIZE];
+    sf2bl_part_table_t *ptable = (sf2bl_part_table_t *)sector_buf;
+    sf2bl_part_entry_t *pentry = (sf2bl_part_entry_t *)(ptable + 1);
+    uint32_t next_free = SF2BL_PART_TABLE_ADDR + TABLE_SECTOR_SIZE;
+    uint32_t crc;
+    uint32_t index;
+    long position = SF2BL_PART_TABLE_ADDR;
+    FILE *fp;
+
+    if((argc < 3) || ((uint32_t)(argc - 2) > SF2BL_PART_MAX_SLOTS))
+    {
+        fprintf(stderr, "usage: %s flash.bin role:size[:tag] ...\n", argv[0]);
+        fprintf(stderr, "       role is image, golden or data, at most %u slots\n", SF2BL_PART_MAX_SLOTS);
+        return(1);
+    }
+
+    memset(sector_buf, 0xFF, sizeof(sector_buf));
+    ptable->magic   = SF2BL_PART_MAGIC;
+    ptable->version = SF2BL_PART_VERSION;
+    ptable->n_slots = (uint16_t)(argc - 2);
+    for(index = 0; index < ptable->n_slots; index++, pentry++)
+    {
+        if(0 != parse_slot(argv[index + 2u], pentry))
+        {
+            fprintf(stderr, "%s: bad slot %s\n", argv[0], argv[index + 2u]);
+            return(1);
+        }
+
+        pentry->offset = next_free;
+        next_free += pentry->size;
+        if(next_free > SF2BL_FLASH_SIZE)
+        {
+            fprintf(stderr, "%s: slot %u does not fit in SF2BL_FLASH_SIZE\n", argv[0], index);
+            return(1);
+        }
+        printf("slot=%u role=%s offset=0x%08X size=0x%08X tag=%u\n",
+               index, g_role_names[pentry->role], pentry->offset, pentry->size, pentry->tag);
+    }
+
+    crc = sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)ptable, sizeof(sf2bl_part_table_t) - sizeof(uint32_t));
+    ptable->crc32 = sf2bl_calc_crc32(crc, (uint8_t *)(ptable + 1), ptable->n_slots * sizeof(sf2bl_part_entry_t));
+
+    fp = fopen(argv[1], "r+b");
+    if(0 == fp)
+    {
+        fp = fopen(argv[1], "wb");
+        position = 0;
+    }
+    if((0 == fp) || (0 != fseek(fp, position, SEEK_SET)) || (1u != fwrite(sector_buf, sizeof(sector_buf), 1, fp)))
+    {
+        perror(argv[1]);
+        return(1);
+    }
+
+    fclose(fp);
+    printf("table=0x%08X slots=%u\n", SF2BL_PART_TABLE_ADDR, ptable->n_slots);
+
+    return(0);
+}
@@ -84,6 +84,7 @@
 #define CORETIMER1_BASE_ADDR            0x70004000UL
 #define COREGPIO_OUT_BASE_ADDR          0x70005000UL
 #define FLASH_CORE_SPI_BASE             0x70006000UL
+#define FLASH_DMA_BASE_ADDR             0x70007000UL /* CoreAXI4DMAController, SF2BL_FLASH_USE_DMA */
 
 /***************************************************************************//**
  * Peripheral Interrupts are mapped to the corresponding Cortex-M1 interrupt
@@ -106,6 +107,9 @@
 #define TIMER0_IRQn                     External_30_IRQn
 #define TIMER1_IRQn                     External_31_IRQn
 
+/* Must match the PLIC input the CoreSPI interrupt is wired to, SF2BL_SPI_ASYNC */
+#define FLASH_CORE_SPI_IRQn             External_29_IRQn
+
 /****************************************************************************
  * Baud value to achieve a 115200 baud rate with a 83MHz system clock.
  * This value is calculated using the following equation:
@@ -16,6 +16,11 @@
 #include "image_tools.h"
 #include "crc32.h"
 #include "ymodem.h"
+#include "lz4.h"
+#include "boot_record.h"
+#include "boot_log.h"
+#include "boot_part.h"
+#include "boot_metrics.h"
 
 /*
  * Length of the buffer we allocate for intermediate buffering of data for FLASH
@@ -46,6 +51,19 @@ uint32_t           g_golden_img_offset;
 sf2bl_hdr_status_t g_golden_img_status;
 #endif
 
+#if defined(SF2BL_FLASH_BG_ERASE)
+/*
+ * Image slot erased in the background while a download arrives, or
+ * SF2BL_NO_IMAGE, and how many bytes of it have been queued for erasing.
+ */
+static uint32_t g_erase_ahead_offset = SF2BL_NO_IMAGE;
+static uint32_t g_erase_ahead_len;
+static uint32_t g_erase_ahead_size; /* Size of the slot */
+
+/* The erase is kept at least this far ahead of the image, in whole blocks */
+#define ERASE_AHEAD_BYTES 65536u
+#endif
+
 
 /***************************************************************************//**
  * Support routines for reading, writing and verifying application images in the
@@ -84,70 +102,716 @@ int32_t sf2bl_wr_flash_image(uint32_t address, uint32_t size)
     uint32_t index;
     uint32_t temp;
     uint32_t block_count;
+    uint32_t erased = 0;
     spi_flash_status_t flash_result = SPI_FLASH_SUCCESS;
 
-    if(0 != size)
+#if defined(SF2BL_PART_TABLE)
+    /* Slots can be any size so make sure the image fits */
+    if(size > sf2bl_part_size(address))
+    {
+        size = 0u;
+        flash_result = SPI_FLASH_UNSUCCESS;
+    }
+#endif
+
+    if(0 != size)
+    {
+        /* Calculate number of blocks required by rounding up. */
+        block_count = (size + (SF2BL_FLASH_IMAGE_GRANUALARITY-1)) / SF2BL_FLASH_IMAGE_GRANUALARITY;
+
+#if defined(SF2BL_FLASH_BG_ERASE)
+        /* Some or all of the image may have been erased during the download */
+        if(address == g_erase_ahead_offset)
+        {
+            if(SPI_FLASH_SUCCESS == spi_flash_erase_wait())
+            {
+                erased = g_erase_ahead_len;
+            }
+            g_erase_ahead_offset = SF2BL_NO_IMAGE;
+        }
+#endif
+        /* Erase the blocks, the driver uses the largest erase it can */
+        if((block_count * SF2BL_FLASH_IMAGE_GRANUALARITY) > erased)
+        {
+            flash_result = spi_flash_erase(address + erased, (block_count * SF2BL_FLASH_IMAGE_GRANUALARITY) - erased);
+        }
+
+        /* Recalculate number of blocks required in case sector buffer is not same size as FLASH erase block. */
+        block_count = (size + (SECTOR_BUF_LEN-1)) / SECTOR_BUF_LEN;
+        for(index = 0; (SPI_FLASH_SUCCESS == flash_result) && (index < block_count); index++)
+        {
+            /*
+             * We use an intermediate buffer in eSRAM as the PDMA does not work
+             * properly with DDR and the HPDMA does not provide the ping pong
+             * buffer functionality that the SPI FLASH driver uses.
+             */
+            memcpy(g_sector_buffer, &g_bin_base[index * SECTOR_BUF_LEN], SECTOR_BUF_LEN);
+            if(index != block_count - 1) /* Last block handled separately... */
+            {
+                flash_result = spi_flash_write(address +(index * SECTOR_BUF_LEN), g_sector_buffer, SECTOR_BUF_LEN, 0);
+            }
+            else
+            {
+                /*
+                 * The last block may be less than a full buffer in size so we
+                 * will only write what is required. It does not really make a
+                 * lot of difference as we are allocating a full sector in the
+                 * FLASH for it but this is more consistent.
+                 */
+                temp = size % SECTOR_BUF_LEN;
+                if(0 == temp) /* Ended exactly on a buffer length boundary! */
+                {
+                    temp = SECTOR_BUF_LEN;
+                }
+                flash_result = spi_flash_write(address + (index * SECTOR_BUF_LEN), g_sector_buffer, temp, 0);
+                if(SPI_FLASH_SUCCESS == flash_result)
+                {
+                    /*
+                     * Mark image as valid. We already calculated the header CRC
+                     * based on a valid block so we only have to update the
+                     * header to make it so.
+                     */
+                    temp = SF2BL_IMG_HDR_VALID;
+                    flash_result = spi_flash_write(address, (uint8_t *)&temp, sizeof(temp), 0);
+                }
+            }
+        }
+    }
+
+    if(SPI_FLASH_SUCCESS != flash_result)
+    {
+        SF2BL_LOG_ERROR(SF2BL_LOG_ERR_WRITE)
+    }
+
+    return(SPI_FLASH_SUCCESS == flash_result ? 0 : -1);
+}
+
+#if defined(SF2BL_FLASH_BG_ERASE)
+/***************************************************************************//**
+ * Select the image slot the download for g_boot_mode will be written to for
+ * erasing as the download arrives. The golden image is never erased before
+ * the whole file has been received and processed.
+ */
+void sf2bl_erase_ahead_init(void)
+{
+    g_erase_ahead_offset = SF2BL_NO_IMAGE;
+    g_erase_ahead_len    = 0u;
+    g_erase_ahead_size   = SF2BL_IMAGE_SIZE;
+    if(SF2BL_BOOT_DOWNLOAD_1 == g_boot_mode)
+    {
+#if defined(SF2BL_PART_TABLE)
+        /* Image 1 is kept as the delta source, the download goes elsewhere */
+        g_erase_ahead_offset = sf2bl_part_target();
+        g_erase_ahead_size   = sf2bl_part_size(g_erase_ahead_offset);
+#else
+        g_erase_ahead_offset = g_img1_offset;
+#endif
+    }
+#if defined(SF2BL_2ND_IMAGE)
+    else if(SF2BL_BOOT_DOWNLOAD_2 == g_boot_mode)
+    {
+        g_erase_ahead_offset = g_img2_offset;
+    }
+#endif
+}
+
+/***************************************************************************//**
+ * Keep the background erase of the slot chosen by sf2bl_erase_ahead_init() at
+ * least ERASE_AHEAD_BYTES ahead of the first bytes bytes of the image being
+ * received. Called for each packet so the erase overlaps the transfer, the
+ * SPI FLASH driver starting the next block erase each time one completes.
+ * sf2bl_wr_flash_image() erases whatever is left.
+ */
+void sf2bl_erase_ahead(uint32_t bytes)
+{
+    spi_flash_status_t flash_result;
+    uint32_t want;
+
+    if(SF2BL_NO_IMAGE != g_erase_ahead_offset)
+    {
+        want = (g_erase_ahead_offset + bytes + (2u * ERASE_AHEAD_BYTES) - 1u) & ~(ERASE_AHEAD_BYTES - 1u);
+        want -= g_erase_ahead_offset;
+        if(want > g_erase_ahead_size)
+        {
+            want = g_erase_ahead_size;
+        }
+
+        if(want > g_erase_ahead_len)
+        {
+            flash_result = spi_flash_erase_start(g_erase_ahead_offset + g_erase_ahead_len, want - g_erase_ahead_len);
+            g_erase_ahead_len = want;
+        }
+        else
+        {
+            flash_result = spi_flash_erase_poll();
+        }
+
+        if((SPI_FLASH_SUCCESS != flash_result) && (SPI_FLASH_BUSY != flash_result))
+        {
+            /* Leave it all to sf2bl_wr_flash_image() */
+            g_erase_ahead_offset = SF2BL_NO_IMAGE;
+        }
+    }
+}
+#endif
+
+
+/*
+ * Decoder state for the compressed data streamed through rd_lz4_stream().
+ */
+typedef struct lz4_read
+{
+    sf2bl_lz4_t lz4_ctx;
+    uint32_t   *crc;
+    int32_t     error;
+} lz4_read_t;
+
+/***************************************************************************//**
+ * spi_flash_read_long() chunk handler for rd_lz4_data().
+ */
+
+static void rd_lz4_stream(uint8_t *chunk, uint32_t chunk_len, void *context)
+{
+    lz4_read_t *pread = (lz4_read_t *)context;
+
+    *pread->crc = sf2bl_calc_crc32(*pread->crc, chunk, chunk_len);
+    if((0 == pread->error) && (0 != sf2bl_lz4_decode(&pread->lz4_ctx, chunk, chunk_len)))
+    {
+        pread->error = 1;
+    }
+}
+
+
+/***************************************************************************//**
+ * Read packed_len bytes of LZ4 compressed chunk data from SPI FLASH at src and
+ * decompress it to dest. The compressed data is read with one read command
+ * and streamed through the sector buffer to the decoder so no intermediate
+ * copy of the decompressed chunk is required. The first buf_len bytes are
+ * taken from buf instead, if they have already been read.
+ *
+ * *crc is updated with the stored data.
+ */
+
+static spi_flash_status_t rd_lz4_data(uint32_t src, uint32_t packed_len, uint8_t *buf, uint32_t buf_len,
+                                      uint8_t *dest, uint32_t len, uint32_t *crc)
+{
+    spi_flash_status_t flash_result = SPI_FLASH_SUCCESS;
+    lz4_read_t lz4_read;
+
+    sf2bl_lz4_init(&lz4_read.lz4_ctx, dest, len);
+    lz4_read.crc   = crc;
+    lz4_read.error = 0;
+
+    if(0u != buf_len)
+    {
+        rd_lz4_stream(buf, buf_len, &lz4_read);
+    }
+    if(packed_len > buf_len)
+    {
+        flash_result = spi_flash_read_long(src + buf_len, g_sector_buffer, packed_len - buf_len, SECTOR_BUF_LEN,
+                                           rd_lz4_stream, &lz4_read);
+    }
+
+    /* Chunk must decompress to exactly the length in the chunk header */
+    if((SPI_FLASH_SUCCESS == flash_result) &&
+       ((0 != lz4_read.error) || (0 != sf2bl_lz4_block_done(&lz4_read.lz4_ctx))))
+    {
+        flash_result = SPI_FLASH_UNSUCCESS;
+    }
+
+    return(flash_result);
+}
+
+
+/***************************************************************************//**
+ * Read an LZ4 compressed chunk, i.e. the compressed length followed by the
+ * compressed data, from SPI FLASH and decompress it to dest.
+ *
+ * *src is advanced past the chunk and *crc is updated with the stored data.
+ */
+
+static spi_flash_status_t rd_lz4_chunk(uint32_t *src, uint8_t *dest, uint32_t len, uint32_t *crc)
+{
+    spi_flash_status_t flash_result;
+    uint32_t packed_len;
+
+    flash_result = spi_flash_read(*src, (uint8_t *)&packed_len, sizeof(packed_len));
+    if(SPI_FLASH_SUCCESS == flash_result)
+    {
+        *crc = sf2bl_calc_crc32(*crc, (uint8_t *)&packed_len, sizeof(packed_len));
+        *src += sizeof(packed_len);
+        flash_result = rd_lz4_data(*src, packed_len, 0, 0u, dest, len, crc);
+        *src += packed_len;
+    }
+
+    return(flash_result);
+}
+
+
+/***************************************************************************//**
+ * Image load planning.
+ *
+ * Every SPI FLASH read costs a command, address and busy poll (plus the 4 byte
+ * address mode switching on large devices) so the image is loaded with as few
+ * reads as possible. A list is made of where each chunk is in the FLASH and
+ * where it goes in RAM, each entry is checked before anything is loaded and
+ * then the chunk data is read straight into place with long reads.
+ *
+ * For version 1 images the list is made from the chunk headers, which are
+ * collected a sector buffer at a time so a run of small chunks costs a single
+ * read. Chunk data which came in with the headers is taken from the sector
+ * buffer rather than read again, so each byte of the image is read once. The
+ * image CRC32 can only be checked once everything is loaded.
+ *
+ * For version 2 images the list is read straight from the chunk index and each
+ * chunk is checked against its own CRC32 as soon as it is loaded. A chunk which
+ * fails is read again, up to LOAD_TRIES times, before the load is abandoned.
+ *
+ * The plan is made LOAD_PLAN_LEN chunks at a time so there is no limit on the
+ * number of chunks in an image.
+ */
+
+/*
+ * Number of chunks planned at a time, read burst size and attempts at loading
+ * a version 2 chunk. With SF2BL_SPI_ASYNC an uncompressed chunk is
+ * read in bursts so the CRC32 of one burst is done while the next is read. Only
+ * the last burst is not overlapped, while each burst costs another read
+ * command, so 32K keeps the command overhead well under 0.1%.
+ */
+#define LOAD_PLAN_LEN  32
+#define LOAD_BURST_LEN 32768u
+#define LOAD_TRIES     3
+
+/*
+ * Where a chunk is in FLASH and where it is loaded to.
+ */
+typedef struct load_extent
+{
+    img_chunk_hdr_t hdr;        /* Copy of chunk header, covered by the CRC */
+    uint32_t        src;        /* FLASH address of stored chunk data */
+    uint32_t        packed_len; /* Compressed length of LZ4 chunk */
+    uint32_t        crc32;      /* CRC32 of stored data, version 2 only */
+    uint8_t        *dest;       /* RAM address chunk is loaded to */
+    uint8_t        *buf;        /* Start of stored data in the sector buffer */
+    uint32_t        buf_len;    /* Amount of stored data in the sector buffer */
+} load_extent_t;
+
+static load_extent_t g_load_plan[LOAD_PLAN_LEN];
+
+/*
+ * Bootloader RAM from the linker script, from the start of its code or data in
+ * DDR to the end of the stack.
+ */
+extern uint8_t _bl_ram_start[];
+extern uint8_t _end[];
+
+
+/***************************************************************************//**
+ * Work out where a planned chunk goes in RAM and check it is safe to load. The
+ * stored bytes must lie within the image, which ends at img_end in the FLASH,
+ * and the chunk must not load over the Bootloader's RAM.
+ */
+
+static spi_flash_status_t place_extent(load_extent_t *pextent, uint32_t stored, uint32_t img_end)
+{
+    spi_flash_status_t flash_result = SPI_FLASH_SUCCESS;
+
+    pextent->dest = (uint8_t *)(pextent->hdr.base + pextent->hdr.offset);
+    if(pextent->dest < (uint8_t *)0x20000000)
+    {
+        /* data for the code space should be written through the DDR primary
+         * addresses and not the cached code addresses as we (in eNVM) are
+         * currently mapped into the cached code ares.
+         */
+        pextent->dest += 0xA0000000;
+    }
+
+    if((pextent->src > img_end) || (stored > (img_end - pextent->src)) ||
+       (pextent->hdr.len > (0xFFFFFFFFu - (uint32_t)pextent->dest)))
+    {
+        flash_result = SPI_FLASH_UNSUCCESS;
+    }
+    else if((pextent->dest < _end) && ((pextent->dest + pextent->hdr.len) > _bl_ram_start))
+    {
+        SF2BL_MESSAGE("Image overlaps Bootloader RAM!\r\n")
+        flash_result = SPI_FLASH_UNSUCCESS;
+    }
+
+    return(flash_result);
+}
+
+
+/***************************************************************************//**
+ * Plan the loading of up to LOAD_PLAN_LEN chunks of a version 1 image starting
+ * with the chunk header at *src. The sector buffer is filled from *src and
+ * planning stops at the first header which is not in it, so that chunk data
+ * in the sector buffer is still there when the chunks are loaded.
+ *
+ * *src is advanced past the chunks planned and *count is set to the number of
+ * chunks planned.
+ */
+
+static spi_flash_status_t plan_load(uint32_t *src, uint32_t img_end, uint32_t remaining, uint32_t *count)
+{
+    spi_flash_status_t flash_result = SPI_FLASH_SUCCESS;
+    load_extent_t *pextent;
+    uint32_t win_addr = *src;
+    uint32_t win_len = 0;
+    uint32_t in_window = 1;
+    uint32_t need;
+    uint32_t stored;
+    uint32_t index = 0;
+
+    if(*src < img_end)
+    {
+        win_len = ((img_end - *src) > SECTOR_BUF_LEN) ? SECTOR_BUF_LEN : (img_end - *src);
+        flash_result = spi_flash_read(win_addr, g_sector_buffer, win_len);
+    }
+
+    while((SPI_FLASH_SUCCESS == flash_result) && (0u != in_window) && (index < remaining) && (index < LOAD_PLAN_LEN))
+    {
+        pextent = &g_load_plan[index];
+
+        /* Header plus compressed length of an LZ4 chunk if the image has room */
+        need = sizeof(img_chunk_hdr_t) + sizeof(uint32_t);
+        if((*src >= img_end) || ((img_end - *src) < sizeof(img_chunk_hdr_t)))
+        {
+            flash_result = SPI_FLASH_UNSUCCESS;
+        }
+        else
+        {
+            if((img_end - *src) < need)
+            {
+                need = img_end - *src;
+            }
+
+            /* The first header is always in the sector buffer */
+            in_window = (((*src - win_addr) + need) <= win_len) ? 1u : 0u;
+        }
+
+        if((SPI_FLASH_SUCCESS == flash_result) && (0u != in_window))
+        {
+            /* Chunk headers are not necessarily word aligned in the image */
+            memcpy(&pextent->hdr, &g_sector_buffer[*src - win_addr], sizeof(img_chunk_hdr_t));
+            pextent->src = *src + sizeof(img_chunk_hdr_t);
+            pextent->packed_len = 0;
+
+            if(0u != (pextent->hdr.index & SF2BL_CHUNK_ZERO_FILL))
+            {
+                stored = 0; /* Nothing stored for this chunk */
+            }
+            else if(0u != (g_img1_header.flags & SF2BL_IMG_FLAG_LZ4))
+            {
+                if(need < (sizeof(img_chunk_hdr_t) + sizeof(uint32_t)))
+                {
+                    flash_result = SPI_FLASH_UNSUCCESS;
+                }
+                else
+                {
+                    memcpy(&pextent->packed_len, &g_sector_buffer[pextent->src - win_addr], sizeof(uint32_t));
+                    pextent->src += sizeof(uint32_t);
+                }
+                stored = pextent->packed_len;
+            }
+            else
+            {
+                stored = pextent->hdr.len;
+            }
+
+            if(SPI_FLASH_SUCCESS == flash_result)
+            {
+                flash_result = place_extent(pextent, stored, img_end);
+            }
+
+            if(SPI_FLASH_SUCCESS == flash_result)
+            {
+                /* The header is in the sector buffer so the data starts in or just after it */
+                pextent->buf = &g_sector_buffer[pextent->src - win_addr];
+                pextent->buf_len = win_len - (pextent->src - win_addr);
+                if(pextent->buf_len > stored)
+                {
+                    pextent->buf_len = stored;
+                }
+                *src = pextent->src + stored;
+                index++;
+            }
+        }
+    }
+
+    *count = index;
+    return(flash_result);
+}
+
+
+/***************************************************************************//**
+ * Plan the loading of up to LOAD_PLAN_LEN chunks of a version 2 image starting
+ * with the chunk index entry at src. The entries are fetched with one read.
+ */
+
+static spi_flash_status_t plan_indexed_load(uint32_t address, uint32_t src, uint32_t img_end, uint32_t count)
+{
+    spi_flash_status_t flash_result;
+    load_extent_t *pextent;
+    img_chunk_idx_t *pidx;
+    uint32_t index;
+
+    /* LOAD_PLAN_LEN entries fit easily in the sector buffer */
+    flash_result = spi_flash_read(src, g_sector_buffer, count * sizeof(img_chunk_idx_t));
+    pidx = (img_chunk_idx_t *)g_sector_buffer;
+
+    for(index = 0; (SPI_FLASH_SUCCESS == flash_result) && (index < count); index++)
+    {
+        pextent = &g_load_plan[index];
+        pextent->hdr.base   = pidx[index].dest & 0xFFFF0000u;
+        pextent->hdr.offset = pidx[index].dest & 0x0000FFFFu;
+        pextent->hdr.len    = pidx[index].len;
+        pextent->hdr.index  = pidx[index].index;
+        pextent->src        = address + pidx[index].offset;
+        pextent->packed_len = pidx[index].stored;
+        pextent->crc32      = pidx[index].crc32;
+        pextent->buf        = 0;
+        pextent->buf_len    = 0u;
+
+        if((pidx[index].offset > (img_end - address)) ||
+           ((0u == (pidx[index].index & SF2BL_CHUNK_ZERO_FILL)) &&
+            (0u == (g_img1_header.flags & SF2BL_IMG_FLAG_LZ4)) && (pidx[index].stored != pidx[index].len)))
+        {
+            flash_result = SPI_FLASH_UNSUCCESS;
+        }
+        else
+        {
+            flash_result = place_extent(pextent, pidx[index].stored, img_end);
+        }
+    }
+
+    return(flash_result);
+}
+
+
+/***************************************************************************//**
+ * Load a planned chunk, updating *crc with the stored data. Any of the stored
+ * data already in the sector buffer is taken from there.
+ */
+
+static spi_flash_status_t load_extent(load_extent_t *pextent, uint32_t *crc)
+{
+    spi_flash_status_t flash_result = SPI_FLASH_SUCCESS;
+    uint32_t src;
+    uint8_t *dest;
+    uint32_t len;
+#if defined(SF2BL_SPI_ASYNC)
+    uint32_t temp;
+    uint8_t *prev;
+    uint32_t prev_len;
+#endif
+
+    if(0u != (pextent->hdr.index & SF2BL_CHUNK_ZERO_FILL))
+    {
+        memset(pextent->dest, 0, pextent->hdr.len);
+    }
+    else if(0u != (g_img1_header.flags & SF2BL_IMG_FLAG_LZ4))
+    {
+        flash_result = rd_lz4_data(pextent->src, pextent->packed_len, pextent->buf, pextent->buf_len,
+                                   pextent->dest, pextent->hdr.len, crc);
+    }
+    else
+    {
+        /* Straight into place, apart from what is already in the sector buffer */
+        if(0u != pextent->buf_len)
+        {
+            memcpy(pextent->dest, pextent->buf, pextent->buf_len);
+        }
+        src  = pextent->src + pextent->buf_len;
+        dest = pextent->dest + pextent->buf_len;
+        len  = pextent->hdr.len - pextent->buf_len;
+#if defined(SF2BL_SPI_ASYNC)
+        /* CRC32 each burst while the next one is read */
+        prev     = pextent->dest;
+        prev_len = pextent->buf_len;
+        while((len > 0) && (SPI_FLASH_SUCCESS == flash_result))
+        {
+            temp = (len > LOAD_BURST_LEN) ? LOAD_BURST_LEN : len;
+            flash_result = spi_flash_read_start(src, dest, temp);
+            if(SPI_FLASH_SUCCESS == flash_result)
+            {
+                if(0u != prev_len)
+                {
+                    *crc = sf2bl_calc_crc32(*crc, prev, prev_len);
+                }
+                flash_result = spi_flash_read_wait();
+            }
+            prev     = dest;
+            prev_len = temp;
+            src  += temp;
+            dest += temp;
+            len  -= temp;
+        }
+        if(SPI_FLASH_SUCCESS == flash_result)
+        {
+            *crc = sf2bl_calc_crc32(*crc, prev, prev_len);
+        }
+#else
+        /* One read command for the rest of the chunk, whatever its size */
+        if(0u != len)
+        {
+            flash_result = spi_flash_read_long(src, dest, len, 0u, 0, 0);
+        }
+        *crc = sf2bl_calc_crc32(*crc, pextent->dest, pextent->hdr.len);
+#endif
+    }
+
+    return(flash_result);
+}
+
+
+#if defined(SF2BL_WARM_BOOT)
+/***************************************************************************//**
+ * Add a loaded chunk to the boot record. chunk_crc is the CRC32 of its stored
+ * data, which is also that of the RAM it was loaded to unless it was
+ * compressed.
+ */
+
+static void record_extent(const load_extent_t *pextent, uint32_t chunk_crc)
+{
+    uint32_t flags = 0u;
+
+    if(0u != (pextent->hdr.index & SF2BL_CHUNK_ZERO_FILL))
+    {
+        flags = SF2BL_REGION_ZERO_FILL;
+    }
+    else if(0u == (g_img1_header.flags & SF2BL_IMG_FLAG_LZ4))
+    {
+        flags = SF2BL_REGION_CRC;
+    }
+    sf2bl_boot_record_add(pextent->dest, pextent->hdr.len, flags, chunk_crc);
+}
+#endif
+
+
+/***************************************************************************//**
+ * Load the count chunks in the plan for a version 1 image, updating *crc with
+ * the chunk headers and stored data in FLASH order. The stored data of each
+ * chunk gets a CRC32 of its own, which is folded into *crc, so that it can be
+ * used for the boot record too.
+ */
+
+static spi_flash_status_t load_planned(uint32_t count, uint32_t *crc)
+{
+    spi_flash_status_t flash_result = SPI_FLASH_SUCCESS;
+    load_extent_t *pextent;
+    uint32_t chunk_crc;
+    uint32_t stored;
+    uint32_t index;
+
+    for(index = 0; (SPI_FLASH_SUCCESS == flash_result) && (index < count); index++)
+    {
+        pextent = &g_load_plan[index];
+        *crc = sf2bl_calc_crc32(*crc, (uint8_t *)&pextent->hdr, sizeof(img_chunk_hdr_t));
+        stored = pextent->hdr.len;
+        if(0u != (pextent->hdr.index & SF2BL_CHUNK_ZERO_FILL))
+        {
+            stored = 0u;
+        }
+        else if(0u != (g_img1_header.flags & SF2BL_IMG_FLAG_LZ4))
+        {
+            *crc = sf2bl_calc_crc32(*crc, (uint8_t *)&pextent->packed_len, sizeof(uint32_t));
+            stored = pextent->packed_len;
+        }
+        chunk_crc = 0xFFFFFFFF;
+        flash_result = load_extent(pextent, &chunk_crc);
+        *crc = sf2bl_crc32_combine(*crc, chunk_crc, stored);
+        SF2BL_METRICS_LOADED(pextent->dest, pextent->hdr.len)
+#if defined(SF2BL_WARM_BOOT)
+        record_extent(pextent, chunk_crc);
+#endif
+    }
+
+    return(flash_result);
+}
+
+
+/***************************************************************************//**
+ * Load the count chunks in the plan for a version 2 image, checking each one
+ * against its CRC32 and retrying any which fail.
+ */
+
+static spi_flash_status_t load_indexed(uint32_t count)
+{
+    spi_flash_status_t flash_result = SPI_FLASH_SUCCESS;
+    load_extent_t *pextent;
+    uint32_t index;
+    uint32_t tries;
+    uint32_t crc;
+
+    for(index = 0; (SPI_FLASH_SUCCESS == flash_result) && (index < count); index++)
+    {
+        pextent = &g_load_plan[index];
+        tries = 0;
+        do
+        {
+            if(0u != tries)
+            {
+                SF2BL_MESSAGE("Chunk CRC error, retrying.\r\n")
+            }
+            crc = 0xFFFFFFFF;
+            flash_result = load_extent(pextent, &crc);
+            tries++;
+        } while(((SPI_FLASH_SUCCESS != flash_result) || (crc != pextent->crc32)) && (tries < LOAD_TRIES));
+
+        if((SPI_FLASH_SUCCESS == flash_result) && (crc != pextent->crc32))
+        {
+            flash_result = SPI_FLASH_VERIFY_FAIL;
+        }
+        SF2BL_METRICS_LOADED(pextent->dest, pextent->hdr.len)
+#if defined(SF2BL_WARM_BOOT)
+        record_extent(pextent, crc);
+#endif
+    }
+
+    return(flash_result);
+}
+
+
+/***************************************************************************//**
+ * Check the chunk index of the version 2 image at address against its CRC32.
+ * The index is read a sector buffer at a time, normally in one go.
+ */
+
+static spi_flash_status_t check_chunk_index(uint32_t address)
+{
+    spi_flash_status_t flash_result = SPI_FLASH_SUCCESS;
+    uint32_t entries_len;
+    uint32_t table_len;
+    uint32_t table_crc = 0;
+    uint32_t pos;
+    uint32_t temp;
+    uint32_t index;
+    uint32_t crc;
+
+    entries_len = g_img1_header.n_chunks * sizeof(img_chunk_idx_t);
+    table_len = SF2BL_IDX_TABLE_LEN(g_img1_header.n_chunks);
+    crc = 0xFFFFFFFF;
+
+    for(pos = 0; (SPI_FLASH_SUCCESS == flash_result) && (pos < table_len); pos += temp)
     {
-        /* Calculate number of blocks required by rounding up. */
-        block_count = (size + (SF2BL_FLASH_IMAGE_GRANUALARITY-1)) / SF2BL_FLASH_IMAGE_GRANUALARITY;
-
-        /* Erase each 4K block */
-        for(index = 0; (SPI_FLASH_SUCCESS == flash_result) && (index < block_count); index++)
+        temp = ((table_len - pos) > SECTOR_BUF_LEN) ? SECTOR_BUF_LEN : (table_len - pos);
+        flash_result = spi_flash_read(address + sizeof(img_hdr_block_t) + pos, g_sector_buffer, temp);
+        if(pos < entries_len)
         {
-#if (SF2BL_FLASH_DEVICE == SF2BL_FLASH_DEV_AT25DF641)
-            flash_result = spi_flash_control_hw(SPI_FLASH_SECTOR_UNPROTECT, address + (index * SF2BL_FLASH_IMAGE_GRANUALARITY), 0);
-            if(SPI_FLASH_SUCCESS == flash_result)
-            {
-                flash_result = spi_flash_control_hw(SPI_FLASH_4KBLOCK_ERASE, address + (index * SF2BL_FLASH_IMAGE_GRANUALARITY), 0);
-            }
-#else
-            flash_result = spi_flash_control_hw(SPI_FLASH_4KBLOCK_ERASE, address + (index * SF2BL_FLASH_IMAGE_GRANUALARITY), 0);
-#endif
+            crc = sf2bl_calc_crc32(crc, g_sector_buffer, ((entries_len - pos) < temp) ? (entries_len - pos) : temp);
         }
 
-        /* Recalculate number of blocks required in case sector buffer is not same size as FLASH erase block. */
-        block_count = (size + (SECTOR_BUF_LEN-1)) / SECTOR_BUF_LEN;
-        for(index = 0; (SPI_FLASH_SUCCESS == flash_result) && (index < block_count); index++)
+        /* The CRC32 of the entries may be split across reads */
+        for(index = 0; index < temp; index++)
         {
-            /*
-             * We use an intermediate buffer in eSRAM as the PDMA does not work
-             * properly with DDR and the HPDMA does not provide the ping pong
-             * buffer functionality that the SPI FLASH driver uses.
-             */
-            memcpy(g_sector_buffer, &g_bin_base[index * SECTOR_BUF_LEN], SECTOR_BUF_LEN);
-            if(index != block_count - 1) /* Last block handled separately... */
-            {
-                flash_result = spi_flash_write(address +(index * SECTOR_BUF_LEN), g_sector_buffer, SECTOR_BUF_LEN, 0);
-            }
-            else
+            if((pos + index) >= entries_len)
             {
-                /*
-                 * The last block may be less than a full buffer in size so we
-                 * will only write what is required. It does not really make a
-                 * lot of difference as we are allocating a full sector in the
-                 * FLASH for it but this is more consistent.
-                 */
-                temp = size % SECTOR_BUF_LEN;
-                if(0 == temp) /* Ended exactly on a buffer length boundary! */
-                {
-                    temp = SECTOR_BUF_LEN;
-                }
-                flash_result = spi_flash_write(address + (index * SECTOR_BUF_LEN), g_sector_buffer, temp, 0);
-                if(SPI_FLASH_SUCCESS == flash_result)
-                {
-                    /*
-                     * Mark image as valid. We already calculated the header CRC
-                     * based on a valid block so we only have to update the
-                     * header to make it so.
-                     */
-                    temp = SF2BL_IMG_HDR_VALID;
-                    flash_result = spi_flash_write(address, (uint8_t *)&temp, sizeof(temp), 0);
-                }
+                ((uint8_t *)&table_crc)[(pos + index) - entries_len] = g_sector_buffer[index];
             }
         }
     }
 
-    return(SPI_FLASH_SUCCESS == flash_result ? 0 : -1);
+    return(((SPI_FLASH_SUCCESS == flash_result) && (crc != table_crc)) ? SPI_FLASH_UNSUCCESS : flash_result);
 }
 
 
@@ -160,77 +824,97 @@ int32_t sf2bl_wr_flash_image(uint32_t address, uint32_t size)
  *
  * g_img1_header is loaded with the image header.
  *
+ * If the image header has the SF2BL_IMG_FLAG_LZ4 flag set the chunk data is
+ * decompressed on the fly as it is read. Chunks marked SF2BL_CHUNK_ZERO_FILL
+ * have no data stored and are simply cleared.
+ *
+ * Version 2 images are checked a chunk at a time and loading stops at the first
+ * chunk that cannot be read correctly.
+ *
  * Returns 0 for success or -1 for error.
  */
 
 int32_t sf2bl_rd_flash_image(uint32_t address)
 {
     spi_flash_status_t flash_result;
-    uint32_t block_count;
-    uint32_t index;
+    uint32_t remaining;
     uint32_t img_src_offset;
-    uint8_t *img_dst_offset;
-    uint32_t temp;
+    uint32_t img_end;
+    uint32_t count;
     uint32_t crc;
+    int32_t return_val;
+
+#if defined(SF2BL_WARM_BOOT)
+    /* Whatever was in RAM is about to be replaced */
+    sf2bl_boot_record_begin(address);
+#endif
 
     flash_result = spi_flash_read(address, (uint8_t *)&g_img1_header, sizeof(g_img1_header));
     img_src_offset = address + sizeof(g_img1_header);
+    img_end = address + g_img1_header.size;
+    remaining = g_img1_header.n_chunks;
     crc = 0xFFFFFFFF;
 
-    for(index = 0; (SPI_FLASH_SUCCESS == flash_result) && (index < g_img1_header.n_chunks) ; index++)
+    if((SPI_FLASH_SUCCESS == flash_result) && (g_img1_header.size < sizeof(g_img1_header)))
     {
-        img_chunk_hdr_t chunk_hdr;
-        flash_result = spi_flash_read(img_src_offset, (uint8_t *)&chunk_hdr, sizeof(chunk_hdr));
+        flash_result = SPI_FLASH_UNSUCCESS;
+    }
+
+    if(SF2BL_IMG_VERSION_2 == g_img1_header.version)
+    {
+        /* Guard against the index length overflowing */
+        if((SPI_FLASH_SUCCESS == flash_result) &&
+           (remaining > ((g_img1_header.size - sizeof(g_img1_header)) / sizeof(img_chunk_idx_t))))
+        {
+            flash_result = SPI_FLASH_UNSUCCESS;
+        }
+
         if(SPI_FLASH_SUCCESS == flash_result)
         {
-            crc = sf2bl_calc_crc32(crc, (uint8_t *)&chunk_hdr, sizeof(chunk_hdr));
-            img_src_offset += sizeof(chunk_hdr);
-            img_dst_offset = (uint8_t *)(chunk_hdr.base + chunk_hdr.offset);
-            if(img_dst_offset < (uint8_t *)0x20000000)
-            {
-                /* data for the code space should be written through the DDR primary
-                 * addresses and not the cached code addresses as we (in eNVM) are
-                 * currently mapped into the cached code ares.
-                 */
-                img_dst_offset += 0xA0000000;
-            }
+            flash_result = check_chunk_index(address);
+        }
 
-            block_count = (chunk_hdr.len + 4095) / 4096;
-             /* Deal with guaranteed full blocks first */
-            while((block_count > 1) && (SPI_FLASH_SUCCESS == flash_result))
+        while((SPI_FLASH_SUCCESS == flash_result) && (remaining > 0))
+        {
+            count = (remaining > LOAD_PLAN_LEN) ? LOAD_PLAN_LEN : remaining;
+            flash_result = plan_indexed_load(address, img_src_offset, img_end, count);
+            if(SPI_FLASH_SUCCESS == flash_result)
             {
-                flash_result = spi_flash_read(img_src_offset, g_sector_buffer, SECTOR_BUF_LEN);
-                crc = sf2bl_calc_crc32(crc, g_sector_buffer, SECTOR_BUF_LEN);
-                memcpy(img_dst_offset, g_sector_buffer, SECTOR_BUF_LEN);
-                img_src_offset += SECTOR_BUF_LEN;
-                img_dst_offset += SECTOR_BUF_LEN;
-                block_count--;
+                flash_result = load_indexed(count);
+                img_src_offset += count * sizeof(img_chunk_idx_t);
+                remaining -= count;
             }
+        }
 
+        return_val = (SPI_FLASH_SUCCESS == flash_result) ? 0 : -1;
+    }
+    else
+    {
+        while((SPI_FLASH_SUCCESS == flash_result) && (remaining > 0))
+        {
+            flash_result = plan_load(&img_src_offset, img_end, remaining, &count);
             if(SPI_FLASH_SUCCESS == flash_result)
             {
-                /* Check for last block being exactly one sector long */
-                temp = chunk_hdr.len % SECTOR_BUF_LEN;
-                if(0 == temp)
-                {
-                    temp = SECTOR_BUF_LEN;
-                }
-
-                flash_result = spi_flash_read(img_src_offset, (uint8_t *)&g_sector_buffer, temp);
-                crc = sf2bl_calc_crc32(crc, g_sector_buffer, temp);
-                memcpy(img_dst_offset, g_sector_buffer, temp);
-                img_src_offset += temp;
+                flash_result = load_planned(count, &crc);
+                remaining -= count;
             }
         }
+
+        /* If there was a SPI FLASH error, force invalid CRC result */
+        if(SPI_FLASH_SUCCESS != flash_result)
+        {
+            crc = ~g_img1_header.crc32;
+        }
+
+        return_val = (crc == g_img1_header.crc32) ? 0 : -1;
     }
 
-    /* If there was a SPI FLASH error, force invalid CRC result */
-    if(SPI_FLASH_SUCCESS != flash_result)
+    if(0 != return_val)
     {
-        crc = ~g_img1_header.crc32;
+        SF2BL_LOG_ERROR(SF2BL_LOG_ERR_LOAD)
     }
 
-    return(crc == g_img1_header.crc32 ? 0 : -1);
+    return(return_val);
 }
 
 
@@ -299,7 +983,390 @@ int32_t sf2bl_raw_rd_flash_image(uint32_t address)
         flash_result = SPI_FLASH_UNSUCCESS;
     }
 
-    return((SPI_FLASH_SUCCESS == flash_result) ? g_img1_header.size : -1);
+    return((SPI_FLASH_SUCCESS == flash_result) ? (int32_t)g_img1_header.size : -1);
+}
+
+
+/***************************************************************************//**
+ * Recalculate the CRC16 of an image header. The CRC is calculated with the
+ * header marked valid as it will be once the image is completely written to
+ * FLASH but the header is left marked blank until then.
+ */
+
+void sf2bl_seal_img_header(img_hdr_block_t *pheader)
+{
+    /* Set the valid flag temporarily so CRC is correct */
+    pheader->valid = SF2BL_IMG_HDR_VALID;
+    pheader->crc16 = sf2bl_crc16((uint8_t *)pheader, sizeof(img_hdr_block_t) - 2u);
+    /* Reset valid flag until we have finished writing to FLASH */
+    pheader->valid = SF2BL_IMG_HDR_BLANK;
+}
+
+
+/***************************************************************************//**
+ * Check a binary image that was received ready built at g_bin_base, rather than
+ * built from an Intel Hex file, and prepare its header for writing to FLASH.
+ * The sequence number is assigned here in the same way as for Intel Hex files.
+ *
+ * Returns the number of bytes in the image or 0 for error.
+ */
+
+uint32_t sf2bl_process_bin_image(uint32_t received)
+{
+    img_hdr_block_t *pheader;
+    uint32_t return_val = 0;
+
+    pheader = (img_hdr_block_t *)g_bin_base;
+    if((received > sizeof(img_hdr_block_t)) && (received == pheader->size) && (0u != pheader->n_chunks))
+    {
+        if(pheader->crc32 == sf2bl_calc_crc32(0xFFFFFFFF, g_bin_base + sizeof(img_hdr_block_t), pheader->size - sizeof(img_hdr_block_t)))
+        {
+            /* Update sequence number if not golden image */
+            if(SF2BL_BOOT_DOWNLOAD_GOLDEN != g_boot_mode)
+            {
+                pheader->sequence = g_current_sequence + 1u;
+            }
+            else
+            {
+                pheader->sequence = 0u;
+            }
+
+            sf2bl_seal_img_header(pheader);
+            return_val = received;
+        }
+    }
+
+    return(return_val);
+}
+
+
+#if defined(SF2BL_IMAGE_COMPRESS)
+/***************************************************************************//**
+ * LZ4 compress the chunks of the binary image at g_bin_base. The compressed
+ * image is built in the receive buffer, which is free once the hex file has
+ * been processed, and then copied back to g_bin_base if it turned out smaller
+ * than the original.
+ *
+ * Each chunk header is kept as is, with len giving the decompressed length, and
+ * is followed by the compressed length and the compressed data.
+ *
+ * Returns the number of bytes in the image to write to FLASH.
+ */
+
+uint32_t sf2bl_compress_image(uint32_t processed)
+{
+    img_hdr_block_t *pheader;
+    img_chunk_hdr_t chunk_hdr;
+    uint8_t *src;
+    uint8_t *dest;
+    uint32_t index;
+    uint32_t packed_len;
+
+    pheader = (img_hdr_block_t *)g_bin_base;
+    if((0u != (pheader->flags & SF2BL_IMG_FLAG_LZ4)) || (SF2BL_IMG_VERSION_1 != pheader->version))
+    {
+        /* Already compressed or indexed, may have been received that way */
+        return(processed);
+    }
+
+    src  = g_bin_base + sizeof(img_hdr_block_t);
+    dest = g_rx_base + sizeof(img_hdr_block_t);
+
+    for(index = 0; index < pheader->n_chunks; index++)
+    {
+        /* Chunk headers are not necessarily word aligned in the image */
+        memcpy(&chunk_hdr, src, sizeof(chunk_hdr));
+        memcpy(dest, &chunk_hdr, sizeof(chunk_hdr));
+        src  += sizeof(chunk_hdr);
+        dest += sizeof(chunk_hdr);
+
+        /* Zero fill chunks have no data to compress */
+        if(0u == (chunk_hdr.index & SF2BL_CHUNK_ZERO_FILL))
+        {
+            packed_len = sf2bl_lz4_compress(src, chunk_hdr.len, dest + sizeof(packed_len));
+            memcpy(dest, &packed_len, sizeof(packed_len));
+            src  += chunk_hdr.len;
+            dest += sizeof(packed_len) + packed_len;
+        }
+    }
+
+    if((uint32_t)(dest - g_rx_base) < pheader->size)
+    {
+        memcpy(g_rx_base, pheader, sizeof(img_hdr_block_t));
+        pheader = (img_hdr_block_t *)g_rx_base;
+        pheader->flags |= SF2BL_IMG_FLAG_LZ4;
+        pheader->size = (uint32_t)(dest - g_rx_base);
+        pheader->crc32 = sf2bl_calc_crc32(0xFFFFFFFF, g_rx_base + sizeof(img_hdr_block_t), pheader->size - sizeof(img_hdr_block_t));
+        sf2bl_seal_img_header(pheader);
+
+        processed = pheader->size;
+        memcpy(g_bin_base, g_rx_base, processed);
+    }
+
+    return(processed);
+}
+#endif
+
+
+#if defined(SF2BL_IMAGE_INDEX)
+/***************************************************************************//**
+ * Convert the version 1 image at g_bin_base to version 2 by inserting the chunk
+ * index between the header and the first chunk. The chunks are moved up in
+ * place to make room. This is done last, after any compression, as the index
+ * describes the chunks as they are stored.
+ *
+ * Images which are already version 2, i.e. were received that way, are left
+ * alone.
+ *
+ * Returns the number of bytes in the image to write to FLASH or 0 for error.
+ */
+
+uint32_t sf2bl_index_image(uint32_t processed)
+{
+    img_hdr_block_t *pheader;
+    img_chunk_idx_t *pidx;
+    img_chunk_hdr_t chunk_hdr;
+    uint8_t *src;
+    uint8_t *end;
+    uint32_t img_len;
+    uint32_t table_len;
+    uint32_t stored;
+    uint32_t index;
+    uint32_t crc;
+    int32_t error = 0;
+    uint32_t return_val = processed;
+
+    pheader = (img_hdr_block_t *)g_bin_base;
+    if(SF2BL_IMG_VERSION_1 == pheader->version)
+    {
+        /*
+         * The image is pheader->size long, processed can be more as the Intel
+         * Hex path counts the header twice.
+         */
+        return_val = 0;
+        img_len = pheader->size;
+        table_len = SF2BL_IDX_TABLE_LEN(pheader->n_chunks);
+        if((img_len >= sizeof(img_hdr_block_t)) && (img_len <= processed) &&
+           (pheader->n_chunks <= (img_len / sizeof(img_chunk_hdr_t))) &&
+           (table_len <= ((SF2BL_DDR_SIZE - g_rx_size) - img_len)))
+        {
+            memmove(g_bin_base + sizeof(img_hdr_block_t) + table_len, g_bin_base + sizeof(img_hdr_block_t),
+                    img_len - sizeof(img_hdr_block_t));
+            pidx = (img_chunk_idx_t *)(g_bin_base + sizeof(img_hdr_block_t));
+            src = g_bin_base + sizeof(img_hdr_block_t) + table_len;
+            end = g_bin_base + img_len + table_len;
+
+            for(index = 0; (0 == error) && (index < pheader->n_chunks); index++)
+            {
+                /* Chunk headers are not necessarily word aligned in the image */
+                memcpy(&chunk_hdr, src, sizeof(chunk_hdr));
+                src += sizeof(chunk_hdr);
+                stored = chunk_hdr.len;
+                if(0u != (chunk_hdr.index & SF2BL_CHUNK_ZERO_FILL))
+                {
+                    stored = 0u;
+                }
+                else if(0u != (pheader->flags & SF2BL_IMG_FLAG_LZ4))
+                {
+                    memcpy(&stored, src, sizeof(stored));
+                    src += sizeof(stored);
+                }
+
+                if((src > end) || (stored > (uint32_t)(end - src)))
+                {
+                    error = 1; /* Chunks run off the end of the image */
+                }
+                else
+                {
+                    pidx[index].offset = (uint32_t)(src - g_bin_base);
+                    pidx[index].dest   = chunk_hdr.base + chunk_hdr.offset;
+                    pidx[index].len    = chunk_hdr.len;
+                    pidx[index].stored = stored;
+                    pidx[index].index  = chunk_hdr.index;
+                    pidx[index].crc32  = sf2bl_calc_crc32(0xFFFFFFFF, src, stored);
+                    src += stored;
+                }
+            }
+
+            if((0 == error) && (src == end))
+            {
+                crc = sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)pidx, pheader->n_chunks * sizeof(img_chunk_idx_t));
+                memcpy(&pidx[pheader->n_chunks], &crc, sizeof(crc));
+                pheader->version = SF2BL_IMG_VERSION_2;
+                pheader->size = img_len + table_len;
+                pheader->crc32 = sf2bl_calc_crc32(0xFFFFFFFF, g_bin_base + sizeof(img_hdr_block_t), pheader->size - sizeof(img_hdr_block_t));
+                sf2bl_seal_img_header(pheader);
+                return_val = pheader->size;
+            }
+        }
+    }
+
+    return(return_val);
+}
+#endif
+
+
+/***************************************************************************//**
+ * Read len bytes from the SPI FLASH into RAM via the sector buffer.
+ */
+
+static spi_flash_status_t rd_flash_to_ram(uint32_t src, uint8_t *dest, uint32_t len)
+{
+    spi_flash_status_t flash_result = SPI_FLASH_SUCCESS;
+    uint32_t temp;
+
+    while((len > 0) && (SPI_FLASH_SUCCESS == flash_result))
+    {
+        temp = (len > SECTOR_BUF_LEN) ? SECTOR_BUF_LEN : len;
+        flash_result = spi_flash_read(src, g_sector_buffer, temp);
+        memcpy(dest, g_sector_buffer, temp);
+        src  += temp;
+        dest += temp;
+        len  -= temp;
+    }
+
+    return(flash_result);
+}
+
+
+/***************************************************************************//**
+ * Remove the chunk index from the uncompressed version 2 image in RAM at img,
+ * after checking the stored CRC32, leaving the version 1 image.
+ *
+ * Returns length of image or 0 for error.
+ */
+
+static uint32_t drop_chunk_index(uint8_t *img)
+{
+    img_hdr_block_t *pheader;
+    uint32_t table_len;
+    uint32_t return_val = 0;
+
+    pheader = (img_hdr_block_t *)img;
+    table_len = SF2BL_IDX_TABLE_LEN(pheader->n_chunks);
+    if((pheader->n_chunks <= (pheader->size / sizeof(img_chunk_idx_t))) &&
+       (table_len <= (pheader->size - sizeof(img_hdr_block_t))) &&
+       (pheader->crc32 == sf2bl_calc_crc32(0xFFFFFFFF, img + sizeof(img_hdr_block_t), pheader->size - sizeof(img_hdr_block_t))))
+    {
+        pheader->size -= table_len;
+        memmove(img + sizeof(img_hdr_block_t), img + sizeof(img_hdr_block_t) + table_len, pheader->size - sizeof(img_hdr_block_t));
+        pheader->version = SF2BL_IMG_VERSION_1;
+        pheader->crc32 = sf2bl_calc_crc32(0xFFFFFFFF, img + sizeof(img_hdr_block_t), pheader->size - sizeof(img_hdr_block_t));
+        return_val = pheader->size;
+    }
+
+    return(return_val);
+}
+
+
+/***************************************************************************//**
+ * Read the image at address in the SPI FLASH into RAM at dest in its
+ * uncompressed form, i.e. exactly as it was built from the Intel Hex file. The
+ * image header size and crc32 describe the uncompressed image. This is the form
+ * delta updates are made against, so any chunk index is removed as well.
+ *
+ * Returns length of image or 0 for error.
+ */
+
+uint32_t sf2bl_expand_flash_image(uint32_t address, uint8_t *dest, uint32_t max_len)
+{
+    spi_flash_status_t flash_result;
+    img_hdr_block_t *pheader;
+    img_chunk_hdr_t chunk_hdr;
+    uint32_t img_src_offset;
+    uint8_t *out;
+    uint32_t table_len;
+    uint32_t remaining;
+    uint32_t index;
+    uint32_t crc;
+    uint32_t return_val = 0;
+
+    pheader = (img_hdr_block_t *)dest;
+    flash_result = SPI_FLASH_UNSUCCESS;
+    if(max_len >= sizeof(img_hdr_block_t))
+    {
+        flash_result = rd_flash_to_ram(address, dest, sizeof(img_hdr_block_t));
+    }
+
+    if((SPI_FLASH_SUCCESS == flash_result) && (SF2BL_HDR_OK == sf2bl_check_img_header(pheader)))
+    {
+        if(0u == (pheader->flags & SF2BL_IMG_FLAG_LZ4))
+        {
+            if(pheader->size <= max_len)
+            {
+                flash_result = rd_flash_to_ram(address, dest, pheader->size);
+                if(SPI_FLASH_SUCCESS == flash_result)
+                {
+                    return_val = pheader->size;
+                    if(SF2BL_IMG_VERSION_2 == pheader->version)
+                    {
+                        return_val = drop_chunk_index(dest);
+                    }
+                }
+            }
+        }
+        else
+        {
+            img_src_offset = address + sizeof(img_hdr_block_t);
+            out = dest + sizeof(img_hdr_block_t);
+            crc = 0xFFFFFFFF;
+
+            if(SF2BL_IMG_VERSION_2 == pheader->version)
+            {
+                /*
+                 * The index is covered by the image CRC32 but is not wanted so
+                 * it is read where the first chunk will go.
+                 */
+                table_len = SF2BL_IDX_TABLE_LEN(pheader->n_chunks);
+                if((pheader->n_chunks <= (pheader->size / sizeof(img_chunk_idx_t))) &&
+                   (table_len <= (max_len - sizeof(img_hdr_block_t))))
+                {
+                    flash_result = rd_flash_to_ram(img_src_offset, out, table_len);
+                    crc = sf2bl_calc_crc32(crc, out, table_len);
+                    img_src_offset += table_len;
+                }
+                else
+                {
+                    flash_result = SPI_FLASH_UNSUCCESS;
+                }
+            }
+            for(index = 0; (SPI_FLASH_SUCCESS == flash_result) && (index < pheader->n_chunks); index++)
+            {
+                flash_result = spi_flash_read(img_src_offset, (uint8_t *)&chunk_hdr, sizeof(chunk_hdr));
+                img_src_offset += sizeof(chunk_hdr);
+                /* Compare by subtraction, a bad len must not wrap the sum */
+                remaining = (uint32_t)((dest + max_len) - out);
+                if((SPI_FLASH_SUCCESS == flash_result) && (remaining >= sizeof(chunk_hdr)) &&
+                   (chunk_hdr.len <= (remaining - sizeof(chunk_hdr))))
+                {
+                    crc = sf2bl_calc_crc32(crc, (uint8_t *)&chunk_hdr, sizeof(chunk_hdr));
+                    memcpy(out, &chunk_hdr, sizeof(chunk_hdr));
+                    out += sizeof(chunk_hdr);
+                    if(0u == (chunk_hdr.index & SF2BL_CHUNK_ZERO_FILL))
+                    {
+                        flash_result = rd_lz4_chunk(&img_src_offset, out, chunk_hdr.len, &crc);
+                        out += chunk_hdr.len;
+                    }
+                }
+                else
+                {
+                    flash_result = SPI_FLASH_UNSUCCESS;
+                }
+            }
+
+            /* Check stored data before replacing the CRC with the expanded one */
+            if((SPI_FLASH_SUCCESS == flash_result) && (crc == pheader->crc32))
+            {
+                pheader->flags &= ~SF2BL_IMG_FLAG_LZ4;
+                pheader->version = SF2BL_IMG_VERSION_1;
+                pheader->size = (uint32_t)(out - dest);
+                pheader->crc32 = sf2bl_calc_crc32(0xFFFFFFFF, dest + sizeof(img_hdr_block_t), pheader->size - sizeof(img_hdr_block_t));
+                return_val = pheader->size;
+            }
+        }
+    }
+
+    return(return_val);
 }
 
 
@@ -341,6 +1408,11 @@ sf2bl_hdr_status_t sf2bl_check_img_header(img_hdr_block_t *this_block)
         {
             return_val = SF2BL_HDR_BAD_CRC;
         }
+        else if(this_block->version > SF2BL_IMG_VERSION_2)
+        {
+            /* Format newer than we understand */
+            return_val = SF2BL_HDR_BAD_DATA;
+        }
         else
         {
             return_val = SF2BL_HDR_OK;
@@ -366,10 +1438,15 @@ sf2bl_hdr_status_t sf2bl_check_img_header(img_hdr_block_t *this_block)
  *   3. Is there a valid second image and if so what offset is it at in the
  *      FLASH?
  *
+ * With SF2BL_PART_TABLE the slots come from the partition table and the normal
+ * image is the newest good one in the table.
  */
 
 void sf2bl_check_flash(void)
 {
+#if defined(SF2BL_PART_TABLE)
+    sf2bl_part_check();
+#else
     spi_flash_status_t flash_result;
 
 #if defined(SF2BL_GOLDEN)
@@ -419,4 +1496,5 @@ void sf2bl_check_flash(void)
         g_img2_status = SF2BL_HDR_READ_FAIL;
     }
 #endif
+#endif
 }
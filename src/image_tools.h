@@ -33,7 +33,23 @@ extern sf2bl_hdr_status_t g_golden_img_status;
 int32_t sf2bl_wr_flash_image(uint32_t address, uint32_t processed);
 int32_t sf2bl_rd_flash_image(uint32_t address);
 int32_t sf2bl_raw_rd_flash_image(uint32_t address);
+uint32_t sf2bl_expand_flash_image(uint32_t address, uint8_t *dest, uint32_t max_len);
 void sf2bl_check_flash(void);
 sf2bl_hdr_status_t sf2bl_check_img_header(img_hdr_block_t *this_block);
+void sf2bl_seal_img_header(img_hdr_block_t *pheader);
+uint32_t sf2bl_process_bin_image(uint32_t received);
+
+#if defined(SF2BL_FLASH_BG_ERASE)
+void sf2bl_erase_ahead_init(void);
+void sf2bl_erase_ahead(uint32_t bytes);
+#endif
+
+#if defined(SF2BL_IMAGE_COMPRESS)
+uint32_t sf2bl_compress_image(uint32_t processed);
+#endif
+
+#if defined(SF2BL_IMAGE_INDEX)
+uint32_t sf2bl_index_image(uint32_t processed);
+#endif
 
 #endif /* IMAGE_TOOLS_H_ */
@@ -244,7 +244,7 @@ uint32_t sf2bl_process_hex_file(int32_t received)
 
     memset((uint8_t *)pheader, 0, sizeof(img_hdr_block_t));
     pheader->valid = SF2BL_IMG_HDR_BLANK;
-    pheader->version = 0x00000001;
+    pheader->version = SF2BL_IMG_VERSION_1;
     pheader->crc16 = 0xFFFF;
     pheader->sequence = 0; /* Will over write if not golden image downloaded */
 
@@ -2,6 +2,8 @@
 #include "hw_platform.h"
 #include "plic.h"
 #include "core_timer.h"
+#include "sf2_bl_options.h"
+#include "spi_flash.h"
 
 #define MTIMECMP_BASE_ADDR     0x44004000UL
 #define MTIME_ADDR             0x4400BFF8UL
@@ -60,11 +62,24 @@ void interrupts_init(void)
     // example.
     PLIC_set_priority(&g_plic, TIMER0_IRQn, 1);  
 
+#if defined(SF2BL_SPI_ASYNC)
+    /*
+     * The 10ms tick comes from mtime so Timer0 is left off the PLIC, otherwise
+     * g_10ms_count would be advanced twice as fast once external interrupts
+     * are enabled for the CoreSPI.
+     */
+    PLIC_set_priority(&g_plic, FLASH_CORE_SPI_IRQn, 1);
+    PLIC_enable_interrupt(&g_plic, FLASH_CORE_SPI_IRQn);
+
+    // Enable the Machine-External bit in MIE
+    set_csr(mie, MIP_MEIP);
+#else
     // Enable Timer 1 & 0 Interrupt
     PLIC_enable_interrupt(&g_plic, TIMER0_IRQn);  
 
     // Enable the Machine-External bit in MIE
 //    set_csr(mie, MIP_MEIP);
+#endif
     
     add_10ms_to_mtimecmp();
 
@@ -146,6 +161,11 @@ void handle_m_ext_interrupt(){
         break;
     case (External_31_IRQn): 
         break;
+#if defined(SF2BL_SPI_ASYNC)
+    case (FLASH_CORE_SPI_IRQn):
+        spi_flash_isr();
+        break;
+#endif
     default: 
         _exit(10 + (uintptr_t) int_num);
     }
@@ -0,0 +1,376 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader LZ4 block compression support routines.
+ *
+ * Implements the LZ4 block format (see lz4_Block_format.md in the LZ4
+ * distribution). The decoder is heap free and streaming, the compressor is a
+ * simple greedy single hash implementation which is only built when image
+ * compression is enabled.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sf2_bl_options.h"
+#include "lz4.h"
+
+#define LZ4_MIN_MATCH     4u
+#define LZ4_LAST_LITERALS 5u  /* Last 5 bytes of a block are always literals */
+#define LZ4_MF_LIMIT      12u /* Last match must start 12 bytes before end */
+#define LZ4_MAX_OFFSET    65535u
+
+/*
+ * Decoder states.
+ */
+#define LZ4_ST_TOKEN      0u
+#define LZ4_ST_LIT_EXT    1u
+#define LZ4_ST_LITERALS   2u
+#define LZ4_ST_OFFSET_LO  3u
+#define LZ4_ST_OFFSET_HI  4u
+#define LZ4_ST_MATCH_EXT  5u
+#define LZ4_ST_ERROR      6u
+
+/***************************************************************************//**
+ * Prepare a decoder context to write up to dest_len bytes at dest.
+ */
+void sf2bl_lz4_init(sf2bl_lz4_t *ctx, uint8_t *dest, uint32_t dest_len)
+{
+    ctx->state     = LZ4_ST_TOKEN;
+    ctx->lit_len   = 0u;
+    ctx->match_len = 0u;
+    ctx->match_off = 0u;
+    ctx->out       = dest;
+    ctx->out_start = dest;
+    ctx->out_end   = dest + dest_len;
+}
+
+/***************************************************************************//**
+ * Finish the current block and prepare to decode a new block which follows on
+ * from it in the output buffer. Matches in the new block may refer back into
+ * earlier blocks as is allowed by linked LZ4 frames.
+ *
+ * Returns 0 for success or -1 if the current block ended part way through a
+ * sequence.
+ */
+int32_t sf2bl_lz4_next_block(sf2bl_lz4_t *ctx)
+{
+    if((LZ4_ST_TOKEN == ctx->state) || (LZ4_ST_OFFSET_LO == ctx->state))
+    {
+        ctx->state = LZ4_ST_TOKEN;
+    }
+    else
+    {
+        ctx->state = LZ4_ST_ERROR;
+    }
+
+    return(LZ4_ST_ERROR == ctx->state ? -1 : 0);
+}
+
+/***************************************************************************//**
+ * Append len bytes of uncompressed data to the output. Used for the stored
+ * blocks of an LZ4 frame, must only be called between blocks.
+ *
+ * Returns 0 for success or -1 if the data would overflow the output buffer.
+ */
+int32_t sf2bl_lz4_store(sf2bl_lz4_t *ctx, const uint8_t *src, uint32_t len)
+{
+    if((LZ4_ST_TOKEN != ctx->state) || (len > (uint32_t)(ctx->out_end - ctx->out)))
+    {
+        ctx->state = LZ4_ST_ERROR;
+    }
+    else
+    {
+        memcpy(ctx->out, src, len);
+        ctx->out += len;
+    }
+
+    return(LZ4_ST_ERROR == ctx->state ? -1 : 0);
+}
+
+/***************************************************************************//**
+ * Copy a match from earlier output. The source and destination may overlap
+ * so this has to be done a byte at a time.
+ *
+ * Returns 0 for success or -1 if the match is out of bounds.
+ */
+static int32_t lz4_copy_match(sf2bl_lz4_t *ctx)
+{
+    uint8_t *from;
+    uint32_t count;
+
+    count = ctx->match_len + LZ4_MIN_MATCH;
+    if((ctx->match_off > (uint32_t)(ctx->out - ctx->out_start)) ||
+       (count > (uint32_t)(ctx->out_end - ctx->out)))
+    {
+        return(-1);
+    }
+
+    from = ctx->out - ctx->match_off;
+    while(count > 0u)
+    {
+        *ctx->out++ = *from++;
+        count--;
+    }
+
+    return(0);
+}
+
+/***************************************************************************//**
+ * Feed len bytes of compressed data to the decoder.
+ *
+ * Returns 0 for success or -1 if the data is corrupt or would overflow the
+ * output buffer. Once an error is reported the context stays in error.
+ */
+int32_t sf2bl_lz4_decode(sf2bl_lz4_t *ctx, const uint8_t *src, uint32_t len)
+{
+    uint32_t temp;
+
+    while((len > 0u) && (LZ4_ST_ERROR != ctx->state))
+    {
+        switch(ctx->state)
+        {
+        case LZ4_ST_TOKEN:
+            ctx->lit_len   = (uint32_t)(*src >> 4);
+            ctx->match_len = (uint32_t)(*src & 0x0Fu);
+            src++;
+            len--;
+            if(15u == ctx->lit_len)
+            {
+                ctx->state = LZ4_ST_LIT_EXT;
+            }
+            else if(0u != ctx->lit_len)
+            {
+                ctx->state = LZ4_ST_LITERALS;
+            }
+            else
+            {
+                ctx->state = LZ4_ST_OFFSET_LO;
+            }
+            break;
+
+        case LZ4_ST_LIT_EXT:
+            ctx->lit_len += (uint32_t)*src;
+            if(255u != *src)
+            {
+                ctx->state = LZ4_ST_LITERALS;
+            }
+            src++;
+            len--;
+            break;
+
+        case LZ4_ST_LITERALS:
+            temp = ctx->lit_len < len ? ctx->lit_len : len;
+            if(temp > (uint32_t)(ctx->out_end - ctx->out))
+            {
+                ctx->state = LZ4_ST_ERROR;
+            }
+            else
+            {
+                memcpy(ctx->out, src, temp);
+                ctx->out     += temp;
+                ctx->lit_len -= temp;
+                src          += temp;
+                len          -= temp;
+                if(0u == ctx->lit_len)
+                {
+                    ctx->state = LZ4_ST_OFFSET_LO;
+                }
+            }
+            break;
+
+        case LZ4_ST_OFFSET_LO:
+            ctx->match_off = (uint32_t)*src;
+            src++;
+            len--;
+            ctx->state = LZ4_ST_OFFSET_HI;
+            break;
+
+        case LZ4_ST_OFFSET_HI:
+            ctx->match_off |= (uint32_t)*src << 8;
+            src++;
+            len--;
+            if(0u == ctx->match_off)
+            {
+                ctx->state = LZ4_ST_ERROR;
+            }
+            else if(15u == ctx->match_len)
+            {
+                ctx->state = LZ4_ST_MATCH_EXT;
+            }
+            else
+            {
+                ctx->state = (0 == lz4_copy_match(ctx)) ? LZ4_ST_TOKEN : LZ4_ST_ERROR;
+            }
+            break;
+
+        case LZ4_ST_MATCH_EXT:
+            ctx->match_len += (uint32_t)*src;
+            if(255u != *src)
+            {
+                ctx->state = (0 == lz4_copy_match(ctx)) ? LZ4_ST_TOKEN : LZ4_ST_ERROR;
+            }
+            src++;
+            len--;
+            break;
+
+        default:
+            ctx->state = LZ4_ST_ERROR;
+            break;
+        }
+    }
+
+    return(LZ4_ST_ERROR == ctx->state ? -1 : 0);
+}
+
+/***************************************************************************//**
+ * Check that the data fed so far forms a complete block which exactly fills
+ * the output buffer. A well formed block ends straight after the literals of
+ * its last sequence.
+ *
+ * Returns 0 if complete or -1 if not.
+ */
+int32_t sf2bl_lz4_block_done(const sf2bl_lz4_t *ctx)
+{
+    int32_t return_val = -1;
+
+    if(ctx->out == ctx->out_end)
+    {
+        if((LZ4_ST_OFFSET_LO == ctx->state) || (LZ4_ST_TOKEN == ctx->state))
+        {
+            return_val = 0;
+        }
+    }
+
+    return(return_val);
+}
+
+#if defined(SF2BL_IMAGE_COMPRESS)
+
+#define LZ4_HASH_LOG 12u
+
+/*
+ * Hash table of recent positions + 1 (0 marks an empty slot). Static rather
+ * than on the stack as 16K is far too much to put there.
+ */
+static uint32_t g_lz4_hash[1u << LZ4_HASH_LOG];
+
+/*
+ * Unaligned safe little endian 32 bit read.
+ */
+static uint32_t lz4_read32(const uint8_t *p)
+{
+    return((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static uint32_t lz4_hash(uint32_t sequence)
+{
+    return((sequence * 2654435761u) >> (32u - LZ4_HASH_LOG));
+}
+
+/*
+ * Write out the length extension bytes for a length field that overflowed its
+ * 4 bit token nibble.
+ */
+static uint8_t *lz4_put_length(uint8_t *op, uint32_t len)
+{
+    while(len >= 255u)
+    {
+        *op++ = 255u;
+        len -= 255u;
+    }
+    *op++ = (uint8_t)len;
+
+    return(op);
+}
+
+/*
+ * Emit one sequence. match_len of 0 indicates the literals only last sequence.
+ */
+static uint8_t *lz4_put_sequence(uint8_t *op, const uint8_t *literals, uint32_t lit_len,
+                                 uint32_t offset, uint32_t match_len)
+{
+    uint8_t *token = op++;
+
+    *token = (uint8_t)((lit_len >= 15u ? 15u : lit_len) << 4);
+    if(lit_len >= 15u)
+    {
+        op = lz4_put_length(op, lit_len - 15u);
+    }
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+
+    if(0u != match_len)
+    {
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+        match_len -= LZ4_MIN_MATCH;
+        *token |= (uint8_t)(match_len >= 15u ? 15u : match_len);
+        if(match_len >= 15u)
+        {
+            op = lz4_put_length(op, match_len - 15u);
+        }
+    }
+
+    return(op);
+}
+
+/***************************************************************************//**
+ * Compress len bytes at src into a single LZ4 block at dst. dst must have room
+ * for SF2BL_LZ4_BOUND(len) bytes.
+ *
+ * Returns the size of the compressed block.
+ */
+uint32_t sf2bl_lz4_compress(const uint8_t *src, uint32_t len, uint8_t *dst)
+{
+    uint8_t *op = dst;
+    uint32_t ip = 0u;
+    uint32_t anchor = 0u;
+    uint32_t ref;
+    uint32_t sequence;
+    uint32_t hash;
+    uint32_t match_len;
+    uint32_t match_limit;
+
+    memset(g_lz4_hash, 0, sizeof(g_lz4_hash));
+
+    if(len > LZ4_MF_LIMIT)
+    {
+        match_limit = len - LZ4_LAST_LITERALS;
+        while(ip < (len - LZ4_MF_LIMIT))
+        {
+            sequence = lz4_read32(&src[ip]);
+            hash = lz4_hash(sequence);
+            ref = g_lz4_hash[hash];
+            g_lz4_hash[hash] = ip + 1u;
+
+            if((0u != ref) && ((ip - (ref - 1u)) <= LZ4_MAX_OFFSET) &&
+               (lz4_read32(&src[ref - 1u]) == sequence))
+            {
+                ref--;
+                match_len = LZ4_MIN_MATCH;
+                while(((ip + match_len) < match_limit) && (src[ref + match_len] == src[ip + match_len]))
+                {
+                    match_len++;
+                }
+
+                op = lz4_put_sequence(op, &src[anchor], ip - anchor, ip - ref, match_len);
+                ip += match_len;
+                anchor = ip;
+            }
+            else
+            {
+                ip++;
+            }
+        }
+    }
+
+    op = lz4_put_sequence(op, &src[anchor], len - anchor, 0u, 0u);
+
+    return((uint32_t)(op - dst));
+}
+
+#endif /* SF2BL_IMAGE_COMPRESS */
@@ -0,0 +1,46 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader LZ4 block compression support header.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef LZ4_H_
+#define LZ4_H_
+
+/*
+ * Worst case size of an LZ4 block for len bytes of incompressible input.
+ */
+#define SF2BL_LZ4_BOUND(len) ((len) + ((len) / 255u) + 16u)
+
+/*
+ * Decoder context. The decoder is a byte driven state machine so the
+ * compressed data can be fed to it in whatever sized pieces it arrives in
+ * (FLASH blocks, YMODEM packets etc.) and the output is written straight to
+ * its final destination. No window buffer is required as match references are
+ * resolved against the output already written.
+ */
+typedef struct sf2bl_lz4
+{
+    uint32_t state;       /* Current decoder state */
+    uint32_t lit_len;     /* Literal bytes still to copy */
+    uint32_t match_len;   /* Length of current match */
+    uint32_t match_off;   /* Offset of current match */
+    uint8_t *out;         /* Next output location */
+    uint8_t *out_start;   /* Start of output, limit for match references */
+    uint8_t *out_end;     /* End of output buffer */
+} sf2bl_lz4_t;
+
+void     sf2bl_lz4_init(sf2bl_lz4_t *ctx, uint8_t *dest, uint32_t dest_len);
+int32_t  sf2bl_lz4_next_block(sf2bl_lz4_t *ctx);
+int32_t  sf2bl_lz4_decode(sf2bl_lz4_t *ctx, const uint8_t *src, uint32_t len);
+int32_t  sf2bl_lz4_store(sf2bl_lz4_t *ctx, const uint8_t *src, uint32_t len);
+int32_t  sf2bl_lz4_block_done(const sf2bl_lz4_t *ctx);
+
+#if defined(SF2BL_IMAGE_COMPRESS)
+uint32_t sf2bl_lz4_compress(const uint8_t *src, uint32_t len, uint8_t *dst);
+#endif
+
+#endif /* LZ4_H_ */
@@ -22,6 +22,14 @@
 #include "intel_hex.h"
 #include "sf2_bl_defs.h"
 #include "image_tools.h"
+#include "rx_stream.h"
+#include "boot_record.h"
+#include "boot_metrics.h"
+#include "boot_log.h"
+#include "boot_config.h"
+#include "boot_part.h"
+#include "bench.h"
+#include "spi_cal.h"
 
 //#include "mss_watchdog.h"
 //#include "mss_gpio.h"
@@ -232,6 +240,9 @@ void sf2bl_check_for_update(void)
     int32_t  use_golden_flag  = 0;
     int32_t  copy_golden_flag = 0;
 #endif
+#if defined(SF2BL_CONFIG_STORE)
+    uint32_t boot_flags;
+#endif
 
     /*
      * The order of precedence in the following in decreasing priority is:
@@ -258,6 +269,17 @@ void sf2bl_check_for_update(void)
        update_flag |= SF2BL_USER_HOOK_UPDATE();
 #endif
 
+#if defined(SF2BL_CONFIG_STORE)
+    /* An update asked for through the configuration store only happens once */
+    boot_flags = sf2bl_config_get_u32(SF2BL_CONFIG_KEY_BOOT_FLAGS, 0u);
+    if(0u != (boot_flags & SF2BL_CONFIG_BOOT_UPDATE))
+    {
+        update_flag = 1;
+        boot_flags &= ~SF2BL_CONFIG_BOOT_UPDATE;
+        (void)sf2bl_config_set(SF2BL_CONFIG_KEY_BOOT_FLAGS, (uint8_t *)&boot_flags, sizeof(boot_flags));
+    }
+#endif
+
 #if (defined(SF2BL_GOLDEN)) && (SF2BL_NO_PIN != SF2BL_USER_USE_GOLDEN_PIN)
 #if defined(SF2BL_USE_COREGPIO)
     use_golden_flag = (GPIO_get_inputs(&g_gpio) >> SF2BL_USER_USE_GOLDEN_PIN) & 1;
@@ -332,6 +354,12 @@ int main()
     img_hdr_block_t *pheader;
     spi_flash_status_t flash_result;
     int32_t image_status; /* 0 - ok, -1 not ok */
+    uint32_t exec_arg;
+#if defined(SF2BL_PART_TABLE)
+    uint32_t fallback;
+#endif
+
+    SF2BL_METRICS_MARK(SF2BL_PHASE_MAIN)
 
 #if !defined(RISCV_PLATFORM)
 #if defined(NDEBUG)
@@ -375,12 +403,20 @@ int main()
     g_driver_init |= SF2BL_DRIVER_MSS_GPIO;
 #endif
 
+    SF2BL_METRICS_MARK(SF2BL_PHASE_FLASH_INIT)
     spi_flash_init();
+#if defined(SF2BL_SPI_CALIBRATE)
+    sf2bl_spi_calibrate();
+#endif
+#if defined(SF2BL_CONFIG_STORE)
+    sf2bl_config_init();
+#endif
     g_rx_base = (uint8_t *)SF2BL_DDR_BASE;
     g_rx_size = (SF2BL_DDR_SIZE / 3) & 0xFFFFFFFC;
     g_rx_size *= 2;
     g_bin_base = (uint8_t *)(SF2BL_DDR_BASE + g_rx_size);
 
+    SF2BL_METRICS_MARK(SF2BL_PHASE_CHECK)
     sf2bl_check_for_update(); /* See what we are expected to do */
     sf2bl_select_image();     /* Select image to work with */
 
@@ -391,6 +427,12 @@ int main()
     _putstring((uint8_t *)SF2BL_PLATFORM_STRING);
     _putstring((uint8_t *)"\r\n");
 #endif
+#if defined(SF2BL_BENCH)
+    /* Benchmark build, run the benchmarks instead of booting */
+    sf2bl_bench();
+    return(0);
+#endif
+    SF2BL_METRICS_MARK(SF2BL_PHASE_LOAD)
     if((SF2BL_BOOT_DOWNLOAD_1      == g_boot_mode) ||
        (SF2BL_BOOT_DOWNLOAD_2      == g_boot_mode) ||
        (SF2BL_BOOT_DOWNLOAD_GOLDEN == g_boot_mode))
@@ -417,7 +459,11 @@ int main()
         _putstring((uint8_t *)"Please start file transfer now.\r\n");
 
 #endif
-        received = ymodem_receive(g_rx_base, g_rx_size);
+        sf2bl_rx_stream_init();
+#if defined(SF2BL_FLASH_BG_ERASE)
+        sf2bl_erase_ahead_init();
+#endif
+        received = ymodem_receive(g_rx_base, g_rx_size, sf2bl_rx_stream_data);
 
 #if defined(SF2BL_VERBOSE)
         /*
@@ -434,8 +480,21 @@ int main()
 #endif
         if(received > 0)
         {
-            SF2BL_MESSAGE("\r\nDownload complete, processing Hex file\r\n")
-            processed = sf2bl_process_hex_file(received);
+            SF2BL_MESSAGE("\r\nDownload complete, processing file\r\n")
+            processed = sf2bl_rx_stream_finish(received);
+#if defined(SF2BL_IMAGE_COMPRESS)
+            if(0 != processed)
+            {
+                SF2BL_MESSAGE("Compressing image\r\n")
+                processed = sf2bl_compress_image(processed);
+            }
+#endif
+#if defined(SF2BL_IMAGE_INDEX)
+            if(0 != processed)
+            {
+                processed = sf2bl_index_image(processed);
+            }
+#endif
         }
 #if defined(SF2BL_VERBOSE)
         else
@@ -443,6 +502,16 @@ int main()
             SF2BL_MESSAGE("\r\nFile download failed!\r\n")
         }
 #endif
+        SF2BL_LOG_TRANSFER(received, processed)
+        if(0 == received)
+        {
+            SF2BL_LOG_ERROR(SF2BL_LOG_ERR_DOWNLOAD)
+        }
+        else if(0 == processed)
+        {
+            SF2BL_LOG_ERROR(SF2BL_LOG_ERR_PROCESS)
+        }
+
         if(0 != processed)
         {
 #if defined(SF2BL_GOLDEN)
@@ -472,6 +541,10 @@ int main()
             }
             else if (SF2BL_BOOT_DOWNLOAD_1 == g_boot_mode)
 #else
+#if defined(SF2BL_PART_TABLE)
+                /* Only the copy of the golden image is left to run */
+                sf2bl_part_invalidate(g_img1_offset);
+#endif
                 /* Load image 1 into RAM */
                 SF2BL_MESSAGE("loading image 1 into RAM.\r\n")
                 image_status = sf2bl_rd_flash_image(g_img1_offset);
@@ -485,6 +558,10 @@ int main()
 #endif
 #endif
             {
+#if defined(SF2BL_PART_TABLE)
+                /* The current image is kept to fall back to */
+                g_img1_offset = sf2bl_part_target();
+#endif
                 /* Write to first image */
                 SF2BL_MESSAGE("Writing image 1 to SPI FLASH.\r\n")
                 temp = sf2bl_wr_flash_image(g_img1_offset, processed);
@@ -517,7 +594,7 @@ int main()
 #if defined(SF2BL_VERBOSE)
         else if(received > 0) /* Got file but decode failed... */
         {
-            SF2BL_MESSAGE("Error processing Hex file!\r\n")
+            SF2BL_MESSAGE("Error processing file!\r\n")
         }
 #endif
     }
@@ -525,7 +602,7 @@ int main()
     else if(SF2BL_BOOT_EXEC_GOLDEN == g_boot_mode)
     {
         SF2BL_MESSAGE("Loading golden image into RAM.\r\n")
-        image_status = sf2bl_rd_flash_image(g_golden_img_offset);
+        image_status = sf2bl_boot_image(g_golden_img_offset);
     }
     else if(SF2BL_BOOT_COPY_GOLDEN == g_boot_mode)
     {
@@ -547,6 +624,10 @@ int main()
         /* Reset valid flag until we have finished writing to FLASH */
         pheader->valid = SF2BL_IMG_HDR_BLANK;
         temp = sf2bl_wr_flash_image(g_img1_offset, processed);
+#if defined(SF2BL_PART_TABLE)
+        /* Only the copy of the golden image is left to run */
+        sf2bl_part_invalidate(g_img1_offset);
+#endif
 #if defined(SF2BL_2ND_IMAGE)
         /* Finally invalidate the 2nd image just in case it was used */
         SF2BL_MESSAGE("Invalidating image 2.\r\n")
@@ -564,22 +645,37 @@ int main()
         if(SF2BL_BOOT_EXEC_1 == g_boot_mode)
         {
             SF2BL_MESSAGE("Loading image 1 into RAM.\r\n")
-            image_status = sf2bl_rd_flash_image(g_img1_offset);
+            image_status = sf2bl_boot_image(g_img1_offset);
         }
         else
         {
             SF2BL_MESSAGE("Loading image 2 into RAM.\r\n")
-            image_status = sf2bl_rd_flash_image(g_img2_offset);
+            image_status = sf2bl_boot_image(g_img2_offset);
         }
 #else
-        image_status = sf2bl_rd_flash_image(g_img1_offset);
+        image_status = sf2bl_boot_image(g_img1_offset);
+#endif
+#if defined(SF2BL_PART_TABLE)
+        /* If the newest image will not load try the older ones in turn */
+        fallback = sf2bl_part_next(g_img1_offset);
+        while((0 != image_status) && (SF2BL_NO_IMAGE != fallback))
+        {
+            SF2BL_MESSAGE("Falling back to an older image.\r\n")
+            g_img1_offset = fallback;
+            image_status = sf2bl_boot_image(g_img1_offset);
+            fallback = sf2bl_part_next(g_img1_offset);
+        }
 #endif
     }
 
     if(0 == image_status) /* Get Ready to execute application */
     {
+        SF2BL_LOG_BOOT(SF2BL_LOG_RESULT_EXEC)
         spi_flash_deinit();
 #if defined(SF2BL_VERBOSE)
+        SF2BL_MESSAGE("SPI FLASH transactions this boot: ")
+        _putdecimal(g_spi_flash_transactions);
+        SF2BL_MESSAGE("\r\n")
         SF2BL_MESSAGE("Commencing application execution.\r\n")
 //<CJ>TODO:        _put_wait(); /* Wait for completion before shutting down UART */
 #endif
@@ -600,14 +696,32 @@ int main()
 //<CJ>TODO        SysTick->CTRL  = SysTick_CTRL_CLKSOURCE_Msk; /* Disable SysTick */
         /*
          * Finally, we get to execute the users application, this is the point of no
-         * return.
+         * return. With SF2BL_BOOT_METRICS the application gets the address of
+         * the boot metrics record in a0, otherwise a0 is 0.
          */
         {
-            sf2bl_exec();
+#if defined(SF2BL_BOOT_METRICS)
+            exec_arg = sf2bl_metrics_finish();
+#else
+            exec_arg = 0u;
+#endif
+            /*
+             * g_img1_header holds the header of whichever image was loaded.
+             * Images without an entry point start at the base of DDR.
+             */
+            if(0u != (g_img1_header.flags & SF2BL_IMG_FLAG_ENTRY))
+            {
+                sf2bl_exec(g_img1_header.entry, exec_arg);
+            }
+            else
+            {
+                sf2bl_exec(SF2BL_DDR_BASE, exec_arg);
+            }
         }
     }
 
     /* We should never make it this far... */
+    SF2BL_LOG_BOOT(SF2BL_LOG_RESULT_HALT)
     SF2BL_MESSAGE("No valid application image available.\r\n")
     SF2BL_MESSAGE("Bootloader halting.\r\n")
     for(;;)
@@ -0,0 +1,462 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader received file stream handling.
+ *
+ * Consumes the update file as it arrives from YMODEM. Plain Intel Hex files are
+ * stored at g_rx_base for processing once the transfer is complete as before,
+ * as are delta update files if SF2BL_DELTA_UPDATE is defined. If
+ * SF2BL_ELF_TRANSFER is defined, ELF executables are turned into a binary
+ * image at g_bin_base as they arrive.
+ * If SF2BL_LZ4_TRANSFER is defined, files which start with the LZ4 frame magic
+ * number are decompressed on the fly, packet by packet, straight into the
+ * binary image area at g_bin_base.
+ * If SF2BL_FLASH_BG_ERASE is defined the image slot the file is going to is
+ * erased in the background as the file arrives.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sf2_bl_options.h"
+#include "sf2_bl_defs.h"
+#include "ymodem.h"
+#include "intel_hex.h"
+#include "image_tools.h"
+#include "lz4.h"
+#include "delta.h"
+#include "elf.h"
+#include "rx_stream.h"
+
+/*
+ * Stream states.
+ */
+#define RXS_IDLE       0u /* No data received yet */
+#define RXS_STORE      1u /* Storing Intel Hex or delta file */
+#define RXS_LZ4_HDR    2u /* Collecting LZ4 frame descriptor */
+#define RXS_LZ4_BSIZE  3u /* Collecting LZ4 block size */
+#define RXS_LZ4_BDATA  4u /* LZ4 block data */
+#define RXS_LZ4_SKIP   5u /* Skipping LZ4 block or content checksum */
+#define RXS_LZ4_END    6u /* LZ4 frame complete, ignore YMODEM padding */
+#define RXS_ERROR      7u
+#define RXS_ELF        8u /* Building image from ELF file */
+
+#define LZ4_FRAME_MAGIC       0x184D2204u
+#define LZ4_FLG_VERSION_MASK  0xC0u
+#define LZ4_FLG_VERSION       0x40u
+#define LZ4_FLG_BLOCK_CSUM    0x10u
+#define LZ4_FLG_CONTENT_SIZE  0x08u
+#define LZ4_FLG_CONTENT_CSUM  0x04u
+#define LZ4_FLG_DICT_ID       0x01u
+#define LZ4_BLOCK_STORED      0x80000000u
+
+#define ELF_MAGIC             0x464C457Fu /* "\177ELF" */
+
+typedef struct rx_stream
+{
+    uint32_t state;
+    uint32_t wire_bytes;   /* Bytes received over the link */
+    uint32_t start_time;   /* g_10ms_count at first packet */
+    uint32_t last_time;    /* g_10ms_count at latest packet */
+#if defined(SF2BL_LZ4_TRANSFER)
+    uint8_t  hdr[16];      /* Frame descriptor/block size collection */
+    uint32_t hdr_len;
+    uint32_t hdr_need;
+    uint32_t flg;          /* Frame descriptor flags */
+    uint32_t block_left;   /* Bytes left in current block */
+    uint32_t block_stored; /* Current block is uncompressed */
+    uint32_t skip_left;    /* Checksum bytes left to skip */
+    uint32_t skip_next;    /* State to return to after skipping */
+    sf2bl_lz4_t lz4;
+#endif
+} rx_stream_t;
+
+static rx_stream_t g_rx_stream;
+
+#if defined(SF2BL_ELF_TRANSFER) || defined(SF2BL_LZ4_TRANSFER) || defined(SF2BL_DELTA_UPDATE) || defined(SF2BL_FLASH_BG_ERASE)
+/***************************************************************************//**
+ * Fetch an unaligned little endian 32 bit value, used for checking magic
+ * numbers.
+ */
+static uint32_t rx_stream_get_u32(const uint8_t *data)
+{
+    return((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+}
+#endif
+
+#if defined(SF2BL_FLASH_BG_ERASE)
+/***************************************************************************//**
+ * Keep the image slot being erased ahead of the image as it arrives. A delta
+ * file is built from the image in FLASH, which may be the one being replaced,
+ * so nothing is erased until the start of the file shows it is not one. Intel
+ * Hex files are bigger than their image so this erases more than needed, which
+ * costs nothing while the link is the bottleneck.
+ */
+static void rx_stream_erase_ahead(void)
+{
+    const uint8_t *start = 0;
+    uint32_t len = 0u;
+
+    if(RXS_STORE == g_rx_stream.state)
+    {
+        start = g_rx_base;
+        len   = g_rx_stream.wire_bytes;
+    }
+#if defined(SF2BL_ELF_TRANSFER)
+    else if(RXS_ELF == g_rx_stream.state)
+    {
+        len = g_rx_stream.wire_bytes;
+    }
+#endif
+#if defined(SF2BL_LZ4_TRANSFER)
+    else if(RXS_ERROR != g_rx_stream.state)
+    {
+        start = g_bin_base;
+        len   = (uint32_t)(g_rx_stream.lz4.out - g_bin_base);
+    }
+#endif
+
+    if((len >= 4u) && ((0 == start) || (SF2BL_DELTA_MAGIC != rx_stream_get_u32(start))))
+    {
+        sf2bl_erase_ahead(len);
+    }
+}
+#endif
+
+/***************************************************************************//**
+ * Reset the stream ready for a new transfer.
+ */
+void sf2bl_rx_stream_init(void)
+{
+    memset(&g_rx_stream, 0, sizeof(g_rx_stream));
+    g_rx_stream.state = RXS_IDLE;
+}
+
+#if defined(SF2BL_LZ4_TRANSFER)
+/***************************************************************************//**
+ * Work through a packet of an LZ4 frame. Only the parts of the frame format
+ * needed to get at the data are handled. The frame descriptor and block
+ * checksums are skipped as YMODEM already protects the data on the link and the
+ * image CRC protects the decompressed result.
+ */
+static void rx_stream_lz4(const uint8_t *data, uint32_t len)
+{
+    uint32_t temp;
+
+    while((len > 0u) && (RXS_ERROR != g_rx_stream.state))
+    {
+        switch(g_rx_stream.state)
+        {
+        case RXS_LZ4_HDR:
+            g_rx_stream.hdr[g_rx_stream.hdr_len++] = *data++;
+            len--;
+            if(5u == g_rx_stream.hdr_len) /* Have magic and FLG */
+            {
+                g_rx_stream.flg = g_rx_stream.hdr[4];
+                if((LZ4_FLG_VERSION != (g_rx_stream.flg & LZ4_FLG_VERSION_MASK)) ||
+                   (0u != (g_rx_stream.flg & LZ4_FLG_DICT_ID)))
+                {
+                    g_rx_stream.state = RXS_ERROR;
+                }
+                else
+                {
+                    /* Magic, FLG, BD, optional content size and HC */
+                    g_rx_stream.hdr_need = 7u;
+                    if(0u != (g_rx_stream.flg & LZ4_FLG_CONTENT_SIZE))
+                    {
+                        g_rx_stream.hdr_need += 8u;
+                    }
+                }
+            }
+            else if(g_rx_stream.hdr_len == g_rx_stream.hdr_need)
+            {
+                g_rx_stream.hdr_len = 0u;
+                g_rx_stream.state = RXS_LZ4_BSIZE;
+            }
+            break;
+
+        case RXS_LZ4_BSIZE:
+            g_rx_stream.hdr[g_rx_stream.hdr_len++] = *data++;
+            len--;
+            if(4u == g_rx_stream.hdr_len)
+            {
+                g_rx_stream.hdr_len = 0u;
+                temp = (uint32_t)g_rx_stream.hdr[0] | ((uint32_t)g_rx_stream.hdr[1] << 8) |
+                       ((uint32_t)g_rx_stream.hdr[2] << 16) | ((uint32_t)g_rx_stream.hdr[3] << 24);
+                if(0u == temp) /* End mark */
+                {
+                    if(0u != (g_rx_stream.flg & LZ4_FLG_CONTENT_CSUM))
+                    {
+                        g_rx_stream.skip_left = 4u;
+                        g_rx_stream.skip_next = RXS_LZ4_END;
+                        g_rx_stream.state = RXS_LZ4_SKIP;
+                    }
+                    else
+                    {
+                        g_rx_stream.state = RXS_LZ4_END;
+                    }
+                }
+                else
+                {
+                    g_rx_stream.block_stored = temp & LZ4_BLOCK_STORED;
+                    g_rx_stream.block_left = temp & ~LZ4_BLOCK_STORED;
+                    g_rx_stream.state = RXS_LZ4_BDATA;
+                }
+            }
+            break;
+
+        case RXS_LZ4_BDATA:
+            temp = (len < g_rx_stream.block_left) ? len : g_rx_stream.block_left;
+            if(0u != g_rx_stream.block_stored)
+            {
+                if(0 != sf2bl_lz4_store(&g_rx_stream.lz4, data, temp))
+                {
+                    g_rx_stream.state = RXS_ERROR;
+                }
+            }
+            else if(0 != sf2bl_lz4_decode(&g_rx_stream.lz4, data, temp))
+            {
+                g_rx_stream.state = RXS_ERROR;
+            }
+
+            data += temp;
+            len  -= temp;
+            g_rx_stream.block_left -= temp;
+            if((RXS_ERROR != g_rx_stream.state) && (0u == g_rx_stream.block_left))
+            {
+                if((0u == g_rx_stream.block_stored) && (0 != sf2bl_lz4_next_block(&g_rx_stream.lz4)))
+                {
+                    g_rx_stream.state = RXS_ERROR;
+                }
+                else if(0u != (g_rx_stream.flg & LZ4_FLG_BLOCK_CSUM))
+                {
+                    g_rx_stream.skip_left = 4u;
+                    g_rx_stream.skip_next = RXS_LZ4_BSIZE;
+                    g_rx_stream.state = RXS_LZ4_SKIP;
+                }
+                else
+                {
+                    g_rx_stream.state = RXS_LZ4_BSIZE;
+                }
+            }
+            break;
+
+        case RXS_LZ4_SKIP:
+            temp = (len < g_rx_stream.skip_left) ? len : g_rx_stream.skip_left;
+            data += temp;
+            len  -= temp;
+            g_rx_stream.skip_left -= temp;
+            if(0u == g_rx_stream.skip_left)
+            {
+                g_rx_stream.state = g_rx_stream.skip_next;
+            }
+            break;
+
+        default: /* RXS_LZ4_END, anything after the frame is YMODEM padding */
+            len = 0u;
+            break;
+        }
+    }
+}
+#endif
+
+/***************************************************************************//**
+ * YMODEM data packet handler.
+ *
+ * Returns 0 to accept the data or -1 to cancel the transfer.
+ */
+int32_t sf2bl_rx_stream_data(const uint8_t *data, uint32_t len)
+{
+    if(RXS_IDLE == g_rx_stream.state)
+    {
+        g_rx_stream.start_time = g_10ms_count;
+        g_rx_stream.state = RXS_STORE;
+        /* YMODEM packets are at least 128 bytes so the magic is all here */
+#if defined(SF2BL_ELF_TRANSFER)
+        if(ELF_MAGIC == rx_stream_get_u32(data))
+        {
+            sf2bl_elf_init();
+            g_rx_stream.state = RXS_ELF;
+        }
+#endif
+#if defined(SF2BL_LZ4_TRANSFER)
+        if(LZ4_FRAME_MAGIC == rx_stream_get_u32(data))
+        {
+            /*
+             * Decompress into the binary image area which runs from g_bin_base
+             * to the end of DDR.
+             */
+            sf2bl_lz4_init(&g_rx_stream.lz4, g_bin_base, SF2BL_DDR_SIZE - g_rx_size);
+            g_rx_stream.state = RXS_LZ4_HDR;
+        }
+#endif
+    }
+
+    if(RXS_STORE == g_rx_stream.state)
+    {
+        /* ymodem_receive() has already checked this fits in g_rx_size */
+        memcpy(&g_rx_base[g_rx_stream.wire_bytes], data, len);
+    }
+#if defined(SF2BL_ELF_TRANSFER)
+    else if(RXS_ELF == g_rx_stream.state)
+    {
+        if(0 != sf2bl_elf_data(data, len))
+        {
+            g_rx_stream.state = RXS_ERROR;
+        }
+    }
+#endif
+#if defined(SF2BL_LZ4_TRANSFER)
+    else
+    {
+        rx_stream_lz4(data, len);
+    }
+#endif
+
+    g_rx_stream.wire_bytes += len;
+    g_rx_stream.last_time = g_10ms_count;
+#if defined(SF2BL_FLASH_BG_ERASE)
+    rx_stream_erase_ahead();
+#endif
+
+    return(RXS_ERROR == g_rx_stream.state ? -1 : 0);
+}
+
+#if defined(SF2BL_VERBOSE)
+/***************************************************************************//**
+ * Calculate (value * scale) / divisor without needing 64 bit arithmetic.
+ */
+static uint32_t rx_stream_scale(uint32_t value, uint32_t scale, uint32_t divisor)
+{
+    return(((value / divisor) * scale) + (((value % divisor) * scale) / divisor));
+}
+
+/***************************************************************************//**
+ * Report the compression ratio and effective throughput for the transfer.
+ * A ratio below 1 is expected for Intel Hex files as the ASCII encoding more
+ * than doubles the size of the data.
+ */
+static void rx_stream_report(uint32_t image_bytes)
+{
+    uint32_t elapsed;
+    uint32_t temp;
+
+    elapsed = g_rx_stream.last_time - g_rx_stream.start_time;
+    if(0u == elapsed)
+    {
+        elapsed = 1u; /* 1mS, avoid divide by 0 for very short transfers */
+    }
+
+    _putstring((uint8_t *)"Received ");
+    _putdecimal(g_rx_stream.wire_bytes);
+    _putstring((uint8_t *)" bytes in ");
+    _putdecimal(elapsed);
+    _putstring((uint8_t *)"mS, image is ");
+    _putdecimal(image_bytes);
+    _putstring((uint8_t *)" bytes\r\nRatio ");
+    /* Ratio to 2 decimal places */
+    temp = rx_stream_scale(image_bytes, 100u, g_rx_stream.wire_bytes);
+    _putdecimal(temp / 100u);
+    _putstring((uint8_t *)".");
+    _putdecimal((temp % 100u) / 10u);
+    _putdecimal(temp % 10u);
+    _putstring((uint8_t *)":1, link ");
+    _putdecimal(rx_stream_scale(g_rx_stream.wire_bytes, 1000u, elapsed));
+    _putstring((uint8_t *)" bytes/S, effective ");
+    _putdecimal(rx_stream_scale(image_bytes, 1000u, elapsed));
+    _putstring((uint8_t *)" bytes/S\r\n");
+}
+#endif
+
+/***************************************************************************//**
+ * Process a complete file stored at g_rx_base.
+ *
+ * Returns the number of bytes in the image or 0 for error.
+ */
+static uint32_t rx_stream_process_stored(uint32_t len)
+{
+    uint32_t processed;
+
+#if defined(SF2BL_DELTA_UPDATE)
+    if((len >= 4u) && (SF2BL_DELTA_MAGIC == rx_stream_get_u32(g_rx_base)))
+    {
+        processed = sf2bl_process_delta(len);
+    }
+    else
+#endif
+#if defined(SF2BL_ELF_TRANSFER)
+    if((len >= 4u) && (ELF_MAGIC == rx_stream_get_u32(g_rx_base)))
+    {
+        /* Only happens for a compressed ELF file, process it in one go */
+        sf2bl_elf_init();
+        processed = 0u;
+        if(0 == sf2bl_elf_data(g_rx_base, len))
+        {
+            processed = sf2bl_elf_finish(len);
+        }
+    }
+    else
+#endif
+    {
+        processed = sf2bl_process_hex_file(len);
+    }
+
+    return(processed);
+}
+
+/***************************************************************************//**
+ * Complete processing of the received file once the transfer has finished.
+ * The binary image ends up at g_bin_base ready for writing to FLASH.
+ *
+ * Returns the number of bytes in the image or 0 for error.
+ */
+uint32_t sf2bl_rx_stream_finish(uint32_t received)
+{
+    uint32_t processed = 0u;
+#if defined(SF2BL_LZ4_TRANSFER)
+    uint32_t out_len;
+#endif
+
+    if(RXS_STORE == g_rx_stream.state)
+    {
+        processed = rx_stream_process_stored(received);
+    }
+#if defined(SF2BL_ELF_TRANSFER)
+    else if(RXS_ELF == g_rx_stream.state)
+    {
+        processed = sf2bl_elf_finish(received);
+    }
+#endif
+#if defined(SF2BL_LZ4_TRANSFER)
+    else if(RXS_LZ4_END == g_rx_stream.state)
+    {
+        out_len = (uint32_t)(g_rx_stream.lz4.out - g_bin_base);
+        if((out_len < sizeof(img_hdr_block_t)) || (SF2BL_IMG_HDR_BLANK != ((img_hdr_block_t *)g_bin_base)->valid))
+        {
+            /*
+             * Compressed Intel Hex, delta or ELF file. Move it to where the
+             * processing expects it, which is bigger than the binary image
+             * area.
+             */
+            memcpy(g_rx_base, g_bin_base, out_len);
+            processed = rx_stream_process_stored(out_len);
+        }
+        else
+        {
+            processed = sf2bl_process_bin_image(out_len);
+        }
+    }
+#endif
+
+#if defined(SF2BL_VERBOSE)
+    if(0u != processed)
+    {
+        rx_stream_report(processed);
+    }
+#endif
+
+    return(processed);
+}
@@ -0,0 +1,17 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader received file stream handling header.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef RX_STREAM_H_
+#define RX_STREAM_H_
+
+void     sf2bl_rx_stream_init(void);
+int32_t  sf2bl_rx_stream_data(const uint8_t *data, uint32_t len);
+uint32_t sf2bl_rx_stream_finish(uint32_t received);
+
+#endif /* RX_STREAM_H_ */
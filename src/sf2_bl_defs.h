@@ -38,7 +38,8 @@ typedef struct img_hdr_block
     uint32_t crc32;
     uint32_t n_chunks;
     uint8_t  name[64];
-    uint8_t  reserved[6];
+    uint32_t entry;       /* Application entry point if SF2BL_IMG_FLAG_ENTRY set */
+    uint8_t  reserved[2];
     uint16_t crc16;
 } img_hdr_block_t;
 
@@ -50,6 +51,60 @@ typedef struct img_chunk_hdr
     uint32_t index;  /* Chunk number starting from 0 */
 } img_chunk_hdr_t;
 
+/*
+ * Set in the chunk header index field for a chunk which is to be filled with
+ * 0s. No data is stored for these chunks.
+ */
+#define SF2BL_CHUNK_ZERO_FILL 0x80000000u
+
+/*
+ * Entry in the chunk index of a version 2 image. All offsets are from the start
+ * of the image header in FLASH.
+ */
+typedef struct img_chunk_idx
+{
+    uint32_t offset; /* Offset of stored chunk data */
+    uint32_t dest;   /* Linear address chunk is loaded to */
+    uint32_t len;    /* Length of chunk once loaded */
+    uint32_t stored; /* Length of stored data, compressed length for LZ4 */
+    uint32_t index;  /* Copy of chunk header index field */
+    uint32_t crc32;  /* CRC32 of stored data */
+} img_chunk_idx_t;
+
+/*
+ * Bytes in the chunk index of a version 2 image with n chunks. The entries are
+ * followed by a CRC32 of the entries.
+ */
+#define SF2BL_IDX_TABLE_LEN(n) (((n) * sizeof(img_chunk_idx_t)) + sizeof(uint32_t))
+
+/*
+ * Header for a delta update file. The header is followed by a list of byte
+ * aligned operations which build the new image from the currently active
+ * image and data in the file. All values are little endian.
+ *
+ *   SF2BL_DELTA_OP_COPY   - uint32_t source offset, uint32_t length. Copy from
+ *                           the active image as stored in FLASH, offset 0 is
+ *                           the start of the image header.
+ *   SF2BL_DELTA_OP_INSERT - uint32_t length followed by that many data bytes.
+ *   SF2BL_DELTA_OP_END    - End of operations.
+ */
+typedef struct img_delta_hdr
+{
+    uint32_t magic;     /* SF2BL_DELTA_MAGIC */
+    uint32_t version;   /* SF2BL_DELTA_VERSION */
+    uint32_t src_crc32; /* crc32 from header of image the delta was made against */
+    uint32_t tgt_size;  /* Size of new image including its header */
+    uint32_t tgt_crc32; /* CRC32 of the complete new image */
+    uint32_t reserved;
+} img_delta_hdr_t;
+
+#define SF2BL_DELTA_MAGIC     0x44324653u /* "SF2D" */
+#define SF2BL_DELTA_VERSION   1u
+
+#define SF2BL_DELTA_OP_END    0x00u
+#define SF2BL_DELTA_OP_COPY   0x01u
+#define SF2BL_DELTA_OP_INSERT 0x02u
+
 /*
  * Defines used to manage bitmask which specifies which of the drivers have been
  * initialised by the bootloader. This is important to ensure that drivers are
@@ -102,6 +157,33 @@ typedef enum {
 #define SF2BL_IMG_HDR_VALID   0xAA55AA55 /* Update complete, active image */
 #define SF2BL_IMG_HDR_INVALID 0x00000000 /* Invalid image - probably superseded */
 
+/*
+ * Image header flags.
+ *
+ * SF2BL_IMG_FLAG_LZ4 - Chunk data is LZ4 block compressed. Each chunk header
+ * is followed by a uint32_t giving the compressed length and then the
+ * compressed data. The chunk header len field is the decompressed length.
+ *
+ * SF2BL_IMG_FLAG_ENTRY - The header entry field holds the application entry
+ * point. Otherwise execution starts at the base of DDR. Only set for ELF
+ * downloads, the start address record of an Intel Hex file is ignored.
+ */
+#define SF2BL_IMG_FLAG_LZ4    0x00000001u
+#define SF2BL_IMG_FLAG_ENTRY  0x00000002u
+
+/*
+ * Image header versions.
+ *
+ * SF2BL_IMG_VERSION_1 - The chunks follow the header, each chunk header being
+ * followed by the chunk data.
+ *
+ * SF2BL_IMG_VERSION_2 - As version 1 with a chunk index between the header and
+ * the first chunk. The index allows each chunk to be located and checked on its
+ * own. The header crc32 covers the index and chunks.
+ */
+#define SF2BL_IMG_VERSION_1   1u
+#define SF2BL_IMG_VERSION_2   2u
+
 /* Defines for FLASH memory device selection */
 
 #define SF2BL_FLASH_DEV_AT25DF641        0
@@ -113,16 +113,39 @@
  * #define SF2BL_FLASH_WRITE_VERIFY
  */
 
+/*
+ * SF2BL_FLASH_VERIFY_CRC
+ *
+ * Define this macro, with SF2BL_FLASH_WRITE_VERIFY, to verify each write with
+ * one long read of everything written rather than a read after every page.
+ * The CRC32 of the data read back is compared with one calculated while the
+ * pages were being programmed, and the pages are only read back one at a time
+ * to find which one is wrong if these differ.
+ *
+ * #define SF2BL_FLASH_VERIFY_CRC
+ */
+
+#if defined(SF2BL_FLASH_VERIFY_CRC) && !defined(SF2BL_FLASH_WRITE_VERIFY)
+#error "SF2BL_FLASH_VERIFY_CRC requires SF2BL_FLASH_WRITE_VERIFY."
+#endif
+
 /* SF2BL_FLASH_USE_DMA
  *
- * Define this macro to enable PDMA operation for SPI FLASH access.
+ * Define this macro to enable PDMA operation for SPI FLASH access. With
+ * SF2BL_CORE_SPI a CoreAXI4DMAController at FLASH_DMA_BASE_ADDR in
+ * hw_platform.h is used instead, see flash/flash_dma.h.
+ * The CoreSPI DMA backend has not yet been validated on hardware and the
+ * default FLASH_DMA_BASE_ADDR is only a placeholder, so leave this off with
+ * SF2BL_CORE_SPI unless the design has been checked against both.
  *
  * #define SF2BL_FLASH_USE_DMA
  */
 
 /* SF2BL_ FLASH_RX_DMA_CHAN
  *
- * Sets the PDMA channel to use for SPI receive data. Default is 0.
+ * Sets the PDMA channel to use for SPI receive data. Default is 0. With
+ * CoreAXI4DMAController this selects a group of FLASH_DMA_MAX_DESCS internal
+ * descriptors, group n starting at descriptor n * FLASH_DMA_MAX_DESCS.
  */
 
 #if !defined(SF2BL_FLASH_RX_DMA_CHAN)
@@ -131,7 +154,8 @@
 
 /* SF2BL_ FLASH_TX_DMA_CHAN
  *
- * Sets the PDMA channel to use for SPI transmit data. Default is 1.
+ * Sets the PDMA channel to use for SPI transmit data. Default is 1. With
+ * CoreAXI4DMAController this selects a group of descriptors as above.
  */
 
 #if !defined(SF2BL_FLASH_TX_DMA_CHAN)
@@ -247,10 +271,14 @@
  * SF2BL_FLASH_DEV_N25Q00AA13GSF40G - Smartfusion2 Advanced Dev kit
  * SF2BL_FLASH_DEV_S25FL128SDPBHICO - SmartFusion2 Starter Kit
  *
+ * The SPI FLASH driver identifies the device from its JEDEC ID at start up so
+ * any of the above will work whatever this is set to. The description of the
+ * device selected here is used if the ID is not recognised.
+ *
  * If the SmartFusion2 Bootloader is being used with a custom design not using
  * one of the above devices, the user should add a definition for the device in
- * question and modify the SPI FLASH driver to provide support for the new
- * device.
+ * question and add it to the table of known devices in the SPI FLASH driver,
+ * or use SF2BL_FLASH_SFDP if the device has SFDP tables.
  */
 
 #if !defined(SF2BL_FLASH_DEVICE)
@@ -328,6 +356,18 @@
 #error "Invalid SF2BL_CONFIG_SIZE value, must be non 0 multiple of 2"
 #endif
 
+/* SF2BL_PART_TABLE_RESERVE
+ *
+ * With SF2BL_PART_TABLE the 4K sector after the configuration area is kept for
+ * the partition table and the images start after it. 0 otherwise.
+ */
+
+#if defined(SF2BL_PART_TABLE)
+#define SF2BL_PART_TABLE_RESERVE 4096
+#else
+#define SF2BL_PART_TABLE_RESERVE 0
+#endif
+
 /* SF2BL_IMAGE_SIZE
  *
  * The amount of memory reserved in the SPI FLASH for each image. The default
@@ -337,15 +377,15 @@
 #if !defined(SF2BL_IMAGE_SIZE)
  #if defined(SF2BL_GOLDEN)
   #if defined(SF2BL_2ND_IMAGE)
-   #define SF2BL_IMAGE_SIZE ((SF2BL_FLASH_SIZE - (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096))) / 3)
+   #define SF2BL_IMAGE_SIZE ((SF2BL_FLASH_SIZE - (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096) + SF2BL_PART_TABLE_RESERVE)) / 3)
   #else
-   #define SF2BL_IMAGE_SIZE ((SF2BL_FLASH_SIZE - (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096))) / 2)
+   #define SF2BL_IMAGE_SIZE ((SF2BL_FLASH_SIZE - (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096) + SF2BL_PART_TABLE_RESERVE)) / 2)
   #endif
  #else
   #if defined(SF2BL_2ND_IMAGE)
-   #define SF2BL_IMAGE_SIZE ((SF2BL_FLASH_SIZE - (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096))) / 2)
+   #define SF2BL_IMAGE_SIZE ((SF2BL_FLASH_SIZE - (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096) + SF2BL_PART_TABLE_RESERVE)) / 2)
   #else
-   #define SF2BL_IMAGE_SIZE (SF2BL_FLASH_SIZE - (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096)))
+   #define SF2BL_IMAGE_SIZE (SF2BL_FLASH_SIZE - (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096) + SF2BL_PART_TABLE_RESERVE))
   #endif
  #endif
 #endif
@@ -354,6 +394,16 @@
 #error "Image size is not a multiple of SF2BL_FLASH_IMAGE_GRANUALARITY"
 #endif
 
+/* SF2BL_CALIBRATION_ADDR
+ *
+ * SPI FLASH address of the 4K sector used with SF2BL_SPI_CALIBRATE. The default
+ * is the last 4K block of the configuration area.
+ */
+
+#if !defined(SF2BL_CALIBRATION_ADDR)
+#define SF2BL_CALIBRATION_ADDR (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096) - 4096)
+#endif
+
 /* SF2BL_COMMS_OPTION
  *
  * Set to one of the following to select the firmware update option:
@@ -698,6 +748,242 @@
  * #define SF2BL_EMBEDDED_VER
  */
 
+/* SF2BL_IMAGE_COMPRESS
+ *
+ * Define this macro to have the Bootloader LZ4 compress the chunk data of a
+ * downloaded image before it is written to the SPI FLASH. This reduces the
+ * amount of data that has to be read back from the FLASH at boot time, which
+ * is where most of the boot time goes. Compressed images are always loaded
+ * regardless of this setting, it only controls whether new images are
+ * compressed. Images which do not get smaller are stored uncompressed.
+ *
+ * As a guide, a 200K RISC-V test image compresses to 78% of its size. In the
+ * host build at 20MHz that cuts the bytes read from the FLASH at boot from
+ * 216072 to 167756 and the boot time from 98.7ms to 79.3ms. The host build
+ * does not charge for the decompression itself, so measure on the target
+ * before relying on the saving with a slow core clock.
+ *
+ * #define SF2BL_IMAGE_COMPRESS
+ */
+
+/* SF2BL_LZ4_TRANSFER
+ *
+ * Define this macro to allow the update file to be sent as an LZ4 frame, as
+ * produced by the standard lz4 command line tool. The frame is decompressed as
+ * each YMODEM packet arrives so the transfer time is reduced by the
+ * compression ratio. The frame may contain either an Intel Hex file or a
+ * binary image in the Bootloader FLASH image format. Plain Intel Hex files are
+ * still accepted.
+ *
+ * #define SF2BL_LZ4_TRANSFER
+ */
+
+/* SF2BL_DELTA_UPDATE
+ *
+ * Define this macro to accept delta update files. A delta update file contains
+ * only the differences between the currently active image and the new image
+ * and so can be much smaller than the full Intel Hex file when only part of
+ * the application has changed. The new image is rebuilt from the active image
+ * and checked against the CRC32 in the delta file before being written to the
+ * FLASH in the normal way. See img_delta_hdr_t in sf2_bl_defs.h for the file
+ * format.
+ *
+ * #define SF2BL_DELTA_UPDATE
+ */
+
+/* SF2BL_ELF_TRANSFER
+ *
+ * Define this macro to accept RISC-V ELF32 executables, as produced by the
+ * linker, as well as Intel Hex files. Each PT_LOAD segment becomes a chunk in
+ * the image and any .bss style zero fill is recorded rather than stored. The
+ * application is started at the ELF entry point. ELF files may also be sent
+ * LZ4 compressed.
+ *
+ * #define SF2BL_ELF_TRANSFER
+ */
+
+/* SF2BL_IMAGE_INDEX
+ *
+ * Define this macro to write images to the SPI FLASH in the version 2 format,
+ * which has an index of the chunks after the image header. Each index entry
+ * gives the location, destination, length and CRC32 of a chunk so each chunk
+ * is checked as it is loaded and a chunk which fails is read again. Version 1
+ * images are always loaded whether or not this is defined.
+ *
+ * #define SF2BL_IMAGE_INDEX
+ */
+
+/* SF2BL_WARM_BOOT
+ *
+ * Define this macro to skip reloading the application from the SPI FLASH after
+ * a watchdog or software reset if it is still intact in RAM. A boot record at
+ * SF2BL_BOOT_RECORD_ADDR describes the image last loaded and the CRC32 of each
+ * region of RAM it occupies. The image is only reused if the record is intact,
+ * it is still the image that would be loaded and every region matches. Zero
+ * fill regions are cleared again. Cold boots and updates are not affected.
+ *
+ * #define SF2BL_WARM_BOOT
+ */
+
+/* SF2BL_BOOT_METRICS
+ *
+ * Define this macro to record how long each phase of the boot takes, in both
+ * mcycle and mtime ticks, along with counts of SPI FLASH transfers, bytes and
+ * busy polls and of bytes passed through CRC32. The record is written to
+ * SF2BL_BOOT_METRICS_ADDR just before the application is started and its
+ * address is passed to the application in a0. See boot_metrics.h for the
+ * layout. Without this macro, or if the image loaded covers the record, a0 is
+ * 0.
+ *
+ * #define SF2BL_BOOT_METRICS
+ */
+
+/* SF2BL_BENCH
+ *
+ * Defined by "make bench" and "make host_bench" to build a bootloader which
+ * times its CRC, Intel Hex, memory copy and SPI FLASH read kernels and prints
+ * the results as CSV instead of booting. See bench.c. Not for normal use.
+ *
+ * #define SF2BL_BENCH
+ */
+
+/* SF2BL_SPI_CALIBRATE
+ *
+ * Define this macro to choose the SPI FLASH read command at boot. READ, which
+ * saves the dummy byte of FAST READ on every read, is used if it reads a known
+ * pattern and the first image header correctly at the CoreSPI clock of the
+ * design. The result is kept with the pattern at SF2BL_CALIBRATION_ADDR so
+ * later boots only check it. See spi_cal.c.
+ *
+ * #define SF2BL_SPI_CALIBRATE
+ */
+
+/* SF2BL_SPI_ASYNC
+ *
+ * Define this macro to have image loads read the SPI FLASH under the control
+ * of the CoreSPI receive interrupt, so the CRC32 of each burst is worked out
+ * while the next one is read. Only for use with SF2BL_CORE_SPI and the CoreSPI
+ * interrupt must be connected to the PLIC as FLASH_CORE_SPI_IRQn in
+ * hw_platform.h. Its default of External_29_IRQn has not been checked against
+ * a design, so set it to match yours before use. Timer0 is not enabled on the
+ * PLIC with this option and the 10ms tick comes from mtime alone.
+ *
+ * #define SF2BL_SPI_ASYNC
+ */
+#if defined(SF2BL_SPI_ASYNC) && (SF2BL_SPI_PORT != SF2BL_CORE_SPI)
+#error "SF2BL_SPI_ASYNC requires SF2BL_SPI_PORT to be SF2BL_CORE_SPI"
+#endif
+
+/* SF2BL_FLASH_SFDP
+ *
+ * Define this macro to have the SPI FLASH driver read the SFDP tables of the
+ * device at start up and use them to update its description of the device:
+ * size, page size, erase sizes, opcodes and times and the 4 byte address
+ * opcodes. Without it only the driver's table of known devices is used.
+ *
+ * #define SF2BL_FLASH_SFDP
+ */
+
+/* SF2BL_FLASH_BG_ERASE
+ *
+ * Define this macro to erase the image slot a download is going to while the
+ * file is still arriving, using the SPI FLASH driver's background erase. The
+ * driver starts each block erase without waiting for it and polls for its
+ * completion as packets arrive, so the UART is never left waiting on an erase,
+ * and suspends the erase for any reads made in the meantime. Only the part of
+ * the slot the image will need is erased, plus up to 128K. Delta files and
+ * golden image downloads are erased after the transfer as usual.
+ *
+ * The image being replaced is lost if the download then fails, where otherwise
+ * it would only be lost if writing the new image failed.
+ *
+ * #define SF2BL_FLASH_BG_ERASE
+ */
+
+/* SF2BL_FLASH_XIP
+ *
+ * Define this macro to offer the N25Q XIP (continuous read) mode as a read
+ * mode. Once the device is in XIP mode each read is sent as just the address
+ * and dummy byte, without the opcode, and the status poll before it is not
+ * needed as nothing else can be running. The driver leaves XIP mode before any
+ * other command, and does not enter it while a background erase is
+ * outstanding. With SF2BL_SPI_CALIBRATE it is tried before the other read
+ * modes, otherwise select it with SPI_FLASH_SET_READ_MODE.
+ *
+ * #define SF2BL_FLASH_XIP
+ */
+
+/* SF2BL_BOOT_LOG
+ *
+ * Define this macro to keep a record of every boot in a circular log in the
+ * SF2BL_LOG_SIZE sectors at SF2BL_FLASH_BASE: the boot mode, the image slot
+ * run, the time in each boot phase with SF2BL_BOOT_METRICS, download sizes and
+ * errors and the SPI FLASH counters. See boot_log.h for the layout and
+ * "make host_log" for a tool to decode a copy of the SPI FLASH.
+ *
+ * #define SF2BL_BOOT_LOG
+ */
+
+#if defined(SF2BL_BOOT_LOG) && (SF2BL_LOG_SIZE < 2)
+#error "SF2BL_BOOT_LOG requires SF2BL_LOG_SIZE of at least 2"
+#endif
+
+/* SF2BL_CONFIG_STORE
+ *
+ * Define this macro to keep a key/value store in the SF2BL_CONFIG_SIZE area,
+ * ping ponging between two banks of half the area each. With
+ * SF2BL_SPI_CALIBRATE the last sector is kept for the calibration record and
+ * the banks share what is left. The bootloader takes its YMODEM baud rate from
+ * the store if one is set there and a boot flag in the store can ask for a
+ * one off update. See boot_config.h for the keys and layout.
+ *
+ * #define SF2BL_CONFIG_STORE
+ */
+
+#if defined(SF2BL_CONFIG_STORE) && defined(SF2BL_SPI_CALIBRATE) && (SF2BL_CONFIG_SIZE < 4)
+#error "SF2BL_CONFIG_STORE with SF2BL_SPI_CALIBRATE requires SF2BL_CONFIG_SIZE of at least 4"
+#endif
+
+/* SF2BL_PART_TABLE
+ *
+ * Define this macro to take the image slots from a partition table at
+ * SF2BL_PART_TABLE_ADDR rather than splitting the SPI FLASH into
+ * SF2BL_IMAGE_SIZE slots. The table can list any number of image slots of any
+ * size, a golden image slot if SF2BL_GOLDEN is defined and data slots which
+ * the bootloader leaves alone. The newest good image is run, falling back to
+ * older ones if it will not load, and a download goes to the slot with the
+ * oldest image. With SF2BL_CONFIG_STORE a tag in the store picks which image
+ * slots are used. Without a good table the slots are laid out as they would
+ * be without this macro. See boot_part.h for the layout and "make host_part"
+ * for a tool to build a table.
+ *
+ * #define SF2BL_PART_TABLE
+ */
+
+#if defined(SF2BL_PART_TABLE) && defined(SF2BL_2ND_IMAGE)
+#error "SF2BL_PART_TABLE replaces SF2BL_2ND_IMAGE, list the image slots in the table instead"
+#endif
+
+/* SF2BL_PART_TABLE_ADDR
+ *
+ * SPI FLASH address of the 4K sector holding the partition table. The default
+ * is the sector kept for it after the log and configuration areas, see
+ * SF2BL_PART_TABLE_RESERVE. Any other address must be clear of the log,
+ * configuration and default image areas, as the images are laid out as they
+ * would be without a table if the table is not good.
+ */
+
+#if !defined(SF2BL_PART_TABLE_ADDR)
+#define SF2BL_PART_TABLE_ADDR (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096))
+#endif
+
+#if defined(SF2BL_PART_TABLE) && (SF2BL_PART_TABLE_ADDR != (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096)))
+ #if (SF2BL_PART_TABLE_ADDR < (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096) + SF2BL_PART_TABLE_RESERVE + SF2BL_IMAGE_SIZE)) || \
+     (defined(SF2BL_GOLDEN) && (SF2BL_PART_TABLE_ADDR < (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096) + SF2BL_PART_TABLE_RESERVE + (2 * SF2BL_IMAGE_SIZE))))
+ #error "SF2BL_PART_TABLE_ADDR overlaps the log, configuration or default image areas"
+ #endif
+#endif
+
 /* SF2BL_DDR_BASE
  *
  * Base address for non-mapped DDR memory. Amongst other things, this is where
@@ -733,6 +1019,34 @@
 #define SF2BL_DDR_SIZE 0x4000000
 #endif
 
+/* SF2BL_BOOT_RECORD_ADDR
+ *
+ * Address of the boot record used with SF2BL_WARM_BOOT. This needs 1K of RAM
+ * which the application does not load over and preferably does not use. If the
+ * application does use it the only effect is that the image is always loaded
+ * from the SPI FLASH.
+ *
+ * The default is the last 1K of DDR.
+ */
+
+#if !defined(SF2BL_BOOT_RECORD_ADDR)
+#define SF2BL_BOOT_RECORD_ADDR (SF2BL_DDR_BASE + SF2BL_DDR_SIZE - 1024)
+#endif
+
+/* SF2BL_BOOT_METRICS_ADDR
+ *
+ * Address of the boot metrics record used with SF2BL_BOOT_METRICS. This needs
+ * 256 bytes of RAM which the application does not load over. If a chunk of the
+ * image is loaded over it the record is not written rather than overwrite the
+ * application.
+ *
+ * The default is the 1K of DDR below the boot record.
+ */
+
+#if !defined(SF2BL_BOOT_METRICS_ADDR)
+#define SF2BL_BOOT_METRICS_ADDR (SF2BL_DDR_BASE + SF2BL_DDR_SIZE - 2048)
+#endif
+
 /* SF2BL_USBD_TIMEOUT
  *
  * This is the number of seconds to wait for a file being downloaded in USB MSC
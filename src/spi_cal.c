@@ -0,0 +1,235 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader SPI FLASH read calibration.
+ *
+ * The CoreSPI serial clock is fixed when the FPGA design is built, so what can
+ * be tuned at run time is the read command. READ needs no dummy byte but the
+ * device only supports it at a lower SPI clock than FAST READ, which is used
+ * with 8 dummy clocks as CoreSPI frames are 8 bits. With SF2BL_FLASH_XIP the
+ * FAST READ in XIP mode, which sends no opcode at all, is tried before either.
+ *
+ * Each read mode is tried in turn, shortest command first, by reading a known
+ * pattern from the calibration sector and the header of the first image. The
+ * first mode which reads both correctly SPI_CAL_PASSES times in a row is used.
+ * FAST READ is the fallback if no mode passes.
+ *
+ * The mode chosen is recorded in the calibration sector after the pattern, so
+ * later boots only check the recorded mode with one pass. The sweep is only
+ * repeated if that check fails.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sf2_bl_defs.h"
+#include "sf2_bl_options.h"
+#include "spi_flash.h"
+#include "crc32.h"
+#include "spi_cal.h"
+
+#if defined(SF2BL_SPI_CALIBRATE)
+
+#define SPI_CAL_MAGIC       0x41434653u /* "SFCA" */
+#define SPI_CAL_VERSION     2u          /* Bump if the pattern or modes change */
+#define SPI_CAL_PATTERN_LEN 256u
+#define SPI_CAL_PASSES      8u
+
+/* Header of the first image, golden or otherwise, or the partition table */
+#define SPI_CAL_HDR_ADDR    (SF2BL_FLASH_BASE + (SF2BL_LOG_SIZE * 4096) + (SF2BL_CONFIG_SIZE * 4096))
+
+typedef struct spi_cal_record
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t mode;     /* spi_flash_read_mode_t chosen */
+    uint32_t crc32;    /* CRC32 of the record up to here */
+} spi_cal_record_t;
+
+/*
+ * Pattern and record as stored in the calibration sector.
+ */
+typedef struct spi_cal_sector
+{
+    uint8_t          pattern[SPI_CAL_PATTERN_LEN];
+    spi_cal_record_t record;
+} spi_cal_sector_t;
+
+static spi_cal_sector_t g_cal_sector;
+static uint8_t g_cal_buf[SPI_CAL_PATTERN_LEN];
+static img_hdr_block_t g_cal_hdr;
+static img_hdr_block_t g_cal_hdr_buf;
+
+/***************************************************************************//**
+ * Byte index of the calibration pattern. Alternating bits, walking ones and
+ * zeros and then a spread of values, so that a bit lost or gained at any
+ * position shows up.
+ */
+static uint8_t cal_pattern_byte(uint32_t index)
+{
+    uint8_t return_val;
+
+    if(index < 64u)
+    {
+        return_val = (0u != (index & 1u)) ? 0xAAu : 0x55u;
+    }
+    else if(index < 128u)
+    {
+        return_val = (uint8_t)(1u << (index & 7u));
+        if(0u != (index & 8u))
+        {
+            return_val = (uint8_t)~return_val;
+        }
+    }
+    else
+    {
+        return_val = (uint8_t)((index * 167u) + 13u);
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Check the pattern in buffer.
+ *
+ * Returns 0 if it matches or -1 if not.
+ */
+static int32_t cal_pattern_check(const uint8_t *buffer)
+{
+    uint32_t index;
+    int32_t return_val = 0;
+
+    for(index = 0; (0 == return_val) && (index < SPI_CAL_PATTERN_LEN); index++)
+    {
+        if(cal_pattern_byte(index) != buffer[index])
+        {
+            return_val = -1;
+        }
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Read the pattern and image header with the current read mode.
+ *
+ * Returns 0 if both read correctly or -1 if not.
+ */
+static int32_t cal_read_check(void)
+{
+    int32_t return_val = -1;
+
+    if((SPI_FLASH_SUCCESS == spi_flash_read(SF2BL_CALIBRATION_ADDR, g_cal_buf, SPI_CAL_PATTERN_LEN)) &&
+       (0 == cal_pattern_check(g_cal_buf)) &&
+       (SPI_FLASH_SUCCESS == spi_flash_read(SPI_CAL_HDR_ADDR, (uint8_t *)&g_cal_hdr_buf, sizeof(g_cal_hdr_buf))) &&
+       (0 == memcmp(&g_cal_hdr, &g_cal_hdr_buf, sizeof(g_cal_hdr))))
+    {
+        return_val = 0;
+    }
+
+    return(return_val);
+}
+
+/***************************************************************************//**
+ * Fill in the record in g_cal_sector for mode.
+ */
+static void cal_make_record(uint32_t mode)
+{
+    g_cal_sector.record.magic   = SPI_CAL_MAGIC;
+    g_cal_sector.record.version = SPI_CAL_VERSION;
+    g_cal_sector.record.mode    = mode;
+    g_cal_sector.record.crc32   = sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)&g_cal_sector.record,
+                                                   sizeof(spi_cal_record_t) - sizeof(uint32_t));
+}
+
+/***************************************************************************//**
+ * Find the fastest read mode which works and select it. Called once the SPI
+ * FLASH is initialised, which leaves FAST READ selected, and before anything
+ * else is read.
+ *
+ * Returns 0 for success or -1 if no mode reads the pattern correctly, in which
+ * case FAST READ is left selected.
+ */
+int32_t sf2bl_spi_calibrate(void)
+{
+    uint32_t mode;
+    uint32_t pass;
+    uint32_t record_blank;
+    int32_t return_val = -1;
+
+    /* Reference copies are read in the default mode */
+    if((SPI_FLASH_SUCCESS == spi_flash_read(SPI_CAL_HDR_ADDR, (uint8_t *)&g_cal_hdr, sizeof(g_cal_hdr))) &&
+       (SPI_FLASH_SUCCESS == spi_flash_read(SF2BL_CALIBRATION_ADDR, (uint8_t *)&g_cal_sector, sizeof(g_cal_sector))))
+    {
+        mode = g_cal_sector.record.mode;
+        if((0 == cal_pattern_check(g_cal_sector.pattern)) &&
+           (SPI_CAL_MAGIC == g_cal_sector.record.magic) && (SPI_CAL_VERSION == g_cal_sector.record.version) &&
+           (mode < (uint32_t)SPI_FLASH_READ_MODES) &&
+           (g_cal_sector.record.crc32 == sf2bl_calc_crc32(0xFFFFFFFF, (uint8_t *)&g_cal_sector.record,
+                                                          sizeof(spi_cal_record_t) - sizeof(uint32_t))) &&
+           (SPI_FLASH_SUCCESS == spi_flash_control_hw(SPI_FLASH_SET_READ_MODE, mode, 0)))
+        {
+            return_val = cal_read_check();
+        }
+
+        if(0 != return_val)
+        {
+            (void)spi_flash_control_hw(SPI_FLASH_SET_READ_MODE, SPI_FLASH_READ_FAST, 0);
+
+            /*
+             * Put the pattern in place on first use, leaving the record erased
+             * so it can be programmed without another erase.
+             */
+            record_blank = 0u;
+            if(0 != cal_pattern_check(g_cal_sector.pattern))
+            {
+                for(pass = 0; pass < SPI_CAL_PATTERN_LEN; pass++)
+                {
+                    g_cal_sector.pattern[pass] = cal_pattern_byte(pass);
+                }
+                memset(&g_cal_sector.record, 0xFF, sizeof(spi_cal_record_t));
+                if(SPI_FLASH_SUCCESS == spi_flash_write(SF2BL_CALIBRATION_ADDR, (uint8_t *)&g_cal_sector, sizeof(g_cal_sector), 1))
+                {
+                    record_blank = 1u;
+                }
+            }
+
+            mode = (uint32_t)SPI_FLASH_READ_MODES;
+            while((0 != return_val) && (0u != mode))
+            {
+                mode--;
+                return_val = (SPI_FLASH_SUCCESS == spi_flash_control_hw(SPI_FLASH_SET_READ_MODE, mode, 0)) ? 0 : -1;
+                for(pass = 0; (0 == return_val) && (pass < SPI_CAL_PASSES); pass++)
+                {
+                    return_val = cal_read_check();
+                }
+            }
+
+            if(0 == return_val)
+            {
+                /* Programming does not depend on the read mode */
+                cal_make_record(mode);
+                if(0u != record_blank)
+                {
+                    (void)spi_flash_write(SF2BL_CALIBRATION_ADDR + SPI_CAL_PATTERN_LEN, (uint8_t *)&g_cal_sector.record,
+                                          sizeof(spi_cal_record_t), 0);
+                }
+                else
+                {
+                    (void)spi_flash_write(SF2BL_CALIBRATION_ADDR, (uint8_t *)&g_cal_sector, sizeof(g_cal_sector), 1);
+                }
+            }
+            else
+            {
+                (void)spi_flash_control_hw(SPI_FLASH_SET_READ_MODE, SPI_FLASH_READ_FAST, 0);
+            }
+        }
+    }
+
+    return(return_val);
+}
+
+#endif
@@ -0,0 +1,15 @@
+/*******************************************************************************
+ * (c) Copyright 2016 Microsemi SoC Products Group.  All rights reserved.
+ *
+ * SmartFusion2 Bootloader SPI FLASH read calibration header.
+ *
+ * SVN $Revision: $
+ * SVN $Date: $
+ */
+
+#ifndef SPI_CAL_H_
+#define SPI_CAL_H_
+
+int32_t sf2bl_spi_calibrate(void);
+
+#endif /* SPI_CAL_H_ */
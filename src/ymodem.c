@@ -30,6 +30,7 @@
 #include "sf2_bl_options.h"
 #include "sf2_bl_defs.h"
 #include "ymodem.h"
+#include "boot_config.h"
 #include "hw_platform.h"
 
 #if SF2BL_YMODEM_PORT == SF2BL_COREUART
@@ -100,6 +101,29 @@ mss_uart_instance_t *g_my_uart = &g_mss_uart1;
 
 #endif
 
+uint32_t g_ymodem_errors = 0;
+
+#if (SF2BL_YMODEM_PORT == SF2BL_CORE16550) || (SF2BL_YMODEM_PORT == SF2BL_COREUART)
+/***************************************************************************//**
+ * The baud rate to use, SF2BL_YMODEM_BAUD unless another one has been set in
+ * the configuration store.
+ */
+static uint32_t ymodem_baud(void)
+{
+    uint32_t baud = SF2BL_YMODEM_BAUD;
+
+#if defined(SF2BL_CONFIG_STORE)
+    baud = sf2bl_config_get_u32(SF2BL_CONFIG_KEY_BAUD, baud);
+    if(0u == baud)
+    {
+        baud = SF2BL_YMODEM_BAUD;
+    }
+#endif
+
+    return(baud);
+}
+#endif
+
 /***************************************************************************//**
  *
  */
@@ -112,9 +136,9 @@ void sf2bl_ymodem_init(void)
     /* baud_value = (clock /(baud_rate * 16))
      * Use 32 bits to preserve precision before down sizing to 16 bit */
 #if SF2BL_CORE16550_FIC == 0
-    temp = (uint32_t)(MSS_SYS_FIC_0_CLK_FREQ) / ((uint32_t)(SF2BL_YMODEM_BAUD) * 16u);
+    temp = (uint32_t)(MSS_SYS_FIC_0_CLK_FREQ) / (ymodem_baud() * 16u);
 #else
-    temp = (uint32_t)(MSS_SYS_FIC_1_CLK_FREQ) / ((uint32_t)(SF2BL_YMODEM_BAUD) * 16u);
+    temp = (uint32_t)(MSS_SYS_FIC_1_CLK_FREQ) / (ymodem_baud() * 16u);
 #endif
     baud_rate = temp;
 
@@ -124,7 +148,7 @@ void sf2bl_ymodem_init(void)
     g_driver_init |=  SF2BL_DRIVER_CORE_UART;
 #elif SF2BL_YMODEM_PORT == SF2BL_COREUART
     uint16_t baud_value;
-    baud_value = (SYS_CLK_FREQ / (SF2BL_YMODEM_BAUD * 16)) - 1;
+    baud_value = (SYS_CLK_FREQ / (ymodem_baud() * 16)) - 1;
     UART_init(&g_my_uart, COREUARTAPB0_BASE_ADDR, baud_value /*SF2BL_MODEM_BAUD*/, DATA_8_BITS | NO_PARITY);
     g_driver_init |=  SF2BL_DRIVER_CORE_UART;
     
@@ -153,7 +177,7 @@ void sf2bl_ymodem_deinit(void)
     g_driver_init &=  ~SF2BL_DRIVER_CORE_UART;
 #elif SF2BL_YMODEM_PORT == SF2BL_COREUART
     uint16_t baud_value;
-    baud_value = (SYS_CLK_FREQ / (SF2BL_YMODEM_BAUD * 16)) - 1;
+    baud_value = (SYS_CLK_FREQ / (ymodem_baud() * 16)) - 1;
     UART_init(&g_my_uart, COREUARTAPB0_BASE_ADDR, baud_value, DATA_8_BITS | NO_PARITY);
     g_driver_init &=  ~SF2BL_DRIVER_CORE_UART;
 #else
@@ -330,6 +354,26 @@ void _putstring(uint8_t *string)
 }
 
 
+/***************************************************************************//**
+ * Print an unsigned value in decimal.
+ */
+void _putdecimal(uint32_t value)
+{
+    uint8_t digits[11];
+    int32_t index;
+
+    index = 10;
+    digits[index] = 0;
+    do
+    {
+        digits[--index] = (uint8_t)('0' + (value % 10u));
+        value /= 10u;
+    } while(0u != value);
+
+    _putstring(&digits[index]);
+}
+
+
 /***************************************************************************//**
  *
  */
@@ -462,10 +506,12 @@ static int32_t receive_packet(uint8_t *data, int32_t *length)
 
 
 /***************************************************************************//**
- *
+ * Receive a file of up to length bytes. If handler is NULL the file is stored
+ * at buf, otherwise each data packet is passed to handler as it arrives and buf
+ * is not used.
  */
 /* Returns the length of the file received, or 0 on error: */
-uint32_t ymodem_receive(uint8_t *buf, uint32_t length)
+uint32_t ymodem_receive(uint8_t *buf, uint32_t length, ymodem_rx_handler_t handler)
 {
     static uint8_t packet_data[PACKET_1K_SIZE + PACKET_OVERHEAD]; /* Declare as static as 1K is a lot to put on our stack */
     static uint8_t file_name[FILE_NAME_LENGTH + 1]; /* +1 for nul */
@@ -480,7 +526,7 @@ uint32_t ymodem_receive(uint8_t *buf, uint32_t length)
     uint32_t packets_received;
     uint32_t errors;
     int32_t  first_try = 1;
-    uint8_t *buf_ptr;
+    uint32_t buf_index;
     uint32_t size = 0;
     uint32_t return_val = 0; /* Default to abnormal exit */
     uint32_t temp;
@@ -503,7 +549,7 @@ uint32_t ymodem_receive(uint8_t *buf, uint32_t length)
         first_try        = 0;
         packets_received = 0;
         file_done        = 0;
-        buf_ptr          = buf;
+        buf_index        = 0;
 
         while(0 == file_done)
         {
@@ -620,8 +666,19 @@ uint32_t ymodem_receive(uint8_t *buf, uint32_t length)
                             /* This shouldn't happen, but we check anyway in case the
                              * sender lied in its filename packet:
                              */
-                            if((buf_ptr + packet_length) - buf > length)
+                            if((buf_index + packet_length) > length)
+                            {
+                                _putchar(CAN);
+                                _putchar(CAN);
+                                _sleep(1);
+
+                                /* Terminate transfer immediately */
+                                file_done    = 1;
+                                session_done = 1;
+                            }
+                            else if((0 != handler) && (0 != handler(packet_data + PACKET_HEADER, (uint32_t)packet_length)))
                             {
+                                /* Handler rejected the data */
                                 _putchar(CAN);
                                 _putchar(CAN);
                                 _sleep(1);
@@ -632,12 +689,12 @@ uint32_t ymodem_receive(uint8_t *buf, uint32_t length)
                             }
                             else
                             {
-                                for (index=0; index < packet_length; index++)
+                                if(0 == handler)
                                 {
-                                    buf_ptr[index] = packet_data[PACKET_HEADER + index];
+                                    memcpy(&buf[buf_index], packet_data + PACKET_HEADER, packet_length);
                                 }
 
-                                buf_ptr += packet_length;
+                                buf_index += packet_length;
                                 _putchar(ACK);
                             }
                         }
@@ -651,6 +708,7 @@ uint32_t ymodem_receive(uint8_t *buf, uint32_t length)
             default: /* timeout or error */
                 if(packets_received != 0)
                 {
+                    g_ymodem_errors++;
                     if(++errors >= MAX_ERRORS)
                     {
                         _putchar(CAN);
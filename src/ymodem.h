@@ -53,12 +53,22 @@
 /* Number of consecutive receive errors before giving up: */
 #define MAX_ERRORS    (5)
 
+/*
+ * Optional handler for the data packets of a file being received. Returns 0 to
+ * accept the data or -1 to cancel the transfer.
+ */
+typedef int32_t (*ymodem_rx_handler_t)(const uint8_t *data, uint32_t len);
+
+/* Packets received in error, over all transfers */
+extern uint32_t g_ymodem_errors;
+
 void sf2bl_ymodem_init(void);
 void sf2bl_ymodem_deinit(void);
-uint32_t ymodem_receive(uint8_t *buf, uint32_t length);
+uint32_t ymodem_receive(uint8_t *buf, uint32_t length, ymodem_rx_handler_t handler);
 uint16_t sf2bl_crc16(const uint8_t *buf, uint32_t count);
 void _putchar(int32_t data);
 void _putstring(uint8_t *string);
+void _putdecimal(uint32_t value);
 void _put_wait(void);
 
 #endif  /* !define(_YMODEM_H) */